@@ -8,15 +8,40 @@
 #include <jansson_helper.h>
 #include <utils.h>
 
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//A stage of the schedule option, and the budget it has each time it runs
+typedef struct {
+	int stage;             //One of the STAGE_* values
+	uint64_t iterations;   //The most iterations the stage runs for, or 0 for no limit
+	uint64_t milliseconds; //The most time the stage runs for, or 0 for no limit
+} afl_schedule_stage_t;
+
 struct afl_state
 {
 	int skip_deterministic;
+	int trim;
 
 	char * input;
 	size_t input_length;
 	int iteration;
+	int walking_byte_iteration; //The iteration of the first walking_byte mutation
+	int trim_iteration; //The iteration of the last trim_input mutation
+	int first_stage; //The stage that the seeds added to the seed pool start at
+
+	//The stages to run, in order, when the schedule option is given
+	afl_schedule_stage_t * schedule;
+	size_t schedule_count;
+	uint64_t stage_start_time; //When the current scheduled stage started, in milliseconds
 
 	mutate_info_t info;
 };
@@ -31,7 +56,7 @@ mutator_t afl_mutator = {
 	afl_free_state,
 	FUNCNAME(set_state),
 	FUNCNAME(get_current_iteration),
-	afl_get_total_iteration_count,
+	FUNCNAME(get_total_iteration_count),
 	FUNCNAME(get_input_info),
 	FUNCNAME(set_input),
 	FUNCNAME(help)
@@ -52,18 +77,23 @@ static int afl_splice(mutate_info_t * info, mutate_buffer_t * buf)
 }
 
 static int(*const mutate_funcs[])(mutate_info_t *, mutate_buffer_t *) = {
+	trim_input,
+	input_to_state,
 	single_walking_bit,
 	two_walking_bit,
 	four_walking_bit,
 	walking_byte,
 	two_walking_byte,
 	four_walking_byte,
+	eight_walking_byte,
 	one_byte_arithmetics,
 	two_byte_arithmetics,
 	four_byte_arithmetics,
+	eight_byte_arithmetics,
 	interesting_one_byte,
 	interesting_two_byte,
 	interesting_four_byte,
+	interesting_eight_byte,
 	dictionary_overwrite,
 	dictionary_insert,
 	afl_havoc,
@@ -72,24 +102,222 @@ static int(*const mutate_funcs[])(mutate_info_t *, mutate_buffer_t *) = {
 
 /* Fuzzing stages */
 enum {
-	/* 00 */ STAGE_FLIP1,
-	/* 01 */ STAGE_FLIP2,
-	/* 02 */ STAGE_FLIP4,
-	/* 03 */ STAGE_FLIP8,
-	/* 04 */ STAGE_FLIP16,
-	/* 05 */ STAGE_FLIP32,
-	/* 06 */ STAGE_ARITH8,
-	/* 07 */ STAGE_ARITH16,
-	/* 08 */ STAGE_ARITH32,
-	/* 09 */ STAGE_INTEREST8,
-	/* 10 */ STAGE_INTEREST16,
-	/* 11 */ STAGE_INTEREST32,
-	/* 12 */ STAGE_EXTRAS_UO,
-	/* 13 */ STAGE_EXTRAS_UI,
-	/* 14 */ STAGE_HAVOC,
-	/* 15 */ STAGE_SPLICE,
+	/* 00 */ STAGE_TRIM,
+	/* 01 */ STAGE_INPUT_TO_STATE,
+	/* 02 */ STAGE_FLIP1,
+	/* 03 */ STAGE_FLIP2,
+	/* 04 */ STAGE_FLIP4,
+	/* 05 */ STAGE_FLIP8,
+	/* 06 */ STAGE_FLIP16,
+	/* 07 */ STAGE_FLIP32,
+	/* 08 */ STAGE_FLIP64,
+	/* 09 */ STAGE_ARITH8,
+	/* 10 */ STAGE_ARITH16,
+	/* 11 */ STAGE_ARITH32,
+	/* 12 */ STAGE_ARITH64,
+	/* 13 */ STAGE_INTEREST8,
+	/* 14 */ STAGE_INTEREST16,
+	/* 15 */ STAGE_INTEREST32,
+	/* 16 */ STAGE_INTEREST64,
+	/* 17 */ STAGE_EXTRAS_UO,
+	/* 18 */ STAGE_EXTRAS_UI,
+	/* 19 */ STAGE_HAVOC,
+	/* 20 */ STAGE_SPLICE,
+	/* 21 */ STAGE_COUNT //The number of stages, i.e. the number of mutate_funcs and stage_names
 };
 
+//The names of the stages, as they're given in the schedule option
+static const char * stage_names[] = {
+	"trim", "input_to_state", "flip1", "flip2", "flip4", "flip8", "flip16", "flip32", "flip64",
+	"arith8", "arith16", "arith32", "arith64", "interesting8", "interesting16", "interesting32", "interesting64",
+	"dictionary_overwrite", "dictionary_insert", "havoc", "splice"
+};
+
+static uint64_t current_time_ms(void)
+{
+#ifdef _WIN32
+	return GetTickCount64();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+#endif
+}
+
+/**
+ * Parses the schedule option, a list of the stages to run in order.  Each stage is an object with
+ * the stage's name and optionally the most iterations and milliseconds it can run for.  If the
+ * options don't have a schedule, the current schedule is kept.
+ * @param state - the afl_state_t to set the schedule of
+ * @param options - the JSON options (or saved state) to read the schedule from
+ * @return - 0 on success, nonzero if the schedule isn't valid
+ */
+static int parse_schedule(afl_state_t * state, char * options)
+{
+	afl_schedule_stage_t * stage;
+	json_t * root, * list, * stage_obj;
+	char * name;
+	size_t index, i;
+	int result, ret = 0;
+
+	root = json_loads(options, 0, NULL);
+	list = json_object_get(root, "schedule");
+	if (!list) {
+		json_decref(root);
+		return 0;
+	}
+	free(state->schedule);
+	state->schedule_count = 0;
+	state->schedule = NULL;
+	if (!json_is_array(list) || !json_array_size(list)) {
+		printf("The schedule option must be a list of one or more stages\n");
+		json_decref(root);
+		return 1;
+	}
+	state->schedule = (afl_schedule_stage_t *)calloc(json_array_size(list), sizeof(afl_schedule_stage_t));
+	if (!state->schedule) {
+		json_decref(root);
+		return 1;
+	}
+
+	json_array_foreach(list, index, stage_obj)
+	{
+		stage = &state->schedule[state->schedule_count++];
+		name = get_string_options_from_json(stage_obj, "stage", &result);
+		if (result <= 0) {
+			printf("Each stage of the schedule must have a stage name\n");
+			ret = 1;
+			break;
+		}
+		for (stage->stage = 0; stage->stage < STAGE_COUNT && strcmp(name, stage_names[stage->stage]); stage->stage++);
+		if (stage->stage == STAGE_COUNT)
+			printf("Unknown stage '%s' in the schedule\n", name);
+		free(name);
+		if (stage->stage == STAGE_COUNT) {
+			ret = 1;
+			break;
+		}
+		for (i = 0; i < index && state->schedule[i].stage != stage->stage; i++);
+		if (i < index) {
+			printf("The %s stage is in the schedule more than once\n", stage_names[stage->stage]);
+			ret = 1;
+			break;
+		}
+		//The deterministic stages only run in the first cycle, so they can't come after the random ones
+		if (index && stage->stage < STAGE_HAVOC && state->schedule[index - 1].stage >= STAGE_HAVOC) {
+			printf("The %s stage can't come after the havoc and splice stages in the schedule\n", stage_names[stage->stage]);
+			ret = 1;
+			break;
+		}
+
+		stage->iterations = get_uint64t_options_from_json(stage_obj, "iterations", &result);
+		if (result >= 0)
+			stage->milliseconds = get_uint64t_options_from_json(stage_obj, "milliseconds", &result);
+		if (result < 0) {
+			printf("The iterations and milliseconds of the %s stage must be integers\n", stage_names[stage->stage]);
+			ret = 1;
+			break;
+		}
+	}
+	json_decref(root);
+
+	if (ret) {
+		free(state->schedule);
+		state->schedule = NULL;
+		state->schedule_count = 0;
+	}
+	return ret;
+}
+
+/**
+ * Adds the schedule and the time spent in the current stage to the mutator's state
+ * @param obj - the JSON object to add the schedule to
+ * @param state - the afl_state_t with the schedule
+ * @return - 1 on success, 0 on failure
+ */
+static int add_schedule_to_json(json_t * obj, afl_state_t * state)
+{
+	json_t *temp, *schedule_list, *stage_obj;
+	size_t i;
+
+	schedule_list = json_array();
+	if (!schedule_list)
+		return 0;
+	json_object_set_new(obj, "schedule", schedule_list);
+	for (i = 0; i < state->schedule_count; i++)
+	{
+		stage_obj = json_object();
+		if (!stage_obj)
+			return 0;
+		json_array_append_new(schedule_list, stage_obj);
+		ADD_STRING(temp, stage_names[state->schedule[i].stage], stage_obj, "stage");
+		if (state->schedule[i].iterations)
+			ADD_UINT64T(temp, state->schedule[i].iterations, stage_obj, "iterations");
+		if (state->schedule[i].milliseconds)
+			ADD_UINT64T(temp, state->schedule[i].milliseconds, stage_obj, "milliseconds");
+	}
+	ADD_UINT64T(temp, current_time_ms() - state->stage_start_time, obj, "schedule_stage_elapsed");
+	return 1;
+}
+
+/* Returns the position of a stage in the schedule, or the number of scheduled stages if it isn't in it */
+static size_t find_scheduled_stage(afl_state_t * state, int stage)
+{
+	size_t i;
+	for (i = 0; i < state->schedule_count && state->schedule[i].stage != stage; i++);
+	return i;
+}
+
+/* Starts the stage that comes after the given stage in the schedule, or ends the cycle if there isn't one */
+static void start_next_scheduled_stage(afl_state_t * state, int stage)
+{
+	size_t i = find_scheduled_stage(state, stage) + 1;
+	state->info.stage = i < state->schedule_count ? state->schedule[i].stage : STAGE_COUNT;
+	state->info.stage_cur = 0;
+	state->stage_start_time = current_time_ms();
+}
+
+/**
+ * Starts the next cycle of the schedule.  As in afl, the deterministic stages only run in the first
+ * cycle, and the later cycles start at the schedule's first havoc or splice stage.
+ * @param state - the afl_state_t to restart the schedule of
+ * @return - 0 on success, or nonzero if the schedule doesn't have a havoc or splice stage
+ */
+static int restart_schedule(afl_state_t * state)
+{
+	size_t i;
+
+	for (i = 0; i < state->schedule_count && state->schedule[i].stage < STAGE_HAVOC; i++);
+	if (i == state->schedule_count)
+		return 1;
+	state->info.stage = state->schedule[i].stage;
+	state->info.stage_cur = 0;
+	state->stage_start_time = current_time_ms();
+	return 0;
+}
+
+/* Runs the current stage of the schedule until it generates an output, moving on to the next stage
+   of the schedule whenever a stage finishes or uses up its budget */
+static int mutate_scheduled(afl_state_t * state, mutate_buffer_t * buf)
+{
+	afl_schedule_stage_t * stage;
+	int ret = MUTATOR_DONE, current;
+	size_t i;
+
+	while (ret == MUTATOR_DONE && state->info.stage < STAGE_COUNT)
+	{
+		current = state->info.stage;
+		i = find_scheduled_stage(state, current);
+		stage = i < state->schedule_count ? &state->schedule[i] : NULL;
+		if (stage && (!stage->iterations || state->info.stage_cur < stage->iterations)
+				&& (!stage->milliseconds || current_time_ms() - state->stage_start_time < stage->milliseconds))
+			ret = mutate_one(&state->info, buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+		if (ret == MUTATOR_DONE)
+			start_next_scheduled_stage(state, current);
+	}
+	return ret;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //// API methods ///////////////////////////////////////////////////////////////////////////
@@ -128,13 +356,38 @@ static afl_state_t * setup_options(char * options)
 		return NULL;
 	}
 	state->info.should_skip_previous = 1;
+	state->info.random_stages = (1ULL << STAGE_HAVOC) | (1ULL << STAGE_SPLICE);
+	state->info.stage = STAGE_INPUT_TO_STATE;
+	state->first_stage = STAGE_INPUT_TO_STATE;
 	if (!options || !strlen(options))
 		return state;
 
+	if (parse_schedule(state, options)) {
+		FUNCNAME(cleanup)(state);
+		return NULL;
+	}
+	//The stages that come before a stage in afl's order may not be in the schedule, so values
+	//they would have tried aren't skipped unless skip_previous_stages is given
+	if (state->schedule_count)
+		state->info.should_skip_previous = 0;
+
 	PARSE_MUTATE_INFO_OPTIONS(state, options, FUNCNAME(cleanup), 0, 0);
 	PARSE_OPTION_INT(state, options, skip_deterministic, "skip_deterministic", FUNCNAME(cleanup));
+	PARSE_OPTION_INT(state, options, trim, "trim", FUNCNAME(cleanup));
+	if (state->trim)
+		state->info.stage = state->first_stage = STAGE_TRIM;
 	if (state->skip_deterministic)
-		state->info.stage = STAGE_HAVOC;
+		state->info.stage = state->first_stage = STAGE_HAVOC;
+
+	if (state->schedule_count) {
+		//Each stage stops at the end of its budget, so mutate_one only runs the current stage
+		state->info.one_stage_only = 1;
+		state->info.stage = state->schedule[0].stage;
+		if (state->skip_deterministic && restart_schedule(state))
+			state->info.stage = ARRAY_SIZE(mutate_funcs);
+		state->first_stage = state->info.stage;
+		state->stage_start_time = current_time_ms();
+	}
 	return state;
 }
 
@@ -162,6 +415,7 @@ AFL_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * inp
 AFL_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 {
 	cleanup_mutate_info(&((afl_state_t *)mutator_state)->info);
+	free(((afl_state_t *)mutator_state)->schedule);
 	GENERIC_MUTATOR_CLEANUP(afl_state_t)
 }
 
@@ -169,7 +423,7 @@ static int mutate_inner(void * mutator_state, char * buffer, size_t buffer_lengt
 {
 	afl_state_t * state = (afl_state_t *)mutator_state;
 	mutate_buffer_t buf;
-	int ret;
+	int ret, restarted = 0;
 	if (buffer_length < state->input_length)
 		return -1;
 
@@ -182,15 +436,31 @@ static int mutate_inner(void * mutator_state, char * buffer, size_t buffer_lengt
 		return -1;
 	state->iteration++;
 	while (1) {
-		ret = mutate_one(&state->info, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
-		if (ret != MUTATOR_DONE)
+		if (state->schedule_count)
+			ret = mutate_scheduled(state, &buf);
+		else
+			ret = mutate_one(&state->info, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+		if (ret != MUTATOR_DONE) {
+			//Remember where the walking_byte stage started, so its results can be matched up to a byte
+			if (ret > 0 && state->info.stage == STAGE_FLIP8 && state->info.stage_cur == 1)
+				state->walking_byte_iteration = state->iteration;
+			//and which output removed the block that the trimming stage is waiting on a verdict for
+			if (ret > 0 && state->info.stage == STAGE_TRIM)
+				state->trim_iteration = state->iteration;
 			break;
+		}
 
 		//We've finished this cycle, reset back to havoc and continue
-		state->info.stage = STAGE_HAVOC;
+		if (!state->schedule_count)
+			state->info.stage = STAGE_HAVOC;
+		//A schedule without havoc or splice is done after one cycle, as is one whose random stages
+		//don't have any outputs (e.g. splice without any splice files)
+		else if (restarted++ || restart_schedule(state))
+			break;
 		state->skip_deterministic = 1;
 		state->info.queue_cycle++;
 	}
+	finish_mutate_info_output(&state->info, state->iteration);
 	if (is_thread_safe && release_mutex(state->info.mutate_mutex))
 		return -1;
 
@@ -242,7 +512,12 @@ AFL_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 	state_obj = json_object();
 	ADD_INT(temp, state->iteration, state_obj, "iteration");
 	ADD_INT(temp, state->skip_deterministic, state_obj, "skip_deterministic");
-	if (!add_mutate_info_to_json(state_obj, &state->info))
+	ADD_INT(temp, state->walking_byte_iteration, state_obj, "walking_byte_iteration");
+	ADD_INT(temp, state->trim, state_obj, "trim");
+	ADD_INT(temp, state->trim_iteration, state_obj, "trim_iteration");
+	if (state->schedule_count && !add_schedule_to_json(state_obj, state))
+		return NULL;
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
 		return NULL;
 	ret = json_dumps(state_obj, 0);
 	json_decref(state_obj);
@@ -259,13 +534,19 @@ AFL_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 AFL_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state)
 {
 	afl_state_t * current_state = (afl_state_t *)mutator_state;
+	uint64_t temp_uint64t, elapsed = 0;
 	int result, temp_int;
 	if (!state)
 		return 1;
 	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
 	GET_INT(temp_int, state, current_state->skip_deterministic, "skip_deterministic", result);
-	if (get_mutate_info_from_json(state, &current_state->info))
+	GET_INT(temp_int, state, current_state->walking_byte_iteration, "walking_byte_iteration", result);
+	GET_INT(temp_int, state, current_state->trim, "trim", result);
+	GET_INT(temp_int, state, current_state->trim_iteration, "trim_iteration", result);
+	GET_UINT64T(temp_uint64t, state, elapsed, "schedule_stage_elapsed", result);
+	if (parse_schedule(current_state, state) || get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
 		return 1;
+	current_state->stage_start_time = current_time_ms() - elapsed;
 	return 0;
 }
 
@@ -280,6 +561,441 @@ AFL_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 	GENERIC_MUTATOR_GET_ITERATION(afl_state_t);
 }
 
+/**
+ * Counts the iterations that a stage of the schedule runs for, i.e. its iteration budget or the
+ * number of outputs that the stage has for the input, whichever is smaller
+ * @param state - the afl_state_t with the schedule
+ * @param stage - the stage to count the iterations of
+ * @return - the number of iterations, or -1 if it isn't known ahead of time
+ */
+static int64_t count_scheduled_stage(afl_state_t * state, afl_schedule_stage_t * stage)
+{
+	int bits_per_stage[] = { 1, 2, 4, 8, 16, 32, 64 };
+	int64_t count = -1;
+	int bits;
+
+	if (stage->stage >= STAGE_FLIP1 && stage->stage <= STAGE_FLIP64) {
+		bits = bits_per_stage[stage->stage - STAGE_FLIP1];
+		count = (int64_t)count_mutable_positions(&state->info, (u8 *)state->input, state->input_length,
+			bits < 8 ? bits : bits >> 3, bits < 8);
+	}
+	else if (stage->stage == STAGE_INPUT_TO_STATE)
+		count = count_input_to_state_candidates(&state->info, (u8 *)state->input, state->input_length);
+	else if (stage->stage == STAGE_EXTRAS_UO || stage->stage == STAGE_EXTRAS_UI)
+		count = count_dictionary_candidates(&state->info, (u8 *)state->input, state->input_length,
+			stage->stage == STAGE_EXTRAS_UI, 0);
+
+	//A stage with only a time budget (or none) runs for as long as it has outputs
+	if (stage->iterations && (count < 0 || (uint64_t)count > stage->iterations))
+		count = stage->iterations > INT64_MAX ? INT64_MAX : (int64_t)stage->iterations;
+	return count;
+}
+
+/**
+ * This function will return the total possible number of mutations with this mutator.  Without
+ * the schedule option, or with a schedule that has a havoc or splice stage, the mutator doesn't run
+ * out of mutations.  Otherwise, the total is the sum of the scheduled stages' iterations, which is
+ * only known when each stage has an iteration budget or can count its outputs ahead of time.  The
+ * time budgets can end the stages early, so the total is the most mutations the mutator generates.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @return - the number of possible mutations with this mutator, or -1 if it's unknown or infinite
+ */
+AFL_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int64_t total = 0, count = 0;
+	size_t i;
+
+	if (!state->schedule_count || take_mutex(state->info.mutate_mutex))
+		return -1;
+	for (i = 0; i < state->schedule_count && count >= 0 && total <= INT_MAX; i++)
+	{
+		count = -1;
+		if (state->schedule[i].stage < STAGE_HAVOC) //skip_deterministic skips all of the stages before havoc
+			count = state->skip_deterministic ? 0 : count_scheduled_stage(state, &state->schedule[i]);
+		total += count;
+	}
+	if (release_mutex(state->info.mutate_mutex) || count < 0 || total > INT_MAX)
+		return -1;
+	return (int)total;
+}
+
+/**
+ * Removes the block that the last trimming stage output removed from the input
+ * @param state - the afl_state_t to trim the input of
+ * @return - 0 on success, nonzero on failure
+ */
+static int apply_trim(afl_state_t * state)
+{
+	uint64_t checksum = state->info.eff_checksum;
+	u32 pos, length;
+
+	if (!accept_trim(&state->info, &pos, &length))
+		return 0;
+	memmove(state->input + pos, state->input + pos + length, state->input_length - pos - length);
+	state->input_length -= length;
+
+	//The trimmed input behaves the same as the old one, so its checksum is still the same
+	if (set_mutate_info_input(&state->info, (u8 *)state->input, state->input_length)
+		|| report_input_checksum(&state->info, state->input_length, checksum))
+		return 1;
+	state->walking_byte_iteration = 0;
+	return 0;
+}
+
+/**
+ * This function reports the result of running one of the mutator's outputs.  The results of the
+ * walking byte stage are used to build an effector map, which the arithmetic, interesting value and
+ * dictionary overwrite stages use to skip the bytes that don't affect the execution.  The result
+ * for the unmodified input should be reported first, with an iteration of 0.  The deterministic
+ * stages only start using the effector map once every walking byte result has been reported.
+ * If the scheduler option is set, the results are also used to learn which havoc operators find
+ * new coverage, and if the dictionary_scores option is set, which dictionary tokens do.  During
+ * the trimming stage, the block removed by the last output is removed from the input if the
+ * output is reported with the MUTATE_RESULT_UNCHANGED flag, or with the same checksum as the
+ * unmodified input.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated), or 0 for the unmodified input
+ * @param flags - MUTATE_RESULT_* flags that describe the result
+ * @param checksum - a hash of the output's execution, such as a hash of the coverage it produced
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	uint64_t pos;
+	int ret = 0;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	if (iteration == 0)
+		ret = report_input_checksum(&state->info, state->input_length, checksum);
+	else if (state->trim_iteration && iteration == state->trim_iteration) {
+		if ((flags & MUTATE_RESULT_UNCHANGED) || (state->info.eff_has_checksum && checksum == state->info.eff_checksum))
+			ret = apply_trim(state);
+	}
+	else if (state->walking_byte_iteration && iteration >= state->walking_byte_iteration
+			&& !locate_mutable_position(&state->info, (u8 *)state->input, state->input_length,
+				iteration - state->walking_byte_iteration, 1, 0, &pos)) //Find the byte that the output flipped
+		ret = report_walking_byte_result(&state->info, state->input_length, (size_t)pos, checksum);
+	report_mutate_info_result(&state->info, iteration, flags);
+	if (release_mutex(state->info.mutate_mutex) || ret)
+		return -1;
+	return 0;
+}
+
+/**
+ * This function adds the operands of a comparison that the target made while processing the
+ * input.  The input-to-state stage looks for each operand in the input and replaces it with the
+ * other one, so that comparisons against magic values and checksums can be solved directly.
+ * The operands should be added after the input is set and before the mutator reaches the
+ * input-to-state stage, and need to be added again after set_state.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param operand1 - the first operand, as it was in the target's memory
+ * @param operand2 - the second operand, as it was in the target's memory
+ * @param length - the length of the operands.  Operands with a length of 2, 4, or 8 bytes are
+ * treated as little-endian integers.
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(add_comparison)(void * mutator_state, char * operand1, char * operand2, size_t length)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = add_comparison_operands(&state->info, (u8 *)operand1, (u8 *)operand2, length);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function copies the mutator's current input, which is smaller than the original input if
+ * the trimming stage has removed any blocks from it.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param buffer - a buffer that the input will be written to
+ * @param buffer_length - the size of the passed in buffer argument.  The size of the input can be
+ * found with the get_input_info function.
+ * @return the length of the input, or -1 if the buffer is too small
+ */
+AFL_MUTATOR_API int FUNCNAME(get_input)(void * mutator_state, char * buffer, size_t buffer_length)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret = -1;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	if (buffer_length >= state->input_length) {
+		memcpy(buffer, state->input, state->input_length);
+		ret = (int)state->input_length;
+	}
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function updates the statistics about the seed being mutated.  If the power_schedule
+ * option is set, the statistics are used to recompute perf_score (and havoc_div), so seeds that
+ * are slow or whose paths have already been exercised often get fewer havoc rounds.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param stats - a JSON object with the seed's statistics.  Any of exec_us, avg_exec_us, bitmap_size,
+ * avg_bitmap_size, depth, handicap, fuzz_level, path_frequency, avg_path_frequency, and new_paths
+ * can be given; the others keep their previous values.
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(set_seed_stats)(void * mutator_state, char * stats)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = set_mutate_info_seed_stats(&state->info, stats);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function sets the weights used to choose the offsets that the havoc and splice stages
+ * mutate, e.g. from taint analysis or an earlier effector map.  Each offset is chosen with
+ * probability proportional to its weight.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param weights - the weight of each of the input's offsets, or NULL to choose them uniformly again
+ * @param length - the number of entries in weights
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(set_position_weights)(void * mutator_state, uint32_t * weights, size_t length)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = position_sampler_set(&state->info.positions, weights, length);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function adds a seed to the mutator's seed pool.  The seed can be selected with select_seed
+ * without recreating the mutator, and is spliced with the selected seed in the meantime.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param input - the seed to add
+ * @param input_length - the size in bytes of the input buffer.
+ * @return the id of the new seed on success, or -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int id;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	id = add_mutate_info_seed(&state->info, input, input_length, state->first_stage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return id;
+}
+
+/**
+ * This function removes a seed from the mutator's seed pool.  The selected seed can't be removed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to remove, as returned by add_seed
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = remove_mutate_info_seed(&state->info, id);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function selects which of the seeds in the mutator's seed pool is mutated.  Each seed keeps
+ * its own progress through the stages, so the mutations continue where they left off when a seed
+ * is selected again.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to select, as returned by add_seed, or 0 for the input the
+ * mutator was created with
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = select_mutate_info_seed(&state->info, id, &state->input, &state->input_length);
+	if (!ret) {
+		state->walking_byte_iteration = 0;
+		state->trim_iteration = 0;
+		state->stage_start_time = current_time_ms(); //The seed's current stage gets a new time budget
+	}
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function looks up the provenance record of one of the mutator's recent outputs, i.e. what's
+ * needed to regenerate the output with the regenerate function.  The provenance_log option sets
+ * how many outputs have their records kept.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated)
+ * @param record - used to return the output's provenance record
+ * @return 0 on success and -1 if the output's record isn't in the log
+ */
+AFL_MUTATOR_API int FUNCNAME(get_provenance)(void * mutator_state, int iteration, mutate_provenance_t * record)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = provenance_log_find(&state->info.provenance, (uint64_t)iteration, record);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function regenerates an output from its provenance record, without changing the mutator's
+ * progress.  The mutator can be the one that generated the output, or one created from its saved
+ * state.  The seed that the output was generated from must be selected, and the output is only the
+ * same as the original if the options and learned statistics it depended on haven't changed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param record - the output's provenance record, as returned by get_provenance
+ * @param buffer - a buffer that the regenerated output will be written to
+ * @param buffer_length - the size of the passed in buffer argument.  It should be the same size
+ * that was passed to the mutate function when the output was generated.
+ * @return the length of the regenerated output, or -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(regenerate)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t buffer_length)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	mutate_buffer_t buf;
+	int ret = -1;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	if (buffer_length >= state->input_length) {
+		buf.buffer = (uint8_t *)buffer;
+		buf.length = state->input_length;
+		buf.max_length = buffer_length;
+		memcpy(buf.buffer, state->input, buf.length);
+		ret = regenerate_mutate_info_output(&state->info, record, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+	}
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function minimizes an output that was found to be interesting (e.g. because it crashed the
+ * target), by reverting the stacked havoc operations that it doesn't need.  The output is
+ * regenerated from its provenance record to find the operations, and chunks of them are reverted
+ * until none of the remaining ones can be, so only a handful of candidates need to be tried.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param record - the output's provenance record, as returned by get_provenance
+ * @param buffer - a buffer holding the output.  The minimized output will be written to it.
+ * @param length - the length of the output
+ * @param buffer_length - the size of the passed in buffer argument.  It should be the same size
+ * that was passed to the mutate function when the output was generated.
+ * @param verdict - a function that's called with each candidate, which should return nonzero if the
+ * candidate is still interesting.  It can't call any of the mutator's functions.
+ * @param context - an argument to pass to verdict
+ * @return the length of the minimized output, or -1 if the output can't be regenerated or on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(minimize)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t length,
+	size_t buffer_length, edit_trace_verdict_t verdict, void * context)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+	mutate_buffer_t buf;
+	char * output;
+	int ret = -1;
+
+	if (length > buffer_length)
+		return -1;
+	output = (char *)malloc(length ? length : 1);
+	if (!output)
+		return -1;
+	memcpy(output, buffer, length);
+
+	if (take_mutex(state->info.mutate_mutex)) {
+		free(output);
+		return -1;
+	}
+	if (buffer_length >= state->input_length) {
+		buf.buffer = (uint8_t *)buffer;
+		buf.length = state->input_length;
+		buf.max_length = buffer_length;
+		memcpy(buf.buffer, state->input, buf.length);
+		ret = minimize_mutate_info_output(&state->info, record, &buf, (u8 *)output, length,
+			mutate_funcs, ARRAY_SIZE(mutate_funcs), verdict, context);
+	}
+	free(output);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function gets the statistics of the duplicate output filter that the dedup_size and
+ * dedup_file options enable.  The duplicate rate is duplicates / checked; the duplicates from the
+ * random stages were replaced with new outputs before they were returned.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param checked - used to return the number of outputs that were checked against the filter
+ * @param duplicates - used to return the number of those outputs that were already in the filter
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	*checked = state->info.dedup.checked;
+	*duplicates = state->info.dedup.duplicates;
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+AFL_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	afl_state_t * state = (afl_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(afl_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -289,6 +1005,12 @@ AFL_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
  */
 AFL_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
 {
+	//Update what's known about the new input (splice partners, dictionary token locations)
+	if (set_mutate_info_input(&((afl_state_t *)mutator_state)->info, (u8 *)new_input, input_length))
+		return -1;
+	((afl_state_t *)mutator_state)->walking_byte_iteration = 0;
+	((afl_state_t *)mutator_state)->trim_iteration = 0;
+	clear_comparison_operands(&((afl_state_t *)mutator_state)->info);
 	GENERIC_MUTATOR_SET_INPUT(afl_state_t);
 }
 
@@ -315,23 +1037,95 @@ AFL_MUTATOR_API int FUNCNAME(help)(char ** help_str)
 	GENERIC_MUTATOR_HELP(
 "afl - afl-based mutator\n"
 "Options:\n"
-"  dictionary            A file or directory containing dictionary to use while\n"
-"                          mangling input\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  dictionary            A dictionary file, a directory with a file for each\n"
+"                          token, or a compiled dictionary file (see\n"
+"                          save_dictionary) to use while mangling input.  The\n"
+"                          tokens in a dictionary file can hold bytes above 127\n"
+"                          (such as UTF-8) without escaping them.\n"
+"  dictionary_scores     Set to 1 to count how often each dictionary token finds\n"
+"                          new coverage (as given to report_result), and use\n"
+"                          the productive tokens more often\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
 "  havoc_div             A divisor for determining the number of rounds that\n"
 "                          the havoc stage should run (typically 1, 2, 5, or 10)\n"
+"  havoc_weights         An object that maps havoc operators to weights, such as\n"
+"                          {\"delete\": 4, \"flip_bit\": 0}.  Each operator is\n"
+"                          chosen with probability proportional to its weight.\n"
+"                          The operators are flip_bit, interesting8,\n"
+"                          interesting16, interesting32, subtract8, add8,\n"
+"                          subtract16, add16, subtract32, add32, random_byte,\n"
+"                          delete (weight 2 by default, the others 1), clone,\n"
+"                          overwrite, dictionary_overwrite, and\n"
+"                          dictionary_insert.  Ignored when scheduler is set.\n"
+"  memory_limit          The most bytes that the dictionary, the splice files,\n"
+"                          and the seeds added with add_seed can hold.  The\n"
+"                          tokens and splice files that don't fit are skipped,\n"
+"                          and splice files are evicted to make room for new\n"
+"                          seeds.  Default is 0 (no limit).\n"
 "  perf_score            A performance score used to determine how long to run\n"
 "                          the havoc and splice stages.  Typically 100, higher\n"
 "                          results in a larger number of mutations in these\n"
 "                          stages before moving on.\n"
+"  position_weights      A file with a weight for each of the input's offsets,\n"
+"                          separated by whitespace or commas.  The havoc and\n"
+"                          splice stages mutate each offset with probability\n"
+"                          proportional to its weight.\n"
+"  power_schedule        How to compute perf_score from the statistics given to\n"
+"                          set_seed_stats; either none (the default), explore,\n"
+"                          fast, coe, exploit, lin, or quad\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
+"  provenance_log        The number of recent outputs to keep a provenance\n"
+"                          record of, so they can be rebuilt with regenerate\n"
+"                          instead of being saved.  Default is 0 (no log).\n"
 "  queue_cycle           The queue round counter.  Used in determining how to\n"
 "                          mutate input.  Generally this shouldn't need to be set\n"
 "  random_state0         The first half of the seed to afl's random number\n"
 "                          generator\n"
 "  random_state1         The second half of the seed to afl's random number\n"
 "                          generator\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
+"  save_dictionary       A file to write the loaded dictionary to, in a compiled\n"
+"                          format that the dictionary option can map instead of\n"
+"                          parsing it\n"
+"  schedule              A list of the stages to run, in order, instead of all of\n"
+"                          afl's stages.  Each is an object with the stage (trim,\n"
+"                          input_to_state, flip1, flip2, flip4, flip8, flip16,\n"
+"                          flip32, flip64, arith8, arith16, arith32, arith64,\n"
+"                          interesting8, interesting16, interesting32,\n"
+"                          interesting64, dictionary_overwrite,\n"
+"                          dictionary_insert, havoc, or splice), and optionally\n"
+"                          the most iterations and milliseconds it runs for.\n"
+"                          The havoc and splice stages come last.  After the\n"
+"                          first cycle, the schedule restarts at its first havoc\n"
+"                          or splice stage, or ends if it has none.\n"
+"  scheduler             Set to 1 to learn which havoc operators find new\n"
+"                          coverage (as given to report_result), and use them\n"
+"                          more often\n"
 "  skip_deterministic    Instruct AFL to skip the deterministic mutations\n"
 "  splice_filenames      An array of files to use during afl's splice stage,\n"
 "                          for mixing with the input\n"
+"  trim                  Set to 1 to try removing blocks of the input before the\n"
+"                          deterministic stages.  Removals are kept if the output\n"
+"                          is reported as unchanged with report_result.\n"
 "\n"
 	);
 }
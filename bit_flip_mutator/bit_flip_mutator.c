@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <utils.h>
 #include <jansson.h>
@@ -29,9 +30,10 @@ static int(*const mutate_funcs[])(mutate_info_t *, mutate_buffer_t *) = {
 	walking_byte,
 	two_walking_byte,
 	four_walking_byte,
+	eight_walking_byte,
 };
 
-mutator_t arithmetic_mutator = {
+mutator_t bit_flip_mutator = {
 	FUNCNAME(create),
 	FUNCNAME(cleanup),
 	FUNCNAME(mutate),
@@ -54,14 +56,14 @@ mutator_t arithmetic_mutator = {
 #ifndef ALL_MUTATORS_IN_ONE
 BF_MUTATOR_API void init(mutator_t * m)
 {
-	memcpy(m, &arithmetic_mutator, sizeof(mutator_t));
+	memcpy(m, &bit_flip_mutator, sizeof(mutator_t));
 }
 #endif
 
 static bit_flip_state_t * setup_options(char * options)
 {
 	bit_flip_state_t * state;
-	int bits_per_stage[] = { 1, 2, 4, 8, 16, 32 };
+	int bits_per_stage[] = { 1, 2, 4, 8, 16, 32, 64 };
 	int i;
 
 	state = (bit_flip_state_t *)malloc(sizeof(bit_flip_state_t));
@@ -193,7 +195,7 @@ BF_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 	state_obj = json_object();
 	ADD_INT(temp, state->iteration, state_obj, "iteration");
 	ADD_INT(temp, state->num_bits, state_obj, "num_bits");
-	if (!add_mutate_info_to_json(state_obj, &state->info))
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
 		return NULL;
 
 	ret = json_dumps(state_obj, 0);
@@ -216,7 +218,7 @@ BF_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state)
 		return 1;
 	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
 	GET_INT(temp_int, state, current_state->num_bits, "num_bits", result);
-	if (get_mutate_info_from_json(state, &current_state->info))
+	if (get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
 		return 1;
 	return 0;
 }
@@ -241,19 +243,23 @@ BF_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 BF_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state)
 {
 	bit_flip_state_t * state = (bit_flip_state_t *)mutator_state;
-	if (state->info.one_stage_only)
+	int bits_per_stage[] = { 1, 2, 4, 8, 16, 32, 64 };
+	uint64_t total = 0;
+	int i;
+
+	//Each stage flips num_bits at every position where they fit in the regions that can be mutated.
+	//Counting them builds the region map, which mutate uses too.
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	for (i = 0; i < ARRAY_SIZE(bits_per_stage); i++)
 	{
-		if(state->num_bits < 8) //1, 2, 4
-			return (state->input_length << 3) - (state->num_bits - 1);
-		return state->input_length - ((state->num_bits >> 3) - 1); //8, 16, 32
+		if (!state->info.one_stage_only || bits_per_stage[i] == state->num_bits)
+			total += count_mutable_positions(&state->info, (u8 *)state->input, state->input_length,
+				bits_per_stage[i] < 8 ? bits_per_stage[i] : bits_per_stage[i] >> 3, bits_per_stage[i] < 8);
 	}
-	//Add up all rounds
-	return ((state->input_length << 3) //1
-		+ ((state->input_length << 3) - 1) //2
-		+ ((state->input_length << 3) - 3) //4
-		+ state->input_length //8
-		+ (state->input_length - 1) //16
-		+ (state->input_length - 3)); //32
+	if (release_mutex(state->info.mutate_mutex) || total > INT_MAX)
+		return -1;
+	return (int)total;
 }
 
 /**
@@ -269,6 +275,28 @@ BF_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inp
 	SINGLE_INPUT_GET_INFO(bit_flip_state_t);
 }
 
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+BF_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	bit_flip_state_t * state = (bit_flip_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(bit_flip_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -291,9 +319,31 @@ BF_MUTATOR_API int FUNCNAME(help)(char **help_str)
 	GENERIC_MUTATOR_HELP(
 "bit_flip - afl-based bit flip mutator\n"
 "Options:\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
 "  num_bits              The number of bits to operate on; either 1, 2, 4, 8,\n"
-"                          16, or 32. The default option is to do all six of\n"
-"                          the options, one after another.\n"
+"                          16, 32, or 64. The default option is to do all\n"
+"                          seven of the options, one after another.\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
 "\n"
 	);
 }
@@ -14,6 +14,7 @@
 #endif
 
 #define MUTATOR_NAME "bit_flip"
+#define MUTATOR_PREFIX bit_flip
 
 BF_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 BF_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -25,6 +26,7 @@ BF_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
 BF_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 BF_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state);
 BF_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+BF_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 BF_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 BF_MUTATOR_API int FUNCNAME(help)(char **help_str);
 
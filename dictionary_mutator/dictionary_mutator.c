@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <utils.h>
 #include <jansson.h>
@@ -36,7 +37,7 @@ mutator_t dictionary_mutator = {
 	dictionary_free_state,
 	FUNCNAME(set_state),
 	FUNCNAME(get_current_iteration),
-	dictionary_get_total_iteration_count,
+	FUNCNAME(get_total_iteration_count),
 	FUNCNAME(get_input_info),
 	FUNCNAME(set_input),
 	FUNCNAME(help)
@@ -138,6 +139,7 @@ static int mutate_inner(void * mutator_state, char * buffer, size_t buffer_lengt
 		return -1;
 	state->iteration++;
 	ret = mutate_one(&state->info, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+	finish_mutate_info_output(&state->info, state->iteration);
 	if (is_thread_safe && release_mutex(state->info.mutate_mutex))
 		return -1;
 	return ret;
@@ -187,7 +189,7 @@ DICTIONARY_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 
 	state_obj = json_object();
 	ADD_INT(temp, state->iteration, state_obj, "iteration");
-	if (!add_mutate_info_to_json(state_obj, &state->info))
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
 		return NULL;
 	ret = json_dumps(state_obj, 0);
 	json_decref(state_obj);
@@ -208,7 +210,7 @@ DICTIONARY_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * stat
 	if (!state)
 		return 1;
 	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
-	if (get_mutate_info_from_json(state, &current_state->info))
+	if (get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
 		return 1;
 	return 0;
 }
@@ -224,6 +226,74 @@ DICTIONARY_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 	GENERIC_MUTATOR_GET_ITERATION(dictionary_state_t);
 }
 
+/**
+ * This function reports the result of running one of the mutator's outputs.  If the dictionary_scores
+ * option is set, the results are used to learn which dictionary tokens find new coverage.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated)
+ * @param flags - MUTATE_RESULT_* flags that describe the result
+ * @param checksum - a hash of the output's execution, such as a hash of the coverage it produced
+ * @return 0 on success and -1 on failure
+ */
+DICTIONARY_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum)
+{
+	dictionary_state_t * state = (dictionary_state_t *)mutator_state;
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	report_mutate_info_result(&state->info, iteration, flags);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function will return the total possible number of mutations with this mutator.  Each
+ * dictionary token is tried at each offset of the input, skipping the tokens that already occur
+ * at an offset and the ones that don't fit in the mutate buffer.  Until the first call to mutate,
+ * the size of the mutate buffer isn't known, and every token is assumed to fit.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @return - the number of possible mutations with this mutator, or -1 on error
+ */
+DICTIONARY_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state)
+{
+	dictionary_state_t * state = (dictionary_state_t *)mutator_state;
+	int64_t overwrite_count = 0, insert_count = 0;
+
+	//Counting the candidates builds the token index and region map, which mutate uses too
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	if (!state->operation || !strcmp(state->operation, "overwrite"))
+		overwrite_count = count_dictionary_candidates(&state->info, (u8 *)state->input, state->input_length, 0, 0);
+	if (!state->operation || !strcmp(state->operation, "insert"))
+		insert_count = count_dictionary_candidates(&state->info, (u8 *)state->input, state->input_length, 1, 0);
+	if (release_mutex(state->info.mutate_mutex) || overwrite_count < 0 || insert_count < 0 || overwrite_count + insert_count > INT_MAX)
+		return -1;
+	return (int)(overwrite_count + insert_count);
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+DICTIONARY_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	dictionary_state_t * state = (dictionary_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(dictionary_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -233,6 +303,9 @@ DICTIONARY_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
  */
 DICTIONARY_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
 {
+	//Find where the dictionary tokens occur in the new input
+	if (index_dictionary_matches(&((dictionary_state_t *)mutator_state)->info, (u8 *)new_input, input_length))
+		return -1;
 	GENERIC_MUTATOR_SET_INPUT(dictionary_state_t);
 }
 
@@ -259,14 +332,48 @@ DICTIONARY_MUTATOR_API int FUNCNAME(help)(char **help_str)
 	GENERIC_MUTATOR_HELP(
 "dictionary - afl-based dictionary mutator\n"
 "Options:\n"
-"  dictionary            A file or directory containing dictionary to use while\n"
-"                          mangling input\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  dictionary            A dictionary file, a directory with a file for each\n"
+"                          token, or a compiled dictionary file (see\n"
+"                          save_dictionary) to use while mangling input.  The\n"
+"                          tokens in a dictionary file can hold bytes above 127\n"
+"                          (such as UTF-8) without escaping them.\n"
+"  dictionary_scores     Set to 1 to count how often each dictionary token finds\n"
+"                          new coverage (as given to report_result), and use\n"
+"                          the productive tokens more often\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
+"  memory_limit          The most bytes that the dictionary can hold.  The\n"
+"                          tokens that don't fit are skipped.  Default is 0 (no\n"
+"                          limit).\n"
 "  operation             The operation to perform with each dictionary item.\n"
 "                          Either, overwrite or insert.  Default option is both.\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
 "  random_state0         The first half of the seed to afl's random number\n"
 "                          generator\n"
 "  random_state1         The second half of the seed to afl's random number\n"
 "                          generator\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
+"  save_dictionary       A file to write the loaded dictionary to, in a compiled\n"
+"                          format that the dictionary option can map instead of\n"
+"                          parsing it\n"
 "\n"
 	);
 }
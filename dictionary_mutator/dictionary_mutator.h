@@ -14,6 +14,7 @@
 #endif
 
 #define MUTATOR_NAME "dictionary"
+#define MUTATOR_PREFIX dictionary
 
 DICTIONARY_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 DICTIONARY_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -23,8 +24,10 @@ DICTIONARY_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state);
 #define dictionary_free_state default_free_state
 DICTIONARY_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
 DICTIONARY_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
-#define dictionary_get_total_iteration_count return_unknown_or_infinite_total_iterations
+DICTIONARY_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum);
+DICTIONARY_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state);
 DICTIONARY_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+DICTIONARY_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 DICTIONARY_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 DICTIONARY_MUTATOR_API int FUNCNAME(help)(char **help_str);
 
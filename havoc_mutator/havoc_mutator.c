@@ -64,6 +64,7 @@ static havoc_state_t * setup_options(char * options)
 		free(state);
 		return NULL;
 	}
+	state->info.random_stages = 1; //havoc is the only stage
 	if (!options || !strlen(options))
 		return state;
 
@@ -121,6 +122,7 @@ static int mutate_inner(void * mutator_state, char * buffer, size_t buffer_lengt
 	}
 	state->iteration++;
 	ret = mutate_one(&state->info, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+	finish_mutate_info_output(&state->info, state->iteration);
 	if (is_thread_safe && release_mutex(state->info.mutate_mutex))
 		return -1;
 	return ret;
@@ -170,7 +172,7 @@ HAVOC_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 
 	state_obj = json_object();
 	ADD_INT(temp, state->iteration, state_obj, "iteration");
-	if (!add_mutate_info_to_json(state_obj, &state->info))
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
 		return NULL;
 	ret = json_dumps(state_obj, 0);
 	json_decref(state_obj);
@@ -191,7 +193,7 @@ HAVOC_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state)
 	if (!state)
 		return 1;
 	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
-	if (get_mutate_info_from_json(state, &current_state->info))
+	if (get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
 		return 1;
 	return 0;
 }
@@ -207,6 +209,283 @@ HAVOC_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 	GENERIC_MUTATOR_GET_ITERATION(havoc_state_t);
 }
 
+/**
+ * This function reports the result of running one of the mutator's outputs.  If the scheduler option
+ * is set, the results are used to learn which havoc operators find new coverage, and if the
+ * dictionary_scores option is set, which dictionary tokens do.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated)
+ * @param flags - MUTATE_RESULT_* flags that describe the result
+ * @param checksum - a hash of the output's execution, such as a hash of the coverage it produced
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	report_mutate_info_result(&state->info, iteration, flags);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function updates the statistics about the seed being mutated.  If the power_schedule
+ * option is set, the statistics are used to recompute perf_score (and havoc_div), so seeds that
+ * are slow or whose paths have already been exercised often get fewer havoc rounds.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param stats - a JSON object with the seed's statistics.  Any of exec_us, avg_exec_us, bitmap_size,
+ * avg_bitmap_size, depth, handicap, fuzz_level, path_frequency, avg_path_frequency, and new_paths
+ * can be given; the others keep their previous values.
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(set_seed_stats)(void * mutator_state, char * stats)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = set_mutate_info_seed_stats(&state->info, stats);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function sets the weights used to choose the offsets that the havoc stage mutates, e.g.
+ * from taint analysis or an earlier effector map.  Each offset is chosen with probability
+ * proportional to its weight.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param weights - the weight of each of the input's offsets, or NULL to choose them uniformly again
+ * @param length - the number of entries in weights
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(set_position_weights)(void * mutator_state, uint32_t * weights, size_t length)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = position_sampler_set(&state->info.positions, weights, length);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function adds a seed to the mutator's seed pool.  The seed can be selected with select_seed
+ * without recreating the mutator, and is spliced with the selected seed in the meantime.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param input - the seed to add
+ * @param input_length - the size in bytes of the input buffer.
+ * @return the id of the new seed on success, or -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int id;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	id = add_mutate_info_seed(&state->info, input, input_length, 0);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return id;
+}
+
+/**
+ * This function removes a seed from the mutator's seed pool.  The selected seed can't be removed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to remove, as returned by add_seed
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = remove_mutate_info_seed(&state->info, id);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function selects which of the seeds in the mutator's seed pool is mutated.  Each seed keeps
+ * its own progress through the stages, so the mutations continue where they left off when a seed
+ * is selected again.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to select, as returned by add_seed, or 0 for the input the
+ * mutator was created with
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = select_mutate_info_seed(&state->info, id, &state->input, &state->input_length);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function looks up the provenance record of one of the mutator's recent outputs, i.e. what's
+ * needed to regenerate the output with the regenerate function.  The provenance_log option sets
+ * how many outputs have their records kept.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated)
+ * @param record - used to return the output's provenance record
+ * @return 0 on success and -1 if the output's record isn't in the log
+ */
+HAVOC_MUTATOR_API int FUNCNAME(get_provenance)(void * mutator_state, int iteration, mutate_provenance_t * record)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = provenance_log_find(&state->info.provenance, (uint64_t)iteration, record);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function regenerates an output from its provenance record, without changing the mutator's
+ * progress.  The mutator can be the one that generated the output, or one created from its saved
+ * state.  The seed that the output was generated from must be selected, and the output is only the
+ * same as the original if the options and learned statistics it depended on haven't changed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param record - the output's provenance record, as returned by get_provenance
+ * @param buffer - a buffer that the regenerated output will be written to
+ * @param buffer_length - the size of the passed in buffer argument.  It should be the same size
+ * that was passed to the mutate function when the output was generated.
+ * @return the length of the regenerated output, or -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(regenerate)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t buffer_length)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	mutate_buffer_t buf;
+	int ret = -1;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	if (buffer_length >= state->input_length) {
+		buf.buffer = (uint8_t *)buffer;
+		buf.length = state->input_length;
+		buf.max_length = buffer_length;
+		memcpy(buf.buffer, state->input, buf.length);
+		ret = regenerate_mutate_info_output(&state->info, record, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+	}
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function minimizes an output that was found to be interesting (e.g. because it crashed the
+ * target), by reverting the stacked havoc operations that it doesn't need.  The output is
+ * regenerated from its provenance record to find the operations, and chunks of them are reverted
+ * until none of the remaining ones can be, so only a handful of candidates need to be tried.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param record - the output's provenance record, as returned by get_provenance
+ * @param buffer - a buffer holding the output.  The minimized output will be written to it.
+ * @param length - the length of the output
+ * @param buffer_length - the size of the passed in buffer argument.  It should be the same size
+ * that was passed to the mutate function when the output was generated.
+ * @param verdict - a function that's called with each candidate, which should return nonzero if the
+ * candidate is still interesting.  It can't call any of the mutator's functions.
+ * @param context - an argument to pass to verdict
+ * @return the length of the minimized output, or -1 if the output can't be regenerated or on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(minimize)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t length,
+	size_t buffer_length, edit_trace_verdict_t verdict, void * context)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+	mutate_buffer_t buf;
+	char * output;
+	int ret = -1;
+
+	if (length > buffer_length)
+		return -1;
+	output = (char *)malloc(length ? length : 1);
+	if (!output)
+		return -1;
+	memcpy(output, buffer, length);
+
+	if (take_mutex(state->info.mutate_mutex)) {
+		free(output);
+		return -1;
+	}
+	if (buffer_length >= state->input_length) {
+		buf.buffer = (uint8_t *)buffer;
+		buf.length = state->input_length;
+		buf.max_length = buffer_length;
+		memcpy(buf.buffer, state->input, buf.length);
+		ret = minimize_mutate_info_output(&state->info, record, &buf, (u8 *)output, length,
+			mutate_funcs, ARRAY_SIZE(mutate_funcs), verdict, context);
+	}
+	free(output);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function gets the statistics of the duplicate output filter that the dedup_size and
+ * dedup_file options enable.  The duplicate rate is duplicates / checked; the duplicates from the
+ * random stages were replaced with new outputs before they were returned.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param checked - used to return the number of outputs that were checked against the filter
+ * @param duplicates - used to return the number of those outputs that were already in the filter
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	*checked = state->info.dedup.checked;
+	*duplicates = state->info.dedup.duplicates;
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+HAVOC_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	havoc_state_t * state = (havoc_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(havoc_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -242,20 +521,77 @@ HAVOC_MUTATOR_API int FUNCNAME(help)(char **help_str)
 	GENERIC_MUTATOR_HELP(
 "havoc - afl-based havoc mutator\n"
 "Options:\n"
-"  dictionary            A file or directory containing dictionary to use while\n"
-"                          mangling input\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  dictionary            A dictionary file, a directory with a file for each\n"
+"                          token, or a compiled dictionary file (see\n"
+"                          save_dictionary) to use while mangling input.  The\n"
+"                          tokens in a dictionary file can hold bytes above 127\n"
+"                          (such as UTF-8) without escaping them.\n"
+"  dictionary_scores     Set to 1 to count how often each dictionary token finds\n"
+"                          new coverage (as given to report_result), and use\n"
+"                          the productive tokens more often\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
 "  havoc_div             A divisor for determining the number of rounds that\n"
 "                          the havoc stage should run (typically 1, 2, 5, or 10)\n"
+"  havoc_weights         An object that maps havoc operators to weights, such as\n"
+"                          {\"delete\": 4, \"flip_bit\": 0}.  Each operator is\n"
+"                          chosen with probability proportional to its weight.\n"
+"                          The operators are flip_bit, interesting8,\n"
+"                          interesting16, interesting32, subtract8, add8,\n"
+"                          subtract16, add16, subtract32, add32, random_byte,\n"
+"                          delete (weight 2 by default, the others 1), clone,\n"
+"                          overwrite, dictionary_overwrite, and\n"
+"                          dictionary_insert.  Ignored when scheduler is set.\n"
+"  memory_limit          The most bytes that the dictionary and the seeds\n"
+"                          added with add_seed can hold.  The tokens that don't\n"
+"                          fit are skipped, and the seeds that don't fit are\n"
+"                          refused.  Default is 0 (no limit).\n"
 "  perf_score            A performance score used to determine how long a havoc\n"
 "                          round lasts.  Typically 100, higher results in a\n"
 "                          larger number of mutations in these stages before\n"
 "                          moving on.\n"
+"  position_weights      A file with a weight for each of the input's offsets,\n"
+"                          separated by whitespace or commas.  The havoc stage\n"
+"                          mutates each offset with probability proportional to\n"
+"                          its weight.\n"
+"  power_schedule        How to compute perf_score from the statistics given to\n"
+"                          set_seed_stats; either none (the default), explore,\n"
+"                          fast, coe, exploit, lin, or quad\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
+"  provenance_log        The number of recent outputs to keep a provenance\n"
+"                          record of, so they can be rebuilt with regenerate\n"
+"                          instead of being saved.  Default is 0 (no log).\n"
 "  queue_cycle           The queue round counter.  Used in determining how to\n"
 "                          mutate input.  Generally this shouldn't need to be set\n"
 "  random_state0         The first half of the seed to afl's random number\n"
 "                          generator\n"
 "  random_state1         The second half of the seed to afl's random number\n"
 "                          generator\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
+"  save_dictionary       A file to write the loaded dictionary to, in a compiled\n"
+"                          format that the dictionary option can map instead of\n"
+"                          parsing it\n"
+"  scheduler             Set to 1 to learn which havoc operators find new\n"
+"                          coverage (as given to report_result), and use them\n"
+"                          more often\n"
 "\n"
 	);
 }
@@ -2,6 +2,8 @@
 
 #include <global_types.h>
 #include <mutators.h>
+#include <provenance_log.h>
+#include <edit_trace.h>
 
 #ifdef _WIN32
 #ifdef HAVOC_MUTATOR_EXPORTS
@@ -14,6 +16,7 @@
 #endif
 
 #define MUTATOR_NAME "havoc"
+#define MUTATOR_PREFIX havoc
 
 HAVOC_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 HAVOC_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -25,6 +28,18 @@ HAVOC_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
 HAVOC_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 #define havoc_get_total_iteration_count return_unknown_or_infinite_total_iterations
 HAVOC_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+HAVOC_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum);
+HAVOC_MUTATOR_API int FUNCNAME(set_seed_stats)(void * mutator_state, char * stats);
+HAVOC_MUTATOR_API int FUNCNAME(set_position_weights)(void * mutator_state, uint32_t * weights, size_t length);
+HAVOC_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length);
+HAVOC_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id);
+HAVOC_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id);
+HAVOC_MUTATOR_API int FUNCNAME(get_provenance)(void * mutator_state, int iteration, mutate_provenance_t * record);
+HAVOC_MUTATOR_API int FUNCNAME(regenerate)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t buffer_length);
+HAVOC_MUTATOR_API int FUNCNAME(minimize)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t length,
+	size_t buffer_length, edit_trace_verdict_t verdict, void * context);
+HAVOC_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates);
+HAVOC_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 HAVOC_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 HAVOC_MUTATOR_API int FUNCNAME(help)(char **help_str);
 
@@ -1,5 +1,15 @@
 #include "honggfuzz_mutator.h"
 #include <mutators.h>
+#include <edit_plan.h>
+#include <edit_trace.h>
+#include <operator_scheduler.h>
+#include <operator_weights.h>
+#include <token_dictionary.h>
+#include <token_scorer.h>
+#include <position_sampler.h>
+#include <seed_pool.h>
+#include <fixup.h>
+#include <output_filter.h>
 
 #include <utils.h>
 #include <jansson.h>
@@ -17,17 +27,13 @@
 #include <string.h>
 #include <time.h>
 
-typedef struct {
-	char* s;
-	size_t len;
-} string_t;
-
 struct honggfuzz_state
 {
 	int mutations_per_run;
+	uint64_t memory_limit; //The most bytes that the dictionary and seed pool can hold, or 0 for no limit
 	char * dictionary_file;
-	uint64_t dictionary_count;
-	string_t ** dictq;
+	char * save_dictionary_file; //Where to write the loaded dictionary as a compiled dictionary file
+	token_dictionary_t dictionary;
 
 	char * input;
 	size_t input_length;
@@ -40,6 +46,28 @@ struct honggfuzz_state
 	uint64_t mutated_buffer_length;
 	uint64_t max_mutated_buffer_length;
 	uint64_t random_state[2];
+
+	//Records the edits to mutated_buffer, so they can be written to it all at once
+	edit_plan_t plan;
+	//The random state before the last output was mangled, so it can be regenerated to minimize it
+	uint64_t last_random_state[2];
+	//Records the mangle functions' changes while an output is being minimized
+	edit_trace_t trace;
+	//Chooses the mangle functions
+	operator_scheduler_t scheduler;
+	//The user-given weights of the mangle functions, used when the scheduler isn't enabled
+	operator_weights_t havoc_weights;
+	//Chooses the dictionary tokens
+	token_scorer_t dictionary_scorer;
+	//Chooses the offsets to mangle
+	char * position_weights_file;
+	position_sampler_t positions;
+	//The seeds that can be selected instead of the input
+	seed_pool_t seed_pool;
+	//The checksums and length fields that are recomputed in each output
+	fixup_list_t fixups;
+	//The outputs that have already been returned, so they aren't returned again
+	output_filter_t dedup;
 };
 typedef struct honggfuzz_state honggfuzz_state_t;
 
@@ -112,11 +140,11 @@ static inline uint64_t util_InternalRnd64(honggfuzz_state_t * state) {
 	return result;
 }
 
-uint64_t util_rnd64(honggfuzz_state_t * state) {
+static uint64_t util_rnd64(honggfuzz_state_t * state) {
 	return util_InternalRnd64(state);
 }
 
-uint64_t util_rndGet(honggfuzz_state_t * state, uint64_t min, uint64_t max) {
+static uint64_t util_rndGet(honggfuzz_state_t * state, uint64_t min, uint64_t max) {
 	assert(min <= max);
 	if (max == UINT64_MAX) {
 		return util_rnd64(state);
@@ -125,7 +153,13 @@ uint64_t util_rndGet(honggfuzz_state_t * state, uint64_t min, uint64_t max) {
 	return ((util_rnd64(state) % (max - min + 1)) + min);
 }
 
-void util_rndBuf(honggfuzz_state_t * state, uint8_t* buf, uint64_t sz) {
+/* Chooses an offset to mangle (from min to max), according to the position weights if there are
+   any.  Without them, this is the same as util_rndGet. */
+static uint64_t util_rndOffset(honggfuzz_state_t * state, uint64_t min, uint64_t max) {
+	return position_sampler_choose(&state->positions, min, max + 1, util_rnd64(state));
+}
+
+static void util_rndBuf(honggfuzz_state_t * state, uint8_t* buf, uint64_t sz) {
 	if (sz == 0) {
 		return;
 	}
@@ -140,7 +174,7 @@ static inline void mangle_Overwrite(honggfuzz_state_t * state, const uint8_t* sr
 		sz = maxToCopy;
 	}
 
-	memmove(&state->mutated_buffer[off], src, (size_t)sz);
+	edit_plan_write(&state->plan, (size_t)off, src, (size_t)sz);
 }
 
 static inline void mangle_Move(honggfuzz_state_t * state, uint64_t off_from, uint64_t off_to, uint64_t len) {
@@ -161,7 +195,7 @@ static inline void mangle_Move(honggfuzz_state_t * state, uint64_t off_from, uin
 		len = len_to;
 	}
 
-	memmove(&state->mutated_buffer[off_to], &state->mutated_buffer[off_from], (size_t)len);
+	edit_plan_move(&state->plan, (size_t)off_from, (size_t)off_to, (size_t)len);
 }
 
 static void mangle_Inflate(honggfuzz_state_t * state, uint64_t off, uint64_t len) {
@@ -178,19 +212,19 @@ static void mangle_Inflate(honggfuzz_state_t * state, uint64_t off, uint64_t len
 
 static void mangle_MemMove(honggfuzz_state_t * state) {
 	uint64_t off_from = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	uint64_t off_to = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off_to = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t len = util_rndGet(state, 0, state->mutated_buffer_length);
 
 	mangle_Move(state, off_from, off_to, len);
 }
 
 static void mangle_Byte(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	state->mutated_buffer[off] = (uint8_t)util_rnd64(state);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	edit_plan_set(&state->plan, (size_t)off, (uint8_t)util_rnd64(state));
 }
 
 static void mangle_Bytes(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint32_t val = (uint32_t)util_rnd64(state);
 
 	/* Overwrite with random 2,3,4-byte values */
@@ -199,34 +233,38 @@ static void mangle_Bytes(honggfuzz_state_t * state) {
 }
 
 static void mangle_Bit(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	state->mutated_buffer[off] ^= (uint8_t)(1U << util_rndGet(state, 0, 7));
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	edit_plan_set(&state->plan, (size_t)off, edit_plan_get(&state->plan, (size_t)off) ^ (uint8_t)(1U << util_rndGet(state, 0, 7)));
 }
 
 static void mangle_DictionaryInsert(honggfuzz_state_t * state) {
-	if (state->dictionary_count == 0) {
+	if (state->dictionary.count == 0) {
 		mangle_Bit(state);
 		return;
 	}
 
-	uint64_t choice = util_rndGet(state, 0, state->dictionary_count - 1);
-	string_t* str = state->dictq[choice];
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	mangle_Inflate(state, off, str->len);
-	mangle_Move(state, off, off + str->len, str->len);
-	mangle_Overwrite(state, (uint8_t*)str->s, off, str->len);
+	uint64_t choice = token_scorer_choose(&state->dictionary_scorer, state->dictionary.count, util_rnd64(state));
+	const uint8_t* token = TOKEN_DICTIONARY_TOKEN(&state->dictionary, choice);
+	size_t len = TOKEN_DICTIONARY_LENGTH(&state->dictionary, choice);
+	token_scorer_use(&state->dictionary_scorer, (size_t)choice);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	mangle_Inflate(state, off, len);
+	mangle_Move(state, off, off + len, len);
+	mangle_Overwrite(state, token, off, len);
 }
 
 static void mangle_Dictionary(honggfuzz_state_t * state) {
-	if (state->dictionary_count == 0) {
+	if (state->dictionary.count == 0) {
 		mangle_Bit(state);
 		return;
 	}
 
-	uint64_t choice = util_rndGet(state, 0, state->dictionary_count - 1);
-	string_t* str = state->dictq[choice];
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	mangle_Overwrite(state, (uint8_t*)str->s, off, str->len);
+	uint64_t choice = token_scorer_choose(&state->dictionary_scorer, state->dictionary.count, util_rnd64(state));
+	const uint8_t* token = TOKEN_DICTIONARY_TOKEN(&state->dictionary, choice);
+	size_t len = TOKEN_DICTIONARY_LENGTH(&state->dictionary, choice);
+	token_scorer_use(&state->dictionary_scorer, (size_t)choice);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	mangle_Overwrite(state, token, off, len);
 }
 
 static void mangle_Magic(honggfuzz_state_t * state) {
@@ -470,27 +508,29 @@ static void mangle_Magic(honggfuzz_state_t * state) {
 		{ "\xFE\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 8 },
 	};
 
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t choice = util_rndGet(state, 0, ARRAY_SIZE(mangleMagicVals) - 1);
 	mangle_Overwrite(state, mangleMagicVals[choice].val, off, mangleMagicVals[choice].size);
 }
 
 static void mangle_MemSet(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t sz = util_rndGet(state, 1, state->mutated_buffer_length - off);
 	int val = (int)util_rndGet(state, 0, UINT8_MAX);
 
-	memset(&state->mutated_buffer[off], val, (size_t)sz);
+	edit_plan_fill(&state->plan, (size_t)off, (uint8_t)val, (size_t)sz);
 }
 
 static void mangle_Random(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t len = util_rndGet(state, 1, state->mutated_buffer_length - off);
-	util_rndBuf(state, &state->mutated_buffer[off], len);
+	uint8_t * dst = edit_plan_reserve(&state->plan, (size_t)off, (size_t)len);
+	if (dst)
+		util_rndBuf(state, dst, len);
 }
 
 static void mangle_AddSub(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 
 	/* 1,2,4,8 */
 	uint64_t varLen = 1ULL << util_rndGet(state, 0, 3);
@@ -504,12 +544,12 @@ static void mangle_AddSub(honggfuzz_state_t * state) {
 	assert(varLen == 1 || varLen == 2 || varLen == 4 || varLen == 8);
 	switch (varLen) {
 		case 1: {
-			state->mutated_buffer[off] += delta;
+			edit_plan_set(&state->plan, (size_t)off, edit_plan_get(&state->plan, (size_t)off) + delta);
 			break;
 		}
 		case 2: {
 			int16_t val;
-			memcpy(&val, &state->mutated_buffer[off], sizeof(val));
+			edit_plan_read(&state->plan, (size_t)off, &val, sizeof(val));
 			if (util_rnd64(state) & 0x1) {
 				val += delta;
 			}
@@ -524,7 +564,7 @@ static void mangle_AddSub(honggfuzz_state_t * state) {
 		}
 		case 4: {
 			int32_t val;
-			memcpy(&val, &state->mutated_buffer[off], sizeof(val));
+			edit_plan_read(&state->plan, (size_t)off, &val, sizeof(val));
 			if (util_rnd64(state) & 0x1) {
 				val += delta;
 			}
@@ -539,7 +579,7 @@ static void mangle_AddSub(honggfuzz_state_t * state) {
 		}
 		case 8: {
 			int64_t val;
-			memcpy(&val, &state->mutated_buffer[off], sizeof(val));
+			edit_plan_read(&state->plan, (size_t)off, &val, sizeof(val));
 			if (util_rnd64(state) & 0x1) {
 				val += delta;
 			}
@@ -556,27 +596,27 @@ static void mangle_AddSub(honggfuzz_state_t * state) {
 }
 
 static void mangle_IncByte(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	state->mutated_buffer[off] += (uint8_t)1UL;
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	edit_plan_set(&state->plan, (size_t)off, edit_plan_get(&state->plan, (size_t)off) + (uint8_t)1UL);
 }
 
 static void mangle_DecByte(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	state->mutated_buffer[off] -= (uint8_t)1UL;
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	edit_plan_set(&state->plan, (size_t)off, edit_plan_get(&state->plan, (size_t)off) - (uint8_t)1UL);
 }
 
 static void mangle_NegByte(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	state->mutated_buffer[off] = ~(state->mutated_buffer[off]);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	edit_plan_set(&state->plan, (size_t)off, ~edit_plan_get(&state->plan, (size_t)off));
 }
 
 static void mangle_CloneByte(honggfuzz_state_t * state) {
-	uint64_t off1 = util_rndGet(state, 0, state->mutated_buffer_length - 1);
-	uint64_t off2 = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off1 = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off2 = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 
-	uint8_t tmp = state->mutated_buffer[off1];
-	state->mutated_buffer[off1] = state->mutated_buffer[off2];
-	state->mutated_buffer[off2] = tmp;
+	uint8_t tmp = edit_plan_get(&state->plan, (size_t)off1);
+	edit_plan_set(&state->plan, (size_t)off1, edit_plan_get(&state->plan, (size_t)off2));
+	edit_plan_set(&state->plan, (size_t)off2, tmp);
 }
 
 static void mangle_Resize(honggfuzz_state_t * state) {
@@ -584,7 +624,7 @@ static void mangle_Resize(honggfuzz_state_t * state) {
 }
 
 static void mangle_Expand(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t len = util_rndGet(state, 1, state->mutated_buffer_length - off);
 
 	mangle_Inflate(state, off, len);
@@ -597,32 +637,40 @@ static void mangle_Shrink(honggfuzz_state_t * state) {
 	}
 
 	uint64_t len = util_rndGet(state, 1, state->mutated_buffer_length - 1);
-	uint64_t off = util_rndGet(state, 0, len);
+	uint64_t off = util_rndOffset(state, 0, len);
 
 	state->mutated_buffer_length -= len;
 	mangle_Move(state, off + len, off, state->mutated_buffer_length);
 }
 
 static void mangle_InsertRnd(honggfuzz_state_t * state) {
-	uint64_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	uint64_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 	uint64_t len = util_rndGet(state, 1, state->mutated_buffer_length - off);
 
 	mangle_Inflate(state, off, len);
 	mangle_Move(state, off, off + len, state->mutated_buffer_length);
-	util_rndBuf(state, &state->mutated_buffer[off], len);
+	uint8_t * dst = edit_plan_reserve(&state->plan, (size_t)off, (size_t)len);
+	if (dst)
+		util_rndBuf(state, dst, len);
 }
 
 static void mangle_ASCIIVal(honggfuzz_state_t * state) {
 	char buf[32];
 	snprintf(buf, sizeof(buf), "%" PRId64, (int64_t)util_rnd64(state));
-	size_t off = util_rndGet(state, 0, state->mutated_buffer_length - 1);
+	size_t off = util_rndOffset(state, 0, state->mutated_buffer_length - 1);
 
 	mangle_Overwrite(state, (uint8_t*)buf, off, strlen(buf));
 }
 
-static void mangle_mangleContent(honggfuzz_state_t* state) {
+//The names of the mangle functions, in the same order as mangleFuncs, for the havoc_weights option
+static const char * mangle_names[] = {
+	"resize", "byte", "bit", "bytes", "magic", "inc_byte", "dec_byte", "neg_byte", "add_sub", "dictionary",
+	"dictionary_insert", "mem_move", "mem_set", "random", "clone_byte", "expand", "shrink", "insert_rnd", "ascii_val"
+};
+
+static int mangle_mangleContent(honggfuzz_state_t* state) {
 	if (state->mutations_per_run == 0U) {
-		return;
+		return 0;
 	}
 
 	/* Minimum support file size for mangling is 1 */
@@ -631,6 +679,12 @@ static void mangle_mangleContent(honggfuzz_state_t* state) {
 		state->mutated_buffer[0] = '\0';
 	}
 
+	/* The changes are recorded in a piece table and written to the buffer once they are all
+	 * done, so that large buffers don't have their tail moved for every change.  The changes
+	 * are recorded exactly as they would be made to the buffer, so the output is the same. */
+	edit_plan_begin(&state->plan, state->mutated_buffer, (size_t)state->max_mutated_buffer_length,
+		state->mutated_buffer_length < EDIT_PLAN_MIN_LENGTH);
+
 	static void(*const mangleFuncs[])(honggfuzz_state_t * state) = {
 		mangle_Resize,
 		mangle_Byte,
@@ -655,134 +709,41 @@ static void mangle_mangleContent(honggfuzz_state_t* state) {
 
 	uint64_t changesCnt = util_rndGet(state, 1, state->mutations_per_run);
 	for (uint64_t x = 0; x < changesCnt; x++) {
-		uint64_t choice = util_rndGet(state, 0, ARRAY_SIZE(mangleFuncs) - 1);
+		uint64_t choice;
+		if (state->havoc_weights.enabled && !state->scheduler.enabled)
+			choice = operator_weights_choose(&state->havoc_weights, ARRAY_SIZE(mangleFuncs), util_rnd64(state));
+		else
+			choice = operator_scheduler_choose(&state->scheduler, ARRAY_SIZE(mangleFuncs), util_rnd64(state));
+		if (state->trace.enabled) //Record each change separately, so it can be reverted when minimizing
+			edit_trace_begin_op(&state->trace, &state->plan, (size_t)state->mutated_buffer_length);
 		mangleFuncs[choice](state);
+		if (state->trace.enabled)
+			edit_trace_end_op(&state->trace, &state->plan, (size_t)state->mutated_buffer_length);
 	}
+	return edit_plan_commit(&state->plan);
 }
 
-static size_t util_decodeCString(char* s) {
-	size_t o = 0;
-	for (size_t i = 0; s[i] != '\0' && s[i] != '"'; i++, o++) {
-		switch (s[i]) {
-		case '\\': {
-			i++;
-			if (!s[i]) {
-				continue;
-			}
-			switch (s[i]) {
-			case 'a':
-				s[o] = '\a';
-				break;
-			case 'r':
-				s[o] = '\r';
-				break;
-			case 'n':
-				s[o] = '\n';
-				break;
-			case 't':
-				s[o] = '\t';
-				break;
-			case '0':
-				s[o] = '\0';
-				break;
-			case 'x': {
-				if (s[i + 1] && s[i + 2]) {
-					char hex[] = { s[i + 1], s[i + 2], 0 };
-					s[o] = (char) strtoul(hex, NULL, 16);
-					i += 2;
-				}
-				else {
-					s[o] = s[i];
-				}
-				break;
-			}
-			default:
-				s[o] = s[i];
-				break;
-			}
-			break;
-		}
-		default: {
-			s[o] = s[i];
-			break;
-		}
-		}
-	}
-	s[o] = '\0';
-	return o;
-}
+//The longest dictionary token, as honggfuzz's own dictionary parser reads at most 1024 characters of each one
+#define MAX_DICTIONARY_TOKEN 1024
 
 static int input_parseDictionary(honggfuzz_state_t * state) {
-	char * contents;
-	char lineptr[2100];
-	int start, pos = 0, length, ret = 0;
-	size_t len;
-
-	length = read_file(state->dictionary_file, &contents);
-	if (length < 0) {
-		printf("Couldn't open '%s'", state->dictionary_file);
-		return 1;
-	}
-
-	for (;;) {
-		//Find the end of the line
-		len = 0;
-		memset(lineptr, 0, sizeof(lineptr));
-		for (start = pos; pos < length; pos++)
-		{
-			if (contents[pos] == '\n')
-			{
-				len = pos - start;
-				memcpy(lineptr, &contents[start], len);
-				pos++;
-				break;
-			}
-		}
-
-		if (len == 0) {
-			if(start == pos) //end of the file with no left over content
-				break;
-
-			len = pos - start;
-			memcpy(lineptr, &contents[start], len);
-		}
-
-		//Remove the \r\n
-		if (len > 1 && lineptr[len - 1] == '\n') {
-			lineptr[len - 1] = '\0';
-			len--;
-		}
-		if (len > 1 && lineptr[len - 1] == '\r') {
-			lineptr[len - 1] = '\0';
-			len--;
-		}
-
-		//if the line is empty, skip it
-		if (lineptr[0] == '#' || lineptr[0] == '\r' || lineptr[0] == '\n' || lineptr[0] == '\0') {
-			continue;
-		}
-
-		//Parse the dictionary line
-		char bufn[1025];
-		char bufv[1025];
-		if (sscanf(lineptr, "\"%1024s", bufv) != 1 &&
-			sscanf(lineptr, "%1024[^=]=\"%1024s", bufn, bufv) != 2) {
-			printf("Incorrect dictionary entry: '%s'.\n", lineptr);
-			ret = 1;
-			break;
-		}
-
-		char* s = strdup(bufv);
-		string_t* str = (string_t*)malloc(sizeof(string_t));
-		str->len = util_decodeCString(s);
-		str->s = s;
+	uint64_t used = seed_pool_memory_usage(&state->seed_pool);
 
-		state->dictq = (string_t **)realloc(state->dictq, (state->dictionary_count + 1) * sizeof(string_t));
-		state->dictq[state->dictionary_count] = str;
-		state->dictionary_count++;
+	//The tokens that don't fit under the memory_limit are left out
+	if (state->memory_limit && used >= state->memory_limit) {
+		printf("The dictionary doesn't fit under the memory_limit\n");
+		return 1;
 	}
+	token_dictionary_free(&state->dictionary);
+	if (token_dictionary_load(&state->dictionary, state->dictionary_file, MAX_DICTIONARY_TOKEN,
+			state->memory_limit ? state->memory_limit - used : 0))
+		return 1;
+	if (state->dictionary.skipped)
+		printf("Skipped %llu dictionary tokens that don't fit under the memory_limit\n", (unsigned long long)state->dictionary.skipped);
 
-	return ret;
+	if (state->save_dictionary_file)
+		return token_dictionary_save(&state->dictionary, state->save_dictionary_file);
+	return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -832,9 +793,27 @@ static honggfuzz_state_t * setup_options(char * options)
 	PARSE_OPTION_INT(state, options, mutations_per_run, "mutations_per_run", FUNCNAME(cleanup));
 	PARSE_OPTION_UINT64T_TEMP(state, options, random_state[0], "random_state0", FUNCNAME(cleanup), temp1);
 	PARSE_OPTION_UINT64T_TEMP(state, options, random_state[1], "random_state1", FUNCNAME(cleanup), temp2);
+	PARSE_OPTION_UINT64T_TEMP(state, options, memory_limit, "memory_limit", FUNCNAME(cleanup), temp3);
 	PARSE_OPTION_STRING(state, options, dictionary_file, "dictionary", FUNCNAME(cleanup));
+	PARSE_OPTION_STRING(state, options, save_dictionary_file, "save_dictionary", FUNCNAME(cleanup));
+	PARSE_OPTION_INT(state, options, scheduler.enabled, "scheduler", FUNCNAME(cleanup));
+	PARSE_OPTION_INT(state, options, dictionary_scorer.enabled, "dictionary_scores", FUNCNAME(cleanup));
+	PARSE_OPTION_STRING(state, options, position_weights_file, "position_weights", FUNCNAME(cleanup));
 
-	if (state->dictionary_file && input_parseDictionary(state))
+	if (state->dictionary_file && (input_parseDictionary(state)
+		|| token_scorer_resize(&state->dictionary_scorer, state->dictionary.count)))
+	{
+		FUNCNAME(cleanup)(state);
+		return NULL;
+	}
+	if (state->position_weights_file && position_sampler_load(&state->positions, state->position_weights_file))
+	{
+		FUNCNAME(cleanup)(state);
+		return NULL;
+	}
+	if (fixup_list_parse(&state->fixups, options) || output_filter_parse(&state->dedup, options)
+		|| operator_weights_parse(&state->havoc_weights, options, "havoc_weights", mangle_names,
+			ARRAY_SIZE(mangle_names), ARRAY_SIZE(mangle_names)))
 	{
 		FUNCNAME(cleanup)(state);
 		return NULL;
@@ -880,18 +859,10 @@ HONGGFUZZ_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char
  */
 static void clear_dictionary(honggfuzz_state_t * honggfuzz_state)
 {
-	uint64_t i;
-	for (i = 0; i < honggfuzz_state->dictionary_count; i++)
-	{
-		free(honggfuzz_state->dictq[i]->s);
-		free(honggfuzz_state->dictq[i]);
-	}
+	token_dictionary_free(&honggfuzz_state->dictionary);
 	free(honggfuzz_state->dictionary_file);
-	free(honggfuzz_state->dictq);
-
-	honggfuzz_state->dictq = NULL;
-	honggfuzz_state->dictionary_count = 0;
 	honggfuzz_state->dictionary_file = NULL;
+	token_scorer_resize(&honggfuzz_state->dictionary_scorer, 0);
 }
 
 /**
@@ -904,6 +875,16 @@ HONGGFUZZ_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 {
 	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
 	clear_dictionary(honggfuzz_state);
+	free(honggfuzz_state->save_dictionary_file);
+	token_scorer_free(&honggfuzz_state->dictionary_scorer);
+	position_sampler_free(&honggfuzz_state->positions);
+	free(honggfuzz_state->position_weights_file);
+	seed_pool_free(&honggfuzz_state->seed_pool);
+	edit_plan_free(&honggfuzz_state->plan);
+	edit_trace_free(&honggfuzz_state->trace);
+	fixup_list_free(&honggfuzz_state->fixups);
+	output_filter_free(&honggfuzz_state->dedup);
+	operator_weights_free(&honggfuzz_state->havoc_weights);
 	destroy_mutex(honggfuzz_state->mutate_mutex);
 	free(honggfuzz_state->input);
 	honggfuzz_state->input = NULL;
@@ -920,19 +901,45 @@ HONGGFUZZ_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 HONGGFUZZ_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t buffer_length)
 {
 	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	int retries = 0, commit_retries = 0, commit_failed;
 	//Can't mutate an empty buffer
 	if (buffer_length == 0)
 		return -1;
 
-	//Setup the mutated buffer
-	honggfuzz_state->mutated_buffer = (uint8_t *)buffer;
-	honggfuzz_state->mutated_buffer_length = MIN(buffer_length, honggfuzz_state->input_length);
-	memcpy(honggfuzz_state->mutated_buffer, honggfuzz_state->input, (size_t)honggfuzz_state->mutated_buffer_length);
-	honggfuzz_state->max_mutated_buffer_length = buffer_length;
-
-	//Now mutate the buffer
 	honggfuzz_state->iteration++;
-	mangle_mangleContent(honggfuzz_state);
+	if (fixup_list_update(&honggfuzz_state->fixups, (uint8_t *)honggfuzz_state->input, honggfuzz_state->input_length))
+		return -1;
+	for (;;)
+	{
+		//Setup the mutated buffer
+		honggfuzz_state->mutated_buffer = (uint8_t *)buffer;
+		honggfuzz_state->mutated_buffer_length = MIN(buffer_length, honggfuzz_state->input_length);
+		memcpy(honggfuzz_state->mutated_buffer, honggfuzz_state->input, (size_t)honggfuzz_state->mutated_buffer_length);
+		honggfuzz_state->max_mutated_buffer_length = buffer_length;
+
+		//Now mutate the buffer
+		honggfuzz_state->last_random_state[0] = honggfuzz_state->random_state[0];
+		honggfuzz_state->last_random_state[1] = honggfuzz_state->random_state[1];
+		//As in havoc, the buffer isn't touched until the plan is committed, so if recording any of the
+		//edits failed, another mutation is tried
+		commit_failed = mangle_mangleContent(honggfuzz_state);
+		if (commit_failed) {
+			if (commit_retries++ == EDIT_PLAN_MAX_RETRIES)
+				return -1;
+		}
+		else {
+			fixup_list_apply(&honggfuzz_state->fixups, honggfuzz_state->mutated_buffer, (size_t)honggfuzz_state->mutated_buffer_length);
+
+			//Replace the output with another one if it's a duplicate of an earlier one
+			if (!honggfuzz_state->dedup.enabled || retries++ == OUTPUT_FILTER_MAX_RETRIES
+				|| !output_filter_check(&honggfuzz_state->dedup, honggfuzz_state->mutated_buffer, (size_t)honggfuzz_state->mutated_buffer_length))
+				break;
+		}
+		honggfuzz_state->scheduler.current = 0; //The replaced output's mangle functions and tokens don't get credit
+		honggfuzz_state->dictionary_scorer.num_current = 0;
+	}
+	operator_scheduler_finish(&honggfuzz_state->scheduler, honggfuzz_state->iteration);
+	token_scorer_finish(&honggfuzz_state->dictionary_scorer, honggfuzz_state->iteration);
 	return (int)honggfuzz_state->mutated_buffer_length;
 }
 
@@ -981,17 +988,24 @@ HONGGFUZZ_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 		dictionary_list = json_array();
 		if (!dictionary_list)
 			return NULL;
-		for (i = 0; i < honggfuzz_state->dictionary_count; i++)
+		for (i = 0; i < honggfuzz_state->dictionary.count; i++)
 		{
 			dictionary_obj = json_object();
 			if (!dictionary_obj)
 				return NULL;
-			ADD_MEM(temp, honggfuzz_state->dictq[i]->s, honggfuzz_state->dictq[i]->len, dictionary_obj, "s");
-			ADD_UINT64T(temp, honggfuzz_state->dictq[i]->len, dictionary_obj, "len");
+			ADD_MEM(temp, (const char *)TOKEN_DICTIONARY_TOKEN(&honggfuzz_state->dictionary, i),
+				TOKEN_DICTIONARY_LENGTH(&honggfuzz_state->dictionary, i), dictionary_obj, "s");
+			ADD_UINT64T(temp, TOKEN_DICTIONARY_LENGTH(&honggfuzz_state->dictionary, i), dictionary_obj, "len");
 			json_array_append_new(dictionary_list, dictionary_obj);
 		}
 		json_object_set_new(obj, "dictionary", dictionary_list);
 	}
+	if (!operator_scheduler_add_to_json(obj, "scheduler", &honggfuzz_state->scheduler)
+		|| !operator_weights_add_to_json(obj, "havoc_weights", &honggfuzz_state->havoc_weights, mangle_names)
+		|| !token_scorer_add_to_json(obj, "dictionary_scores", &honggfuzz_state->dictionary_scorer)
+		|| !position_sampler_add_to_json(obj, "position_weights", &honggfuzz_state->positions)
+		|| !seed_pool_add_to_json(obj, "seed_pool", &honggfuzz_state->seed_pool, honggfuzz_state->input, honggfuzz_state->input_length))
+		return NULL;
 
 	ret = json_dumps(obj, 0);
 	json_decref(obj);
@@ -1010,9 +1024,9 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
 	int result, inner_result, temp_int;
 	uint64_t temp_uint64t;
-	char * temp_str;
+	char * temp_str, * token;
+	size_t token_length;
 	json_t * dictionary_obj;
-	string_t * dictionary_item;
 
 	if (!state)
 		return 1;
@@ -1020,6 +1034,14 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 	GET_INT(temp_int, state, honggfuzz_state->iteration, "iteration", result);
 	GET_UINT64T(temp_uint64t, state, honggfuzz_state->random_state[0], "random_state0", result);
 	GET_UINT64T(temp_uint64t, state, honggfuzz_state->random_state[1], "random_state1", result);
+	if (operator_scheduler_get_from_json(state, "scheduler", &honggfuzz_state->scheduler)
+		|| operator_weights_get_from_json(state, "havoc_weights", &honggfuzz_state->havoc_weights, mangle_names,
+			ARRAY_SIZE(mangle_names), ARRAY_SIZE(mangle_names))
+		|| position_sampler_get_from_json(state, "position_weights", &honggfuzz_state->positions)
+		|| seed_pool_get_from_json(state, "seed_pool", &honggfuzz_state->seed_pool, &honggfuzz_state->input,
+			&honggfuzz_state->input_length, 0))
+		return 1;
+	honggfuzz_state->fixups.valid = 0; //The state's selected seed can replace the input
 
 	clear_dictionary(honggfuzz_state);
 	temp_str = get_string_options(state, "dictionary_file", &result);
@@ -1028,15 +1050,14 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 		honggfuzz_state->dictionary_file = temp_str;
 		FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(state, dictionary, "dictionary", dictionary_obj, result)
 
-			//Create the new dictionary item
-			dictionary_item = (string_t *)malloc(sizeof(string_t));
-			GET_ITEM(dictionary_obj, dictionary_item->s, temp_str, get_mem_options_from_json, "s", inner_result);
-			GET_ITEM(dictionary_obj, dictionary_item->len, temp_int, get_int_options_from_json, "len", inner_result);
-
-			//Add the dictionary item to the dictionary linked list
-			honggfuzz_state->dictq = (string_t **)realloc(honggfuzz_state->dictq, (honggfuzz_state->dictionary_count + 1) * sizeof(string_t));
-			honggfuzz_state->dictq[honggfuzz_state->dictionary_count] = dictionary_item;
-			honggfuzz_state->dictionary_count++;
+			//Read the dictionary item and add it to the dictionary
+			token = NULL;
+			token_length = 0;
+			GET_ITEM(dictionary_obj, token, temp_str, get_mem_options_from_json, "s", inner_result);
+			GET_ITEM(dictionary_obj, token_length, temp_int, get_int_options_from_json, "len", inner_result);
+			if (token && token_dictionary_add(&honggfuzz_state->dictionary, (uint8_t *)token, token_length, 0) < 0)
+				result = -1;
+			free(token);
 
 		FOREACH_OBJECT_JSON_ARRAY_ITEM_END(dictionary);
 
@@ -1044,7 +1065,10 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 			return 1;
 	}
 
-	return 0;
+	//The scores are loaded once the scorer is sized for the loaded dictionary
+	if (token_scorer_resize(&honggfuzz_state->dictionary_scorer, honggfuzz_state->dictionary.count))
+		return 1;
+	return token_scorer_get_from_json(state, "dictionary_scores", &honggfuzz_state->dictionary_scorer);
 }
 
 /**
@@ -1058,6 +1082,118 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 	GENERIC_MUTATOR_GET_ITERATION(honggfuzz_state_t);
 }
 
+/**
+ * This function reports the result of running one of the mutator's outputs.  If the scheduler option
+ * is set, the results are used to learn which mangle functions find new coverage, and if the
+ * dictionary_scores option is set, which dictionary tokens do.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param iteration - the iteration of the output (i.e. the value get_current_iteration returned
+ * after it was generated)
+ * @param flags - MUTATE_RESULT_* flags that describe the result
+ * @param checksum - a hash of the output's execution, such as a hash of the coverage it produced
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	operator_scheduler_report(&honggfuzz_state->scheduler, iteration, (flags & MUTATE_RESULT_NEW_COVERAGE) != 0);
+	token_scorer_report(&honggfuzz_state->dictionary_scorer, iteration, (flags & MUTATE_RESULT_NEW_COVERAGE) != 0);
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function sets the weights used to choose the offsets that are mangled, e.g. from taint
+ * analysis or an effector map.  Each offset is chosen with probability proportional to its weight.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param weights - the weight of each of the input's offsets, or NULL to choose them uniformly again
+ * @param length - the number of entries in weights
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(set_position_weights)(void * mutator_state, uint32_t * weights, size_t length)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	ret = position_sampler_set(&honggfuzz_state->positions, weights, length);
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function adds a seed to the mutator's seed pool.  The seed can be selected with select_seed
+ * without recreating the mutator.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param input - the seed to add
+ * @param input_length - the size in bytes of the input buffer.
+ * @return the id of the new seed on success, or -1 on failure (including when the seed doesn't fit
+ * under the memory_limit option)
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	int id = -1;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	if (memory_usage_fits(honggfuzz_state->memory_limit,
+		token_dictionary_memory_usage(&honggfuzz_state->dictionary) + seed_pool_memory_usage(&honggfuzz_state->seed_pool),
+		input_length + sizeof(seed_pool_seed_t)))
+		id = seed_pool_add(&honggfuzz_state->seed_pool, input, input_length, NULL, 0);
+	else
+		printf("The seed doesn't fit under the memory_limit\n");
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return id;
+}
+
+/**
+ * This function removes a seed from the mutator's seed pool.  The selected seed can't be removed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to remove, as returned by add_seed
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	ret = seed_pool_remove(&honggfuzz_state->seed_pool, id);
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function selects which of the seeds in the mutator's seed pool is mutated.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to select, as returned by add_seed, or 0 for the input the
+ * mutator was created with
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	ret = seed_pool_select(&honggfuzz_state->seed_pool, id, &honggfuzz_state->input, &honggfuzz_state->input_length, NULL);
+	if (!ret)
+		honggfuzz_state->fixups.valid = 0;
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
 /**
  * Obtains information about the inputs that were given to the mutator when it was created
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -1071,6 +1207,126 @@ HONGGFUZZ_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int *
 	SINGLE_INPUT_GET_INFO(honggfuzz_state_t);
 }
 
+/**
+ * This function minimizes the mutator's last output, after it was found to be interesting (e.g.
+ * because it crashed the target), by reverting the mangle functions' changes that it doesn't need.
+ * The output is regenerated to find the changes, and chunks of them are reverted until none of the
+ * remaining ones can be, so only a handful of candidates need to be tried.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param record - ignored, and can be NULL.  It's only taken so that minimize has the same arguments
+ * in every mutator; honggfuzz doesn't keep provenance records, so only the last output can be minimized.
+ * @param buffer - a buffer holding the last output.  The minimized output will be written to it.
+ * @param length - the length of the output
+ * @param buffer_length - the size of the passed in buffer argument.  It should be the same size
+ * that was passed to the mutate function when the output was generated.
+ * @param verdict - a function that's called with each candidate, which should return nonzero if the
+ * candidate is still interesting.  It can't call any of the mutator's functions.
+ * @param context - an argument to pass to verdict
+ * @return the length of the minimized output, or -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(minimize)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t length,
+	size_t buffer_length, edit_trace_verdict_t verdict, void * context)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+	uint64_t random_state[2];
+	uint32_t scheduler_current, scorer_current[TOKEN_SCORER_MAX_OUTPUT_TOKENS], scorer_num_current;
+	char * output;
+	int ret = -1;
+
+	if (!honggfuzz_state->iteration || !buffer_length || length > buffer_length)
+		return -1;
+	output = (char *)malloc(length ? length : 1);
+	if (!output)
+		return -1;
+	memcpy(output, buffer, length);
+
+	if (take_mutex(honggfuzz_state->mutate_mutex)) {
+		free(output);
+		return -1;
+	}
+
+	//Regenerating the output mustn't change the random state or which operators and tokens are
+	//credited with the last output
+	random_state[0] = honggfuzz_state->random_state[0];
+	random_state[1] = honggfuzz_state->random_state[1];
+	scheduler_current = honggfuzz_state->scheduler.current;
+	scorer_num_current = honggfuzz_state->dictionary_scorer.num_current;
+	memcpy(scorer_current, honggfuzz_state->dictionary_scorer.current, sizeof(scorer_current));
+
+	honggfuzz_state->random_state[0] = honggfuzz_state->last_random_state[0];
+	honggfuzz_state->random_state[1] = honggfuzz_state->last_random_state[1];
+	honggfuzz_state->mutated_buffer = (uint8_t *)buffer;
+	honggfuzz_state->mutated_buffer_length = MIN(buffer_length, honggfuzz_state->input_length);
+	memcpy(honggfuzz_state->mutated_buffer, honggfuzz_state->input, (size_t)honggfuzz_state->mutated_buffer_length);
+	honggfuzz_state->max_mutated_buffer_length = buffer_length;
+	if (!edit_trace_start(&honggfuzz_state->trace, honggfuzz_state->mutated_buffer, (size_t)honggfuzz_state->mutated_buffer_length)
+		&& !mangle_mangleContent(honggfuzz_state))
+	{
+		ret = fixup_list_minimize(&honggfuzz_state->fixups, &honggfuzz_state->trace, (uint8_t *)output, length, (uint8_t *)buffer,
+			buffer_length, verdict, context);
+	}
+	edit_trace_stop(&honggfuzz_state->trace);
+
+	honggfuzz_state->random_state[0] = random_state[0];
+	honggfuzz_state->random_state[1] = random_state[1];
+	honggfuzz_state->scheduler.current = scheduler_current;
+	honggfuzz_state->dictionary_scorer.num_current = scorer_num_current;
+	memcpy(honggfuzz_state->dictionary_scorer.current, scorer_current, sizeof(scorer_current));
+	free(output);
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function gets the statistics of the duplicate output filter that the dedup_size and
+ * dedup_file options enable.  The duplicate rate is duplicates / checked; the duplicates were
+ * replaced with new outputs before they were returned.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param checked - used to return the number of outputs that were checked against the filter
+ * @param duplicates - used to return the number of those outputs that were already in the filter
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	*checked = honggfuzz_state->dedup.checked;
+	*duplicates = honggfuzz_state->dedup.duplicates;
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+HONGGFUZZ_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	honggfuzz_state_t * honggfuzz_state = (honggfuzz_state_t *)mutator_state;
+
+	if (take_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(honggfuzz_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = honggfuzz_state->input_length + edit_plan_memory_usage(&honggfuzz_state->plan);
+	usage->bytes[MEMORY_USAGE_DICTIONARY] = token_dictionary_memory_usage(&honggfuzz_state->dictionary) + token_scorer_memory_usage(&honggfuzz_state->dictionary_scorer);
+	usage->bytes[MEMORY_USAGE_SEEDS] = seed_pool_memory_usage(&honggfuzz_state->seed_pool);
+	usage->bytes[MEMORY_USAGE_INDEXES] = position_sampler_memory_usage(&honggfuzz_state->positions) +
+		fixup_list_memory_usage(&honggfuzz_state->fixups) + operator_weights_memory_usage(&honggfuzz_state->havoc_weights);
+	usage->bytes[MEMORY_USAGE_HISTORY] = edit_trace_memory_usage(&honggfuzz_state->trace);
+	usage->bytes[MEMORY_USAGE_DEDUP] = output_filter_memory_usage(&honggfuzz_state->dedup);
+	if (release_mutex(honggfuzz_state->mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the input(saved in the mutators state) to something new.
  * This can be used to reinitialize a mutator with new data, without reallocating the entire state struct.
@@ -1081,6 +1337,7 @@ HONGGFUZZ_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int *
  */
 HONGGFUZZ_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
 {
+	((honggfuzz_state_t *)mutator_state)->fixups.valid = 0; //The outputs are compared with the new input from now on
 	GENERIC_MUTATOR_SET_INPUT(honggfuzz_state_t);
 }
 
@@ -1094,14 +1351,57 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(help)(char ** help_str)
 	GENERIC_MUTATOR_HELP(
 "honggfuzz - honggfuzz-based mutator\n"
 "Options:\n"
-"  dictionary_file       A file containing dictionary words to use while\n"
-"                          mangling input\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the outputs that repeat\n"
+"                          an earlier output.  It must be at least 64.  Setting\n"
+"                          this or dedup_file enables the filter.\n"
+"  dictionary            A dictionary file, a directory with a file for each\n"
+"                          token, or a compiled dictionary file (see\n"
+"                          save_dictionary) to use while mangling input.  The\n"
+"                          tokens in a dictionary file can hold bytes above 127\n"
+"                          (such as UTF-8) without escaping them.\n"
+"  dictionary_scores     Set to 1 to count how often each dictionary token finds\n"
+"                          new coverage (as given to report_result), and use\n"
+"                          the productive tokens more often\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
+"  havoc_weights         An object that maps mangle functions to weights, such as\n"
+"                          {\"resize\": 0, \"bytes\": 4}.  Each function is chosen\n"
+"                          with probability proportional to its weight (1 by\n"
+"                          default).  The functions are resize, byte, bit,\n"
+"                          bytes, magic, inc_byte, dec_byte, neg_byte, add_sub,\n"
+"                          dictionary, dictionary_insert, mem_move, mem_set,\n"
+"                          random, clone_byte, expand, shrink, insert_rnd, and\n"
+"                          ascii_val.  Ignored when scheduler is set.\n"
+"  memory_limit          The most bytes that the dictionary and the seeds\n"
+"                          added with add_seed can hold.  The tokens that don't\n"
+"                          fit are skipped, and the seeds that don't fit are\n"
+"                          refused.  Default is 0 (no limit).\n"
 "  mutations_per_run     The number of different mangle functions to apply per\n"
 "                          single round of mutating the input\n"
+"  position_weights      A file with a weight for each of the input's offsets,\n"
+"                          separated by whitespace or commas.  Each offset is\n"
+"                          mangled with probability proportional to its weight.\n"
 "  random_state0         The first half of the seed to honggfuzz's random\n"
 "                          number generator\n"
 "  random_state1         The second half of the seed to honggfuzz's random\n"
 "                          number generator\n"
+"  save_dictionary       A file to write the loaded dictionary to, in a compiled\n"
+"                          format that the dictionary option can map instead of\n"
+"                          parsing it\n"
+"  scheduler             Set to 1 to learn which mangle functions find new\n"
+"                          coverage (as given to report_result), and use them\n"
+"                          more often\n"
 "\n"
 	);
 }
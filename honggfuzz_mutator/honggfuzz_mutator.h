@@ -2,6 +2,8 @@
 
 #include <global_types.h>
 #include <mutators.h>
+#include <edit_trace.h>
+#include <provenance_log.h>
 #include <afl_types.h> //grab the definition of MIN/MAX
 
 #ifdef _WIN32
@@ -15,6 +17,7 @@
 #endif
 
 #define MUTATOR_NAME "honggfuzz"
+#define MUTATOR_PREFIX honggfuzz
 
 HONGGFUZZ_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 HONGGFUZZ_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -26,6 +29,15 @@ HONGGFUZZ_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 HONGGFUZZ_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 #define honggfuzz_get_total_iteration_count return_unknown_or_infinite_total_iterations
 HONGGFUZZ_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(report_result)(void * mutator_state, int iteration, uint64_t flags, uint64_t checksum);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(set_position_weights)(void * mutator_state, uint32_t * weights, size_t length);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(minimize)(void * mutator_state, const mutate_provenance_t * record, char * buffer, size_t length,
+	size_t buffer_length, edit_trace_verdict_t verdict, void * context);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates);
+HONGGFUZZ_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 HONGGFUZZ_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 HONGGFUZZ_MUTATOR_API int FUNCNAME(help)(char ** help_str);
 
@@ -0,0 +1,340 @@
+#include "input_to_state_mutator.h"
+#include <mutators.h>
+#include <afl_helpers.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils.h>
+#include <jansson.h>
+#include <jansson_helper.h>
+
+struct input_to_state_state
+{
+	char * input;
+	size_t input_length;
+	int iteration;
+
+	mutate_info_t info;
+};
+typedef struct input_to_state_state input_to_state_state_t;
+
+static int(*const mutate_funcs[])(mutate_info_t *, mutate_buffer_t *) = {
+	input_to_state,
+};
+
+mutator_t input_to_state_mutator = {
+	FUNCNAME(create),
+	FUNCNAME(cleanup),
+	FUNCNAME(mutate),
+	FUNCNAME(mutate_extended),
+	FUNCNAME(get_state),
+	input_to_state_free_state,
+	FUNCNAME(set_state),
+	FUNCNAME(get_current_iteration),
+	FUNCNAME(get_total_iteration_count),
+	FUNCNAME(get_input_info),
+	FUNCNAME(set_input),
+	FUNCNAME(help)
+};
+
+/**
+ * This function fills in m with all of the function pointers for this mutator.
+ * @param m - a pointer to a mutator_t structure
+ * @return none
+ */
+#ifndef ALL_MUTATORS_IN_ONE
+INPUT_TO_STATE_MUTATOR_API void init(mutator_t * m)
+{
+	memcpy(m, &input_to_state_mutator, sizeof(mutator_t));
+}
+#endif
+
+static input_to_state_state_t * setup_options(char * options)
+{
+	input_to_state_state_t * state;
+
+	state = (input_to_state_state_t *)malloc(sizeof(input_to_state_state_t));
+	if (!state)
+		return NULL;
+	memset(state, 0, sizeof(input_to_state_state_t));
+
+	//Setup defaults
+	if (reset_mutate_info(&state->info)) {
+		free(state);
+		return NULL;
+	}
+
+	if (!options || !strlen(options))
+		return state;
+
+	PARSE_MUTATE_INFO_OPTIONS(state, options, FUNCNAME(cleanup), 0, 0);
+	return state;
+}
+
+/**
+ * This function will allocate and initialize the mutator state used in the other Mutator API
+ * functions.  
+ * @param options - a json string that contains the mutator specific string of options.
+ * @param state - Optionally, used to load a previously dumped state (with the get_state()
+ * function), that defines the current iteration of the mutator.
+ * @param input - used to produce new mutated inputs later when the mutate function is called
+ * @param input_length - the size of the input buffer
+ * @return a mutator specific structure or NULL on failure.
+ */
+INPUT_TO_STATE_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length)
+{
+	GENERIC_MUTATOR_CREATE(input_to_state_state_t, setup_options, FUNCNAME(cleanup));
+}
+
+/**
+ * This function will release any resources that the mutator has open 
+ * and free the mutator state structure.
+ * @param mutator_state - a mutator specific structure previously created by 
+ * the create function.  This structure will be freed and should not be referenced afterwards.
+ */
+INPUT_TO_STATE_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
+{
+	cleanup_mutate_info(&((input_to_state_state_t *)mutator_state)->info);
+	GENERIC_MUTATOR_CLEANUP(input_to_state_state_t)
+}
+
+static int mutate_inner(void * mutator_state, char * buffer, size_t buffer_length, int is_thread_safe)
+{
+	input_to_state_state_t * state = (input_to_state_state_t *)mutator_state;
+	mutate_buffer_t buf;
+	int ret;
+	if (buffer_length < state->input_length)
+		return -1;
+
+	buf.buffer = (uint8_t *)buffer;
+	buf.length = MIN(buffer_length, state->input_length);
+	buf.max_length = buffer_length;
+	memcpy(buf.buffer, state->input, buf.length);
+
+	if(is_thread_safe && take_mutex(state->info.mutate_mutex))
+		return -1;
+	state->iteration++;
+	ret = mutate_one(&state->info, &buf, mutate_funcs, ARRAY_SIZE(mutate_funcs));
+	if (is_thread_safe && release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret;
+}
+
+/**
+ * This function will mutate the input given in the create function and return it in the buffer argument.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param buffer - a buffer that the mutated input will be written to
+ * @param buffer_length - the size of the passed in buffer argument.  It must be at least as large as
+ * the original input buffer.
+ * @return - the length of the mutated data, 0 when the mutator is out of mutations, or -1 on error
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t buffer_length)
+{
+	return mutate_inner(mutator_state, buffer, buffer_length, 0);
+}
+
+/**
+ * This function will mutate the input given in the create function and return it in the buffer argument.
+ * This function also accepts a set of flags which instruct it how to mutate the input.  See global_types.h
+ * for the list of available flags.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param buffer - a buffer that the mutated input will be written to
+ * @param buffer_length - the size of the passed in buffer argument.  It must be at least as large as
+ * the original input buffer.
+ * @param flags - A set of mutate flags that modify how this mutator mutates the input.
+ * @return - the length of the mutated data, 0 when the mutator is out of mutations, or -1 on error
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(mutate_extended)(void * mutator_state, char * buffer, size_t buffer_length, uint64_t flags)
+{
+	SINGLE_INPUT_MUTATE_EXTENDED(input_to_state_state_t, state->info.mutate_mutex);
+}
+
+/**
+ * This function will return the state of the mutator.  The returned value can be used to restart the
+ * mutator at a later time, by passing it to the create or set_state function.  It is the caller's
+ * responsibility to free the memory allocated here by calling the free_state function.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @return - a buffer that defines the current state of the mutator.
+ */
+INPUT_TO_STATE_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
+{
+	input_to_state_state_t * state = (input_to_state_state_t *)mutator_state;
+	json_t *state_obj, *temp;
+	char * ret;
+
+	state_obj = json_object();
+	ADD_INT(temp, state->iteration, state_obj, "iteration");
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
+		return NULL;
+
+	ret = json_dumps(state_obj, 0);
+	json_decref(state_obj);
+	return ret;
+}
+
+/**
+ * This function will set the current state of the mutator.
+ * This can be used to restart a mutator once from a previous run.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param state - a previously dumped state buffer obtained by the get_state function.
+ * @return 0 on success or non-zero on failure
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state)
+{
+	input_to_state_state_t * current_state = (input_to_state_state_t *)mutator_state;
+	int result, temp_int;
+	if (!state)
+		return 1;
+	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
+	if (get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
+		return 1;
+	return 0;
+}
+
+/**
+ * This function will return the current iteration count of the mutator, i.e.
+ * how many mutations have been generated with it.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @return value - the number of previously generated mutations
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
+{
+	GENERIC_MUTATOR_GET_ITERATION(input_to_state_state_t);
+}
+
+/**
+ * This function will return the total possible number of mutations with this mutator, i.e. the number
+ * of places that the comparison operands added so far occur in the input.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @return - the number of possible mutations with this mutator, or -1 on error
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state)
+{
+	input_to_state_state_t * state = (input_to_state_state_t *)mutator_state;
+	int64_t count;
+
+	//Counting the candidates finds the operands in the input, which mutate uses too
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	count = count_input_to_state_candidates(&state->info, (u8 *)state->input, state->input_length);
+	if (release_mutex(state->info.mutate_mutex) || count < 0 || count > INT_MAX)
+		return -1;
+	return (int)count;
+}
+
+/**
+ * This function adds the operands of a comparison that the target made while processing the
+ * input.  Each operand is looked for in the input and replaced with the other one, in each of
+ * the encodings described in add_comparison_operands.  The operands should be added before the
+ * first call to mutate, and need to be added again after set_input or set_state.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param operand1 - the first operand, as it was in the target's memory
+ * @param operand2 - the second operand, as it was in the target's memory
+ * @param length - the length of the operands.  Operands with a length of 2, 4, or 8 bytes are
+ * treated as little-endian integers.
+ * @return 0 on success and -1 on failure
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(add_comparison)(void * mutator_state, char * operand1, char * operand2, size_t length)
+{
+	input_to_state_state_t * state = (input_to_state_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	ret = add_comparison_operands(&state->info, (u8 *)operand1, (u8 *)operand2, length);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	input_to_state_state_t * state = (input_to_state_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(input_to_state_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
+/**
+ * This function will set the mutator's input to something new.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param new_input - The new input used to produce new mutated inputs later when the mutate function is called
+ * @param input_length - the size in bytes of the input buffer.
+ * @return 0 on success and -1 on failure
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
+{
+	//The comparison operands were for the old input
+	clear_comparison_operands(&((input_to_state_state_t *)mutator_state)->info);
+	GENERIC_MUTATOR_SET_INPUT(input_to_state_state_t);
+}
+
+/**
+ * Obtains information about the inputs that were given to the mutator when it was created
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param num_inputs - a pointer to an integer used to return the number of inputs given to this mutator
+ * when it was created.  This parameter is optional and can be NULL, if this information is not needed
+ * @param input_sizes - a pointer to a size_t array used to return the sizes of the inputs given to this
+ * mutator when it was created. This parameter is optional and can be NULL, if this information is not needed.
+ */
+INPUT_TO_STATE_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes)
+{
+	SINGLE_INPUT_GET_INFO(input_to_state_state_t);
+}
+
+/**
+ * This function sets a help message for the mutator.
+ * @param help_str - A pointer that will be updated to point to the new help string.
+ * @return 0 on success and -1 on failure
+ */
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(help)(char **help_str)
+{
+	GENERIC_MUTATOR_HELP(
+"input_to_state - input-to-state (comparison operand) replacement mutator\n"
+"The comparisons that the target makes while processing the input should be\n"
+"added with add_comparison.  Each comparison operand found in the input is\n"
+"replaced with the value it was compared against, in little-endian, big-endian,\n"
+"and decimal string encodings.\n"
+"Options:\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
+"\n"
+	);
+}
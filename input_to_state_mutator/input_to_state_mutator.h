@@ -0,0 +1,36 @@
+#pragma once
+
+#include <global_types.h>
+#include <mutators.h>
+
+#ifdef _WIN32
+#ifdef INPUT_TO_STATE_MUTATOR_EXPORTS
+#define INPUT_TO_STATE_MUTATOR_API __declspec(dllexport)
+#else
+#define INPUT_TO_STATE_MUTATOR_API __declspec(dllimport)
+#endif
+#else //_WIN32
+#define INPUT_TO_STATE_MUTATOR_API
+#endif
+
+#define MUTATOR_NAME "input_to_state"
+#define MUTATOR_PREFIX input_to_state
+
+INPUT_TO_STATE_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
+INPUT_TO_STATE_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t buffer_length);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(mutate_extended)(void * mutator_state, char * buffer, size_t buffer_length, uint64_t flags);
+INPUT_TO_STATE_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state);
+#define input_to_state_free_state default_free_state
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state);
+INPUT_TO_STATE_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(add_comparison)(void * mutator_state, char * operand1, char * operand2, size_t length);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
+INPUT_TO_STATE_MUTATOR_API int FUNCNAME(help)(char **help_str);
+
+#ifndef ALL_MUTATORS_IN_ONE
+INPUT_TO_STATE_MUTATOR_API void init(mutator_t * m);
+#endif
@@ -26,6 +26,7 @@ static int(*const mutate_funcs[])(mutate_info_t *, mutate_buffer_t *) = {
 	interesting_one_byte,
 	interesting_two_byte,
 	interesting_four_byte,
+	interesting_eight_byte,
 };
 
 mutator_t interesting_value_mutator = {
@@ -58,7 +59,7 @@ INTERESTING_VALUE_MUTATOR_API void init(mutator_t * m)
 static interesting_value_state_t * setup_options(char * options)
 {
 	interesting_value_state_t * state;
-	int bytes_per_stage[] = { 1, 2, 4 };
+	int bytes_per_stage[] = { 1, 2, 4, 8 };
 	int i;
 
 	state = (interesting_value_state_t *)malloc(sizeof(interesting_value_state_t));
@@ -188,7 +189,7 @@ INTERESTING_VALUE_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 
 	state_obj = json_object();
 	ADD_INT(temp, state->iteration, state_obj, "iteration");
-	if (!add_mutate_info_to_json(state_obj, &state->info))
+	if (!add_mutate_info_to_json(state_obj, &state->info, state->input, state->input_length))
 		return NULL;
 
 	ret = json_dumps(state_obj, 0);
@@ -210,7 +211,7 @@ INTERESTING_VALUE_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char
 	if (!state)
 		return 1;
 	GET_INT(temp_int, state, current_state->iteration, "iteration", result);
-	if (get_mutate_info_from_json(state, &current_state->info))
+	if (get_mutate_info_from_json(state, &current_state->info, &current_state->input, &current_state->input_length))
 		return 1;
 	return 0;
 }
@@ -226,6 +227,28 @@ INTERESTING_VALUE_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator
 	GENERIC_MUTATOR_GET_ITERATION(interesting_value_state_t);
 }
 
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+INTERESTING_VALUE_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	interesting_value_state_t * state = (interesting_value_state_t *)mutator_state;
+
+	if (take_mutex(state->info.mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(interesting_value_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	add_mutate_info_memory_usage(&state->info, usage);
+	if (release_mutex(state->info.mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -261,9 +284,31 @@ INTERESTING_VALUE_MUTATOR_API int FUNCNAME(help)(char **help_str)
 	GENERIC_MUTATOR_HELP(
 "interesting_value - afl-based interesting value mutator\n"
 "Options:\n"
-"  num_bytes             The number of bytes to operate on; either 1, 2, or 4.\n"
-"                          The default option is to do all three of the\n"
+"  dedup_file            A file that backs the duplicate output filter, which is\n"
+"                          created if it doesn't exist.  The processes that use\n"
+"                          the same file don't repeat each other's outputs.\n"
+"  dedup_size            The size in bytes of the duplicate output filter (4MB\n"
+"                          by default), which replaces the havoc and splice\n"
+"                          outputs that repeat an earlier output.  It must be at\n"
+"                          least 64.  Setting this or dedup_file enables the\n"
+"                          filter.\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
+"  num_bytes             The number of bytes to operate on; either 1, 2, 4, or\n"
+"                          8. The default option is to do all four of the\n"
 "                          options, one after another.\n"
+"  protect_bytes         A list of byte values (e.g. 0-31,127) that are never\n"
+"                          mutated, wherever they occur in the input\n"
+"  regions               The offsets of the input that can be mutated, as a list\n"
+"                          of ranges such as 4-99,120- (the format used by cut).\n"
+"                          The other offsets are left as they are.\n"
 "  skip_previous_stages  Whether the mutation outputs should skip any output\n"
 "                          that would match the output of the bit_flip or\n"
 "                          arithmetic mutator.  Useful when using multiple\n"
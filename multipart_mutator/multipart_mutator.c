@@ -5,6 +5,7 @@
 #include <Shlwapi.h>
 #else
 #include <libgen.h>
+#include <pthread.h>
 #include <unistd.h>
 #endif
 
@@ -14,19 +15,108 @@
 
 #include <utils.h>
 #include <mutator_factory.h>
+#ifdef ALL_MUTATORS_IN_ONE
+#include <mutators_all.h>
+#endif
 #include <jansson.h>
 #include <jansson_helper.h>
 
+struct part_pool;
+
 typedef struct
 {
 	char ** mutator_names;
 	char * mutator_directory;
 
-	mutator_t ** mutators;
-	void ** mutator_states;
+	mutator_t ** mutators;  //Owned by the mutator cache, not the multipart state
+	void ** mutator_states; //Each part's state is NULL until that part is first mutated
 	size_t mutator_count;
+
+	//The arguments used to create each part's mutator state, which are kept until it's created.
+	//The inputs are always kept, so parts whose mutators are out of mutations can be passed through.
+	char ** part_options;
+	char ** part_states;
+	char ** part_inputs;
+	size_t * part_input_lengths;
+	int * part_iterations;   //The iteration in each part's saved state, until the part is created
+
+	int parallel;             //The number of threads that mutate parts at once
+	struct part_pool * pool;  //The worker threads, or NULL if the parts are mutated serially
+	int * part_results;
+
+	//The buffers that mutate() mutates the parts into, before they're copied into its container
+	char ** part_buffers;
+	size_t * part_buffer_lengths;
+	size_t part_buffer_size;
+	size_t * part_lengths;
 } multipart_state_t;
 
+//A mutator library that has been loaded by a multipart mutator
+typedef struct
+{
+	char * directory;
+	char * name;
+	mutator_t * mutator;
+} cached_mutator_t;
+
+//The mutator libraries are loaded once per process and shared between all of the multipart
+//mutators, so creating a multipart mutator doesn't dlopen and look up every part's library again
+static cached_mutator_t * mutator_cache = NULL;
+static size_t mutator_cache_count = 0, mutator_cache_max = 0;
+static char * default_mutator_directory = NULL;
+static int default_mutator_directory_found = 0;
+#ifdef _WIN32
+static SRWLOCK mutator_cache_lock = SRWLOCK_INIT;
+#define LOCK_MUTATOR_CACHE() AcquireSRWLockExclusive(&mutator_cache_lock)
+#define UNLOCK_MUTATOR_CACHE() ReleaseSRWLockExclusive(&mutator_cache_lock)
+#else
+static pthread_mutex_t mutator_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_MUTATOR_CACHE() pthread_mutex_lock(&mutator_cache_lock)
+#define UNLOCK_MUTATOR_CACHE() pthread_mutex_unlock(&mutator_cache_lock)
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION pool_lock_t;
+typedef CONDITION_VARIABLE pool_cond_t;
+typedef HANDLE pool_thread_t;
+#define POOL_LOCK(lock) EnterCriticalSection(lock)
+#define POOL_UNLOCK(lock) LeaveCriticalSection(lock)
+#define POOL_WAIT(cond, lock) SleepConditionVariableCS(cond, lock, INFINITE)
+#define POOL_BROADCAST(cond) WakeAllConditionVariable(cond)
+#else
+typedef pthread_mutex_t pool_lock_t;
+typedef pthread_cond_t pool_cond_t;
+typedef pthread_t pool_thread_t;
+#define POOL_LOCK(lock) pthread_mutex_lock(lock)
+#define POOL_UNLOCK(lock) pthread_mutex_unlock(lock)
+#define POOL_WAIT(cond, lock) pthread_cond_wait(cond, lock)
+#define POOL_BROADCAST(cond) pthread_cond_broadcast(cond)
+#endif
+
+//A small pool of threads that mutate a multipart mutator's parts at the same time.  Each part has
+//its own mutator state, so different parts can be mutated at once.  The thread that calls
+//mutate_parts() mutates parts too, so there is one less worker thread than the parallel option.
+typedef struct part_pool
+{
+	pool_lock_t lock;
+	pool_cond_t work_ready;
+	pool_cond_t work_done;
+	pool_thread_t * threads;
+	size_t thread_count;
+	int stop;
+
+	//The current set of parts being mutated
+	uint64_t generation;
+	multipart_state_t * state;
+	char ** buffers;
+	size_t * buffer_lengths;
+	size_t * part_lengths;
+	size_t next_part;
+	size_t parts_done;
+} part_pool_t;
+
+static char * get_default_mutator_directory();
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 // Helper functions ///////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -104,6 +194,281 @@ static void free_mutator_arrays(char ** inputs, size_t * input_lengths, size_t i
 	free(input_lengths);
 }
 
+/**
+ * Gets a mutator from the process wide mutator cache, loading its library the first time it's used.
+ * @param directory - the directory to look for the mutator library in, or NULL to search the
+ * normal library paths
+ * @param name - the mutator's name or library filename
+ * @return - the mutator, which is owned by the cache and must not be freed, or NULL on failure
+ */
+static mutator_t * get_cached_mutator(char * directory, char * name)
+{
+	cached_mutator_t * new_cache;
+	mutator_t * mutator = NULL;
+	size_t i;
+
+#ifdef ALL_MUTATORS_IN_ONE
+	//Mutators that are built into the same library don't need to be loaded
+	mutator = mutators_all_find(name);
+	if (mutator)
+		return mutator;
+#endif
+
+	LOCK_MUTATOR_CACHE();
+	for (i = 0; i < mutator_cache_count && !mutator; i++)
+	{
+		if (!strcmp(mutator_cache[i].name, name) && (mutator_cache[i].directory == directory
+			|| (mutator_cache[i].directory && directory && !strcmp(mutator_cache[i].directory, directory))))
+			mutator = mutator_cache[i].mutator;
+	}
+
+	if (!mutator) {
+		if (mutator_cache_count == mutator_cache_max) {
+			new_cache = (cached_mutator_t *)realloc(mutator_cache, (mutator_cache_max + 8) * sizeof(cached_mutator_t));
+			if (!new_cache) {
+				UNLOCK_MUTATOR_CACHE();
+				return NULL;
+			}
+			mutator_cache = new_cache;
+			mutator_cache_max += 8;
+		}
+
+		mutator = mutator_factory_directory(directory, name);
+		if (mutator) {
+			mutator_cache[mutator_cache_count].directory = directory ? strdup(directory) : NULL;
+			mutator_cache[mutator_cache_count].name = strdup(name);
+			mutator_cache[mutator_cache_count].mutator = mutator;
+			mutator_cache_count++;
+		}
+	}
+	UNLOCK_MUTATOR_CACHE();
+	return mutator;
+}
+
+/**
+ * Gets the default mutator directory, which is only determined once per process
+ * @return - a copy of the default mutator directory, or NULL if it can't be determined
+ */
+static char * get_cached_default_mutator_directory()
+{
+	char * directory = NULL;
+
+	LOCK_MUTATOR_CACHE();
+	if (!default_mutator_directory_found) {
+		default_mutator_directory = get_default_mutator_directory();
+		default_mutator_directory_found = 1;
+	}
+	if (default_mutator_directory)
+		directory = strdup(default_mutator_directory);
+	UNLOCK_MUTATOR_CACHE();
+	return directory;
+}
+
+/**
+ * Creates a part's mutator state, if it hasn't been created already.  The parts are created
+ * lazily, so parts that are never mutated don't pay for creating their mutator.
+ * @param multipart_state - the multipart mutator's state
+ * @param part - the part to create the mutator state for
+ * @return - 0 on success, nonzero on failure
+ */
+static int create_part(multipart_state_t * multipart_state, size_t part)
+{
+	if (multipart_state->mutator_states[part])
+		return 0;
+
+	multipart_state->mutator_states[part] = multipart_state->mutators[part]->create(multipart_state->part_options[part],
+		multipart_state->part_states[part], multipart_state->part_inputs[part], multipart_state->part_input_lengths[part]);
+	if (!multipart_state->mutator_states[part]) {
+		printf("Bad mutator options or bad saved state for mutator %lu (%s)\n", part, multipart_state->mutator_names[part]);
+		return 1;
+	}
+
+	//The mutator has its own copy of these now
+	free(multipart_state->part_options[part]);
+	free(multipart_state->part_states[part]);
+	multipart_state->part_options[part] = NULL;
+	multipart_state->part_states[part] = NULL;
+	return 0;
+}
+
+/**
+ * Reads the iteration out of a part's saved state, without creating the part's mutator state.
+ * Every mutator saves its iteration as the "iteration" item of its state.
+ * @param saved_state - the part's saved state, or NULL
+ * @return - the iteration the saved state is at, or 0 if it doesn't have one
+ */
+static int get_saved_iteration(const char * saved_state)
+{
+	json_t * root;
+	int iteration = 0;
+
+	if (!saved_state)
+		return 0;
+	root = json_loads(saved_state, 0, NULL);
+	if (root && json_is_integer(json_object_get(root, "iteration")))
+		iteration = (int)json_integer_value(json_object_get(root, "iteration"));
+	if (root)
+		json_decref(root);
+	return iteration;
+}
+
+/**
+ * Mutates one part of the input.  If the part's mutator is out of mutations, the part's input is
+ * copied to the buffer unchanged instead.
+ * @param multipart_state - the multipart mutator's state
+ * @param part - the part to mutate
+ * @param buffer - the buffer to write the mutated part to
+ * @param buffer_length - the size of buffer
+ * @param part_length - used to return the length of the part written to buffer
+ * @return - 1 if the part was mutated, 0 if it was passed through unchanged, or -1 on error
+ */
+static int mutate_part(multipart_state_t * multipart_state, size_t part, char * buffer, size_t buffer_length, size_t * part_length)
+{
+	int ret;
+
+	if (create_part(multipart_state, part))
+		return -1;
+	ret = multipart_state->mutators[part]->mutate_extended(multipart_state->mutator_states[part], buffer, buffer_length, 0);
+	if (ret < 0)
+		return -1;
+	if (ret > 0) {
+		*part_length = ret;
+		return 1;
+	}
+
+	if (multipart_state->part_input_lengths[part] > buffer_length)
+		return -1;
+	memcpy(buffer, multipart_state->part_inputs[part], multipart_state->part_input_lengths[part]);
+	*part_length = multipart_state->part_input_lengths[part];
+	return 0;
+}
+
+/**
+ * Mutates parts from the pool's current set until there aren't any left.  This must be called
+ * with the pool's lock held.
+ * @param pool - the part_pool_t to mutate the parts of
+ */
+static void run_pool_parts(part_pool_t * pool)
+{
+	multipart_state_t * state = pool->state;
+	size_t part;
+	int result;
+
+	while (pool->next_part < state->mutator_count)
+	{
+		part = pool->next_part++;
+		POOL_UNLOCK(&pool->lock);
+		result = mutate_part(state, part, pool->buffers[part], pool->buffer_lengths[part], &pool->part_lengths[part]);
+		POOL_LOCK(&pool->lock);
+		state->part_results[part] = result;
+		pool->parts_done++;
+	}
+	if (pool->parts_done == state->mutator_count)
+		POOL_BROADCAST(&pool->work_done);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_worker(LPVOID arg)
+#else
+static void * pool_worker(void * arg)
+#endif
+{
+	part_pool_t * pool = (part_pool_t *)arg;
+	uint64_t seen = 0;
+
+	POOL_LOCK(&pool->lock);
+	while (1)
+	{
+		while (!pool->stop && pool->generation == seen)
+			POOL_WAIT(&pool->work_ready, &pool->lock);
+		if (pool->stop)
+			break;
+		seen = pool->generation;
+		run_pool_parts(pool);
+	}
+	POOL_UNLOCK(&pool->lock);
+	return 0;
+}
+
+/**
+ * Stops a part_pool_t's threads and frees it
+ * @param pool - the part_pool_t to free
+ */
+static void destroy_part_pool(part_pool_t * pool)
+{
+	size_t i;
+
+	POOL_LOCK(&pool->lock);
+	pool->stop = 1;
+	POOL_BROADCAST(&pool->work_ready);
+	POOL_UNLOCK(&pool->lock);
+	for (i = 0; i < pool->thread_count; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(pool->threads[i], INFINITE);
+		CloseHandle(pool->threads[i]);
+#else
+		pthread_join(pool->threads[i], NULL);
+#endif
+	}
+
+#ifdef _WIN32
+	DeleteCriticalSection(&pool->lock);
+#else
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work_ready);
+	pthread_cond_destroy(&pool->work_done);
+#endif
+	free(pool->threads);
+	free(pool);
+}
+
+/**
+ * Creates a part_pool_t and starts its threads
+ * @param thread_count - the number of worker threads to start
+ * @return - the new part_pool_t, or NULL on failure
+ */
+static part_pool_t * create_part_pool(size_t thread_count)
+{
+	part_pool_t * pool;
+
+	pool = (part_pool_t *)calloc(1, sizeof(part_pool_t));
+	if (!pool)
+		return NULL;
+	pool->threads = (pool_thread_t *)calloc(thread_count, sizeof(pool_thread_t));
+	if (!pool->threads) {
+		free(pool);
+		return NULL;
+	}
+
+#ifdef _WIN32
+	InitializeCriticalSection(&pool->lock);
+	InitializeConditionVariable(&pool->work_ready);
+	InitializeConditionVariable(&pool->work_done);
+#else
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+#endif
+
+	for (; pool->thread_count < thread_count; pool->thread_count++)
+	{
+#ifdef _WIN32
+		pool->threads[pool->thread_count] = CreateThread(NULL, 0, pool_worker, pool, 0, NULL);
+		if (!pool->threads[pool->thread_count])
+			break;
+#else
+		if (pthread_create(&pool->threads[pool->thread_count], NULL, pool_worker, pool))
+			break;
+#endif
+	}
+	if (pool->thread_count != thread_count) {
+		destroy_part_pool(pool);
+		return NULL;
+	}
+	return pool;
+}
+
 static int setup_mutators(multipart_state_t * multipart_state, char * mutator_options, char * mutator_states, char * mutator_inputs)
 {
 	size_t inputs_count, i;
@@ -123,8 +488,8 @@ static int setup_mutators(multipart_state_t * multipart_state, char * mutator_op
 	num_states = get_json_items(mutator_states, NULL, &states, &all_use_same_states);
 
 	if (inputs_count != multipart_state->mutator_count
-		|| (num_options != 0 && !all_use_same_options && num_options != inputs_count)
-		|| (num_states != 0 && !all_use_same_states && num_states != inputs_count))
+		|| (num_options != 0 && !all_use_same_options && (size_t)num_options != inputs_count)
+		|| (num_states != 0 && !all_use_same_states && (size_t)num_states != inputs_count))
 	{
 		free_mutator_arrays(inputs, input_lengths, inputs_count, options, num_options, states, num_states);
 		return 1;
@@ -132,45 +497,58 @@ static int setup_mutators(multipart_state_t * multipart_state, char * mutator_op
 
 	multipart_state->mutators = calloc(inputs_count, sizeof(mutator_t *));
 	multipart_state->mutator_states = calloc(inputs_count, sizeof(void *));
-	if(!multipart_state->mutators || !multipart_state->mutator_states) {
-		free(multipart_state->mutators);
-		free(multipart_state->mutator_states);
-		multipart_state->mutators = NULL;
-		multipart_state->mutator_states = NULL;
+	multipart_state->part_options = calloc(inputs_count, sizeof(char *));
+	multipart_state->part_states = calloc(inputs_count, sizeof(char *));
+	multipart_state->part_results = calloc(inputs_count, sizeof(int));
+	multipart_state->part_iterations = calloc(inputs_count, sizeof(int));
+	if(!multipart_state->mutators || !multipart_state->mutator_states || !multipart_state->part_options
+		|| !multipart_state->part_states || !multipart_state->part_results || !multipart_state->part_iterations) {
 		free_mutator_arrays(inputs, input_lengths, inputs_count, options, num_options, states, num_states);
 		return 1;
 	}
 
+	//The parts' inputs are kept until their mutator states are created
+	multipart_state->part_inputs = inputs;
+	multipart_state->part_input_lengths = input_lengths;
+
 	for (i = 0; i < inputs_count; i++)
 	{
-		//Create the mutator and get its state
-		multipart_state->mutators[i] = mutator_factory_directory(multipart_state->mutator_directory, multipart_state->mutator_names[i]);
-		if (multipart_state->mutators[i]) {
-			option = NULL;
-			if (all_use_same_options)
-				option = options[0];
-			else if(num_options != 0)
-				option = options[i];
-			state = NULL;
-			if (all_use_same_states)
-				state = states[0];
-			else if (num_states != 0)
-				state = states[i];
-
-			multipart_state->mutator_states[i] = multipart_state->mutators[i]->create(option, state, inputs[i], input_lengths[i]);
-		}
-
-		if (!multipart_state->mutator_states[i] || !multipart_state->mutators[i])
+		//Load the mutator now, so unknown mutators are still reported by create
+		multipart_state->mutators[i] = get_cached_mutator(multipart_state->mutator_directory, multipart_state->mutator_names[i]);
+		if (!multipart_state->mutators[i])
 		{
-			printf("Unknown mutator %s, bad mutator options, or bad saved state for mutator %lu\n", multipart_state->mutator_names[i], i);
-			free(multipart_state->mutators[i]); //free the one that failed, if it did
-			multipart_state->mutators[i] = NULL;
-			free_mutator_arrays(inputs, input_lengths, inputs_count, options, num_options, states, num_states);
+			printf("Unknown mutator %s for mutator %lu\n", multipart_state->mutator_names[i], i);
+			free_mutator_arrays(NULL, NULL, 0, options, num_options, states, num_states);
 			return 1;
 		}
+
+		option = NULL;
+		if (all_use_same_options)
+			option = options[0];
+		else if(num_options != 0)
+			option = options[i];
+		state = NULL;
+		if (all_use_same_states)
+			state = states[0];
+		else if (num_states != 0)
+			state = states[i];
+
+		multipart_state->part_options[i] = option ? strdup(option) : NULL;
+		multipart_state->part_states[i] = state ? strdup(state) : NULL;
+		multipart_state->part_iterations[i] = get_saved_iteration(state);
 	}
 
-	free_mutator_arrays(inputs, input_lengths, inputs_count, options, num_options, states, num_states);
+	free_mutator_arrays(NULL, NULL, 0, options, num_options, states, num_states);
+
+	//The calling thread mutates parts too, and there's no point in having more threads than parts
+	if (multipart_state->parallel > 1 && inputs_count > 1) {
+		multipart_state->pool = create_part_pool(((size_t)multipart_state->parallel < inputs_count ?
+			(size_t)multipart_state->parallel : inputs_count) - 1);
+		if (!multipart_state->pool) {
+			printf("Unable to start the multipart mutator's threads\n");
+			return 1;
+		}
+	}
 	return 0;
 }
 
@@ -286,9 +664,10 @@ static multipart_state_t * setup_options(char * options, char * input, size_t in
 
 	PARSE_OPTION_STRING(state, options, mutator_directory, "mutator_directory", FUNCNAME(cleanup));
 	PARSE_OPTION_ARRAY(state, options, mutator_names, mutator_count, "mutators", FUNCNAME(cleanup));
+	PARSE_OPTION_INT(state, options, parallel, "parallel", FUNCNAME(cleanup));
 
 	if(!state->mutator_directory)
-		state->mutator_directory = get_default_mutator_directory();
+		state->mutator_directory = get_cached_default_mutator_directory();
 
 	if (state->mutator_count == 0) {
 		FUNCNAME(cleanup)(state);
@@ -335,37 +714,146 @@ MULTIPART_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 	multipart_state_t * state = (multipart_state_t *)mutator_state;
 	size_t i;
 
+	if (state->pool)
+		destroy_part_pool(state->pool);
 	for (i = 0; i < state->mutator_count; i++)
 	{
 		free(state->mutator_names[i]);
-		if (state->mutators && state->mutators[i])
-		{
+		if (state->mutator_states && state->mutator_states[i])
 			state->mutators[i]->cleanup(state->mutator_states[i]);
-			free(state->mutators[i]);
-		}
+		if (state->part_options)
+			free(state->part_options[i]);
+		if (state->part_states)
+			free(state->part_states[i]);
+		if (state->part_inputs)
+			free(state->part_inputs[i]);
+		if (state->part_buffers)
+			free(state->part_buffers[i]);
 	}
 
 	free(state->mutator_directory);
 	free(state->mutators);
 	free(state->mutator_states);
+	free(state->part_options);
+	free(state->part_states);
+	free(state->part_inputs);
+	free(state->part_input_lengths);
+	free(state->part_results);
+	free(state->part_iterations);
+	free(state->part_buffers);
+	free(state->part_buffer_lengths);
+	free(state->part_lengths);
 	free(state);
 }
 
 /**
- * The multipart mutator does not implement the mutate function, and thus this function always
- * returns an error (-1).
- * @return - -1 to indicate an error
+ * This function will mutate all of the parts of the input given in the create function and return
+ * them in the buffer argument, as a container with each part's length (4 bytes, little endian)
+ * followed by the part.  Parts whose mutators are out of mutations are passed through unchanged.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param buffer - a buffer that the container of mutated parts will be written to
+ * @param buffer_length - the size of the passed in buffer argument
+ * @return - the length of the container, 0 when all of the parts' mutators are out of mutations,
+ * or -1 on error (including when the container doesn't fit in buffer)
  */
 MULTIPART_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t buffer_length)
 {
-	return -1;
+	multipart_state_t * state = (multipart_state_t *)mutator_state;
+	size_t i, offset = 0;
+	char * part_buffer;
+	int ret;
+
+	//Mutate each part into a buffer that's large enough for any part that would fit in the container
+	if (!state->part_buffers) {
+		state->part_buffers = calloc(state->mutator_count, sizeof(char *));
+		state->part_buffer_lengths = calloc(state->mutator_count, sizeof(size_t));
+		state->part_lengths = calloc(state->mutator_count, sizeof(size_t));
+		if (!state->part_buffers || !state->part_buffer_lengths || !state->part_lengths)
+			return -1;
+	}
+	if (state->part_buffer_size < buffer_length) {
+		for (i = 0; i < state->mutator_count; i++)
+		{
+			part_buffer = realloc(state->part_buffers[i], buffer_length);
+			if (!part_buffer)
+				return -1;
+			state->part_buffers[i] = part_buffer;
+			state->part_buffer_lengths[i] = buffer_length;
+		}
+		state->part_buffer_size = buffer_length;
+	}
+
+	ret = FUNCNAME(mutate_parts)(state, state->part_buffers, state->part_buffer_lengths, state->part_lengths);
+	if (ret <= 0)
+		return ret;
+
+	for (i = 0; i < state->mutator_count; i++)
+	{
+		if (state->part_lengths[i] > UINT32_MAX || buffer_length - offset < 4 + state->part_lengths[i])
+			return -1;
+		buffer[offset++] = (char)(state->part_lengths[i] & 0xff);
+		buffer[offset++] = (char)((state->part_lengths[i] >> 8) & 0xff);
+		buffer[offset++] = (char)((state->part_lengths[i] >> 16) & 0xff);
+		buffer[offset++] = (char)((state->part_lengths[i] >> 24) & 0xff);
+		memcpy(buffer + offset, state->part_buffers[i], state->part_lengths[i]);
+		offset += state->part_lengths[i];
+	}
+	return (int)offset;
+}
+
+/**
+ * This function will mutate all of the parts of the input given in the create function at once.  If
+ * the parallel option was set, the parts are mutated on that many threads.  Parts whose mutators are
+ * out of mutations are passed through unchanged.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param buffers - an array with a buffer for each part, that the mutated parts will be written to
+ * @param buffer_lengths - an array with the size of each of the buffers
+ * @param part_lengths - an array used to return the length of each of the mutated parts
+ * @return - the number of parts that were mutated, 0 when all of the parts' mutators are out of
+ * mutations, or -1 on error
+ */
+MULTIPART_MUTATOR_API int FUNCNAME(mutate_parts)(void * mutator_state, char ** buffers, size_t * buffer_lengths, size_t * part_lengths)
+{
+	multipart_state_t * state = (multipart_state_t *)mutator_state;
+	part_pool_t * pool = state->pool;
+	int mutated = 0;
+	size_t i;
+
+	if (pool) {
+		POOL_LOCK(&pool->lock);
+		pool->state = state;
+		pool->buffers = buffers;
+		pool->buffer_lengths = buffer_lengths;
+		pool->part_lengths = part_lengths;
+		pool->next_part = 0;
+		pool->parts_done = 0;
+		pool->generation++;
+		POOL_BROADCAST(&pool->work_ready);
+		run_pool_parts(pool);
+		while (pool->parts_done != state->mutator_count)
+			POOL_WAIT(&pool->work_done, &pool->lock);
+		POOL_UNLOCK(&pool->lock);
+	}
+	else {
+		for (i = 0; i < state->mutator_count; i++)
+			state->part_results[i] = mutate_part(state, i, buffers[i], buffer_lengths[i], &part_lengths[i]);
+	}
+
+	for (i = 0; i < state->mutator_count; i++)
+	{
+		if (state->part_results[i] < 0)
+			return -1;
+		mutated += state->part_results[i];
+	}
+	return mutated;
 }
 
 /**
  * This function will mutate the input given in the create function and return it in the buffer argument.
  * This function also accepts a set of flags which instruct it how to mutate the input.  See global_types.h
- * for the list of available flags.  The multipart mutator does not support mutating all of the inputs given
- * during create at once, so the MUTATE_MULTIPLE_INPUTS flag must be set.
+ * for the list of available flags.  This function mutates a single one of the inputs given during create,
+ * so the MUTATE_MULTIPLE_INPUTS flag must be set.  Use mutate or mutate_parts to mutate all of the inputs
+ * at once instead.  Each part's mutator state is created the first time that part is mutated.
  * @param mutator_state - a mutator specific structure previously created by the create function.
  * @param buffer - a buffer that the mutated input will be written to
  * @param buffer_length - the size of the passed in buffer argument.  It must be at least as large as
@@ -382,6 +870,8 @@ MULTIPART_MUTATOR_API int FUNCNAME(mutate_extended)(void * mutator_state, char *
 		return -1;
 
 	inner_flags = flags & ~(MUTATE_MULTIPLE_INPUTS | MUTATE_MULTIPLE_INPUTS_MASK);
+	if (create_part(state, input_part))
+		return -1;
 	return state->mutators[input_part]->mutate_extended(state->mutator_states[input_part], buffer, buffer_length, inner_flags);
 }
 
@@ -403,6 +893,11 @@ MULTIPART_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 	states_array = json_array();
 	for (i = 0; i < state->mutator_count; i++)
 	{
+		if (!state->mutator_states[i]) { //Parts that haven't been created keep the state they were given
+			temp = state->part_states[i] ? json_loads(state->part_states[i], 0, &error) : NULL;
+			json_array_append_new(states_array, temp ? temp : json_null());
+			continue;
+		}
 		single_state = state->mutators[i]->get_state(state->mutator_states[i]);
 		temp = json_loads(single_state, 0, &error);
 		state->mutators[i]->free_state(single_state);
@@ -443,6 +938,12 @@ MULTIPART_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 	{
 		temp = json_array_get(states_array, i);
 		single_state = json_dumps(temp, 0);
+		if (!current_state->mutator_states[i]) { //Save the state until the part is created
+			free(current_state->part_states[i]);
+			current_state->part_states[i] = single_state;
+			current_state->part_iterations[i] = get_saved_iteration(single_state);
+			continue;
+		}
 		current_state->mutators[i]->set_state(current_state->mutator_states[i], single_state);
 		free(single_state);
 	}
@@ -453,7 +954,8 @@ MULTIPART_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 
 /**
  * This function will return the current iteration count of the mutator, i.e.
- * how many mutations have been generated with it.
+ * how many mutations have been generated with it.  Parts that haven't been created
+ * yet report the iteration from their saved state, so they aren't created here.
  * @param mutator_state - a mutator specific structure previously created by the create function.
  * @return value - the number of previously generated mutations
  */
@@ -463,7 +965,10 @@ MULTIPART_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 	int lowest = -1, temp;
 	size_t i;
 	for (i = 0; i < state->mutator_count; i++) {
-		temp = state->mutators[i]->get_current_iteration(state->mutator_states[i]);
+		if (!state->mutator_states[i])
+			temp = state->part_iterations[i];
+		else
+			temp = state->mutators[i]->get_current_iteration(state->mutator_states[i]);
 		if (lowest == -1 || lowest > temp)
 			lowest = temp;
 	}
@@ -473,7 +978,9 @@ MULTIPART_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state)
 /**
  * Returns the total number of mutations possible with this mutator and the current options.
  * For the multipart mutator, it will determine the number of mutations possible from all of
- * the mutators and return the lowest value
+ * the mutators and return the lowest value.  The parts that haven't been created yet aren't
+ * created to count their mutations, so they're left out until they're first mutated, and the
+ * count can drop once they are.
  * @param mutator_state - a mutator specific structure previously created by the create function.
  * @return the number of possible mutations with this mutator, or -1 if infinite or the number
  * cannot be determined.
@@ -484,6 +991,8 @@ MULTIPART_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_sta
 	int lowest = -1, temp;
 	size_t i;
 	for (i = 0; i < state->mutator_count; i++) {
+		if (!state->mutator_states[i])
+			continue;
 		temp = state->mutators[i]->get_total_iteration_count(state->mutator_states[i]);
 		if (lowest == -1 || (temp != -1 && lowest > temp))
 			lowest = temp;
@@ -510,6 +1019,10 @@ MULTIPART_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int *
 		*input_sizes = malloc(sizeof(size_t) * state->mutator_count);
 		for (i = 0; i < state->mutator_count; i++)
 		{
+			if (!state->mutator_states[i]) {
+				(*input_sizes)[i] = state->part_input_lengths[i];
+				continue;
+			}
 			state->mutators[i]->get_input_info(state->mutator_states[i], NULL, &sizes);
 			(*input_sizes)[i] = sizes[0];
 			free(sizes);
@@ -517,6 +1030,42 @@ MULTIPART_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int *
 	}
 }
 
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).  The inputs, options, and buffers that are kept for
+ * the parts are reported as children, but the memory held by the parts' own mutators isn't included.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+MULTIPART_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	multipart_state_t * state = (multipart_state_t *)mutator_state;
+	size_t i;
+
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(multipart_state_t) +
+		state->mutator_count * (sizeof(char *) + sizeof(mutator_t *) + sizeof(void *) + 2 * sizeof(int));
+	if (state->mutator_directory)
+		usage->bytes[MEMORY_USAGE_STATE] += strlen(state->mutator_directory) + 1;
+
+	//The parts' own mutators aren't included, since the mutator_t interface can't report them
+	usage->bytes[MEMORY_USAGE_CHILDREN] = state->mutator_count * (3 * sizeof(char *) + sizeof(size_t));
+	if (state->part_buffers)
+		usage->bytes[MEMORY_USAGE_CHILDREN] += state->mutator_count * (sizeof(char *) + 2 * sizeof(size_t) + state->part_buffer_size);
+	for (i = 0; i < state->mutator_count; i++)
+	{
+		usage->bytes[MEMORY_USAGE_STATE] += strlen(state->mutator_names[i]) + 1;
+		if (state->part_options && state->part_options[i])
+			usage->bytes[MEMORY_USAGE_CHILDREN] += strlen(state->part_options[i]) + 1;
+		if (state->part_states && state->part_states[i])
+			usage->bytes[MEMORY_USAGE_CHILDREN] += strlen(state->part_states[i]) + 1;
+		if (state->part_inputs && state->part_inputs[i])
+			usage->bytes[MEMORY_USAGE_CHILDREN] += state->part_input_lengths[i];
+	}
+	return 0;
+}
+
 /**
  * This function will set the mutator's input to something new.
  * @param mutator_state - a mutator specific structure previously created by the create function.
@@ -540,7 +1089,22 @@ MULTIPART_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_i
 	}
 
 	for (i = 0; ret == 0 && i < state->mutator_count; i++)
+	{
+		if (!state->mutator_states[i]) { //Replace the input the part will be created with
+			free(state->part_inputs[i]);
+			state->part_inputs[i] = inputs[i];
+			state->part_input_lengths[i] = input_lengths[i];
+			inputs[i] = NULL;
+			continue;
+		}
 		ret = state->mutators[i]->set_input(state->mutator_states[i], inputs[i], input_lengths[i]);
+		if (!ret) { //Keep a copy to pass through once the part's mutator is out of mutations
+			free(state->part_inputs[i]);
+			state->part_inputs[i] = inputs[i];
+			state->part_input_lengths[i] = input_lengths[i];
+			inputs[i] = NULL;
+		}
+	}
 	free_mutator_arrays(inputs, input_lengths, inputs_count, NULL, 0, NULL, 0);
 	return ret;
 }
@@ -560,6 +1124,12 @@ MULTIPART_MUTATOR_API int FUNCNAME(help)(char **help_str)
 "Optional Options:\n"
 "  mutator_directory     The directory to look for other mutator libraries in\n"
 "  options               An array of mutator options to pass to each mutator used\n"
+"  parallel              The number of threads to mutate the parts with when\n"
+"                          all of the parts are mutated at once\n"
+"\n"
+"The mutate function mutates all of the parts at once, and returns them as a\n"
+"container with each part's length (4 bytes, little endian) followed by the\n"
+"part.  Parts whose mutators are out of mutations are passed through unchanged.\n"
 "\n"
 	);
 }
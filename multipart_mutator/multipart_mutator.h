@@ -14,6 +14,7 @@
 #endif
 
 #define MUTATOR_NAME "multipart"
+#define MUTATOR_PREFIX multipart
 
 MULTIPART_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 MULTIPART_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -25,8 +26,10 @@ MULTIPART_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state
 MULTIPART_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 MULTIPART_MUTATOR_API int FUNCNAME(get_total_iteration_count)(void * mutator_state);
 MULTIPART_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+MULTIPART_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 MULTIPART_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 MULTIPART_MUTATOR_API int FUNCNAME(help)(char **help_str);
+MULTIPART_MUTATOR_API int FUNCNAME(mutate_parts)(void * mutator_state, char ** buffers, size_t * buffer_lengths, size_t * part_lengths);
 
 #ifndef ALL_MUTATORS_IN_ONE
 MULTIPART_MUTATOR_API void init(mutator_t * m);
@@ -90,6 +90,12 @@
 
 #define HAVOC_MIN           16
 
+/* Power schedule constants (from AFLFast): the divisor applied to a
+   schedule's factor, and the largest factor a schedule can give: */
+
+#define POWER_BETA          1
+#define MAX_FACTOR          (POWER_BETA * 32)
+
 /* Maximum stacking for havoc-stage tweaks. The actual value is calculated
    like this: 
 
@@ -249,6 +255,14 @@
    100663045,    /* Large positive number (endian-agnostic) */ \
    2147483647    /* Overflow signed 32-bit when incremented */
 
+#define INTERESTING_64 \
+  -9223372036854775807LL - 1, /* Overflow signed 64-bit when decremented */ \
+  -2147483649LL,              /* Overflow signed 32-bit                  */ \
+   2147483648LL,              /* Overflow signed 32-bit                  */ \
+   4294967295LL,              /* Overflow unsig 32-bit when incremented  */ \
+   4294967296LL,              /* Overflow unsig 32 bit                   */ \
+   9223372036854775807LL      /* Overflow signed 64-bit when incremented */
+
 /***********************************************************
  *                                                         *
  *  Really exotic stuff you probably don't want to touch:  *
@@ -3,15 +3,32 @@
 #include "afl_config.h"
 #include "afl_debug.h"
 #include "afl_types.h"
+#include "edit_plan.h"
+#include "token_matcher.h"
+#include "operator_scheduler.h"
+#include "operator_weights.h"
+#include "token_scorer.h"
 
 #include <utils.h>
 
 #include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//Helpers to find the effector map entries for a byte or a range of bytes
+#define EFF_APOS(_p)          ((_p) >> EFF_MAP_SCALE2)
+#define EFF_REM(_x)           ((_x) & ((1 << EFF_MAP_SCALE2) - 1))
+#define EFF_ALEN(_l)          (EFF_APOS(_l) + !!EFF_REM(_l))
+#define EFF_SPAN_ALEN(_p, _l) (EFF_APOS((_p) + (_l) - 1) - EFF_APOS(_p) + 1)
+
 #ifdef _WIN32
 #include <io.h>
 #include <windows.h>
@@ -46,12 +63,89 @@ MUTATORS_API u32 UR(mutate_info_t * info, u32 limit) {
 	return rnd64(info) % limit;
 }
 
-//Mutates a buffer, running through each of the passed in mutate functions, updating the mutate_info_t
-//with the current progress through the mutation functions
-MUTATORS_API int mutate_one(mutate_info_t * info, mutate_buffer_t * buf, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs) {
-	int length = MUTATOR_DONE;
-	while ((length == MUTATOR_DONE || length == MUTATOR_TRY_AGAIN) && info->stage < num_funcs)
+/* Choose an offset to mutate (from start to end - 1), according to the position weights if
+   there are any.  Without them, this is the same as start + UR(info, end - start). */
+static inline u32 choose_position(mutate_info_t * info, u32 start, u32 end) {
+	return (u32)position_sampler_choose(&info->positions, start, end, rnd64(info));
+}
+
+/* Choose an offset (from start to end - 1) where width bytes can be mutated, or where bytes can be
+   inserted if width is 0.  Without regions, this is the same as choose_position.  Returns nonzero if
+   there isn't an offset in the range where the regions allow it. */
+static inline int choose_mutable_position(mutate_info_t * info, u32 start, u32 end, u32 width, u32 * pos) {
+	uint64_t random;
+	size_t offset;
+
+	if (!info->regions.enabled) {
+		*pos = choose_position(info, start, end);
+		return 0;
+	}
+	random = rnd64(info);
+	if (info->positions.weights) {
+		offset = alias_table_sample(&info->positions.table, random);
+		if (offset >= start && offset < end && region_map_contains(&info->regions, offset, width)) {
+			*pos = (u32)offset;
+			return 0;
+		}
+	}
+	if (region_map_choose(&info->regions, start, end, width, random, &offset))
+		return 1;
+	*pos = (u32)offset;
+	return 0;
+}
+
+/* Choose a bit to flip, in a byte chosen according to the position weights and regions if there are any */
+static inline int choose_bit_position(mutate_info_t * info, u32 length, u32 * pos) {
+	if (!info->positions.weights && !info->regions.enabled) {
+		*pos = UR(info, length << 3);
+		return 0;
+	}
+	if (choose_mutable_position(info, 0, length, 1, pos))
+		return 1;
+	*pos = (*pos << 3) | UR(info, 8);
+	return 0;
+}
+
+/* Finds the offset (or the bit, if bits is set) of the index'th place a deterministic stage mutates
+   width bytes (or bits) at.  Without regions, this is just index.  Returns nonzero once the stage
+   has run out of places. */
+static inline int locate_position(mutate_info_t * info, size_t length, uint64_t index, size_t width, int bits, uint64_t * pos) {
+	uint64_t units = (uint64_t)length << (bits ? 3 : 0);
+
+	if (info->regions.enabled)
+		return region_map_locate(&info->regions, index, width, bits, pos);
+	if (units < width || index > units - width)
+		return 1;
+	*pos = index;
+	return 0;
+}
+
+/* The number of bytes of an input that the walking_byte stage flips, i.e. the ones that the regions
+   allow to be mutated */
+static size_t count_mutable_bytes(mutate_info_t * info, size_t length) {
+	if (!info->regions.enabled || !info->regions.valid || info->regions.input_length != length)
+		return length;
+	return (size_t)region_map_count(&info->regions, 1, 0);
+}
+
+/* Runs the mutate functions from the current stage until one of them produces an output, updating the
+   mutate_info_t with the current progress through the mutation functions */
+static int mutate_next_output(mutate_info_t * info, mutate_buffer_t * buf, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *),
+	size_t num_funcs, size_t input_length) {
+	int length = MUTATOR_DONE, stage_count = (int)num_funcs;
+
+	while ((length == MUTATOR_DONE || length == MUTATOR_TRY_AGAIN) && info->stage < stage_count)
 	{
+		if (info->provenance.size) { //Remember what the output depends on, so it can be regenerated
+			info->provenance_pending.random_state[0] = info->random_state[0];
+			info->provenance_pending.random_state[1] = info->random_state[1];
+			info->provenance_pending.stage_cur = info->stage_cur;
+			info->provenance_pending.input_length = (uint32_t)input_length;
+			info->provenance_pending.stage = info->stage;
+			info->provenance_pending.queue_cycle = info->queue_cycle;
+			info->provenance_pending.trim_remove_len = info->trim_remove_len;
+			info->provenance_pending.trim_remove_pos = info->trim_remove_pos;
+		}
 		length = mutate_funcs[info->stage](info, buf);
 		if (length == MUTATOR_TRY_AGAIN)
 			info->stage_cur++;
@@ -60,14 +154,59 @@ MUTATORS_API int mutate_one(mutate_info_t * info, mutate_buffer_t * buf, int(*co
 			info->stage++;
 			info->stage_cur = 0;
 			if (info->one_stage_only) { //if we're only doing one stage, set the stage to the end
-				info->stage = num_funcs; //so the next call to mutate_one doesn't return a mutated buffer
+				info->stage = stage_count; //so the next call to mutate_one doesn't return a mutated buffer
 				break;
 			}
 		}
 	}
 	info->stage_cur++;
-	if (length == MUTATOR_DONE && info->stage == num_funcs) //If we've reached
+	if (length == MUTATOR_DONE && info->stage == stage_count) //If we've reached
 		info->stage_cur = 0; //the end of the mutators cycle, reset the stage to 0
+	if (length > 0)
+		fixup_list_apply(&info->fixups, buf->buffer, length);
+	return length;
+}
+
+//Mutates a buffer, running through each of the passed in mutate functions, updating the mutate_info_t
+//with the current progress through the mutation functions
+MUTATORS_API int mutate_one(mutate_info_t * info, mutate_buffer_t * buf, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs) {
+	int length, retries;
+	size_t input_length = buf->length;
+	u8 * dedup_input;
+
+	// The buffer still holds the unmodified input at this point
+	if (region_map_update(&info->regions, buf->buffer, buf->length)
+		|| fixup_list_update(&info->fixups, buf->buffer, buf->length))
+		return -1;
+	if (info->dedup.enabled && info->dedup_input_max < input_length) {
+		dedup_input = (u8 *)realloc(info->dedup_input, input_length);
+		if (!dedup_input)
+			return -1;
+		info->dedup_input = dedup_input;
+		info->dedup_input_max = input_length;
+	}
+	if (info->dedup.enabled)
+		memcpy(info->dedup_input, buf->buffer, input_length);
+
+	for (retries = 0; ; retries++)
+	{
+		length = mutate_next_output(info, buf, mutate_funcs, num_funcs, input_length);
+		if (length <= 0 || !info->dedup.enabled)
+			break;
+
+		//Duplicates from the random stages are replaced with another output from the same stage.  The
+		//deterministic stages' outputs are only added to the filter, since their results are matched
+		//back up to the outputs that produced them by iteration.
+		if (!output_filter_check(&info->dedup, buf->buffer, length) || retries == OUTPUT_FILTER_MAX_RETRIES
+			|| !(info->random_stages & (1ULL << info->stage)))
+			break;
+		memcpy(buf->buffer, info->dedup_input, input_length);
+		buf->length = input_length;
+		info->stage_cur--; //The replacement takes the duplicate's place in the stage's budget
+		info->havoc_scheduler.current = 0; //The replaced output's operators and tokens don't get credit
+		info->dictionary_scorer.num_current = 0;
+	}
+	info->provenance_pending_valid = length > 0;
 	return length;
 }
 
@@ -84,10 +223,46 @@ static void clear_splice_files(mutate_info_t * info)
 		info->splice_files = NULL;
 		info->splice_files_count = 0;
 	}
+	info->splice_files_bytes = 0;
+	free(info->splice_partners);
+	info->splice_partners = NULL;
+	info->splice_partners_count = 0;
+	info->splice_partners_valid = 0;
+}
+
+/**
+ * Counts the memory that the memory_limit option applies to, i.e. the memory held by the
+ * dictionary tokens, the splice files, and the seed pool
+ * @param info - the mutate_info_t to count the memory of
+ * @return - the number of bytes
+ */
+static uint64_t limited_memory_usage(mutate_info_t * info)
+{
+	return token_dictionary_memory_usage(&info->dictionary) + info->splice_files_bytes + seed_pool_memory_usage(&info->seed_pool);
 }
 
 /**
- * Loads the splice files into the given afl state
+ * Frees the most recently loaded splice file, to make room for something else under the
+ * memory_limit option.  The splice partners point into the splice files, so they're recomputed
+ * the next time they're needed.
+ * @param info - the mutate_info_t to evict the splice file from
+ */
+static void evict_splice_file(mutate_info_t * info)
+{
+	string_t * splice_file = info->splice_files[--info->splice_files_count];
+
+	info->splice_files_bytes -= splice_file->len + sizeof(string_t) + sizeof(string_t *);
+	free(splice_file->s);
+	free(splice_file);
+	free(info->splice_partners);
+	info->splice_partners = NULL;
+	info->splice_partners_count = 0;
+	info->splice_partners_valid = 0;
+}
+
+/**
+ * Loads the splice files into the given afl state.  The files that don't fit under the
+ * memory_limit option are skipped.
  * @param info - the mutate_info_t to load the splice files for
  * @return - 0 on success, nonzero on failure
  */
@@ -97,6 +272,7 @@ MUTATORS_API int load_splice_files(mutate_info_t * info, char ** splice_filename
 	int length;
 	size_t i;
 	string_t * splice_file;
+	uint64_t bytes;
 
 	clear_splice_files(info);
 	for (i = 0; i < splice_filenames_count; i++)
@@ -109,6 +285,14 @@ MUTATORS_API int load_splice_files(mutate_info_t * info, char ** splice_filename
 			return 1;
 		}
 
+		bytes = length + sizeof(string_t) + sizeof(string_t *);
+		if (!memory_usage_fits(info->memory_limit, limited_memory_usage(info), bytes))
+		{
+			printf("Skipping splice file %s, which doesn't fit under the memory_limit\n", splice_filenames[i]);
+			free(contents);
+			continue;
+		}
+
 		splice_file = (string_t *)malloc(sizeof(string_t));
 		info->splice_files = (string_t **)realloc(info->splice_files, sizeof(string_t *) * (info->splice_files_count + 1));
 		if (!info->splice_files || !splice_file)
@@ -123,23 +307,68 @@ MUTATORS_API int load_splice_files(mutate_info_t * info, char ** splice_filename
 		splice_file->s = (u8 *)contents;
 		info->splice_files[info->splice_files_count] = splice_file;
 		info->splice_files_count++;
+		info->splice_files_bytes += bytes;
 	}
 	return 0;
 }
 
 static void clear_dictionary_files(mutate_info_t * info)
 {
-	size_t i;
-	if (info->dictq)
+	token_dictionary_free(&info->dictionary);
+	token_matcher_free(info->dictionary_matcher);
+	info->dictionary_matcher = NULL;
+	info->dictionary_max_token_length = 0;
+	free(info->dictionary_matches);
+	info->dictionary_matches = NULL;
+	info->dictionary_matches_count = 0;
+	info->dictionary_matches_valid = 0;
+	info->dictionary_cursor.valid = 0;
+	token_scorer_resize(&info->dictionary_scorer, 0);
+	free(info->dictionary_order);
+	info->dictionary_order = NULL;
+	free(info->dictionary_rank);
+	info->dictionary_rank = NULL;
+}
+
+/**
+ * Builds the automaton used to find the dictionary tokens in an input, and resets the token
+ * scores.  This should be called whenever the dictionary changes.
+ * @param info - the mutate_info_t with the dictionary to build the automaton for
+ * @return - 0 on success, nonzero on failure
+ */
+static int build_dictionary_matcher(mutate_info_t * info)
+{
+	uint64_t i;
+
+	token_matcher_free(info->dictionary_matcher);
+	info->dictionary_max_token_length = 0;
+	info->dictionary_matches_valid = 0;
+	info->dictionary_cursor.valid = 0;
+
+	info->dictionary_matcher = token_matcher_create();
+	if (!info->dictionary_matcher || token_scorer_resize(&info->dictionary_scorer, info->dictionary.count))
+		return 1;
+	for (i = 0; i < info->dictionary.count; i++)
 	{
-		for (i = 0; i < info->dictionary_count; i++) {
-			free(info->dictq[i]->s);
-			free(info->dictq[i]);
-		}
-		free(info->dictq);
-		info->dictq = NULL;
-		info->dictionary_count = 0;
+		if (token_matcher_add(info->dictionary_matcher, TOKEN_DICTIONARY_TOKEN(&info->dictionary, i),
+				TOKEN_DICTIONARY_LENGTH(&info->dictionary, i), (uint32_t)i))
+			return 1;
+		info->dictionary_max_token_length = MAX(info->dictionary_max_token_length, TOKEN_DICTIONARY_LENGTH(&info->dictionary, i));
 	}
+	return token_matcher_compile(info->dictionary_matcher);
+}
+
+static void clear_effector_map(mutate_info_t * info)
+{
+	free(info->eff_map);
+	info->eff_map = NULL;
+	free(info->eff_reported);
+	info->eff_reported = NULL;
+	info->eff_input_length = 0;
+	info->eff_reported_count = 0;
+	info->eff_count = 0;
+	info->eff_checksum = 0;
+	info->eff_has_checksum = 0;
 }
 
 MUTATORS_API void cleanup_mutate_info(mutate_info_t * info)
@@ -147,10 +376,69 @@ MUTATORS_API void cleanup_mutate_info(mutate_info_t * info)
 	//Free any dictionary/splice files that were loaded
 	clear_dictionary_files(info);
 	clear_splice_files(info);
+	clear_effector_map(info);
+	clear_comparison_operands(info);
+	seed_pool_free(&info->seed_pool);
+	position_sampler_free(&info->positions);
+	free(info->position_weights_file);
+	info->position_weights_file = NULL;
+	free(info->save_dictionary_file);
+	info->save_dictionary_file = NULL;
+	region_map_free(&info->regions);
+	free(info->regions_string);
+	info->regions_string = NULL;
+	free(info->protect_bytes_string);
+	info->protect_bytes_string = NULL;
+	fixup_list_free(&info->fixups);
+	output_filter_free(&info->dedup);
+	operator_weights_free(&info->havoc_weights);
+	free(info->dedup_input);
+	info->dedup_input = NULL;
+	info->dedup_input_max = 0;
+	edit_plan_free(&info->plan);
+	edit_trace_free(&info->edit_trace);
+	provenance_log_free(&info->provenance);
+	info->provenance_pending_valid = 0;
 	destroy_mutex(info->mutate_mutex);
 	info->mutate_mutex = NULL;
 }
 
+/**
+ * Adds the memory held by a mutate_info_t (other than the mutate_info_t itself) to a mutator's
+ * memory usage
+ * @param info - the mutate_info_t to count the memory of
+ * @param usage - the memory usage to add to
+ */
+MUTATORS_API void add_mutate_info_memory_usage(mutate_info_t * info, memory_usage_t * usage)
+{
+	size_t i;
+
+	usage->bytes[MEMORY_USAGE_INPUT] += info->dedup_input_max + edit_plan_memory_usage(&info->plan);
+
+	usage->bytes[MEMORY_USAGE_DICTIONARY] += token_dictionary_memory_usage(&info->dictionary) +
+		token_matcher_memory_usage(info->dictionary_matcher) + info->dictionary_matches_count * sizeof(token_match_t) +
+		token_scorer_memory_usage(&info->dictionary_scorer);
+	if (info->dictionary_order)
+		usage->bytes[MEMORY_USAGE_DICTIONARY] += info->dictionary.count * 2 * sizeof(uint32_t);
+
+	usage->bytes[MEMORY_USAGE_SPLICE_FILES] += info->splice_files_bytes + info->splice_partners_count * sizeof(splice_partner_t);
+	for (i = 0; i < info->splice_filenames_count; i++)
+		usage->bytes[MEMORY_USAGE_SPLICE_FILES] += sizeof(char *) + strlen(info->splice_filenames[i]) + 1;
+
+	usage->bytes[MEMORY_USAGE_SEEDS] += seed_pool_memory_usage(&info->seed_pool);
+
+	if (info->eff_map)
+		usage->bytes[MEMORY_USAGE_INDEXES] += EFF_ALEN(info->eff_input_length) + (info->eff_input_length + 7) / 8;
+	usage->bytes[MEMORY_USAGE_INDEXES] += info->cmp_replacements_max * sizeof(cmp_replacement_t) +
+		token_matcher_memory_usage(info->cmp_matcher) + info->cmp_matches_count * sizeof(token_match_t) +
+		position_sampler_memory_usage(&info->positions) + region_map_memory_usage(&info->regions) +
+		fixup_list_memory_usage(&info->fixups) + operator_weights_memory_usage(&info->havoc_weights);
+
+	usage->bytes[MEMORY_USAGE_HISTORY] += provenance_log_memory_usage(&info->provenance) + edit_trace_memory_usage(&info->edit_trace);
+
+	usage->bytes[MEMORY_USAGE_DEDUP] += output_filter_memory_usage(&info->dedup);
+}
+
 /**
  * Cleans up the old mutate_info_t struct and reinitializes it back to defaults
  * @param info - the mutate_info_t struct to reset
@@ -170,9 +458,533 @@ MUTATORS_API int reset_mutate_info(mutate_info_t * info)
 	return info->mutate_mutex == NULL; //1 if the mutex creation failed, 0 otherwise
 }
 
-MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info)
+/**
+ * Updates the information that the mutate_info_t keeps about the input, i.e. which splice
+ * files can be spliced with it and where the dictionary tokens and comparison operands occur
+ * in it.  This should be called whenever the mutator's input changes.
+ * @param info - the mutate_info_t to update
+ * @param input - the new input
+ * @param input_length - the length of the new input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int set_mutate_info_input(mutate_info_t * info, u8 * input, size_t input_length)
+{
+	if (index_splice_files(info, input, input_length) || reset_effector_map(info, input_length))
+		return 1;
+	info->cmp_matches_valid = 0;
+	info->regions.valid = 0;
+	info->fixups.valid = 0;
+	if (region_map_update(&info->regions, input, input_length))
+		return 1;
+	return index_dictionary_matches(info, input, input_length);
+}
+
+/**
+ * Starts a new effector map for an input.  Until the walking_byte result of every byte of the input
+ * has been reported, the deterministic stages don't use the effector map.
+ * @param info - the mutate_info_t to reset the effector map of
+ * @param input_length - the length of the input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int reset_effector_map(mutate_info_t * info, size_t input_length)
 {
-	json_t *temp, *temp2, *dictionary_list, *dictionary_item;
+	clear_effector_map(info);
+	if (!input_length)
+		return 0;
+
+	info->eff_map = (u8 *)calloc(EFF_ALEN(input_length), 1);
+	info->eff_reported = (u8 *)calloc((input_length + 7) / 8, 1);
+	if (!info->eff_map || !info->eff_reported) {
+		clear_effector_map(info);
+		return 1;
+	}
+	info->eff_input_length = input_length;
+
+	//The first and last blocks are always fuzzed
+	info->eff_map[0] = 1;
+	info->eff_count = 1;
+	if (EFF_APOS(input_length - 1) != 0) {
+		info->eff_map[EFF_APOS(input_length - 1)] = 1;
+		info->eff_count++;
+	}
+	return 0;
+}
+
+/**
+ * Records the execution checksum of the unmodified input, which the walking_byte results
+ * are compared against.
+ * @param info - the mutate_info_t to record the checksum in
+ * @param input_length - the length of the input
+ * @param checksum - a hash of the unmodified input's execution (such as a hash of its coverage)
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int report_input_checksum(mutate_info_t * info, size_t input_length, uint64_t checksum)
+{
+	if (info->eff_input_length != input_length && reset_effector_map(info, input_length))
+		return 1;
+	info->eff_checksum = checksum;
+	info->eff_has_checksum = 1;
+	return 0;
+}
+
+/**
+ * Records the result of one of the walking_byte mutations, i.e. the input with the byte at pos flipped.
+ * Once the result of every byte (that the regions allow to be mutated) has been reported, the arithmetic,
+ * interesting value and dictionary overwrite stages skip the bytes that didn't change the execution
+ * when they were flipped.
+ * @param info - the mutate_info_t to update the effector map of
+ * @param input_length - the length of the input
+ * @param pos - the offset of the byte that was flipped
+ * @param checksum - a hash of the mutated input's execution (such as a hash of its coverage)
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int report_walking_byte_result(mutate_info_t * info, size_t input_length, size_t pos, uint64_t checksum)
+{
+	if (pos >= input_length)
+		return 1;
+	if (info->eff_input_length != input_length && reset_effector_map(info, input_length))
+		return 1;
+	if (info->eff_reported[pos / 8] & (1 << (pos % 8)))
+		return 0;
+	info->eff_reported[pos / 8] |= 1 << (pos % 8);
+	info->eff_reported_count++;
+
+	// Short inputs are always fuzzed in full, as are bytes we can't compare to the unmodified input
+	if (!info->eff_map[EFF_APOS(pos)] &&
+		(input_length < EFF_MIN_LEN || !info->eff_has_checksum || checksum != info->eff_checksum))
+	{
+		info->eff_map[EFF_APOS(pos)] = 1;
+		info->eff_count++;
+	}
+
+	// If the effector map is dense enough, just fuzz every byte
+	if (info->eff_count != EFF_ALEN(input_length) && info->eff_count * 100 / EFF_ALEN(input_length) > EFF_MAX_PERC) {
+		memset(info->eff_map, 1, EFF_ALEN(input_length));
+		info->eff_count = EFF_ALEN(input_length);
+	}
+
+	//The dictionary candidates change once the effector map is complete
+	if (info->eff_reported_count == count_mutable_bytes(info, input_length))
+		info->dictionary_cursor.valid = 0;
+	return 0;
+}
+
+/**
+ * Counts the positions of an input that a deterministic stage which steps through it mutates,
+ * i.e. the places where width bits or bytes fit in the offsets that the regions allow to be mutated
+ * @param info - the mutate_info_t with the regions
+ * @param input - the input that will be mutated
+ * @param input_length - the length of the input
+ * @param width - the number of bits or bytes that the stage mutates at each position
+ * @param bits - 1 if width is in bits, 0 if it is in bytes
+ * @return - the number of positions
+ */
+MUTATORS_API uint64_t count_mutable_positions(mutate_info_t * info, u8 * input, size_t input_length, size_t width, int bits)
+{
+	uint64_t units = (uint64_t)input_length << (bits ? 3 : 0);
+
+	if (info->regions.enabled && !region_map_update(&info->regions, input, input_length))
+		return region_map_count(&info->regions, width, bits);
+	return units >= width ? units - width + 1 : 0;
+}
+
+/**
+ * Finds the position that a deterministic stage which steps through an input mutates in one of its
+ * iterations, e.g. to find which byte of the input a walking_byte output flipped
+ * @param info - the mutate_info_t with the regions
+ * @param input - the input that was mutated
+ * @param input_length - the length of the input
+ * @param index - the number of the stage's iteration, starting from 0
+ * @param width - the number of bits or bytes that the stage mutates at each position
+ * @param bits - 1 if width and the returned position are in bits, 0 if they are in bytes
+ * @param pos - used to return the position
+ * @return - 0 on success, nonzero if the stage doesn't have an index'th iteration
+ */
+MUTATORS_API int locate_mutable_position(mutate_info_t * info, u8 * input, size_t input_length, uint64_t index,
+	size_t width, int bits, uint64_t * pos)
+{
+	if (region_map_update(&info->regions, input, input_length))
+		return 1;
+	return locate_position(info, input_length, index, width, bits, pos);
+}
+
+/**
+ * Records the havoc operators and dictionary tokens that were used to generate an output, so they
+ * can be credited if the output finds new coverage.  This should be called after each output.
+ * @param info - the mutate_info_t that generated the output
+ * @param iteration - the iteration of the output
+ */
+MUTATORS_API void finish_mutate_info_output(mutate_info_t * info, int iteration)
+{
+	operator_scheduler_finish(&info->havoc_scheduler, iteration);
+	token_scorer_finish(&info->dictionary_scorer, iteration);
+	if (info->provenance_pending_valid && iteration > 0) {
+		info->provenance_pending.iteration = (uint64_t)iteration;
+		info->provenance_pending.seed_id = seed_pool_selected_id(&info->seed_pool);
+		provenance_log_add(&info->provenance, &info->provenance_pending);
+		info->provenance_pending_valid = 0;
+	}
+}
+
+/**
+ * Updates the havoc operator and dictionary token statistics with the result of an output
+ * @param info - the mutate_info_t that generated the output
+ * @param iteration - the iteration of the output
+ * @param flags - MUTATE_RESULT_* flags that describe the result
+ */
+MUTATORS_API void report_mutate_info_result(mutate_info_t * info, int iteration, uint64_t flags)
+{
+	operator_scheduler_report(&info->havoc_scheduler, iteration, (flags & MUTATE_RESULT_NEW_COVERAGE) != 0);
+	token_scorer_report(&info->dictionary_scorer, iteration, (flags & MUTATE_RESULT_NEW_COVERAGE) != 0);
+}
+
+static const char * power_schedule_names[] = { "none", "explore", "fast", "coe", "exploit", "lin", "quad" };
+
+//The names of the havoc operators, in the order that havoc numbers them.  The two delete operators
+//share a name, as afl makes deleting twice as likely as the other operators.
+static const char * havoc_operator_names[] = {
+	"flip_bit", "interesting8", "interesting16", "interesting32", "subtract8", "add8", "subtract16", "add16",
+	"subtract32", "add32", "random_byte", "delete", "delete", "clone", "overwrite", "dictionary_overwrite",
+	"dictionary_insert"
+};
+//The number of havoc operators that don't need a dictionary, which come before the ones that do
+#define HAVOC_BASE_OPERATORS 15
+
+//The names of the seed statistics, as given to set_mutate_info_seed_stats
+static const struct {
+	const char * name;
+	size_t offset;
+} seed_stats_fields[] = {
+	{ "exec_us", offsetof(seed_stats_t, exec_us) },
+	{ "avg_exec_us", offsetof(seed_stats_t, avg_exec_us) },
+	{ "bitmap_size", offsetof(seed_stats_t, bitmap_size) },
+	{ "avg_bitmap_size", offsetof(seed_stats_t, avg_bitmap_size) },
+	{ "depth", offsetof(seed_stats_t, depth) },
+	{ "handicap", offsetof(seed_stats_t, handicap) },
+	{ "fuzz_level", offsetof(seed_stats_t, fuzz_level) },
+	{ "path_frequency", offsetof(seed_stats_t, path_frequency) },
+	{ "avg_path_frequency", offsetof(seed_stats_t, avg_path_frequency) },
+	{ "new_paths", offsetof(seed_stats_t, new_paths) },
+};
+
+/**
+ * Parses the power_schedule option
+ * @param info - the mutate_info_t to set the power schedule of
+ * @param options - the mutator's JSON options
+ * @return - 0 on success, nonzero if the option isn't one of the power schedules
+ */
+MUTATORS_API int get_power_schedule_from_options(mutate_info_t * info, char * options)
+{
+	char * name;
+	int result;
+	size_t i;
+
+	name = get_string_options(options, "power_schedule", &result);
+	if (result < 0)
+		return 1;
+	if (!result)
+		return 0;
+
+	info->power_schedule = -1;
+	for (i = 0; i < ARRAY_SIZE(power_schedule_names) && info->power_schedule < 0; i++)
+	{
+		if (!strcmp(name, power_schedule_names[i]))
+			info->power_schedule = (int)i;
+	}
+	if (info->power_schedule < 0)
+		printf("Unknown power schedule %s\n", name);
+	free(name);
+	return info->power_schedule < 0;
+}
+
+/**
+ * Parses the havoc_weights option
+ * @param info - the mutate_info_t to set the havoc operator weights of
+ * @param options - the mutator's JSON options
+ * @return - 0 on success, nonzero if the option isn't a valid set of weights
+ */
+MUTATORS_API int get_havoc_weights_from_options(mutate_info_t * info, char * options)
+{
+	return operator_weights_parse(&info->havoc_weights, options, "havoc_weights", havoc_operator_names,
+		ARRAY_SIZE(havoc_operator_names), HAVOC_BASE_OPERATORS);
+}
+
+/* Loads the seed statistics that are in a JSON object.  Statistics that aren't in the object are left as they are. */
+static int get_seed_stats_from_json(json_t * obj, seed_stats_t * stats)
+{
+	uint64_t value;
+	int result;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(seed_stats_fields); i++)
+	{
+		value = get_uint64t_options_from_json(obj, seed_stats_fields[i].name, &result);
+		if (result < 0)
+			return 1;
+		if (result > 0)
+			*(uint64_t *)((char *)stats + seed_stats_fields[i].offset) = value;
+	}
+	return 0;
+}
+
+static int add_seed_stats_to_json(json_t * obj, seed_stats_t * stats)
+{
+	json_t *temp, *stats_obj;
+	size_t i;
+
+	stats_obj = json_object();
+	if (!stats_obj)
+		return 0;
+	json_object_set_new(obj, "seed_stats", stats_obj);
+	for (i = 0; i < ARRAY_SIZE(seed_stats_fields); i++)
+		ADD_UINT64T(temp, *(uint64_t *)((char *)stats + seed_stats_fields[i].offset), stats_obj, seed_stats_fields[i].name);
+	return 1;
+}
+
+static int calculate_score(mutate_info_t * info);
+
+/**
+ * Updates the statistics about the seed being mutated, and recomputes perf_score (and havoc_div)
+ * from them with the power schedule.  If no power schedule was chosen, the statistics are only
+ * recorded.
+ * @param info - the mutate_info_t to update
+ * @param stats - a JSON object with any of the fields of seed_stats_t, i.e. exec_us, avg_exec_us,
+ * bitmap_size, avg_bitmap_size, depth, handicap, fuzz_level, path_frequency, avg_path_frequency,
+ * and new_paths.  Fields that aren't given keep their previous values.
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int set_mutate_info_seed_stats(mutate_info_t * info, char * stats)
+{
+	json_t * root;
+	int ret;
+
+	root = json_loads(stats, 0, NULL);
+	if (!root)
+		return 1;
+	ret = get_seed_stats_from_json(root, &info->seed_stats);
+	json_decref(root);
+	if (ret || info->power_schedule == POWER_SCHEDULE_NONE)
+		return ret;
+
+	info->perf_score = calculate_score(info);
+
+	//Slow targets get fewer havoc rounds, as in afl's show_init_stats
+	if (info->seed_stats.avg_exec_us > 50000)
+		info->havoc_div = 10;
+	else if (info->seed_stats.avg_exec_us > 20000)
+		info->havoc_div = 5;
+	else if (info->seed_stats.avg_exec_us > 10000)
+		info->havoc_div = 2;
+	else
+		info->havoc_div = 1;
+	return 0;
+}
+
+static void save_progress(mutate_info_t * info, mutate_info_progress_t * progress)
+{
+	progress->stage = info->stage;
+	progress->stage_cur = info->stage_cur;
+	progress->queue_cycle = info->queue_cycle;
+	progress->havoc_div = info->havoc_div;
+	progress->perf_score = info->perf_score;
+	progress->seed_stats = info->seed_stats;
+	progress->trim_remove_len = info->trim_remove_len;
+	progress->trim_remove_pos = info->trim_remove_pos;
+	progress->trim_pending_pos = info->trim_pending_pos;
+	progress->trim_pending_len = info->trim_pending_len;
+}
+
+static void restore_progress(mutate_info_t * info, mutate_info_progress_t * progress)
+{
+	info->stage = progress->stage;
+	info->stage_cur = progress->stage_cur;
+	info->queue_cycle = progress->queue_cycle;
+	info->havoc_div = progress->havoc_div;
+	info->perf_score = progress->perf_score;
+	info->seed_stats = progress->seed_stats;
+	info->trim_remove_len = progress->trim_remove_len;
+	info->trim_remove_pos = progress->trim_remove_pos;
+	info->trim_pending_pos = progress->trim_pending_pos;
+	info->trim_pending_len = progress->trim_pending_len;
+}
+
+/**
+ * Adds a seed to the seed pool, so it can be selected with select_mutate_info_seed, and spliced
+ * with the other seeds in the meantime
+ * @param info - the mutate_info_t to add the seed to
+ * @param input - the seed's contents
+ * @param input_length - the length of input
+ * @param stage - the stage that the seed's mutations start at
+ * @return - the id of the new seed, or -1 on failure.  If the seed doesn't fit under the
+ * memory_limit option, splice files are evicted to make room for it, and it's refused if that
+ * isn't enough.
+ */
+MUTATORS_API int add_mutate_info_seed(mutate_info_t * info, char * input, size_t input_length, int stage)
+{
+	mutate_info_progress_t progress;
+	uint64_t bytes = input_length + sizeof(progress) + sizeof(seed_pool_seed_t);
+	int id;
+
+	//The seeds are more useful than the splice files, so the splice files are evicted to make room
+	while (!memory_usage_fits(info->memory_limit, limited_memory_usage(info), bytes) && info->splice_files_count)
+		evict_splice_file(info);
+	if (!memory_usage_fits(info->memory_limit, limited_memory_usage(info), bytes)) {
+		printf("The seed doesn't fit under the memory_limit\n");
+		return -1;
+	}
+
+	//The new seed starts with the options' havoc settings, and no statistics
+	save_progress(info, &progress);
+	progress.stage = stage;
+	progress.stage_cur = 0;
+	progress.queue_cycle = 1;
+	memset(&progress.seed_stats, 0, sizeof(seed_stats_t));
+	progress.trim_remove_len = progress.trim_remove_pos = 0;
+	progress.trim_pending_pos = progress.trim_pending_len = 0;
+
+	id = seed_pool_add(&info->seed_pool, input, input_length, &progress, sizeof(progress));
+	info->splice_partners_valid = 0;
+	return id;
+}
+
+/**
+ * Removes a seed from the seed pool.  The selected seed can't be removed.
+ * @param info - the mutate_info_t to remove the seed from
+ * @param id - the id of the seed to remove
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int remove_mutate_info_seed(mutate_info_t * info, int id)
+{
+	info->splice_partners_valid = 0;
+	return seed_pool_remove(&info->seed_pool, id);
+}
+
+/**
+ * Selects which of the seeds in the seed pool is mutated.  The progress through the previously
+ * selected seed is saved, so its mutations continue from the same place when it's selected again.
+ * What's known about the input (splice partners, dictionary token locations, mutable regions,
+ * and the effector map) is recomputed when the stages next need it, and the comparison operands are cleared.
+ * @param info - the mutate_info_t with the seed
+ * @param id - the id of the seed to select, as returned by add_mutate_info_seed (or 0 for the
+ * mutator's original input)
+ * @param input - a pointer to the mutator's input, which is swapped with the selected seed
+ * @param input_length - a pointer to the length of the mutator's input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int select_mutate_info_seed(mutate_info_t * info, int id, char ** input, size_t * input_length)
+{
+	mutate_info_progress_t progress;
+
+	if (id == seed_pool_selected_id(&info->seed_pool))
+		return 0;
+	save_progress(info, &progress);
+	if (seed_pool_select(&info->seed_pool, id, input, input_length, &progress))
+		return 1;
+	restore_progress(info, &progress);
+
+	info->splice_partners_valid = 0;
+	info->dictionary_matches_valid = 0;
+	info->dictionary_cursor.valid = 0;
+	info->regions.valid = 0;
+	info->fixups.valid = 0;
+	clear_effector_map(info);
+	clear_comparison_operands(info);
+	return 0;
+}
+
+/**
+ * Regenerates an output from its provenance record, by running the output's stage once with the
+ * random number generator state and stage progress that it had when the output was generated.  The
+ * mutate_info_t's own progress is left unchanged, so this can be done at any time.  The output is
+ * the same as the original one as long as the seed and the state that the stage uses (such as the
+ * havoc operator statistics or the dictionary) haven't changed since it was generated.
+ * @param info - the mutate_info_t that generated the output, or one created from its state
+ * @param record - the output's provenance record
+ * @param buf - a buffer holding the seed that the output was generated from
+ * @param mutate_funcs - the mutation functions that were passed to mutate_one
+ * @param num_funcs - the number of entries in mutate_funcs
+ * @return - the length of the output, or -1 if it can't be regenerated
+ */
+MUTATORS_API int regenerate_mutate_info_output(mutate_info_t * info, const mutate_provenance_t * record, mutate_buffer_t * buf,
+	int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs)
+{
+	mutate_info_progress_t progress;
+	dictionary_cursor_t cursor;
+	uint64_t random_state[2];
+	uint32_t scheduler_current, scorer_current[TOKEN_SCORER_MAX_OUTPUT_TOKENS], scorer_num_current;
+	int length;
+
+	if (record->stage < 0 || (size_t)record->stage >= num_funcs || record->input_length != buf->length
+		|| record->seed_id != seed_pool_selected_id(&info->seed_pool)
+		|| region_map_update(&info->regions, buf->buffer, buf->length)
+		|| fixup_list_update(&info->fixups, buf->buffer, buf->length))
+		return -1;
+
+	//Save everything that running the stage changes
+	save_progress(info, &progress);
+	random_state[0] = info->random_state[0];
+	random_state[1] = info->random_state[1];
+	cursor = info->dictionary_cursor;
+	scheduler_current = info->havoc_scheduler.current;
+	scorer_num_current = info->dictionary_scorer.num_current;
+	memcpy(scorer_current, info->dictionary_scorer.current, sizeof(scorer_current));
+
+	info->random_state[0] = record->random_state[0];
+	info->random_state[1] = record->random_state[1];
+	info->stage = record->stage;
+	info->stage_cur = record->stage_cur;
+	info->queue_cycle = record->queue_cycle;
+	info->trim_remove_len = record->trim_remove_len;
+	info->trim_remove_pos = record->trim_remove_pos;
+	length = mutate_funcs[record->stage](info, buf);
+	if (length > 0)
+		fixup_list_apply(&info->fixups, buf->buffer, length);
+
+	//The regenerated output isn't a new output, so the operators and tokens it used aren't recorded
+	restore_progress(info, &progress);
+	info->random_state[0] = random_state[0];
+	info->random_state[1] = random_state[1];
+	info->dictionary_cursor = cursor;
+	info->havoc_scheduler.current = scheduler_current;
+	info->dictionary_scorer.num_current = scorer_num_current;
+	memcpy(info->dictionary_scorer.current, scorer_current, sizeof(scorer_current));
+	return length > 0 ? length : -1;
+}
+
+/**
+ * Minimizes an output by regenerating it from its provenance record while recording the havoc
+ * operations (and splice) that produced it, then reverting the operations that the output doesn't
+ * need to stay interesting.  The verdict function is called with each candidate.
+ * @param info - the mutate_info_t that generated the output, or one created from its state
+ * @param record - the output's provenance record
+ * @param buf - a buffer holding the seed that the output was generated from.  The minimized
+ * output is written to it.
+ * @param output - the output to minimize
+ * @param output_length - the length of output
+ * @param mutate_funcs - the mutation functions that were passed to mutate_one
+ * @param num_funcs - the number of entries in mutate_funcs
+ * @param verdict - a function that returns nonzero if a candidate is still interesting
+ * @param context - an argument to pass to verdict
+ * @return - the length of the minimized output, or -1 if the output can't be regenerated or on failure
+ */
+MUTATORS_API int minimize_mutate_info_output(mutate_info_t * info, const mutate_provenance_t * record, mutate_buffer_t * buf,
+	const u8 * output, size_t output_length, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs,
+	edit_trace_verdict_t verdict, void * context)
+{
+	int length;
+
+	if (edit_trace_start(&info->edit_trace, buf->buffer, buf->length))
+		return -1;
+	length = regenerate_mutate_info_output(info, record, buf, mutate_funcs, num_funcs);
+	edit_trace_stop(&info->edit_trace);
+	if (length < 0)
+		return -1;
+	return fixup_list_minimize(&info->fixups, &info->edit_trace, output, output_length, buf->buffer, buf->max_length, verdict, context);
+}
+
+MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info, const char * input, size_t input_length)
+{
+	json_t *temp, *temp2, *dictionary_list, *dictionary_item, *effector_obj;
 	uint64_t i;
 
 	ADD_UINT64T(temp, info->random_state[0], obj, "random_state0");
@@ -184,15 +996,22 @@ MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info)
 	ADD_INT(temp, info->queue_cycle, obj, "queue_cycle");
 	ADD_INT(temp, info->havoc_div, obj, "havoc_div");
 	ADD_INT(temp, info->perf_score, obj, "perf_score");
+	ADD_INT(temp, info->power_schedule, obj, "power_schedule");
+	if (!add_seed_stats_to_json(obj, &info->seed_stats))
+		return 0;
+	ADD_UINT64T(temp, info->trim_remove_len, obj, "trim_remove_len");
+	ADD_UINT64T(temp, info->trim_remove_pos, obj, "trim_remove_pos");
+	ADD_UINT64T(temp, info->trim_pending_pos, obj, "trim_pending_pos");
+	ADD_UINT64T(temp, info->trim_pending_len, obj, "trim_pending_len");
 
 	dictionary_list = json_array();
 	if (!dictionary_list)
 		return 0;
-	for(i = 0; i < info->dictionary_count; i++)
+	for(i = 0; i < info->dictionary.count; i++)
 	{
 		dictionary_item = json_object();
-		temp = json_mem((const char *)info->dictq[i]->s, info->dictq[i]->len);
-		temp2 = json_integer(info->dictq[i]->len);
+		temp = json_mem((const char *)TOKEN_DICTIONARY_TOKEN(&info->dictionary, i), TOKEN_DICTIONARY_LENGTH(&info->dictionary, i));
+		temp2 = json_integer(TOKEN_DICTIONARY_LENGTH(&info->dictionary, i));
 
 		if (!temp || !temp2 || !dictionary_item) {
 			if(dictionary_item)
@@ -218,17 +1037,108 @@ MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info)
 		}
 		json_array_append_new(dictionary_list, dictionary_item);
 	}
-	if (json_object_set_new(obj, "dictionary", dictionary_list))
-		json_decref(dictionary_list);
+	if (json_object_set_new(obj, "dictionary", dictionary_list))
+		json_decref(dictionary_list);
+
+	if (!operator_scheduler_add_to_json(obj, "havoc_scheduler", &info->havoc_scheduler)
+		|| !operator_weights_add_to_json(obj, "havoc_weights", &info->havoc_weights, havoc_operator_names)
+		|| !token_scorer_add_to_json(obj, "dictionary_scores", &info->dictionary_scorer)
+		|| !position_sampler_add_to_json(obj, "position_weights", &info->positions)
+		|| !region_map_add_to_json(obj, "regions", &info->regions)
+		|| !seed_pool_add_to_json(obj, "seed_pool", &info->seed_pool, input, input_length)
+		|| !provenance_log_add_to_json(obj, "provenance_log", &info->provenance))
+		return 0;
+
+	if (info->eff_map) {
+		effector_obj = json_object();
+		if (!effector_obj)
+			return 0;
+		json_object_set_new(obj, "effector", effector_obj);
+		ADD_UINT64T(temp, info->eff_input_length, effector_obj, "input_length");
+		ADD_UINT64T(temp, info->eff_reported_count, effector_obj, "reported_count");
+		ADD_UINT64T(temp, info->eff_count, effector_obj, "count");
+		ADD_UINT64T(temp, info->eff_checksum, effector_obj, "checksum");
+		ADD_INT(temp, info->eff_has_checksum, effector_obj, "has_checksum");
+		ADD_MEM(temp, info->eff_map, EFF_ALEN(info->eff_input_length), effector_obj, "map");
+		ADD_MEM(temp, info->eff_reported, (info->eff_input_length + 7) / 8, effector_obj, "reported");
+	}
+
+	return 1;
+}
+
+/* Loads the seed statistics saved by add_mutate_info_to_json */
+static int get_seed_stats_from_state(char * state, mutate_info_t * info)
+{
+	json_t * root, * stats_obj;
+	int ret = 0;
+
+	memset(&info->seed_stats, 0, sizeof(seed_stats_t));
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+	stats_obj = json_object_get(root, "seed_stats");
+	if (stats_obj)
+		ret = get_seed_stats_from_json(stats_obj, &info->seed_stats);
+	json_decref(root);
+	return ret;
+}
+
+/**
+ * Loads the effector map saved by add_mutate_info_to_json
+ * @param state - the saved state
+ * @param info - the mutate_info_t to load the effector map into
+ * @return - 0 on success, nonzero on failure
+ */
+static int get_effector_map_from_json(char * state, mutate_info_t * info)
+{
+	json_t * root, * effector_obj;
+	int result, ret = 1;
+
+	clear_effector_map(info);
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+	effector_obj = json_object_get(root, "effector");
+	if (!effector_obj) { //The effector map isn't required
+		json_decref(root);
+		return 0;
+	}
 
-	return 1;
+	info->eff_input_length = get_uint64t_options_from_json(effector_obj, "input_length", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_reported_count = get_uint64t_options_from_json(effector_obj, "reported_count", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_count = get_uint64t_options_from_json(effector_obj, "count", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_checksum = get_uint64t_options_from_json(effector_obj, "checksum", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_has_checksum = get_int_options_from_json(effector_obj, "has_checksum", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_map = (u8 *)get_mem_options_from_json(effector_obj, "map", &result);
+	if (result <= 0)
+		goto cleanup;
+	info->eff_reported = (u8 *)get_mem_options_from_json(effector_obj, "reported", &result);
+	if (result <= 0)
+		goto cleanup;
+	ret = 0;
+
+cleanup:
+	json_decref(root);
+	if (ret)
+		clear_effector_map(info);
+	return ret;
 }
 
-MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info)
+MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info, char ** input, size_t * input_length)
 {
 	int temp_int, result, inner_result;
 	uint64_t temp_uint64t;
-	char * tempstr;
+	char * tempstr, * previous_input = *input;
 	json_t *dictionary_obj;
 
 	clear_splice_files(info);
@@ -243,6 +1153,11 @@ MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info)
 	GET_INT(temp_int, state, info->queue_cycle, "queue_cycle", result);
 	GET_INT(temp_int, state, info->havoc_div, "havoc_div", result);
 	GET_INT(temp_int, state, info->perf_score, "perf_score", result);
+	GET_INT(temp_int, state, info->power_schedule, "power_schedule", result);
+	GET_UINT64T(temp_uint64t, state, info->trim_remove_len, "trim_remove_len", result);
+	GET_UINT64T(temp_uint64t, state, info->trim_remove_pos, "trim_remove_pos", result);
+	GET_UINT64T(temp_uint64t, state, info->trim_pending_pos, "trim_pending_pos", result);
+	GET_UINT64T(temp_uint64t, state, info->trim_pending_len, "trim_pending_len", result);
 
 	FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(state, modules, "dictionary", dictionary_obj, result)
 
@@ -253,28 +1168,36 @@ MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info)
 			return 1;
 		}
 
-		info->dictq = (string_t **)realloc(info->dictq, (info->dictionary_count + 1) * sizeof(string_t *));
-		if (!info->dictq) {
-			free(tempstr);
-			FOREACH_OBJECT_JSON_ARRAY_ITEM_FREE(modules);
-			return 1;
-		}
-		info->dictq[info->dictionary_count] = (string_t *)malloc(sizeof(string_t));
-		if (!info->dictq[info->dictionary_count]) {
-			free(tempstr);
+		inner_result = token_dictionary_add(&info->dictionary, (u8 *)tempstr, (size_t)temp_uint64t, 0);
+		free(tempstr);
+		if (inner_result < 0) {
 			FOREACH_OBJECT_JSON_ARRAY_ITEM_FREE(modules);
 			return 1;
 		}
 
-		info->dictq[info->dictionary_count]->len = temp_uint64t;
-		info->dictq[info->dictionary_count]->s = (u8*)tempstr;
-		info->dictionary_count++;
-
 	FOREACH_OBJECT_JSON_ARRAY_ITEM_END(modules);
-	if (result < 0)
+	if (result < 0 || get_seed_stats_from_state(state, info) || get_effector_map_from_json(state, info)
+		|| operator_scheduler_get_from_json(state, "havoc_scheduler", &info->havoc_scheduler)
+		|| operator_weights_get_from_json(state, "havoc_weights", &info->havoc_weights, havoc_operator_names,
+			ARRAY_SIZE(havoc_operator_names), HAVOC_BASE_OPERATORS)
+		|| position_sampler_get_from_json(state, "position_weights", &info->positions)
+		|| region_map_get_from_json(state, "regions", &info->regions)
+		|| seed_pool_get_from_json(state, "seed_pool", &info->seed_pool, input, input_length,
+			sizeof(mutate_info_progress_t))
+		|| provenance_log_get_from_json(state, "provenance_log", &info->provenance))
 		return 1;
 
-	return 0;
+	//If the state's selected seed replaced the input, what was found in the previous input is recomputed
+	if (*input != previous_input) {
+		info->regions.valid = 0;
+		info->fixups.valid = 0;
+		clear_comparison_operands(info);
+	}
+
+	//The scores are loaded after the matcher is built, as building it resets them
+	if (info->dictionary.count && build_dictionary_matcher(info))
+		return 1;
+	return token_scorer_get_from_json(state, "dictionary_scores", &info->dictionary_scorer);
 }
 
 
@@ -310,6 +1233,105 @@ MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info)
 static s8  interesting_8[] = { INTERESTING_8 };
 static s16 interesting_16[] = { INTERESTING_8, INTERESTING_16 };
 static s32 interesting_32[] = { INTERESTING_8, INTERESTING_16, INTERESTING_32 };
+static s64 interesting_64[] = { INTERESTING_8, INTERESTING_16, INTERESTING_32, INTERESTING_64 };
+
+/* The interesting values for a 1, 2, 4, or 8 byte wide stage */
+static inline size_t interesting_count(int width)
+{
+	switch (width) {
+	case 1: return ARRAY_SIZE(interesting_8);
+	case 2: return ARRAY_SIZE(interesting_16);
+	case 4: return ARRAY_SIZE(interesting_32);
+	default: return ARRAY_SIZE(interesting_64);
+	}
+}
+
+static inline u64 interesting_value(int width, size_t index)
+{
+	switch (width) {
+	case 1: return (u8)interesting_8[index];
+	case 2: return (u16)interesting_16[index];
+	case 4: return (u32)interesting_32[index];
+	default: return (u64)interesting_64[index];
+	}
+}
+
+/* Alignment-safe loads and stores of 1, 2, 4, or 8 byte values.  The stages call these with a
+   constant width, so each memcpy compiles to a single load or store. */
+static inline u64 load_value(const u8 * ptr, int width)
+{
+	u16 value16;
+	u32 value32;
+	u64 value64;
+
+	switch (width) {
+	case 1:
+		return *ptr;
+	case 2:
+		memcpy(&value16, ptr, sizeof(value16));
+		return value16;
+	case 4:
+		memcpy(&value32, ptr, sizeof(value32));
+		return value32;
+	default:
+		memcpy(&value64, ptr, sizeof(value64));
+		return value64;
+	}
+}
+
+static inline void store_value(u8 * ptr, u64 value, int width)
+{
+	u16 value16 = (u16)value;
+	u32 value32 = (u32)value;
+
+	switch (width) {
+	case 1:
+		*ptr = (u8)value;
+		break;
+	case 2:
+		memcpy(ptr, &value16, sizeof(value16));
+		break;
+	case 4:
+		memcpy(ptr, &value32, sizeof(value32));
+		break;
+	default:
+		memcpy(ptr, &value, sizeof(value));
+		break;
+	}
+}
+
+static inline u64 width_mask(int width)
+{
+	return width == 8 ? ~0ULL : (1ULL << (width * 8)) - 1;
+}
+
+static inline u64 swap_value(u64 value, int width)
+{
+	switch (width) {
+	case 2: return SWAP16((u16)value);
+	case 4: return SWAP32((u32)value);
+	case 8: return SWAP64(value);
+	default: return value;
+	}
+}
+
+/* Whether the effector map is complete for an input of the given length */
+static int effector_map_ready(mutate_info_t * info, size_t length)
+{
+	return info->eff_map && info->eff_input_length == length && info->eff_reported_count == count_mutable_bytes(info, length);
+}
+
+/* If none of the bytes from offset to offset + length affected the execution when they were flipped,
+   moves stage_cur to the last mutation of index (so that mutate_one moves on to the next index) and
+   returns 1.  Otherwise, returns 0.  The index and offset are the same unless there are regions. */
+static int skip_ineffective_bytes(mutate_info_t * info, mutate_buffer_t * buf, uint64_t index, uint64_t offset, size_t length,
+	uint64_t mutations_per_index)
+{
+	if (!effector_map_ready(info, buf->length) || memchr(info->eff_map + EFF_APOS(offset), 1, EFF_SPAN_ALEN(offset, length)))
+		return 0;
+	info->stage_cur = (index + 1) * mutations_per_index - 1;
+	return 1;
+}
 
 /* Helper to choose random block len for block operations in fuzz_one().
 Doesn't return zero, provided that max_len is > 0. */
@@ -347,29 +1369,49 @@ static u32 choose_block_len(mutate_info_t * info, u32 limit) {
 	return min_value + UR(info, MIN(max_value, limit) - min_value + 1);
 }
 
-/* Helper function to compare buffers; returns first and last differing offset. We
-use this to find reasonable locations for splicing two files. */
-static void locate_diffs(u8* ptr1, u8* ptr2, u32 len, s32* first, s32* last) {
-
-	s32 f_loc = -1;
-	s32 l_loc = -1;
-	u32 pos;
+#define DIFF_BLOCK_SIZE 16
 
-	for (pos = 0; pos < len; pos++) {
+/* Helper function to check if two DIFF_BLOCK_SIZE byte blocks are the same */
+static inline int blocks_equal(u8* ptr1, u8* ptr2) {
+#ifdef USE_SSE2
+	__m128i block1 = _mm_loadu_si128((const __m128i *)ptr1);
+	__m128i block2 = _mm_loadu_si128((const __m128i *)ptr2);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(block1, block2)) == 0xFFFF;
+#else
+	u64 a[2], b[2];
+	memcpy(a, ptr1, sizeof(a));
+	memcpy(b, ptr2, sizeof(b));
+	return ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0;
+#endif
+}
 
-		if (*(ptr1++) != *(ptr2++)) {
+/* Helper function to compare buffers; returns first and last differing offset. We
+use this to find reasonable locations for splicing two files. The buffers are
+compared a block at a time from the front to find the first difference, and then
+from the back to find the last one. */
+static void locate_diffs(u8* ptr1, u8* ptr2, u32 len, s32* first, s32* last) {
 
-			if (f_loc == -1) f_loc = pos;
-			l_loc = pos;
+	u32 pos = 0, end = len;
 
-		}
+	while (pos + DIFF_BLOCK_SIZE <= len && blocks_equal(ptr1 + pos, ptr2 + pos))
+		pos += DIFF_BLOCK_SIZE;
+	while (pos < len && ptr1[pos] == ptr2[pos])
+		pos++;
 
+	if (pos == len) {
+		*first = -1;
+		*last = -1;
+		return;
 	}
 
-	*first = f_loc;
-	*last = l_loc;
+	//ptr1[pos] != ptr2[pos], so this can't go past pos
+	while (end >= pos + DIFF_BLOCK_SIZE && blocks_equal(ptr1 + end - DIFF_BLOCK_SIZE, ptr2 + end - DIFF_BLOCK_SIZE))
+		end -= DIFF_BLOCK_SIZE;
+	while (ptr1[end - 1] == ptr2[end - 1])
+		end--;
 
-	return;
+	*first = pos;
+	*last = end - 1;
 }
 
 /* Helper function to see if a particular change (xor_val = old ^ new) could
@@ -378,7 +1420,7 @@ attempted by afl-fuzz. This is used to avoid dupes in some of the
 deterministic fuzzing operations that follow bit flips. We also
 return 1 if xor_val is zero, which implies that the old and attempted new
 values are identical and the exec would be a waste of time. */
-static u8 could_be_bitflip(u32 xor_val) {
+static u8 could_be_bitflip(u64 xor_val) {
 
 	u32 sh = 0;
 
@@ -392,12 +1434,12 @@ static u8 could_be_bitflip(u32 xor_val) {
 
 	if (xor_val == 1 || xor_val == 3 || xor_val == 15) return 1;
 
-	/* 8-, 16-, and 32-bit patterns are OK only if shift factor is
+	/* 8-, 16-, 32-, and 64-bit patterns are OK only if shift factor is
 	divisible by 8, since that's the stepover for these ops. */
 
 	if (sh & 7) return 0;
 
-	if (xor_val == 0xff || xor_val == 0xffff || xor_val == 0xffffffff)
+	if (xor_val == 0xff || xor_val == 0xffff || xor_val == 0xffffffff || xor_val == 0xffffffffffffffffULL)
 		return 1;
 
 	return 0;
@@ -406,9 +1448,10 @@ static u8 could_be_bitflip(u32 xor_val) {
 
 /* Helper function to see if a particular value is reachable through
 arithmetic operations. Used for similar purposes. */
-static u8 could_be_arith(u32 old_val, u32 new_val, u8 blen) {
+static u8 could_be_arith(u64 old_val, u64 new_val, u8 blen) {
 
-	u32 i, ov = 0, nv = 0, diffs = 0;
+	u32 i, diffs = 0;
+	u64 ov = 0, nv = 0;
 
 	if (old_val == new_val) return 1;
 
@@ -454,25 +1497,52 @@ static u8 could_be_arith(u32 old_val, u32 new_val, u8 blen) {
 		if ((u16)(ov - nv) <= ARITH_MAX ||
 			(u16)(nv - ov) <= ARITH_MAX) return 1;
 
-		ov = SWAP16(ov); nv = SWAP16(nv);
+		ov = SWAP16((u16)ov); nv = SWAP16((u16)nv);
 
 		if ((u16)(ov - nv) <= ARITH_MAX ||
 			(u16)(nv - ov) <= ARITH_MAX) return 1;
 
 	}
 
-	/* Finally, let's do the same thing for dwords. */
+	if (blen == 2) return 0;
+
+	/* Then the same thing for dwords. */
+
+	diffs = 0;
+
+	for (i = 0; i < blen / 4U; i++) {
+
+		u32 a = old_val >> (32 * i),
+			b = new_val >> (32 * i);
+
+		if (a != b) { diffs++; ov = a; nv = b; }
+
+	}
+
+	if (diffs == 1) {
+
+		if ((u32)(ov - nv) <= ARITH_MAX ||
+			(u32)(nv - ov) <= ARITH_MAX) return 1;
+
+		ov = SWAP32((u32)ov); nv = SWAP32((u32)nv);
+
+		if ((u32)(ov - nv) <= ARITH_MAX ||
+			(u32)(nv - ov) <= ARITH_MAX) return 1;
+
+	}
+
+	/* Finally, let's do the same thing for qwords. */
 
-	if (blen == 4) {
+	if (blen == 8) {
 
-		if ((u32)(old_val - new_val) <= ARITH_MAX ||
-			(u32)(new_val - old_val) <= ARITH_MAX) return 1;
+		if ((u64)(old_val - new_val) <= ARITH_MAX ||
+			(u64)(new_val - old_val) <= ARITH_MAX) return 1;
 
-		new_val = SWAP32(new_val);
-		old_val = SWAP32(old_val);
+		new_val = SWAP64(new_val);
+		old_val = SWAP64(old_val);
 
-		if ((u32)(old_val - new_val) <= ARITH_MAX ||
-			(u32)(new_val - old_val) <= ARITH_MAX) return 1;
+		if ((u64)(old_val - new_val) <= ARITH_MAX ||
+			(u64)(new_val - old_val) <= ARITH_MAX) return 1;
 
 	}
 
@@ -541,7 +1611,7 @@ interesting integer is redundant given the insertions done for
 shorter blen. The last param (check_le) is set if the caller
 already executed LE insertion for current blen and wants to see
 if BE variant passed in new_val is unique. */
-static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
+static u8 could_be_interest(u64 old_val, u64 new_val, u8 blen, u8 check_le) {
 
 	u32 i, j;
 
@@ -552,10 +1622,10 @@ static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
 
 	for (i = 0; i < blen; i++) {
 
-		for (j = 0; j < sizeof(interesting_8); j++) {
+		for (j = 0; j < ARRAY_SIZE(interesting_8); j++) {
 
-			u32 tval = (old_val & ~(0xff << (i * 8))) |
-				(((u8)interesting_8[j]) << (i * 8));
+			u64 tval = (old_val & ~(0xffULL << (i * 8))) |
+				((u64)(u8)interesting_8[j] << (i * 8));
 
 			if (new_val == tval) return 1;
 
@@ -572,10 +1642,10 @@ static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
 
 	for (i = 0; i < blen - 1; i++) {
 
-		for (j = 0; j < sizeof(interesting_16) / 2; j++) {
+		for (j = 0; j < ARRAY_SIZE(interesting_16); j++) {
 
-			u32 tval = (old_val & ~(0xffff << (i * 8))) |
-				(((u16)interesting_16[j]) << (i * 8));
+			u64 tval = (old_val & ~(0xffffULL << (i * 8))) |
+				((u64)(u16)interesting_16[j] << (i * 8));
 
 			if (new_val == tval) return 1;
 
@@ -583,8 +1653,8 @@ static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
 
 			if (blen > 2) {
 
-				tval = (old_val & ~(0xffff << (i * 8))) |
-					(SWAP16(interesting_16[j]) << (i * 8));
+				tval = (old_val & ~(0xffffULL << (i * 8))) |
+					((u64)SWAP16((u16)interesting_16[j]) << (i * 8));
 
 				if (new_val == tval) return 1;
 
@@ -599,717 +1669,1127 @@ static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
 		/* See if four-byte insertions could produce the same result
 		(LE only). */
 
-		for (j = 0; j < sizeof(interesting_32) / 4; j++)
+		for (j = 0; j < ARRAY_SIZE(interesting_32); j++)
 			if (new_val == (u32)interesting_32[j]) return 1;
 
 	}
 
-	return 0;
-
-}
+	if (blen == 8) {
 
-/* Read the dictionary from a file */
-static int load_dictionary_file(mutate_info_t * info, char * fname, u32* min_len, u32* max_len, u32 dict_level) {
+		/* See if four-byte insertions in either endian could produce the
+		same result, and then eight-byte ones (LE only). */
 
-	FILE* fp;
-	char buf[MAX_LINE];
-	u8 *lptr;
-	u32 cur_line = 0;
-	char* hexdigits = "0123456789abcdef";
-	string_t ** temp_dictq;
+		for (i = 0; i < (u32)blen - 3; i++) {
 
-	fp = fopen(fname, "r");
-	if (!fp) {
-		printf("Unable to open dictionary file '%s'", fname);
-		return 1;
-	}
+			for (j = 0; j < ARRAY_SIZE(interesting_32); j++) {
 
-	while ((lptr = (u8 *)fgets(buf, MAX_LINE, fp))) {
+				u64 tval = (old_val & ~(0xffffffffULL << (i * 8))) |
+					((u64)(u32)interesting_32[j] << (i * 8));
 
-		u8 *rptr, *wptr, *new_item;
-		u32 klen = 0;
+				if (new_val == tval) return 1;
 
-		cur_line++;
+				tval = (old_val & ~(0xffffffffULL << (i * 8))) |
+					((u64)SWAP32((u32)interesting_32[j]) << (i * 8));
 
-		// Trim on left and right.
-		while (isspace(*lptr)) lptr++;
-		rptr = lptr + strlen((char *)lptr) - 1;
-		while (rptr >= lptr && isspace(*rptr)) rptr--;
-		rptr++;
-		*rptr = 0;
+				if (new_val == tval) return 1;
 
-		// Skip empty lines and comments.
-		if (!*lptr || *lptr == '#') continue;
+			}
 
-		// All other lines must end with '"', which we can consume.
-		rptr--;
-		if (rptr < lptr || *rptr != '"') {
-			printf("Malformed name=\"value\" pair in dictionary file %s on line %u.", fname, cur_line);
-			fclose(fp);
-			return 1;
 		}
-		*rptr = 0;
 
-		// Skip alphanumerics and dashes (label).
-		while (isalnum(*lptr) || *lptr == '_') lptr++;
+		if (check_le) {
 
-		// If @number follows, parse that.
-		if (*lptr == '@') {
-			lptr++;
-			if (atoi((char *)lptr) > dict_level) continue;
-			while (isdigit(*lptr)) lptr++;
-		}
-
-		// Skip whitespace and = signs.
-		while (isspace(*lptr) || *lptr == '=') lptr++;
+			for (j = 0; j < ARRAY_SIZE(interesting_64); j++)
+				if (new_val == (u64)interesting_64[j]) return 1;
 
-		// Consume opening '"'.
-		if (*lptr != '"') {
-			printf("Malformed name=\"keyword\" pair in dictionary file %s on line %u.", fname, cur_line);
-			fclose(fp);
-			return 1;
 		}
 
-		lptr++;
-		if (!*lptr) {
-			printf("Empty keyword in dictionary file %s on line %u.", fname, cur_line);
-			fclose(fp);
-			return 1;
-		}
+	}
 
+	return 0;
 
-		// Okay, let's allocate memory and copy data between "...", handling
-		// \xNN escaping, \\, and \".
-		wptr = new_item = (u8 *)malloc(rptr - lptr);
-		if (!new_item) {
-			printf("Failed allocating memory while parsing dictionary file %s, line %u.", fname, cur_line);
-			fclose(fp);
-			return 1;
-		}
+}
 
-		while (*lptr) {
-			if ((*lptr >= 1 && *lptr <= 31) || (*lptr >= 128 && *lptr <= 255)) {
-				printf("Non-printable characters in dictionary file %s on line %u.", fname, cur_line);
-				free(new_item);
-				fclose(fp);
-				return 1;
-			}
+/* Read the dictionary from a dictionary file, a compiled dictionary file, or a directory */
+MUTATORS_API int load_dictionary(mutate_info_t * info, char * path) {
+	uint64_t used, max_bytes = 0;
+	size_t i, length, min_len = MAX_DICT_FILE, max_len = 0;
 
-			if (*lptr == '\\') {
-				lptr++;
-
-				if (*lptr == '\\' || *lptr == '"') {
-					*(wptr++) = *(lptr++);
-					klen++;
-				}
-				else {
-					if (*lptr != 'x' || !isxdigit(lptr[1]) || !isxdigit(lptr[2])) {
-						printf("Invalid escaping (not \\xNN) in dictionary file %s on line %u.", fname, cur_line);
-						free(new_item);
-						fclose(fp);
-						return 1;
-					}
-
-					*(wptr++) =
-						((strchr(hexdigits, tolower(lptr[1])) - hexdigits) << 4) |
-						(strchr(hexdigits, tolower(lptr[2])) - hexdigits);
-					lptr += 3;
-					klen++;
-				}
-			}
-			else {
-				*(wptr++) = *(lptr++);
-				klen++;
-			}
-		}
+	ACTF("Loading extra dictionary from '%s'...", path);
 
-		if (klen > MAX_DICT_FILE) {
-			printf("Keyword too big in line %u (%s, limit is %s)", cur_line, DMS(klen), DMS(MAX_DICT_FILE));
-			free(new_item);
-			fclose(fp);
+	//The tokens that don't fit under the memory_limit are left out
+	if (info->memory_limit) {
+		used = limited_memory_usage(info);
+		if (used >= info->memory_limit) {
+			printf("The dictionary doesn't fit under the memory_limit\n");
 			return 1;
 		}
+		max_bytes = info->memory_limit - used;
+	}
 
-		if (*min_len > klen) *min_len = klen;
-		if (*max_len < klen) *max_len = klen;
+	token_dictionary_free(&info->dictionary);
+	if (token_dictionary_load(&info->dictionary, path, MAX_DICT_FILE, max_bytes))
+		return 1;
 
-		temp_dictq = (string_t **)realloc(info->dictq, (info->dictionary_count + 1) * sizeof(string_t *));
-		if (!temp_dictq) {
-			printf("Failed allocating memory while parsing dictionary file %s, line %u.", fname, cur_line);
-			free(new_item);
-			fclose(fp);
-			return 1;
-		}
-		info->dictq = temp_dictq;
+	if (info->dictionary.skipped)
+		WARNF("Skipped %llu dictionary tokens that don't fit under the memory_limit.", (unsigned long long)info->dictionary.skipped);
+	if (info->dictionary.duplicates)
+		WARNF("Skipped %llu duplicate dictionary tokens.", (unsigned long long)info->dictionary.duplicates);
+	if (!info->dictionary.count) {
+		printf("No usable dictionary files in '%s'\n", path);
+		return 1;
+	}
 
-		info->dictq[info->dictionary_count] = (string_t *)malloc(sizeof(string_t));
-		if (!info->dictq[info->dictionary_count]) {
-			printf("Failed allocating memory while parsing dictionary file %s, line %u.", fname, cur_line);
-			free(new_item);
-			fclose(fp);
-			return 1;
-		}
+	for (i = 0; i < info->dictionary.count; i++)
+	{
+		length = TOKEN_DICTIONARY_LENGTH(&info->dictionary, i);
+		if (min_len > length) min_len = length;
+		if (max_len < length) max_len = length;
+	}
+	OKF("Loaded %llu dictionary tokens, size range %s to %s.", (unsigned long long)info->dictionary.count, DMS(min_len), DMS(max_len));
+	if (max_len > 32)
+		WARNF("Some tokens are relatively large (%s) - consider trimming.", DMS(max_len));
+	if (info->dictionary.count > MAX_DET_EXTRAS)
+		WARNF("More than %u tokens - will only use some of them at each offset.", MAX_DET_EXTRAS);
 
-		info->dictq[info->dictionary_count]->s = new_item;
-		info->dictq[info->dictionary_count]->len = klen;
-		info->dictionary_count++;
+	if (info->save_dictionary_file && token_dictionary_save(&info->dictionary, info->save_dictionary_file))
+		return 1;
+	if (build_dictionary_matcher(info)) {
+		printf("Failed allocating memory while indexing the dictionary\n");
+		return 1;
 	}
-	fclose(fp);
 	return 0;
 }
 
-/* Read the dictionary from the dictionary directory */
-MUTATORS_API int load_dictionary(mutate_info_t * info, char * path) {
-	u32 min_len = MAX_DICT_FILE, max_len = 0, dict_level = 0;
-	char * x, * file_contents;
-	char filename[MAX_PATH];
-	int length, ret;
-	string_t ** temp_dictq;
+/* Returns the first power of two that is greater than or equal to val */
+static u32 next_p2(u32 val) {
+	u32 ret = 1;
+	while (val > ret)
+		ret <<= 1;
+	return ret;
+}
 
-	/* If the name ends with @, extract level and continue. */
-	if ((x = strchr(path, '@'))) {
-		*x = 0;
-		dict_level = atoi(x + 1);
+/* Calculates the perf_score of the seed with the power schedule, as afl's calculate_score does
+   (with AFLFast's power schedules).  A perf_score of 100 is the normal amount of havoc. */
+static int calculate_score(mutate_info_t * info)
+{
+	seed_stats_t * stats = &info->seed_stats;
+	double perf_score = 100, factor = 1;
+	u32 fuzz = (u32)MIN(stats->path_frequency, 0x80000000ULL);
+	u32 fuzz_level = (u32)MIN(stats->fuzz_level, 0xffffULL);
+
+	/* Adjust score based on execution speed of this path, compared to the
+	   global average. Multiplier ranges from 0.1x to 3x. Fast inputs are
+	   less expensive to fuzz, so we're giving them more air time. */
+	if (stats->avg_exec_us) {
+		if (stats->exec_us * 0.1 > stats->avg_exec_us) perf_score = 10;
+		else if (stats->exec_us * 0.25 > stats->avg_exec_us) perf_score = 25;
+		else if (stats->exec_us * 0.5 > stats->avg_exec_us) perf_score = 50;
+		else if (stats->exec_us * 0.75 > stats->avg_exec_us) perf_score = 75;
+		else if (stats->exec_us * 4 < stats->avg_exec_us) perf_score = 300;
+		else if (stats->exec_us * 3 < stats->avg_exec_us) perf_score = 200;
+		else if (stats->exec_us * 2 < stats->avg_exec_us) perf_score = 150;
 	}
 
-	ACTF("Loading extra dictionary from '%s' (level %u)...", path, dict_level);
+	/* Adjust score based on bitmap size. The working theory is that better
+	   coverage translates to better targets. Multiplier from 0.25x to 3x. */
+	if (stats->avg_bitmap_size) {
+		if (stats->bitmap_size * 0.3 > stats->avg_bitmap_size) perf_score *= 3;
+		else if (stats->bitmap_size * 0.5 > stats->avg_bitmap_size) perf_score *= 2;
+		else if (stats->bitmap_size * 0.75 > stats->avg_bitmap_size) perf_score *= 1.5;
+		else if (stats->bitmap_size * 3 < stats->avg_bitmap_size) perf_score *= 0.25;
+		else if (stats->bitmap_size * 2 < stats->avg_bitmap_size) perf_score *= 0.5;
+		else if (stats->bitmap_size * 1.5 < stats->avg_bitmap_size) perf_score *= 0.75;
+	}
 
-#ifdef _WIN32
-	WIN32_FIND_DATA fdata;
-	HANDLE h;
-	wchar_t * wide_pattern;
+	/* Adjust score based on handicap. Handicap is proportional to how late
+	   in the game we learned about this path. Latecomers are allowed to run
+	   for a bit longer until they catch up with the rest. */
+	if (stats->handicap >= 4) perf_score *= 4;
+	else if (stats->handicap) perf_score *= 2;
+
+	/* Final adjustment based on input depth, under the assumption that fuzzing
+	   deeper test cases is more likely to reveal stuff that can't be
+	   discovered with traditional fuzzers. */
+	if (stats->depth >= 26) perf_score *= 5;
+	else if (stats->depth >= 14) perf_score *= 4;
+	else if (stats->depth >= 8) perf_score *= 3;
+	else if (stats->depth >= 4) perf_score *= 2;
+
+	switch (info->power_schedule) {
+	case POWER_SCHEDULE_EXPLOIT:
+		factor = MAX_FACTOR;
+		break;
+	case POWER_SCHEDULE_COE:
+		if (fuzz <= stats->avg_path_frequency)
+			factor = fuzz_level < 16 ? (u32)(1 << fuzz_level) : MAX_FACTOR;
+		else
+			factor = 0;
+		break;
+	case POWER_SCHEDULE_FAST:
+		if (fuzz_level < 16)
+			factor = ((u32)(1 << fuzz_level)) / (fuzz == 0 ? 1 : fuzz);
+		else
+			factor = MAX_FACTOR / (fuzz == 0 ? 1 : next_p2(fuzz));
+		break;
+	case POWER_SCHEDULE_LIN:
+		factor = fuzz_level / (fuzz == 0 ? 1 : fuzz);
+		break;
+	case POWER_SCHEDULE_QUAD:
+		factor = (fuzz_level * fuzz_level) / (fuzz == 0 ? 1 : fuzz);
+		break;
+	}
+	if (factor > MAX_FACTOR)
+		factor = MAX_FACTOR;
+	perf_score *= factor / POWER_BETA;
+
+	// Seeds that are still finding new paths are worth spending more time on
+	if (stats->new_paths)
+		perf_score *= 2;
+
+	/* Make sure that we don't go over limit. */
+	if (perf_score > HAVOC_MAX_MULT * 100)
+		perf_score = HAVOC_MAX_MULT * 100;
+	return (int)perf_score;
+}
 
-	if (path[strlen(path) - 1] == '\\')
-		snprintf(filename, sizeof(filename), "%s*", path);
-	else
-		snprintf(filename, sizeof(filename), "%s\\*", path);
-	wide_pattern = convert_char_array_to_wchar(filename, NULL);
-	h = FindFirstFile(wide_pattern, &fdata);
-	free(wide_pattern);
+/* Tries removing blocks of the input, starting with large blocks and moving on to smaller ones, as
+   afl's trim_case does.  Each output is the input with one block removed.  The caller decides whether
+   a removal should be kept (i.e. if it didn't change the execution), and calls accept_trim before
+   getting the next output.  Removals that aren't accepted by then are skipped. */
+MUTATORS_API int trim_input(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	u32 len_p2, trim_avail;
+
+	if (buf->length < 5)
+		return MUTATOR_DONE;
 
-	if (h == INVALID_HANDLE_VALUE) {
-		ret = load_dictionary_file(info, path, &min_len, &max_len, dict_level);
-		if (ret)
-			return ret;
-		goto check_dictionary;
+	len_p2 = next_p2((u32)buf->length);
+	if (!info->trim_remove_len) { //Starting the stage
+		info->trim_remove_len = MAX(len_p2 / TRIM_START_STEPS, TRIM_MIN_BYTES);
+		info->trim_remove_pos = info->trim_remove_len;
 	}
+	else if (info->trim_pending_len) //The last removal wasn't accepted, move on to the next block
+		info->trim_remove_pos += info->trim_remove_len;
+	info->trim_pending_len = 0;
 
-	if (x) {
-		printf("Dictionary levels not supported for directories.");
-		FindClose(h);
-		return 1;
+	for (;;)
+	{
+		while (info->trim_remove_pos >= buf->length)
+		{
+			info->trim_remove_len >>= 1;
+			if (info->trim_remove_len < MAX(len_p2 / TRIM_END_STEPS, TRIM_MIN_BYTES)) {
+				info->trim_remove_len = 0;
+				return MUTATOR_DONE;
+			}
+			info->trim_remove_pos = info->trim_remove_len;
+		}
+
+		//Only the blocks that the regions allow to be mutated are removed
+		trim_avail = MIN(info->trim_remove_len, (u32)buf->length - info->trim_remove_pos);
+		if (!info->regions.enabled || region_map_contains(&info->regions, info->trim_remove_pos, trim_avail))
+			break;
+		info->trim_remove_pos += info->trim_remove_len;
 	}
+	memmove(buf->buffer + info->trim_remove_pos, buf->buffer + info->trim_remove_pos + trim_avail,
+		buf->length - info->trim_remove_pos - trim_avail);
+	buf->length -= trim_avail;
 
-	do {
-		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-			continue;
+	info->trim_pending_pos = info->trim_remove_pos;
+	info->trim_pending_len = trim_avail;
+	return (int)buf->length;
+}
 
-		snprintf(filename, sizeof(filename), "%s\\%s", path, fdata.cFileName);
-		if (_access(filename, 0)) {
-			printf("Unable to access dictionary file '%s'", filename);
-			FindClose(h);
-			return 1;
-		}
-		if ((fdata.nFileSizeHigh > 0) || (fdata.nFileSizeLow > MAX_DICT_FILE)) {
-			printf("Dictionary item '%s' is too big (%s, limit is %s)", filename, DMS(fdata.nFileSizeLow), DMS(MAX_DICT_FILE));
-			FindClose(h);
-			return 1;
-		}
+/**
+ * Accepts the removal made by the last trim_input output.  The caller should remove the same block
+ * from its input, and then update the mutate_info_t with set_mutate_info_input.
+ * @param info - the mutate_info_t that made the removal
+ * @param pos - used to return the offset of the removed block
+ * @param length - used to return the length of the removed block
+ * @return - 1 if there was a removal to accept, 0 otherwise
+ */
+MUTATORS_API int accept_trim(mutate_info_t * info, u32 * pos, u32 * length)
+{
+	if (!info->trim_remove_len || !info->trim_pending_len)
+		return 0;
+	*pos = info->trim_pending_pos;
+	*length = info->trim_pending_len;
+	info->trim_pending_len = 0; //The next block to try is now at the same offset
+	return 1;
+}
+
+MUTATORS_API int single_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	uint64_t pos;
 
-		if (min_len > fdata.nFileSizeLow) min_len = fdata.nFileSizeLow;
-		if (max_len < fdata.nFileSizeLow) max_len = fdata.nFileSizeLow;
+	if (locate_position(info, buf->length, info->stage_cur, 1, 1, &pos))
+		return MUTATOR_DONE;
+	FLIP_BIT(buf->buffer, pos);
+	return (int)buf->length;
+}
 
-		length = read_file(filename, &file_contents);
-		if (length < 0) {
-			printf("Unable to open dictionary file '%s'", filename);
-			FindClose(h);
-			return 1;
-		}
+MUTATORS_API int two_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	uint64_t pos;
 
-		temp_dictq = (string_t **)realloc(info->dictq, (info->dictionary_count + 1) * sizeof(string_t *));
-		if (!temp_dictq) {
-			printf("Failed allocating memory while parsing dictionary file %s.", filename);
-			free(file_contents);
-			FindClose(h);
-			return 1;
-		}
-		info->dictq = temp_dictq;
+	if (locate_position(info, buf->length, info->stage_cur, 2, 1, &pos))
+		return MUTATOR_DONE;
+	FLIP_BIT(buf->buffer, pos);
+	FLIP_BIT(buf->buffer, pos + 1);
+	return (int)buf->length;
+}
 
-		info->dictq[info->dictionary_count] = (string_t *)malloc(sizeof(string_t));
-		if (!info->dictq[info->dictionary_count]) {
-			printf("Failed allocating memory while parsing dictionary file %s.", filename);
-			free(file_contents);
-			FindClose(h);
-			return 1;
-		}
+MUTATORS_API int four_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	uint64_t pos;
 
-		info->dictq[info->dictionary_count]->len = length;
-		info->dictq[info->dictionary_count]->s = (u8*)file_contents;
-		info->dictionary_count++;
+	if (locate_position(info, buf->length, info->stage_cur, 4, 1, &pos))
+		return MUTATOR_DONE;
+	FLIP_BIT(buf->buffer, pos);
+	FLIP_BIT(buf->buffer, pos + 1);
+	FLIP_BIT(buf->buffer, pos + 2);
+	FLIP_BIT(buf->buffer, pos + 3);
+	return (int)buf->length;
+}
 
-	} while (FindNextFile(h, &fdata));
+/* The walking byte, arithmetic, and interesting value stages for each width.  These are
+   generated from one kernel per stage, which is inlined with a constant width. */
 
-	FindClose(h);
+/* Flips all of the bits in the width bytes at each offset */
+static inline int walking_bytes(mutate_info_t * info, mutate_buffer_t * buf, int width)
+{
+	uint64_t offset;
+	u64 value;
 
-#else
+	if (locate_position(info, buf->length, info->stage_cur, width, 0, &offset))
+		return MUTATOR_DONE;
+	value = load_value(buf->buffer + offset, width);
+	store_value(buf->buffer + offset, value ^ width_mask(width), width);
+	return (int)buf->length;
+}
+
+/* Adds or subtracts 1 to ARITH_MAX from the width byte value at each offset, in little endian
+   and then (for multibyte values) big endian */
+static inline int arithmetics(mutate_info_t * info, mutate_buffer_t * buf, int width)
+{
+	uint64_t index, offset, round, rounds = width == 1 ? 2 : 4;
+	u64 old_value, new_value, arith_value, low, mask = width_mask(width), half_mask;
+
+	index = info->stage_cur / (rounds * ARITH_MAX);
+	if (locate_position(info, buf->length, index, width, 0, &offset))
+		return MUTATOR_DONE;
+	if (skip_ineffective_bytes(info, buf, index, offset, width, rounds * ARITH_MAX))
+		return MUTATOR_TRY_AGAIN;
+	round = (info->stage_cur / ARITH_MAX) % rounds;
+	arith_value = (info->stage_cur % (ARITH_MAX)) + 1;
+	old_value = load_value(buf->buffer + offset, width);
 
-	DIR* d;
-	struct dirent* de;
-	struct stat st;
-	int fd;
+	if (round == 0) //little endian addition
+		new_value = (old_value + arith_value) & mask;
+	else if (round == 1) //little endian subtraction
+		new_value = (old_value - arith_value) & mask;
+	else if (round == 2) //big endian addition
+		new_value = swap_value((swap_value(old_value, width) + arith_value) & mask, width);
+	else //big endian subtraction
+		new_value = swap_value((swap_value(old_value, width) - arith_value) & mask, width);
+
+	// Do arithmetic operations only if the result couldn't be a product of a bitflip.
+	if (info->should_skip_previous && could_be_bitflip(old_value ^ new_value))
+		return MUTATOR_TRY_AGAIN;
+
+	// For multibyte values, only try the operation if it would affect more than the low
+	// half of the value (hence the overflow checks), since the narrower stages did the rest.
+	if (width > 1) {
+		half_mask = width_mask(width / 2);
+		low = (round < 2 ? old_value : swap_value(old_value, width)) & half_mask;
+		if ((round % 2 == 0 && low + arith_value <= half_mask) || (round % 2 == 1 && low > arith_value))
+			return MUTATOR_TRY_AGAIN;
+	}
+
+	store_value(buf->buffer + offset, new_value, width);
+	return (int)buf->length;
+}
+
+/* Sets the width byte value at each offset to each of the interesting values, in little endian
+   and then (for multibyte values) big endian */
+static inline int interesting_bytes(mutate_info_t * info, mutate_buffer_t * buf, int width)
+{
+	uint64_t index, offset, round, rounds = width == 1 ? 1 : 2;
+	size_t count = interesting_count(width);
+	u64 old_value, new_value;
+
+	index = info->stage_cur / (rounds * count);
+	if (locate_position(info, buf->length, index, width, 0, &offset))
+		return MUTATOR_DONE;
+	if (skip_ineffective_bytes(info, buf, index, offset, width, rounds * count))
+		return MUTATOR_TRY_AGAIN;
+	round = (info->stage_cur / count) % rounds;
+	old_value = load_value(buf->buffer + offset, width);
+	new_value = interesting_value(width, info->stage_cur % count);
+	if (round) //second round, use reverse endian
+		new_value = swap_value(new_value, width);
+
+	/* Skip if this could be a product of a bitflip, arithmetics,
+	narrower interesting value insertion, or if on the reverse endian
+	round and the value is the same in both endians */
+	if ((info->should_skip_previous &&
+		(could_be_bitflip(old_value ^ new_value)
+		|| could_be_arith(old_value, new_value, width)
+		|| (width > 1 && could_be_interest(old_value, new_value, width, round))))
+		|| (round == 1 && new_value == swap_value(new_value, width)))
+		return MUTATOR_TRY_AGAIN;
+
+	store_value(buf->buffer + offset, new_value, width);
+	return (int)buf->length;
+}
+
+MUTATORS_API int walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return walking_bytes(info, buf, 1);
+}
+
+MUTATORS_API int two_walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return walking_bytes(info, buf, 2);
+}
+
+MUTATORS_API int four_walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return walking_bytes(info, buf, 4);
+}
+
+MUTATORS_API int eight_walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return walking_bytes(info, buf, 8);
+}
+
+MUTATORS_API int one_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return arithmetics(info, buf, 1);
+}
+
+MUTATORS_API int two_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return arithmetics(info, buf, 2);
+}
+
+MUTATORS_API int four_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return arithmetics(info, buf, 4);
+}
+
+MUTATORS_API int eight_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return arithmetics(info, buf, 8);
+}
+
+MUTATORS_API int interesting_one_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return interesting_bytes(info, buf, 1);
+}
+
+MUTATORS_API int interesting_two_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return interesting_bytes(info, buf, 2);
+}
 
-	d = opendir(path);
-	if (!d) {
-		ret = load_dictionary_file(info, path, &min_len, &max_len, dict_level);
-		if (ret)
-			return ret;
-		goto check_dictionary;
-	}
+MUTATORS_API int interesting_four_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return interesting_bytes(info, buf, 4);
+}
 
-	if (x) {
-		printf("Dictionary levels not supported for directories.");
-		return 1;
-	}
+MUTATORS_API int interesting_eight_byte(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	return interesting_bytes(info, buf, 8);
+}
 
-	while ((de = readdir(d))) {
+/* Returns a dictionary token, which points into the dictionary's buffer */
+static string_t dictionary_token(mutate_info_t * info, size_t token)
+{
+	string_t item;
+	item.s = TOKEN_DICTIONARY_TOKEN(&info->dictionary, token);
+	item.len = TOKEN_DICTIONARY_LENGTH(&info->dictionary, token);
+	return item;
+}
 
-		snprintf(filename, sizeof(filename), "%s/%s", path, de->d_name);
-		if (lstat(filename, &st) || access(filename, R_OK)) {
-			printf("Unable to access dictionary file '%s'", filename);
-			return 1;
-		}
+//The number of tokens tried at each offset by the deterministic dictionary stages
+#define DICTIONARY_WINDOW(info) MIN((info)->dictionary.count, MAX_DET_EXTRAS)
 
-		/* This also takes care of . and .. */
-		if (!S_ISREG(st.st_mode) || !st.st_size)
-			continue;
+/* When there are more than MAX_DET_EXTRAS tokens, each offset tries the MAX_DET_EXTRAS tokens
+   after the ones tried at the previous offset, so that every token is still tried at about the
+   same number of offsets.  Returns the first token that is tried at an offset. */
+static uint64_t dictionary_window_start(mutate_info_t * info, size_t offset)
+{
+	if (info->dictionary.count <= MAX_DET_EXTRAS)
+		return 0;
+	return ((uint64_t)offset * MAX_DET_EXTRAS) % info->dictionary.count;
+}
 
-		if (st.st_size > MAX_DICT_FILE) {
-			printf("Dictionary item '%s' is too big (%s, limit is %s)", filename, DMS(st.st_size), DMS(MAX_DICT_FILE));
-			return 1;
-		}
+/* Returns the i'th token tried at an offset.  Once the token scores have found some productive
+   tokens, every offset tries the best scoring tokens rather than a rotating window. */
+static uint64_t dictionary_window_token(mutate_info_t * info, size_t offset, uint64_t i)
+{
+	if (info->dictionary_order)
+		return info->dictionary_order[i];
+	return (dictionary_window_start(info, offset) + i) % info->dictionary.count;
+}
 
-		if (min_len > st.st_size) min_len = st.st_size;
-		if (max_len < st.st_size) max_len = st.st_size;
+/* Whether a token is one of the tokens tried at an offset */
+static int dictionary_window_contains(mutate_info_t * info, size_t offset, uint64_t token)
+{
+	if (info->dictionary_order)
+		return info->dictionary_rank[token] < DICTIONARY_WINDOW(info);
+	return (token + info->dictionary.count - dictionary_window_start(info, offset)) % info->dictionary.count
+		< DICTIONARY_WINDOW(info);
+}
 
-		info->dictq = (string_t **)realloc(info->dictq, (info->dictionary_count + 1) * sizeof(string_t *));
-		info->dictq[info->dictionary_count] = (string_t *)malloc(sizeof(string_t));
+typedef struct {
+	double score;
+	uint32_t token;
+} scored_token_t;
 
-		length = read_file(filename, (char **)&info->dictq[info->dictionary_count]->s);
-		if (length < 0) {
-			printf("Unable to open dictionary file '%s'", filename);
-			return 1;
-		}
-		info->dictq[info->dictionary_count]->len = length;
-		info->dictionary_count++;
-	}
+static int compare_scored_tokens(const void * a, const void * b)
+{
+	const scored_token_t * token_a = (const scored_token_t *)a;
+	const scored_token_t * token_b = (const scored_token_t *)b;
+	if (token_a->score != token_b->score)
+		return token_a->score > token_b->score ? -1 : 1;
+	return token_a->token < token_b->token ? -1 : (token_a->token > token_b->token);
+}
 
-	closedir(d);
+/* Orders the tokens by their scores, if there are too many tokens to try them all at each offset
+   and the scores have found some productive tokens */
+static int order_dictionary_tokens(mutate_info_t * info)
+{
+	scored_token_t * scored;
+	uint64_t i;
 
-#endif
+	free(info->dictionary_order);
+	info->dictionary_order = NULL;
+	free(info->dictionary_rank);
+	info->dictionary_rank = NULL;
+	if (info->dictionary.count <= MAX_DET_EXTRAS || !token_scorer_ready(&info->dictionary_scorer)
+		|| info->dictionary_scorer.num_tokens != info->dictionary.count)
+		return 0;
 
-check_dictionary:
-	if (!info->dictionary_count) {
-		printf("No usable dictionary files in '%s'", path);
+	scored = (scored_token_t *)malloc(info->dictionary.count * sizeof(scored_token_t));
+	info->dictionary_order = (uint32_t *)malloc(info->dictionary.count * sizeof(uint32_t));
+	info->dictionary_rank = (uint32_t *)malloc(info->dictionary.count * sizeof(uint32_t));
+	if (!scored || !info->dictionary_order || !info->dictionary_rank) {
+		free(scored);
+		free(info->dictionary_order);
+		info->dictionary_order = NULL;
+		free(info->dictionary_rank);
+		info->dictionary_rank = NULL;
 		return 1;
 	}
 
-	OKF("Loaded %llu dictionary tokens, size range %s to %s.", info->dictionary_count, DMS(min_len), DMS(max_len));
-	if (max_len > 32)
-		WARNF("Some tokens are relatively large (%s) - consider trimming.", DMS(max_len));
-	if (info->dictionary_count > MAX_DET_EXTRAS)
-		WARNF("More than %u tokens - will use them probabilistically.", MAX_DET_EXTRAS);
-
+	for (i = 0; i < info->dictionary.count; i++)
+	{
+		scored[i].score = token_scorer_score(&info->dictionary_scorer, i);
+		scored[i].token = (uint32_t)i;
+	}
+	qsort(scored, info->dictionary.count, sizeof(scored_token_t), compare_scored_tokens);
+	for (i = 0; i < info->dictionary.count; i++)
+	{
+		info->dictionary_order[i] = scored[i].token;
+		info->dictionary_rank[scored[i].token] = (uint32_t)i;
+	}
+	free(scored);
 	return 0;
 }
 
-MUTATORS_API int single_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
+/* Whether a token should be tried at an offset, i.e. it fits in the buffer and it doesn't
+   already occur at that offset.  The tokens that occur at the offset are given by the
+   dictionary_matches entries from match to match_end. */
+static int is_dictionary_candidate(mutate_info_t * info, int insert, size_t max_length, size_t offset,
+	uint64_t token, size_t match, size_t match_end)
 {
-	if (info->stage_cur >= buf->length << 3)
-		return MUTATOR_DONE;
-	FLIP_BIT(buf->buffer, info->stage_cur);
-	return (int)buf->length;
-}
+	size_t i;
 
-MUTATORS_API int two_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
-{
-	if (info->stage_cur >= (buf->length << 3) - 1)
-		return MUTATOR_DONE;
-	FLIP_BIT(buf->buffer, info->stage_cur);
-	FLIP_BIT(buf->buffer, info->stage_cur + 1);
-	return (int)buf->length;
+	if (TOKEN_DICTIONARY_LENGTH(&info->dictionary, token) > max_length - (insert ? info->dictionary_input_length : offset))
+		return 0;
+	// Only overwrite (or insert between) the bytes that the regions allow to be mutated
+	if (info->regions.enabled && !region_map_contains(&info->regions, offset,
+			insert ? 0 : MIN(TOKEN_DICTIONARY_LENGTH(&info->dictionary, token), info->dictionary_input_length - offset)))
+		return 0;
+	// Don't overwrite bytes that didn't affect the execution when they were flipped
+	if (!insert && effector_map_ready(info, info->dictionary_input_length) && !memchr(info->eff_map + EFF_APOS(offset), 1,
+			EFF_SPAN_ALEN(offset, MIN(TOKEN_DICTIONARY_LENGTH(&info->dictionary, token), info->dictionary_input_length - offset))))
+		return 0;
+	for (i = match; i < match_end && info->dictionary_matches[i].id <= token; i++)
+	{
+		if (info->dictionary_matches[i].id == token)
+			return 0;
+	}
+	return 1;
 }
 
-MUTATORS_API int four_walking_bit(mutate_info_t * info, mutate_buffer_t * buf)
+/* Counts the tokens that should be tried at an offset */
+static uint64_t count_dictionary_candidates_at(mutate_info_t * info, int insert, size_t max_length, size_t offset,
+	size_t match, size_t match_end)
 {
-	if (info->stage_cur >= (buf->length << 3) - 3)
-		return MUTATOR_DONE;
-	FLIP_BIT(buf->buffer, info->stage_cur);
-	FLIP_BIT(buf->buffer, info->stage_cur + 1);
-	FLIP_BIT(buf->buffer, info->stage_cur + 2);
-	FLIP_BIT(buf->buffer, info->stage_cur + 3);
-	return (int)buf->length;
-}
+	uint64_t window, count, i;
 
-MUTATORS_API int walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
-{
-	if (info->stage_cur >= buf->length)
-		return MUTATOR_DONE;
-	buf->buffer[info->stage_cur] ^= 0xFF;
-	return (int)buf->length;
+	window = DICTIONARY_WINDOW(info);
+	if (info->dictionary_max_token_length <= max_length - (insert ? info->dictionary_input_length : offset)
+		&& (insert || !effector_map_ready(info, info->dictionary_input_length)) && !info->regions.enabled)
+	{
+		//Every token fits, so only the tokens that already occur here are skipped
+		count = window;
+		for (i = match; i < match_end; i++)
+		{
+			if (dictionary_window_contains(info, offset, info->dictionary_matches[i].id))
+				count--;
+		}
+		return count;
+	}
+
+	count = 0;
+	for (i = 0; i < window; i++)
+		count += is_dictionary_candidate(info, insert, max_length, offset, dictionary_window_token(info, offset, i), match, match_end);
+	return count;
 }
 
-MUTATORS_API int two_walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+/* Finds the dictionary_matches entries for an offset, starting the search from *match */
+static size_t find_dictionary_matches(mutate_info_t * info, size_t offset, size_t * match)
 {
-	if (info->stage_cur >= buf->length - 1 || buf->length < 2)
-		return MUTATOR_DONE;
-	*(u16*)(buf->buffer + info->stage_cur) ^= 0xFFFF;
-	return (int)buf->length;
+	size_t match_end;
+	while (*match < info->dictionary_matches_count && info->dictionary_matches[*match].offset < offset)
+		(*match)++;
+	for (match_end = *match; match_end < info->dictionary_matches_count
+		&& info->dictionary_matches[match_end].offset == offset; match_end++);
+	return match_end;
 }
 
-MUTATORS_API int four_walking_byte(mutate_info_t * info, mutate_buffer_t * buf)
+/**
+ * Finds where the dictionary tokens occur in the input, so that the deterministic dictionary
+ * stages can skip the mutations that wouldn't change it.  This should be called whenever the
+ * input changes.  If it isn't, the dictionary stages will call it with the buffer they are given
+ * the first time they need it.
+ * @param info - the mutate_info_t with the dictionary to search for
+ * @param input - the input to search
+ * @param input_length - the length of the input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int index_dictionary_matches(mutate_info_t * info, u8 * input, size_t input_length)
 {
-	if (info->stage_cur >= buf->length - 3 || buf->length < 4)
-		return MUTATOR_DONE;
-	*(u32*)(buf->buffer + info->stage_cur) ^= 0xFFFFFFFF;
-	return (int)buf->length;
+	free(info->dictionary_matches);
+	info->dictionary_matches = NULL;
+	info->dictionary_matches_count = 0;
+	info->dictionary_matches_valid = 0;
+	info->dictionary_cursor.valid = 0;
+	info->dictionary_input_length = input_length;
+
+	//The tokens are only reordered between inputs, so the order is the same throughout the stages
+	if (order_dictionary_tokens(info) || (info->dictionary_matcher && token_matcher_scan(info->dictionary_matcher,
+			input, input_length, &info->dictionary_matches, &info->dictionary_matches_count)))
+		return 1;
+	info->dictionary_matches_valid = 1;
+	return 0;
 }
 
-MUTATORS_API int one_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+/**
+ * Counts the mutations that a deterministic dictionary stage will make to an input
+ * @param info - the mutate_info_t with the dictionary to use
+ * @param input - the input that will be mutated
+ * @param input_length - the length of the input
+ * @param insert - 1 to count the mutations of dictionary_insert, 0 for dictionary_overwrite
+ * @param max_length - the size of the buffers that the mutations will be written to.  If 0, the size
+ * of the last buffer given to a dictionary stage is used, or every token is assumed to fit if there
+ * hasn't been one yet.
+ * @return - the number of mutations, or -1 on failure
+ */
+MUTATORS_API int64_t count_dictionary_candidates(mutate_info_t * info, u8 * input, size_t input_length, int insert, size_t max_length)
 {
-	uint64_t index, round;
-	u8 old_value, new_value, arith_value;
+	size_t offset, num_offsets, match = 0, match_end;
+	int64_t count = 0;
 
-	if (info->stage_cur >= 2 * buf->length * ARITH_MAX)
-		return MUTATOR_DONE;
+	if (!info->dictionary.count)
+		return 0;
+	if (region_map_update(&info->regions, input, input_length)
+		|| (!info->dictionary_matches_valid && index_dictionary_matches(info, input, input_length)))
+		return -1;
+	if (!max_length)
+		max_length = info->dictionary_max_length ? info->dictionary_max_length : SIZE_MAX;
+
+	num_offsets = info->dictionary_input_length + (insert ? 1 : 0);
+	for (offset = 0; offset < num_offsets; offset++)
+	{
+		match_end = find_dictionary_matches(info, offset, &match);
+		count += count_dictionary_candidates_at(info, insert, max_length, offset, match, match_end);
+	}
+	return count;
+}
 
-	index = info->stage_cur / (2 * ARITH_MAX);
-	round = (info->stage_cur / ARITH_MAX) % 2;
-	arith_value = (u8)(info->stage_cur % (ARITH_MAX));
+/* Finds the stage_cur'th mutation of a deterministic dictionary stage, and returns the index of
+   its token.  The cursor in the mutate_info_t remembers where the previous one was, so stepping
+   through the stage only looks at each offset's tokens once. */
+static int64_t find_dictionary_candidate(mutate_info_t * info, mutate_buffer_t * buf, int insert, size_t * offset)
+{
+	dictionary_cursor_t * cursor = &info->dictionary_cursor;
+	uint64_t window, token, candidates;
+	size_t num_offsets, match_end;
 
-	old_value = buf->buffer[index];
+	// The buffer still holds the unmodified input at this point
+	if (!info->dictionary_matches_valid && index_dictionary_matches(info, buf->buffer, buf->length))
+		return -1;
 
-	if (round == 0) //one byte addition
-		new_value = old_value + (arith_value + 1);
-	else //one byte subtraction
-		new_value = old_value - (arith_value + 1);
+	info->dictionary_max_length = buf->max_length;
+	if (!cursor->valid || cursor->insert != insert || cursor->max_length != buf->max_length
+		|| info->stage_cur < cursor->rank)
+	{
+		memset(cursor, 0, sizeof(dictionary_cursor_t));
+		cursor->valid = 1;
+		cursor->insert = insert;
+		cursor->max_length = buf->max_length;
+	}
 
-	// Do arithmetic operations only if the result couldn't be a product of a bitflip.
-	if (info->should_skip_previous && could_be_bitflip(old_value ^ new_value))
-		return MUTATOR_TRY_AGAIN;
+	num_offsets = info->dictionary_input_length + (insert ? 1 : 0);
+	window = DICTIONARY_WINDOW(info);
+	for (; cursor->offset < num_offsets; cursor->offset++, cursor->token = 0)
+	{
+		match_end = find_dictionary_matches(info, cursor->offset, &cursor->match);
+
+		//Skip over whole offsets until we reach the one with the mutation we're looking for
+		if (!cursor->token) {
+			candidates = count_dictionary_candidates_at(info, insert, buf->max_length, cursor->offset, cursor->match, match_end);
+			if (info->stage_cur - cursor->rank >= candidates) {
+				cursor->rank += candidates;
+				continue;
+			}
+		}
 
-	buf->buffer[index] = new_value;
-	return (int)buf->length;
+		for (; cursor->token < window; cursor->token++)
+		{
+			token = dictionary_window_token(info, cursor->offset, cursor->token);
+			if (!is_dictionary_candidate(info, insert, buf->max_length, cursor->offset, token, cursor->match, match_end))
+				continue;
+			if (cursor->rank == info->stage_cur) {
+				*offset = cursor->offset;
+				return (int64_t)token;
+			}
+			cursor->rank++;
+		}
+	}
+	return -1;
 }
 
-MUTATORS_API int two_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+MUTATORS_API int dictionary_overwrite(mutate_info_t * info, mutate_buffer_t * buf)
 {
-	uint64_t index, round;
-	u16 old_value, new_value, arith_value;
+	size_t index;
+	int64_t token;
+	string_t dictionary_item;
 
-	if (info->stage_cur >= 4 * (buf->length - 1) * ARITH_MAX || buf->length < 2)
+	if (!info->dictionary.count)
 		return MUTATOR_DONE;
 
-	index = info->stage_cur / (4 * ARITH_MAX);
-	round = (info->stage_cur / ARITH_MAX) % 4;
-	arith_value = (info->stage_cur % (ARITH_MAX)) + 1;
-	old_value = *(u16*)(buf->buffer + index);
-
-	if (round == 0) //little endian addition
-		new_value = old_value + arith_value;
-	else if (round == 1) //little endian subtraction
-		new_value = old_value - arith_value;
-	else if (round == 2) //big endian addition
-		new_value = SWAP16(SWAP16(old_value) + arith_value);
-	else //big endian subtraction
-		new_value = SWAP16(SWAP16(old_value) - arith_value);
-
-	// Try little endian addition and subtraction first, then big endian. Do it only
-	// if the operation would affect more than one byte (hence the & 0xff overflow checks)
-	// and if it couldn't be a product of a bitflip.
-	if ((info->should_skip_previous && could_be_bitflip(old_value ^ new_value))
-		|| (round == 0 && (old_value & 0xff) + arith_value <= 0xff)
-		|| (round == 1 && (old_value & 0xff) > arith_value)
-		|| (round == 2 && (old_value >> 8) + arith_value <= 0xff)
-		|| (round == 3 && (old_value >> 8)  > arith_value))
-		return MUTATOR_TRY_AGAIN;
+	// Only the tokens that fit and aren't already at an offset are tried there
+	token = find_dictionary_candidate(info, buf, 0, &index);
+	if (token < 0)
+		return MUTATOR_DONE;
+	dictionary_item = dictionary_token(info, token);
+	token_scorer_use(&info->dictionary_scorer, (size_t)token);
 
-	*(u16*)(buf->buffer + index) = new_value;
+	memcpy(buf->buffer + index, dictionary_item.s, dictionary_item.len);
+	buf->length = MAX(buf->length, index + dictionary_item.len);
 	return (int)buf->length;
 }
 
-MUTATORS_API int four_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf)
+MUTATORS_API int dictionary_insert(mutate_info_t * info, mutate_buffer_t * buf)
 {
-	uint64_t index, round;
-	u32 old_value, new_value, arith_value;
+	size_t index;
+	int64_t token;
+	string_t dictionary_item;
 
-	if (info->stage_cur >= 4 * (buf->length - 3) * ARITH_MAX || buf->length < 4)
+	if (!info->dictionary.count)
 		return MUTATOR_DONE;
 
-	index = info->stage_cur / (4 * ARITH_MAX);
-	round = (info->stage_cur / ARITH_MAX) % 4;
-	arith_value = (info->stage_cur % (ARITH_MAX)) + 1;
-	old_value = *(u32*)(buf->buffer + index);
-
-	if (round == 0) //little endian addition
-		new_value = old_value + arith_value;
-	else if (round == 1) //little endian subtraction
-		new_value = old_value - arith_value;
-	else if (round == 2) //big endian addition
-		new_value = SWAP32(SWAP32(old_value) + arith_value);
-	else //big endian subtraction
-		new_value = SWAP32(SWAP32(old_value) - arith_value);
-
-	// Little endian first. Same deal as with 16-bit: we only want to
-	// try if the operation would have effect on more than two bytes.
-	if ((info->should_skip_previous && could_be_bitflip(old_value ^ new_value))
-		|| (round == 0 && (old_value & 0xffff) + arith_value <= 0xffff)
-		|| (round == 1 && (old_value & 0xffff) > arith_value)
-		|| (round == 2 && (SWAP32(old_value) & 0xffff) + arith_value <= 0xffff)
-		|| (round == 3 && (SWAP32(old_value) & 0xffff) > arith_value))
-		return MUTATOR_TRY_AGAIN;
+	// Only the tokens that fit and aren't already at an offset are tried there
+	token = find_dictionary_candidate(info, buf, 1, &index);
+	if (token < 0)
+		return MUTATOR_DONE;
+	dictionary_item = dictionary_token(info, token);
+	token_scorer_use(&info->dictionary_scorer, (size_t)token);
 
-	*(u32*)(buf->buffer + index) = new_value;
+	memmove(buf->buffer + index + dictionary_item.len, buf->buffer + index, buf->length - index);
+	memcpy(buf->buffer + index, dictionary_item.s, dictionary_item.len);
+	buf->length += dictionary_item.len;
 	return (int)buf->length;
 }
 
-MUTATORS_API int interesting_one_byte(mutate_info_t * info, mutate_buffer_t * buf)
+/* Adds a replacement for the input-to-state stage.  Replacements that wouldn't change the input
+   are ignored, as are operands that are too short to be found reliably. */
+static int add_comparison_replacement(mutate_info_t * info, const u8 * pattern, size_t pattern_len,
+	const u8 * replacement, size_t replacement_len)
 {
-	uint64_t index;
-	u8 old_value, new_value;
+	cmp_replacement_t * new_replacements;
+	cmp_replacement_t * cmp;
+	size_t new_max;
 
-	if (info->stage_cur >= buf->length * ARRAY_SIZE(interesting_8))
-		return MUTATOR_DONE;
+	if (pattern_len < 2 || pattern_len > CMP_MAX_LENGTH || replacement_len > CMP_MAX_LENGTH
+		|| (pattern_len == replacement_len && !memcmp(pattern, replacement, pattern_len)))
+		return 0;
 
-	index = info->stage_cur / ARRAY_SIZE(interesting_8);
-	old_value = buf->buffer[index];
-	new_value = interesting_8[info->stage_cur % ARRAY_SIZE(interesting_8)];
+	if (info->cmp_replacements_count == info->cmp_replacements_max) {
+		new_max = info->cmp_replacements_max ? info->cmp_replacements_max * 2 : 64;
+		new_replacements = (cmp_replacement_t *)realloc(info->cmp_replacements, new_max * sizeof(cmp_replacement_t));
+		if (!new_replacements)
+			return 1;
+		info->cmp_replacements = new_replacements;
+		info->cmp_replacements_max = new_max;
+	}
 
-	// Skip if the value could be a product of bitflips or arithmetics.
-	if (info->should_skip_previous && (could_be_bitflip(old_value ^ new_value) || could_be_arith(old_value, new_value, 1)))
-		return MUTATOR_TRY_AGAIN;
+	cmp = &info->cmp_replacements[info->cmp_replacements_count++];
+	memset(cmp, 0, sizeof(cmp_replacement_t));
+	memcpy(cmp->pattern, pattern, pattern_len);
+	memcpy(cmp->replacement, replacement, replacement_len);
+	cmp->pattern_len = (u8)pattern_len;
+	cmp->replacement_len = (u8)replacement_len;
+	info->cmp_matches_valid = 0;
+	return 0;
+}
 
-	buf->buffer[index] = new_value;
-	return (int)buf->length;
+/* Adds the replacements for a comparison in both directions, i.e. operand1 is replaced with
+   operand2 and operand2 is replaced with operand1 */
+static int add_comparison_pair(mutate_info_t * info, const u8 * operand1, size_t operand1_len,
+	const u8 * operand2, size_t operand2_len)
+{
+	return add_comparison_replacement(info, operand1, operand1_len, operand2, operand2_len)
+		|| add_comparison_replacement(info, operand2, operand2_len, operand1, operand1_len);
 }
 
-MUTATORS_API int interesting_two_byte(mutate_info_t * info, mutate_buffer_t * buf)
+/**
+ * Adds the operands of a comparison that the target made while processing the input, so that
+ * the input-to-state stage can look for each operand in the input and replace it with the
+ * other one (as in RedQueen and AFL++'s cmplog).  The operands should be reported after the
+ * input is set and before the input-to-state stage starts.  They are not included in the
+ * mutator's saved state.
+ * @param info - the mutate_info_t to add the operands to
+ * @param operand1 - the first operand, as it was in the target's memory
+ * @param operand2 - the second operand, as it was in the target's memory
+ * @param length - the length of the operands.  Operands with a length of 2, 4, or 8 are treated
+ * as little-endian integers, and are also looked for as big-endian integers, in any smaller width
+ * that both operands fit in, and as decimal strings.  Longer operands (such as those of memcmp or
+ * strcmp) are looked for as they are, up to CMP_MAX_LENGTH bytes.
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int add_comparison_operands(mutate_info_t * info, const u8 * operand1, const u8 * operand2, size_t length)
 {
-	uint64_t index, round;
-	u16 old_value, new_value;
+	u8 big1[sizeof(u64)], big2[sizeof(u64)];
+	char ascii1[24], ascii2[24];
+	u64 value1 = 0, value2 = 0;
+	size_t width, i;
 
-	if (info->stage_cur >= 2 * (buf->length - 1) * ARRAY_SIZE(interesting_16) || buf->length < 2)
-		return MUTATOR_DONE;
+	if (length != 2 && length != 4 && length != 8)
+		return add_comparison_pair(info, operand1, MIN(length, CMP_MAX_LENGTH), operand2, MIN(length, CMP_MAX_LENGTH));
 
-	index = info->stage_cur / (2 * ARRAY_SIZE(interesting_16));
-	round = (info->stage_cur / ARRAY_SIZE(interesting_16)) % 2;
-	old_value = *(u16*)(buf->buffer + index);
-	new_value = interesting_16[info->stage_cur % ARRAY_SIZE(interesting_16)];
-	if (round) //second round, use reverse endian
-		new_value = SWAP16(new_value);
+	for (i = 0; i < length; i++)
+	{
+		value1 |= ((u64)operand1[i]) << (8 * i);
+		value2 |= ((u64)operand2[i]) << (8 * i);
+	}
 
-	/* Skip if this could be a product of a bitflip, arithmetics,
-	single-byte interesting value insertion, or if on the reverse endian
-	round and the value is the same in both endians */
-	if ((info->should_skip_previous &&
-		(could_be_bitflip(old_value ^ new_value)
-		|| could_be_arith(old_value, new_value, 2)
-		|| could_be_interest(old_value, new_value, 2, round)))
-		|| (round == 1 && new_value == SWAP16(new_value)))
-		return MUTATOR_TRY_AGAIN;
+	//Integers are often stored narrower in the input than they are compared at
+	for (width = length; width >= 2; width /= 2)
+	{
+		if (width < length && ((value1 | value2) >> (8 * width)))
+			break;
+		for (i = 0; i < width; i++)
+		{
+			big1[i] = operand1[width - 1 - i];
+			big2[i] = operand2[width - 1 - i];
+		}
+		if (add_comparison_pair(info, operand1, width, operand2, width)
+			|| ((memcmp(big1, operand1, width) || memcmp(big2, operand2, width)) && add_comparison_pair(info, big1, width, big2, width)))
+			return 1;
+	}
 
-	*(u16*)(buf->buffer + index) = new_value;
-	return (int)buf->length;
+	snprintf(ascii1, sizeof(ascii1), "%llu", (unsigned long long)value1);
+	snprintf(ascii2, sizeof(ascii2), "%llu", (unsigned long long)value2);
+	return add_comparison_pair(info, (u8 *)ascii1, strlen(ascii1), (u8 *)ascii2, strlen(ascii2));
 }
 
-MUTATORS_API int interesting_four_byte(mutate_info_t * info, mutate_buffer_t * buf)
+/**
+ * Removes the comparison operands added with add_comparison_operands.  This should be called
+ * whenever the input is changed to a different seed.
+ * @param info - the mutate_info_t to remove the operands from
+ */
+MUTATORS_API void clear_comparison_operands(mutate_info_t * info)
 {
-	uint64_t index, round;
-	u32 old_value, new_value;
-
-	if (info->stage_cur >= 2 * (buf->length - 3) * ARRAY_SIZE(interesting_32) || buf->length < 4)
-		return MUTATOR_DONE;
-
-	index = info->stage_cur / (2 * ARRAY_SIZE(interesting_32));
-	round = (info->stage_cur / ARRAY_SIZE(interesting_32)) % 2;
-	old_value = *(u32*)(buf->buffer + index);
-	new_value = interesting_32[info->stage_cur % ARRAY_SIZE(interesting_32)];
-	if (round) //second round, use reverse endian
-		new_value = SWAP32(new_value);
-
-	/* Skip if this could be a product of a bitflip, arithmetics,
-	single-byte interesting value insertion, or if on the reverse endian
-	round and the value is the same in both endians */
-	if ((info->should_skip_previous && 
-		(could_be_bitflip(old_value ^ new_value)
-		|| could_be_arith(old_value, new_value, 4)
-		|| could_be_interest(old_value, new_value, 4, round)))
-		|| (round == 1 && new_value == SWAP32(new_value)))
-		return MUTATOR_TRY_AGAIN;
+	free(info->cmp_replacements);
+	info->cmp_replacements = NULL;
+	info->cmp_replacements_count = 0;
+	info->cmp_replacements_max = 0;
+	token_matcher_free(info->cmp_matcher);
+	info->cmp_matcher = NULL;
+	free(info->cmp_matches);
+	info->cmp_matches = NULL;
+	info->cmp_matches_count = 0;
+	info->cmp_matches_valid = 0;
+}
 
-	*(u32*)(buf->buffer + index) = new_value;
-	return (int)buf->length;
+static int compare_replacements(const void * a, const void * b)
+{
+	const cmp_replacement_t * cmp_a = (const cmp_replacement_t *)a;
+	const cmp_replacement_t * cmp_b = (const cmp_replacement_t *)b;
+	if (cmp_a->pattern_len != cmp_b->pattern_len)
+		return cmp_a->pattern_len < cmp_b->pattern_len ? -1 : 1;
+	if (cmp_a->replacement_len != cmp_b->replacement_len)
+		return cmp_a->replacement_len < cmp_b->replacement_len ? -1 : 1;
+	return memcmp(cmp_a, cmp_b, 2 * CMP_MAX_LENGTH);
 }
 
-MUTATORS_API int dictionary_overwrite(mutate_info_t * info, mutate_buffer_t * buf)
+/* Removes the duplicate replacements, then finds every place that the comparison operands occur
+   in the input with a single pass of the multi-pattern matcher */
+static int index_comparison_matches(mutate_info_t * info, u8 * input, size_t input_length)
 {
-	uint64_t index;
-	string_t * dictionary_item;
+	size_t i, count = 0;
 
-	if (!info->dictionary_count || !info->dictq || info->stage_cur > buf->length * info->dictionary_count)
-		return MUTATOR_DONE;
+	token_matcher_free(info->cmp_matcher);
+	info->cmp_matcher = NULL;
+	free(info->cmp_matches);
+	info->cmp_matches = NULL;
+	info->cmp_matches_count = 0;
 
-	index = info->stage_cur / info->dictionary_count;
-	dictionary_item = info->dictq[info->stage_cur % info->dictionary_count];
+	if (info->cmp_replacements_count) {
+		qsort(info->cmp_replacements, info->cmp_replacements_count, sizeof(cmp_replacement_t), compare_replacements);
+		for (i = 0; i < info->cmp_replacements_count; i++)
+		{
+			if (!count || compare_replacements(&info->cmp_replacements[count - 1], &info->cmp_replacements[i]))
+				info->cmp_replacements[count++] = info->cmp_replacements[i];
+		}
+		info->cmp_replacements_count = count;
 
-	// Skip extras probabilistically if extras_cnt > MAX_DET_EXTRAS. Also
-	// skip if there's no room to insert the payload or if the token is redundant.
-	if ((info->dictionary_count > MAX_DET_EXTRAS && UR(info, info->dictionary_count) >= MAX_DET_EXTRAS)
-		|| dictionary_item->len > buf->max_length - index
-		|| !memcmp(dictionary_item->s, buf->buffer + index, dictionary_item->len))
-		return MUTATOR_TRY_AGAIN;
+		info->cmp_matcher = token_matcher_create();
+		if (!info->cmp_matcher)
+			return 1;
+		for (i = 0; i < info->cmp_replacements_count; i++)
+		{
+			if (token_matcher_add(info->cmp_matcher, info->cmp_replacements[i].pattern,
+					info->cmp_replacements[i].pattern_len, (uint32_t)i))
+				return 1;
+		}
+		if (token_matcher_scan(info->cmp_matcher, input, input_length, &info->cmp_matches, &info->cmp_matches_count))
+			return 1;
 
-	memcpy(buf->buffer + index, dictionary_item->s, dictionary_item->len);
-	buf->length = MAX(buf->length, index + dictionary_item->len);
-	return (int)buf->length;
+		//Only the operands in the offsets that the regions allow to be mutated are replaced
+		if (info->regions.enabled) {
+			if (region_map_update(&info->regions, input, input_length))
+				return 1;
+			for (i = count = 0; i < info->cmp_matches_count; i++)
+			{
+				if (region_map_contains(&info->regions, info->cmp_matches[i].offset,
+						info->cmp_replacements[info->cmp_matches[i].id].pattern_len))
+					info->cmp_matches[count++] = info->cmp_matches[i];
+			}
+			info->cmp_matches_count = count;
+		}
+	}
+	info->cmp_matches_valid = 1;
+	return 0;
 }
 
-MUTATORS_API int dictionary_insert(mutate_info_t * info, mutate_buffer_t * buf)
+/**
+ * Counts the mutations that the input-to-state stage will make to an input
+ * @param info - the mutate_info_t with the comparison operands to use
+ * @param input - the input that will be mutated
+ * @param input_length - the length of the input
+ * @return - the number of mutations, or -1 on failure
+ */
+MUTATORS_API int64_t count_input_to_state_candidates(mutate_info_t * info, u8 * input, size_t input_length)
 {
-	uint64_t index;
-	string_t * dictionary_item;
+	if (!info->cmp_matches_valid && index_comparison_matches(info, input, input_length))
+		return -1;
+	return (int64_t)info->cmp_matches_count;
+}
 
-	if (!info->dictionary_count || !info->dictq || info->stage_cur > buf->length * info->dictionary_count)
-		return MUTATOR_DONE;
+/* Replaces one occurrence of a comparison operand in the input with the value it was compared against */
+MUTATORS_API int input_to_state(mutate_info_t * info, mutate_buffer_t * buf)
+{
+	cmp_replacement_t * cmp;
+	token_match_t * match;
 
-	index = info->stage_cur / info->dictionary_count;
-	dictionary_item = info->dictq[info->stage_cur % info->dictionary_count];
+	// The buffer still holds the unmodified input at this point
+	if (!info->cmp_matches_valid && index_comparison_matches(info, buf->buffer, buf->length))
+		return MUTATOR_DONE;
+	if (info->stage_cur >= info->cmp_matches_count)
+		return MUTATOR_DONE;
 
-	// Skip extras probabilistically if extras_cnt > MAX_DET_EXTRAS. Also
-	// skip if there's no room to insert the payload or if the token is redundant.
-	if ((info->dictionary_count > MAX_DET_EXTRAS && UR(info, info->dictionary_count) >= MAX_DET_EXTRAS)
-		|| dictionary_item->len > buf->max_length - index
-		|| buf->length + dictionary_item->len > buf->max_length
-		|| !memcmp(dictionary_item->s, buf->buffer + index, dictionary_item->len))
+	match = &info->cmp_matches[info->stage_cur];
+	cmp = &info->cmp_replacements[match->id];
+	if (buf->length - cmp->pattern_len + cmp->replacement_len > buf->max_length)
 		return MUTATOR_TRY_AGAIN;
 
-	memmove(buf->buffer + index + dictionary_item->len, buf->buffer + index, buf->length - index);
-	memcpy(buf->buffer + index, dictionary_item->s, dictionary_item->len);
-	buf->length += dictionary_item->len;
+	// Decimal strings can change length, so the rest of the input is moved to make room
+	memmove(buf->buffer + match->offset + cmp->replacement_len, buf->buffer + match->offset + cmp->pattern_len,
+		buf->length - match->offset - cmp->pattern_len);
+	memcpy(buf->buffer + match->offset, cmp->replacement, cmp->replacement_len);
+	buf->length = buf->length - cmp->pattern_len + cmp->replacement_len;
 	return (int)buf->length;
 }
 
+/* Chooses a havoc operator with the scheduler, or with the havoc_weights when the scheduler isn't enabled */
+static uint32_t choose_havoc_operator(mutate_info_t * info, uint32_t num_operators)
+{
+	if (info->havoc_weights.enabled && !info->havoc_scheduler.enabled)
+		return operator_weights_choose(&info->havoc_weights, num_operators, rnd64(info));
+	return operator_scheduler_choose(&info->havoc_scheduler, num_operators, rnd64(info));
+}
+
 MUTATORS_API int havoc(mutate_info_t * info, mutate_buffer_t * buf)
 {
 	uint64_t use_stacking, i;
-	u32 pos, num32, del_from, del_len, insert_at, use_extra;
+	u32 pos, num32, dword, del_from, del_len, insert_at, use_extra;
 	u32 copy_from, copy_to, copy_len;
 	u32 clone_from, clone_to, clone_len;
-	u16 num16;
-	u8  actually_clone;
-	string_t * dictionary_item;
+	u16 num16, word;
+	u8  num8, actually_clone;
+	string_t dictionary_item;
+	size_t original_length = buf->length;
+	edit_plan_t * plan = &info->plan;
+	int editing_regions = info->regions.enabled && !info->regions.editing;
+
+	// The stacked edits are recorded in a piece table and written to the buffer once at
+	// the end, so that large buffers don't have their tail moved for every insertion and
+	// deletion.  Each edit is recorded as the memmove/memset it replaces, so the output
+	// (and the random numbers used) are the same as editing the buffer directly.
+	// The offsets that are written to are chosen with choose_mutable_position, so they follow the
+	// position weights and regions; the offsets that bytes are copied from are still chosen uniformly.
+	// The regions follow the insertions and deletions, so the later edits still avoid the bytes
+	// that can't be mutated (which are moved, but never changed).
+	if (editing_regions && region_map_begin_edit(&info->regions))
+		return MUTATOR_TRY_AGAIN;
+	edit_plan_begin(plan, buf->buffer, buf->max_length, buf->length < EDIT_PLAN_MIN_LENGTH);
 
 	use_stacking = 1ULL << (1 + UR(info, HAVOC_STACK_POW2));
 	for (i = 0; i < use_stacking; i++)
 	{
-		switch (UR(info, 15 + (info->dictionary_count ? 2 : 0)))
+		if (info->edit_trace.enabled) //Record each operation separately, so it can be reverted when minimizing
+			edit_trace_begin_op(&info->edit_trace, plan, buf->length);
+		switch (choose_havoc_operator(info, HAVOC_BASE_OPERATORS + (info->dictionary.count ? 2 : 0)))
 		{
 		case 0: // Flip a single bit somewhere. Spooky!
-			FLIP_BIT(buf->buffer, UR(info, buf->length << 3));
+			if (choose_bit_position(info, buf->length, &pos))
+				break;
+			edit_plan_set(plan, pos >> 3, edit_plan_get(plan, pos >> 3) ^ (128 >> (pos & 7)));
 			break;
 
 		case 1: // Set byte to interesting value.
-			buf->buffer[UR(info, buf->length)] = interesting_8[UR(info, sizeof(interesting_8))];
+			num8 = interesting_8[UR(info, sizeof(interesting_8))];
+			if (choose_mutable_position(info, 0, buf->length, 1, &pos))
+				break;
+			edit_plan_set(plan, pos, num8);
 			break;
 
 		case 2: // Set word to interesting value, randomly choosing endian.
 			if (buf->length < 2)
 				break;
 
-			if (UR(info, 2)) {
-				*(u16*)(buf->buffer + UR(info, buf->length - 1)) =
-					interesting_16[UR(info, sizeof(interesting_16) >> 1)];
-			}
-			else {
-				*(u16*)(buf->buffer + UR(info, buf->length - 1)) =
-					SWAP16(interesting_16[UR(info, sizeof(interesting_16) >> 1)]);
-			}
+			if (UR(info, 2))
+				num16 = interesting_16[UR(info, sizeof(interesting_16) >> 1)];
+			else
+				num16 = SWAP16(interesting_16[UR(info, sizeof(interesting_16) >> 1)]);
+			if (choose_mutable_position(info, 0, buf->length - 1, 2, &pos))
+				break;
+			edit_plan_write(plan, pos, &num16, sizeof(num16));
 			break;
 
 		case 3: // Set dword to interesting value, randomly choosing endian.
 			if (buf->length < 4)
 				break;
 
-			if (UR(info, 2)) {
-				*(u32*)(buf->buffer + UR(info, buf->length - 3)) =
-					interesting_32[UR(info, sizeof(interesting_32) >> 2)];
-			}
-			else {
-				*(u32*)(buf->buffer + UR(info, buf->length - 3)) =
-					SWAP32(interesting_32[UR(info, sizeof(interesting_32) >> 2)]);
-			}
+			if (UR(info, 2))
+				num32 = interesting_32[UR(info, sizeof(interesting_32) >> 2)];
+			else
+				num32 = SWAP32(interesting_32[UR(info, sizeof(interesting_32) >> 2)]);
+			if (choose_mutable_position(info, 0, buf->length - 3, 4, &pos))
+				break;
+			edit_plan_write(plan, pos, &num32, sizeof(num32));
 			break;
 
 		case 4: // Randomly subtract from byte.
-			buf->buffer[UR(info, buf->length)] -= 1 + UR(info, ARITH_MAX);
+			num8 = 1 + UR(info, ARITH_MAX);
+			if (choose_mutable_position(info, 0, buf->length, 1, &pos))
+				break;
+			edit_plan_set(plan, pos, edit_plan_get(plan, pos) - num8);
 			break;
 
 		case 5: // Randomly add to byte.
-			buf->buffer[UR(info, buf->length)] += 1 + UR(info, ARITH_MAX);
+			num8 = 1 + UR(info, ARITH_MAX);
+			if (choose_mutable_position(info, 0, buf->length, 1, &pos))
+				break;
+			edit_plan_set(plan, pos, edit_plan_get(plan, pos) + num8);
 			break;
 
 		case 6: // Randomly subtract from word, random endian.
 			if (buf->length < 2)
 				break;
 
-			pos = UR(info, buf->length - 1);
+			if (choose_mutable_position(info, 0, buf->length - 1, 2, &pos))
+				break;
 			num16 = 1 + UR(info, ARITH_MAX);
+			edit_plan_read(plan, pos, &word, sizeof(word));
 			if (UR(info, 2))
-				*(u16*)(buf->buffer + pos) -= num16;
+				word -= num16;
 			else
-				*(u16*)(buf->buffer + pos) = SWAP16(SWAP16(*(u16*)(buf->buffer + pos)) - num16);
+				word = SWAP16(SWAP16(word) - num16);
+			edit_plan_write(plan, pos, &word, sizeof(word));
 			break;
 
 		case 7: // Randomly add to word, random endian.
 			if (buf->length < 2)
 				break;
 
-			pos = UR(info, buf->length - 1);
+			if (choose_mutable_position(info, 0, buf->length - 1, 2, &pos))
+				break;
 			num16 = 1 + UR(info, ARITH_MAX);
+			edit_plan_read(plan, pos, &word, sizeof(word));
 			if (UR(info, 2))
-				*(u16*)(buf->buffer + pos) += num16;
+				word += num16;
 			else
-				*(u16*)(buf->buffer + pos) = SWAP16(SWAP16(*(u16*)(buf->buffer + pos)) + num16);
+				word = SWAP16(SWAP16(word) + num16);
+			edit_plan_write(plan, pos, &word, sizeof(word));
 			break;
 
 		case 8: // Randomly subtract from dword, random endian.
 			if (buf->length < 4)
 				break;
 
-			pos = UR(info, buf->length - 3);
+			if (choose_mutable_position(info, 0, buf->length - 3, 4, &pos))
+				break;
 			num32 = 1 + UR(info, ARITH_MAX);
+			edit_plan_read(plan, pos, &dword, sizeof(dword));
 			if (UR(info, 2))
-				*(u32*)(buf->buffer + pos) -= num32;
+				dword -= num32;
 			else
-				*(u32*)(buf->buffer + pos) = SWAP32(SWAP32(*(u32*)(buf->buffer + pos)) - num32);
+				dword = SWAP32(SWAP32(dword) - num32);
+			edit_plan_write(plan, pos, &dword, sizeof(dword));
 			break;
 
 		case 9: // Randomly add to dword, random endian.
 			if (buf->length < 4)
 				break;
 
-			pos = UR(info, buf->length - 3);
+			if (choose_mutable_position(info, 0, buf->length - 3, 4, &pos))
+				break;
 			num32 = 1 + UR(info, ARITH_MAX);
+			edit_plan_read(plan, pos, &dword, sizeof(dword));
 			if (UR(info, 2))
-				*(u32*)(buf->buffer + pos) += num32;
+				dword += num32;
 			else
-				*(u32*)(buf->buffer + pos) = SWAP32(SWAP32(*(u32*)(buf->buffer + pos)) + num32);
+				dword = SWAP32(SWAP32(dword) + num32);
+			edit_plan_write(plan, pos, &dword, sizeof(dword));
 			break;
 
 		case 10:
 			/* Just set a random byte to a random value. Because,
 			why not. We use XOR with 1-255 to eliminate the
 			possibility of a no-op. */
-			buf->buffer[UR(info, buf->length)] ^= 1 + UR(info, 255);
+			num8 = 1 + UR(info, 255);
+			if (choose_mutable_position(info, 0, buf->length, 1, &pos))
+				break;
+			edit_plan_set(plan, pos, edit_plan_get(plan, pos) ^ num8);
 			break;
 
 		case 11:
@@ -1321,10 +2801,11 @@ MUTATORS_API int havoc(mutate_info_t * info, mutate_buffer_t * buf)
 				break;
 
 			del_len = choose_block_len(info, buf->length - 1);
-			del_from = UR(info, buf->length - del_len + 1);
-			memmove(buf->buffer + del_from, buf->buffer + del_from + del_len,
-				buf->length - del_from - del_len);
+			if (choose_mutable_position(info, 0, buf->length - del_len + 1, del_len, &del_from))
+				break;
+			edit_plan_move(plan, del_from + del_len, del_from, buf->length - del_from - del_len);
 			buf->length -= del_len;
+			region_map_edit(&info->regions, del_from, del_len, 0);
 			break;
 
 		case 13: //Clone bytes (75%) or insert a block of constant bytes (25%).
@@ -1343,14 +2824,17 @@ MUTATORS_API int havoc(mutate_info_t * info, mutate_buffer_t * buf)
 				clone_from = 0;
 			}
 
-			clone_to = UR(info, buf->length);
-			memmove(buf->buffer + clone_to + clone_len, buf->buffer + clone_to, buf->length - clone_to);
+			if (choose_mutable_position(info, 0, buf->length, 0, &clone_to))
+				break;
+			edit_plan_move(plan, clone_to, clone_to + clone_len, buf->length - clone_to);
 			if (actually_clone)
-				memmove(buf->buffer + clone_to, buf->buffer + clone_from, clone_len);
-			else
-				memset(buf->buffer + clone_to,
-					UR(info, 2) ? UR(info, 256) : buf->buffer[UR(info, buf->length)], clone_len);
+				edit_plan_move(plan, clone_from, clone_to, clone_len);
+			else {
+				num8 = UR(info, 2) ? UR(info, 256) : edit_plan_get(plan, UR(info, buf->length));
+				edit_plan_fill(plan, clone_to, num8, clone_len);
+			}
 			buf->length += clone_len;
+			region_map_edit(&info->regions, clone_to, 0, clone_len);
 			break;
 
 		case 14: // Overwrite bytes with a randomly selected chunk (75%) or fixed bytes (25%).
@@ -1359,70 +2843,190 @@ MUTATORS_API int havoc(mutate_info_t * info, mutate_buffer_t * buf)
 
 			copy_len = choose_block_len(info, buf->length - 1);
 			copy_from = UR(info, buf->length - copy_len + 1);
-			copy_to = UR(info, buf->length - copy_len + 1);
+			if (choose_mutable_position(info, 0, buf->length - copy_len + 1, copy_len, &copy_to))
+				break;
 
-			if (!UR(info, 4))
-				memset(buf->buffer + copy_to,
-					UR(info, 2) ? UR(info, 256) : buf->buffer[UR(info, buf->length)], copy_len);
+			if (!UR(info, 4)) {
+				num8 = UR(info, 2) ? UR(info, 256) : edit_plan_get(plan, UR(info, buf->length));
+				edit_plan_fill(plan, copy_to, num8, copy_len);
+			}
 			else if (copy_from != copy_to)
-				memmove(buf->buffer + copy_to, buf->buffer + copy_from, copy_len);
+				edit_plan_move(plan, copy_from, copy_to, copy_len);
 			break;
 
 		case 15: // Overwrite bytes with a dictionary item
-			use_extra = UR(info, info->dictionary_count);
-			dictionary_item = info->dictq[use_extra];
+			use_extra = (u32)token_scorer_choose(&info->dictionary_scorer, info->dictionary.count, rnd64(info));
+			dictionary_item = dictionary_token(info, use_extra);
 
-			if (dictionary_item->len > buf->length)
+			if (dictionary_item.len > buf->length)
 				break;
 
-			insert_at = UR(info, buf->length - dictionary_item->len + 1);
-			memcpy(buf->buffer + insert_at, dictionary_item->s, dictionary_item->len);
+			if (choose_mutable_position(info, 0, buf->length - dictionary_item.len + 1, dictionary_item.len, &insert_at))
+				break;
+			edit_plan_write(plan, insert_at, dictionary_item.s, dictionary_item.len);
+			token_scorer_use(&info->dictionary_scorer, use_extra);
 			break;
 
 		case 16: // Insert an extra. Do the same dice-rolling stuff as for the previous case.
-			insert_at = UR(info, buf->length + 1);
-			use_extra = UR(info, info->dictionary_count);
-			dictionary_item = info->dictq[use_extra];
+			if (choose_mutable_position(info, 0, buf->length + 1, 0, &insert_at))
+				break;
+			use_extra = (u32)token_scorer_choose(&info->dictionary_scorer, info->dictionary.count, rnd64(info));
+			dictionary_item = dictionary_token(info, use_extra);
 
-			if (buf->length + dictionary_item->len >= buf->max_length)
+			if (buf->length + dictionary_item.len >= buf->max_length)
 				break;
 
-			memmove(buf->buffer + insert_at + dictionary_item->len, buf->buffer + insert_at,
-				buf->length - insert_at);
-			memcpy(buf->buffer + insert_at, dictionary_item->s, dictionary_item->len);
-			buf->length += dictionary_item->len;
+			edit_plan_move(plan, insert_at, insert_at + dictionary_item.len, buf->length - insert_at);
+			edit_plan_write(plan, insert_at, dictionary_item.s, dictionary_item.len);
+			buf->length += dictionary_item.len;
+			region_map_edit(&info->regions, insert_at, 0, dictionary_item.len);
+			token_scorer_use(&info->dictionary_scorer, use_extra);
 			break;
 		}
+		if (info->edit_trace.enabled)
+			edit_trace_end_op(&info->edit_trace, plan, buf->length);
 	}
-
+	if (editing_regions)
+		region_map_end_edit(&info->regions);
+
+	// The buffer isn't touched until the plan is committed, so if recording any of
+	// the edits failed the original buffer can be tried again.  If it keeps failing,
+	// the stage ends rather than retrying forever.
+	if (edit_plan_commit(plan)) {
+		buf->length = original_length;
+		if (++info->plan_failures <= EDIT_PLAN_MAX_RETRIES)
+			return MUTATOR_TRY_AGAIN;
+		info->plan_failures = 0;
+		return MUTATOR_DONE;
+	}
+	info->plan_failures = 0;
 	return (int)buf->length;
 }
 
+/**
+ * Finds the first and last offsets where each of the splice files differs from the input,
+ * and keeps the splice files that can be spliced with the input (i.e. the ones that differ
+ * from it in more than one place), so that splice_buffers doesn't need to search for one.
+ * This should be called whenever the input or the splice files change.  If it isn't,
+ * splice_buffers will call it with the buffer it is given the first time it needs it.
+ * @param info - the mutate_info_t with the splice files to index
+ * @param input - the input that will be spliced
+ * @param input_length - the length of the input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int index_splice_files(mutate_info_t * info, u8 * input, size_t input_length)
+{
+	uint64_t i, num_seeds = seed_pool_other_count(&info->seed_pool);
+	s32 f_diff, l_diff;
+	u8 * target;
+	size_t target_len;
+
+	free(info->splice_partners);
+	info->splice_partners = NULL;
+	info->splice_partners_count = 0;
+	info->splice_partners_valid = 0;
+
+	if (info->splice_files_count + num_seeds) {
+		info->splice_partners = (splice_partner_t *)malloc(sizeof(splice_partner_t) * (info->splice_files_count + num_seeds));
+		if (!info->splice_partners)
+			return 1;
+	}
+
+	//The other seeds in the seed pool are spliced with after the splice files
+	for (i = 0; i < info->splice_files_count + num_seeds; i++)
+	{
+		if (i < info->splice_files_count) {
+			target = info->splice_files[i]->s;
+			target_len = info->splice_files[i]->len;
+		}
+		else
+			target = (u8 *)seed_pool_other_seed(&info->seed_pool, i - info->splice_files_count, &target_len);
+		locate_diffs(input, target, MIN(input_length, target_len), &f_diff, &l_diff);
+		if (f_diff < 0 || l_diff < 2 || f_diff == l_diff)
+			continue;
+
+		info->splice_partners[info->splice_partners_count].s = target;
+		info->splice_partners[info->splice_partners_count].len = target_len;
+		info->splice_partners[info->splice_partners_count].first_diff = f_diff;
+		info->splice_partners[info->splice_partners_count].last_diff = l_diff;
+		info->splice_partners_count++;
+	}
+	info->splice_partners_valid = 1;
+	return 0;
+}
+
+/**
+ * Chooses one of the splice partners that fit in the buffer, for when the one that was chosen
+ * doesn't fit
+ * @param info - the mutate_info_t with the splice partners
+ * @param max_length - the size of the buffer
+ * @return - the chosen splice partner, or NULL if none of them fit
+ */
+static splice_partner_t * choose_fitting_splice_partner(mutate_info_t * info, size_t max_length)
+{
+	size_t i;
+	u32 fitting = 0, choice;
+
+	for (i = 0; i < info->splice_partners_count; i++)
+		fitting += info->splice_partners[i].len <= max_length;
+	if (!fitting)
+		return NULL;
+	choice = UR(info, fitting);
+	for (i = 0; info->splice_partners[i].len > max_length || choice--; i++);
+	return &info->splice_partners[i];
+}
+
 MUTATORS_API int splice_buffers(mutate_info_t * info, mutate_buffer_t * buf)
 {
-	string_t * target = NULL;
-	u32 attempts = 0, split_at;
-	s32 f_diff = -1, l_diff = -1;
+	splice_partner_t * partner;
+	const region_range_t * range;
+	u32 split_at, splice_end, kept_length = 0;
+	int ret;
 
 	// Splicing takes the current input file, randomly selects another input, and
 	// splices them together at some offset, then relies on the havoc code to mutate that blob.
-	if (info->splice_files_count == 0)
+	if (info->splice_files_count == 0 && seed_pool_other_count(&info->seed_pool) == 0)
+		return MUTATOR_DONE;
+
+	// The buffer still holds the unmodified input at this point
+	if (!info->splice_partners_valid && index_splice_files(info, buf->buffer, buf->length))
+		return MUTATOR_TRY_AGAIN;
+	if (info->splice_partners_count == 0) //None of the splice files can be spliced with the input
 		return MUTATOR_DONE;
 
 	//Pick a target to splice with
-	while (target == NULL || ((f_diff < 0 || l_diff < 2 || f_diff == l_diff) && (attempts < 2 * info->splice_files_count)))
-	{
-		attempts++;
-		target = info->splice_files[UR(info, info->splice_files_count)];
-		locate_diffs(buf->buffer, target->s, MIN(buf->length, target->len), &f_diff, &l_diff);
+	partner = &info->splice_partners[UR(info, (u32)info->splice_partners_count)];
+	if (partner->len > buf->max_length) { //The seeds in the seed pool can be larger than the buffer
+		partner = choose_fitting_splice_partner(info, buf->max_length);
+		if (!partner) //None of them fit, so every try would fail the same way
+			return MUTATOR_DONE;
 	}
-	if (f_diff < 0 || l_diff < 2 || f_diff == l_diff)
-		return MUTATOR_TRY_AGAIN;
 
-	// Split somewhere between the first and last differing byte.
-	split_at = f_diff + UR(info, l_diff - f_diff);
+	// Split somewhere between the first and last differing byte.  If the regions don't allow any
+	// of those bytes to be mutated, the input is just havoced.
+	if (choose_mutable_position(info, partner->first_diff, partner->last_diff, 1, &split_at))
+		return havoc(info, buf);
+	splice_end = (u32)partner->len;
+
+	// If the input's bytes after the split's region can't be mutated, only the rest of the region is
+	// spliced, and the input's length is kept.  The havoc edits stacked on the splice use the same regions.
+	if (info->regions.enabled) {
+		if (region_map_begin_edit(&info->regions))
+			return MUTATOR_TRY_AGAIN;
+		range = region_map_find(&info->regions, split_at);
+		if (range->end < buf->length) {
+			splice_end = MIN((u32)range->end, (u32)partner->len);
+			kept_length = (u32)buf->length - splice_end;
+		}
+		else
+			region_map_edit(&info->regions, split_at, buf->length - split_at, partner->len - split_at);
+	}
 
-	buf->length = target->len;
-	memcpy(buf->buffer + split_at, target->s + split_at, target->len - split_at);
-	return havoc(info, buf);
+	if (info->edit_trace.enabled) //The splice is one operation, and the havoc operations stacked on it are the rest
+		edit_trace_add(&info->edit_trace, split_at, buf->length - split_at - kept_length, partner->s + split_at, splice_end - split_at);
+	buf->length = splice_end + kept_length;
+	memcpy(buf->buffer + split_at, partner->s + split_at, splice_end - split_at);
+	ret = havoc(info, buf);
+	region_map_end_edit(&info->regions);
+	return ret;
 }
@@ -2,6 +2,19 @@
 
 #include "mutators.h"
 #include "afl_types.h"
+#include "edit_plan.h"
+#include "edit_trace.h"
+#include "token_dictionary.h"
+#include "token_matcher.h"
+#include "operator_scheduler.h"
+#include "operator_weights.h"
+#include "token_scorer.h"
+#include "position_sampler.h"
+#include "region_map.h"
+#include "fixup.h"
+#include "output_filter.h"
+#include "seed_pool.h"
+#include "provenance_log.h"
 
 #include <utils.h>
 #include <jansson_helper.h>
@@ -11,26 +24,116 @@ typedef struct {
 	size_t len;
 } string_t;
 
+//A splice file (or another seed in the seed pool) that can be spliced with the current input
+typedef struct {
+	u8 * s;
+	size_t len;
+	u32 first_diff; //The first offset where the file differs from the input
+	u32 last_diff;  //The last offset where the file differs from the input
+} splice_partner_t;
+
+//The position of a deterministic dictionary stage in its list of useful candidates
+typedef struct {
+	int valid;
+	int insert;        //Whether the cursor is for dictionary_insert or dictionary_overwrite
+	size_t max_length; //The buffer size that the candidates were chosen for
+	uint64_t rank;     //The number of candidates before the cursor
+	size_t offset;     //The offset the cursor is at
+	size_t token;      //The index of the cursor in the offset's tokens
+	size_t match;      //The first entry of dictionary_matches at or after offset
+} dictionary_cursor_t;
+
+//The longest comparison operand that the input-to-state stage will look for in the input
+#define CMP_MAX_LENGTH 32
+
+//A comparison operand to look for in the input, and the other operand to replace it with
+typedef struct {
+	u8 pattern[CMP_MAX_LENGTH];
+	u8 replacement[CMP_MAX_LENGTH];
+	u8 pattern_len;
+	u8 replacement_len;
+} cmp_replacement_t;
+
+//The power schedules that can be used to compute perf_score from the seed's statistics
+enum {
+	POWER_SCHEDULE_NONE,    //perf_score is only set by the perf_score option
+	POWER_SCHEDULE_EXPLORE, //AFL's score, based on the seed's speed, coverage, and depth
+	POWER_SCHEDULE_FAST,    //Favors seeds that exercise rare paths, doubling each time the seed is fuzzed
+	POWER_SCHEDULE_COE,     //Like fast, but seeds on paths exercised more than average get no energy
+	POWER_SCHEDULE_EXPLOIT, //AFL's score multiplied by MAX_FACTOR
+	POWER_SCHEDULE_LIN,     //Grows linearly with the number of times the seed has been fuzzed
+	POWER_SCHEDULE_QUAD,    //Grows quadratically with the number of times the seed has been fuzzed
+};
+
+//Statistics about the seed being mutated, as tracked by the caller's queue
+typedef struct {
+	uint64_t exec_us;            //The time it takes to run the seed, in microseconds
+	uint64_t avg_exec_us;        //The average time it takes to run the seeds in the queue
+	uint64_t bitmap_size;        //The number of coverage entries that the seed hits
+	uint64_t avg_bitmap_size;    //The average number of coverage entries that the seeds in the queue hit
+	uint64_t depth;              //The number of mutations between this seed and one of the initial seeds
+	uint64_t handicap;           //The number of queue cycles that were done before the seed was found
+	uint64_t fuzz_level;         //The number of times the seed has been fuzzed
+	uint64_t path_frequency;     //The number of executions that exercised the seed's path
+	uint64_t avg_path_frequency; //The average path_frequency of the seeds in the queue
+	uint64_t new_paths;          //The number of new paths found while fuzzing the seed
+} seed_stats_t;
+
 typedef struct {
 	uint8_t * buffer;
 	size_t length;
 	size_t max_length;
 } mutate_buffer_t;
 
+//The progress through one of the seeds in the seed pool, saved while another seed is selected
+typedef struct {
+	int stage;
+	uint64_t stage_cur;
+	int queue_cycle;
+	int havoc_div;
+	int perf_score;
+	seed_stats_t seed_stats;
+	u32 trim_remove_len;
+	u32 trim_remove_pos;
+	u32 trim_pending_pos;
+	u32 trim_pending_len;
+} mutate_info_progress_t;
+
 typedef struct {
 	int should_skip_previous;
 	int one_stage_only;
+	uint64_t random_stages;  //A bit for each of the stages whose outputs are random, so duplicate outputs are replaced
 	int havoc_div;
 	int perf_score;
+	int power_schedule;      //One of the POWER_SCHEDULE_* values
+	seed_stats_t seed_stats; //The statistics that the power schedule computes perf_score from
+
+	uint64_t memory_limit;       //The most bytes that the dictionary, splice files, and seed pool can hold, or 0 for no limit
+	uint64_t splice_files_bytes; //The bytes held by the splice files
 
 	char * dictionary_file;
-	uint64_t dictionary_count;
-	string_t ** dictq;
+	char * save_dictionary_file; //Where to write the loaded dictionary as a compiled dictionary file
+	token_dictionary_t dictionary;
+	size_t dictionary_max_token_length;
+	token_matcher_t * dictionary_matcher; //Finds the dictionary tokens in the input
+	token_match_t * dictionary_matches;  //Where the dictionary tokens already occur in the input
+	size_t dictionary_matches_count;
+	size_t dictionary_input_length;
+	int dictionary_matches_valid; //Whether dictionary_matches has been computed for the current input
+	size_t dictionary_max_length; //The size of the last buffer given to a dictionary stage
+	dictionary_cursor_t dictionary_cursor;
+	token_scorer_t dictionary_scorer; //Learns which dictionary tokens find new coverage
+	uint32_t * dictionary_order; //The tokens from best to worst score, when the deterministic stages use the scores
+	uint32_t * dictionary_rank;  //The position of each token in dictionary_order
 
 	char ** splice_filenames;
 	size_t splice_filenames_count;
 	uint64_t splice_files_count;
 	string_t ** splice_files;
+	splice_partner_t * splice_partners; //The splice files that can be spliced with the input
+	uint64_t splice_partners_count;
+	int splice_partners_valid; //Whether splice_partners has been computed for the current input
+	seed_pool_t seed_pool; //The seeds that can be selected instead of the input, which are also spliced with it
 
 	//Used to protects the fields below, as well as any non-thread safe fields in
 	mutex_t mutate_mutex; //the mutator-specific state (such as the iteration)
@@ -40,32 +143,111 @@ typedef struct {
 	int stage; //The current mutation stage, an index into the mutation functions passed to mutate_one
 	int queue_cycle;
 
+	//The effector map, built from the results of the walking_byte stage.  Each entry is set if
+	//flipping a byte in that 2^EFF_MAP_SCALE2 byte block of the input changed the execution.
+	u8 * eff_map;
+	u8 * eff_reported;       //A bitmap of the bytes whose walking_byte result has been reported
+	size_t eff_input_length; //The length of the input that the effector map is for
+	size_t eff_reported_count;
+	size_t eff_count;        //The number of entries set in eff_map
+	uint64_t eff_checksum;   //The execution checksum of the unmodified input
+	int eff_has_checksum;
+
+	//The progress of the trimming stage
+	u32 trim_remove_len;  //The size of the blocks being removed, or 0 if the stage hasn't started
+	u32 trim_remove_pos;  //The offset of the next block to try removing
+	u32 trim_pending_pos; //The block removed by the last trim_input output, until it's accepted
+	u32 trim_pending_len;
+
+	//The comparison operands for the input-to-state stage, in each of the encodings they're looked for in
+	cmp_replacement_t * cmp_replacements;
+	size_t cmp_replacements_count;
+	size_t cmp_replacements_max;
+	token_matcher_t * cmp_matcher; //Finds the operands in the input
+	token_match_t * cmp_matches;   //Where the operands occur in the input
+	size_t cmp_matches_count;
+	int cmp_matches_valid; //Whether cmp_matcher and cmp_matches are up to date
+
+	char * position_weights_file;
+	position_sampler_t positions; //Chooses the offsets that havoc and splicing mutate
+	char * regions_string;
+	char * protect_bytes_string;
+	region_map_t regions; //The offsets of the input that the stages are allowed to mutate
+	fixup_list_t fixups;  //The checksums and length fields that are recomputed in each output
+	output_filter_t dedup; //The outputs that have already been returned, so they aren't returned again
+	u8 * dedup_input;      //A copy of the input, to restore the buffer from when a duplicate is replaced
+	size_t dedup_input_max;
+
+	edit_plan_t plan; //Scratch storage used to record the havoc edits
+	int plan_failures; //The number of havoc rounds in a row whose edit plan couldn't be committed
+	edit_trace_t edit_trace; //Records the stacked havoc operations while an output is being minimized
+	operator_scheduler_t havoc_scheduler; //Chooses the havoc operators
+	operator_weights_t havoc_weights;     //The user-given weights of the havoc operators, used when the scheduler isn't enabled
+
+	int provenance_log_size;         //The number of outputs to keep provenance records for, 0 to not keep any
+	provenance_log_t provenance;     //The provenance records of the recent outputs
+	mutate_provenance_t provenance_pending; //The record of the output being generated, until it's finished
+	int provenance_pending_valid;
+
 } mutate_info_t;
 
 MUTATORS_API u32 UR(mutate_info_t * info, u32 limit);
 MUTATORS_API int load_dictionary(mutate_info_t * info, char * path);
 MUTATORS_API int load_splice_files(mutate_info_t * info, char ** splice_filenames, size_t splice_filenames_count);
+MUTATORS_API int index_splice_files(mutate_info_t * info, u8 * input, size_t input_length);
+MUTATORS_API int index_dictionary_matches(mutate_info_t * info, u8 * input, size_t input_length);
+MUTATORS_API int set_mutate_info_input(mutate_info_t * info, u8 * input, size_t input_length);
+MUTATORS_API int reset_effector_map(mutate_info_t * info, size_t input_length);
+MUTATORS_API int report_input_checksum(mutate_info_t * info, size_t input_length, uint64_t checksum);
+MUTATORS_API int report_walking_byte_result(mutate_info_t * info, size_t input_length, size_t pos, uint64_t checksum);
+MUTATORS_API int accept_trim(mutate_info_t * info, u32 * pos, u32 * length);
+MUTATORS_API int add_comparison_operands(mutate_info_t * info, const u8 * operand1, const u8 * operand2, size_t length);
+MUTATORS_API void clear_comparison_operands(mutate_info_t * info);
+MUTATORS_API int64_t count_input_to_state_candidates(mutate_info_t * info, u8 * input, size_t input_length);
+MUTATORS_API uint64_t count_mutable_positions(mutate_info_t * info, u8 * input, size_t input_length, size_t width, int bits);
+MUTATORS_API int locate_mutable_position(mutate_info_t * info, u8 * input, size_t input_length, uint64_t index,
+	size_t width, int bits, uint64_t * pos);
+MUTATORS_API int64_t count_dictionary_candidates(mutate_info_t * info, u8 * input, size_t input_length, int insert, size_t max_length);
+MUTATORS_API int get_power_schedule_from_options(mutate_info_t * info, char * options);
+MUTATORS_API int get_havoc_weights_from_options(mutate_info_t * info, char * options);
+MUTATORS_API int set_mutate_info_seed_stats(mutate_info_t * info, char * stats);
+MUTATORS_API int add_mutate_info_seed(mutate_info_t * info, char * input, size_t input_length, int stage);
+MUTATORS_API int remove_mutate_info_seed(mutate_info_t * info, int id);
+MUTATORS_API int select_mutate_info_seed(mutate_info_t * info, int id, char ** input, size_t * input_length);
 MUTATORS_API int reset_mutate_info(mutate_info_t * info);
 MUTATORS_API void cleanup_mutate_info(mutate_info_t * info);
-MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info);
-MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info);
+MUTATORS_API void add_mutate_info_memory_usage(mutate_info_t * info, memory_usage_t * usage);
+MUTATORS_API void finish_mutate_info_output(mutate_info_t * info, int iteration);
+MUTATORS_API void report_mutate_info_result(mutate_info_t * info, int iteration, uint64_t flags);
+MUTATORS_API int add_mutate_info_to_json(json_t * obj, mutate_info_t * info, const char * input, size_t input_length);
+MUTATORS_API int get_mutate_info_from_json(char * state, mutate_info_t * info, char ** input, size_t * input_length);
+MUTATORS_API int regenerate_mutate_info_output(mutate_info_t * info, const mutate_provenance_t * record, mutate_buffer_t * buf,
+	int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs);
+MUTATORS_API int minimize_mutate_info_output(mutate_info_t * info, const mutate_provenance_t * record, mutate_buffer_t * buf,
+	const u8 * output, size_t output_length, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs,
+	edit_trace_verdict_t verdict, void * context);
 MUTATORS_API int mutate_one(mutate_info_t * info, mutate_buffer_t * buf, int(*const*mutate_funcs)(mutate_info_t *, mutate_buffer_t *), size_t num_funcs);
 
 //Individual mutation functions
+MUTATORS_API int trim_input(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int single_walking_bit(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int two_walking_bit(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int four_walking_bit(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int walking_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int two_walking_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int four_walking_byte(mutate_info_t * info, mutate_buffer_t * buf);
+MUTATORS_API int eight_walking_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int one_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int two_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int four_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf);
+MUTATORS_API int eight_byte_arithmetics(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int interesting_one_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int interesting_two_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int interesting_four_byte(mutate_info_t * info, mutate_buffer_t * buf);
+MUTATORS_API int interesting_eight_byte(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int dictionary_overwrite(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int dictionary_insert(mutate_info_t * info, mutate_buffer_t * buf);
+MUTATORS_API int input_to_state(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int havoc(mutate_info_t * info, mutate_buffer_t * buf);
 MUTATORS_API int splice_buffers(mutate_info_t * info, mutate_buffer_t * buf);
 
@@ -85,8 +267,27 @@ MUTATORS_API int splice_buffers(mutate_info_t * info, mutate_buffer_t * buf);
 	PARSE_OPTION_INT_TEMP(state, options, info.queue_cycle, "queue_cycle", cleanup_func, queue_cycle);                                 \
 	PARSE_OPTION_INT_TEMP(state, options, info.havoc_div, "havoc_div", cleanup_func, havoc_div);                                       \
 	PARSE_OPTION_INT_TEMP(state, options, info.perf_score, "perf_score", cleanup_func, perf_score);                                    \
+	PARSE_OPTION_INT_TEMP(state, options, info.havoc_scheduler.enabled, "scheduler", cleanup_func, scheduler);                         \
+	PARSE_OPTION_INT_TEMP(state, options, info.dictionary_scorer.enabled, "dictionary_scores", cleanup_func, dictionary_scores);       \
+	PARSE_OPTION_UINT64T_TEMP(state, options, info.memory_limit, "memory_limit", cleanup_func, memory_limit);                          \
 	PARSE_OPTION_STRING_TEMP(state, options, info.dictionary_file, "dictionary", cleanup_func, dictionary);                            \
+	PARSE_OPTION_STRING_TEMP(state, options, info.save_dictionary_file, "save_dictionary", cleanup_func, save_dictionary);             \
 	PARSE_OPTION_ARRAY_TEMP(state, options, info.splice_filenames, info.splice_filenames_count, "splice_filenames", cleanup_func, ss); \
+	PARSE_OPTION_STRING_TEMP(state, options, info.position_weights_file, "position_weights", cleanup_func, position_weights);          \
+	PARSE_OPTION_INT_TEMP(state, options, info.provenance_log_size, "provenance_log", cleanup_func, provenance_log);                   \
+	PARSE_OPTION_STRING_TEMP(state, options, info.regions_string, "regions", cleanup_func, regions);                                   \
+	PARSE_OPTION_STRING_TEMP(state, options, info.protect_bytes_string, "protect_bytes", cleanup_func, protect_bytes);                 \
+	if (get_power_schedule_from_options(&state->info, options) || get_havoc_weights_from_options(&state->info, options) ||             \
+		state->info.provenance_log_size < 0 ||                                                                                         \
+		provenance_log_resize(&state->info.provenance, state->info.provenance_log_size) ||                                             \
+		region_map_set(&state->info.regions, state->info.regions_string, state->info.protect_bytes_string) ||                          \
+		fixup_list_parse(&state->info.fixups, options) ||                                                                              \
+		output_filter_parse(&state->info.dedup, options) ||                                                                            \
+		(state->info.position_weights_file && position_sampler_load(&state->info.positions, state->info.position_weights_file)))       \
+	{                                                                                                                                  \
+		cleanup_func(state);                                                                                                           \
+		return NULL;                                                                                                                   \
+	}                                                                                                                                  \
 	if ((dictionary_required && !state->info.dictionary_file) ||                                                                       \
 		(state->info.dictionary_file && load_dictionary(&state->info, state->info.dictionary_file)))                                   \
 	{                                                                                                                                  \
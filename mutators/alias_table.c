@@ -0,0 +1,105 @@
+#include "alias_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Builds an alias table that chooses each index with probability proportional to its weight.
+ * Any table that was previously built in the alias_table_t is freed.
+ * @param table - the alias_table_t to build
+ * @param weights - the weight of each index.  Indices with a weight of 0 are never chosen.
+ * @param count - the number of entries in weights
+ * @return - 0 on success, nonzero on failure (including when all of the weights are 0)
+ */
+MUTATORS_API int alias_table_build(alias_table_t * table, const uint32_t * weights, size_t count)
+{
+	uint64_t total = 0;
+	double * scaled;
+	uint32_t * worklist, small, large;
+	size_t i, small_count = 0, large_start = count;
+
+	alias_table_free(table);
+	for (i = 0; i < count; i++)
+		total += weights[i];
+	if (!count || count > UINT32_MAX || !total)
+		return 1;
+
+	table->threshold = (uint32_t *)malloc(count * sizeof(uint32_t));
+	table->alias = (uint32_t *)malloc(count * sizeof(uint32_t));
+	scaled = (double *)malloc(count * sizeof(double));
+	//The small entries are kept at the start of the worklist, and the large ones at the end
+	worklist = (uint32_t *)malloc(count * sizeof(uint32_t));
+	if (!table->threshold || !table->alias || !scaled || !worklist) {
+		free(scaled);
+		free(worklist);
+		alias_table_free(table);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		scaled[i] = (double)weights[i] * count / total;
+		if (scaled[i] < 1)
+			worklist[small_count++] = (uint32_t)i;
+		else
+			worklist[--large_start] = (uint32_t)i;
+	}
+
+	//Fill each small column with its own probability, and the rest of it with a large entry
+	while (small_count && large_start < count)
+	{
+		small = worklist[--small_count];
+		large = worklist[large_start++];
+		table->threshold[small] = (uint32_t)(scaled[small] * 4294967296.0);
+		table->alias[small] = large;
+		scaled[large] -= 1 - scaled[small];
+		if (scaled[large] < 1)
+			worklist[small_count++] = large;
+		else
+			worklist[--large_start] = large;
+	}
+
+	//Whatever is left over is full, up to rounding error
+	while (small_count)
+	{
+		small = worklist[--small_count];
+		table->threshold[small] = UINT32_MAX;
+		table->alias[small] = small;
+	}
+	for (i = large_start; i < count; i++)
+	{
+		table->threshold[worklist[i]] = UINT32_MAX;
+		table->alias[worklist[i]] = worklist[i];
+	}
+
+	free(scaled);
+	free(worklist);
+	table->count = count;
+	return 0;
+}
+
+/**
+ * Frees an alias table.  The alias_table_t itself is not freed.
+ * @param table - the alias_table_t to free
+ */
+MUTATORS_API void alias_table_free(alias_table_t * table)
+{
+	free(table->threshold);
+	free(table->alias);
+	memset(table, 0, sizeof(alias_table_t));
+}
+
+/**
+ * Chooses an index from an alias table
+ * @param table - a built alias_table_t
+ * @param random - a random number used to choose the index.  The high half chooses the column and
+ * the low half chooses between the column's index and its alias.
+ * @return - the chosen index
+ */
+MUTATORS_API size_t alias_table_sample(alias_table_t * table, uint64_t random)
+{
+	size_t column = (size_t)(((random >> 32) * table->count) >> 32);
+	if ((uint32_t)random < table->threshold[column])
+		return column;
+	return table->alias[column];
+}
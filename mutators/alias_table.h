@@ -0,0 +1,19 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Chooses an index with probability proportional to its weight in constant time, using Vose's
+//alias method.  Each index has a column, which returns the index itself with the column's
+//threshold probability, and otherwise returns the column's alias.
+typedef struct {
+	size_t count;
+	uint32_t * threshold; //The chance (out of 2^32) that each column returns its own index
+	uint32_t * alias;     //The index each column returns otherwise
+} alias_table_t;
+
+MUTATORS_API int alias_table_build(alias_table_t * table, const uint32_t * weights, size_t count);
+MUTATORS_API void alias_table_free(alias_table_t * table);
+MUTATORS_API size_t alias_table_sample(alias_table_t * table, uint64_t random);
@@ -0,0 +1,446 @@
+#include "edit_plan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Grows an array so that it can hold at least the requested number of elements
+ * @param array - a pointer to the array to grow
+ * @param max - a pointer to the current capacity of the array, updated on success
+ * @param needed - the number of elements the array needs to hold
+ * @param element_size - the size of each element in the array
+ * @return - 0 on success, nonzero on failure
+ */
+static int grow_array(void ** array, size_t * max, size_t needed, size_t element_size)
+{
+	size_t new_max;
+	void * new_array;
+
+	if (needed <= *max)
+		return 0;
+	new_max = *max ? *max : 64;
+	while (new_max < needed)
+		new_max *= 2;
+	new_array = realloc(*array, new_max * element_size);
+	if (!new_array)
+		return 1;
+	*array = new_array;
+	*max = new_max;
+	return 0;
+}
+
+static int grow_pieces(edit_plan_t * plan, size_t needed)
+{
+	if (grow_array((void **)&plan->pieces, &plan->max_pieces, needed, sizeof(edit_piece_t))) {
+		plan->error = 1;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Finds the piece that holds the given offset of the edited buffer
+ * @param plan - the edit_plan_t to search
+ * @param pos - an offset less than the size of the edited buffer
+ * @return - the index of the piece that contains pos
+ */
+static size_t find_piece(edit_plan_t * plan, size_t pos)
+{
+	size_t low = 0, high = plan->num_pieces - 1, mid;
+
+	while (low < high)
+	{
+		mid = low + (high - low + 1) / 2;
+		if (plan->pieces[mid].start <= pos)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
+}
+
+/**
+ * Replaces a range of the edited buffer with a new list of pieces
+ * @param plan - the edit_plan_t to modify
+ * @param pos - the offset of the range to replace
+ * @param length - the nonzero length of the range to replace, this must match the total length of the new pieces
+ * @param new_pieces - the pieces to put in the range.  The start of each piece is filled in by this function.
+ * @param count - the number of pieces in new_pieces
+ * @return - 0 on success, nonzero on failure
+ */
+static int replace_range(edit_plan_t * plan, size_t pos, size_t length, edit_piece_t * new_pieces, size_t count)
+{
+	size_t first, last, end = pos + length, skip, num_pieces, i;
+	edit_piece_t head, tail;
+	int has_head, has_tail;
+
+	//Keep the parts of the first and last pieces that are outside of the range
+	first = find_piece(plan, pos);
+	last = find_piece(plan, end - 1);
+	head = plan->pieces[first];
+	has_head = head.start < pos;
+	head.length = pos - head.start;
+	tail = plan->pieces[last];
+	has_tail = tail.start + tail.length > end;
+	skip = end - tail.start;
+	tail.start = end;
+	tail.length -= skip;
+	tail.offset += skip;
+
+	num_pieces = plan->num_pieces - (last - first + 1) + has_head + count + has_tail;
+	if (grow_pieces(plan, num_pieces))
+		return 1;
+
+	memmove(plan->pieces + first + has_head + count + has_tail, plan->pieces + last + 1,
+		(plan->num_pieces - last - 1) * sizeof(edit_piece_t));
+	if (has_head)
+		plan->pieces[first++] = head;
+	for (i = 0; i < count; i++)
+	{
+		plan->pieces[first] = new_pieces[i];
+		plan->pieces[first++].start = pos;
+		pos += new_pieces[i].length;
+	}
+	if (has_tail)
+		plan->pieces[first] = tail;
+	plan->num_pieces = num_pieces;
+	return 0;
+}
+
+/**
+ * Starts recording a new set of edits to a buffer
+ * @param plan - the edit_plan_t to record the edits in.  Any storage from a previous use
+ * of the plan is reused.
+ * @param buffer - the buffer to edit
+ * @param size - the number of bytes of buffer that edits may touch
+ * @param direct - whether the edits should be applied to the buffer immediately, rather than
+ * recorded in the piece table
+ */
+MUTATORS_API void edit_plan_begin(edit_plan_t * plan, uint8_t * buffer, size_t size, int direct)
+{
+	plan->buffer = buffer;
+	plan->size = size;
+	plan->direct = direct;
+	plan->error = 0;
+	plan->num_pieces = 0;
+	plan->added_length = 0;
+
+	if (direct || !size)
+		return;
+	if (grow_pieces(plan, 1)) { //Fallback to editing the buffer directly
+		plan->direct = 1;
+		plan->error = 0;
+		return;
+	}
+	plan->pieces[0].start = 0;
+	plan->pieces[0].length = size;
+	plan->pieces[0].offset = 0;
+	plan->pieces[0].added = 0;
+	plan->pieces[0].shared = 0;
+	plan->num_pieces = 1;
+}
+
+/**
+ * Checks whether the source bytes of an original piece would be overwritten by one
+ * of the pieces moving left, which commit writes first
+ * @param plan - the edit_plan_t being committed
+ * @param piece - a piece that is moving to the right
+ * @return - 1 if the piece's source bytes overlap a piece moving to the left, 0 otherwise
+ */
+static int source_overwritten(edit_plan_t * plan, edit_piece_t * piece)
+{
+	size_t i, end = piece->offset + piece->length;
+	edit_piece_t * other;
+
+	//Only the pieces that are written to the source range need to be checked
+	for (i = find_piece(plan, piece->offset); i < plan->num_pieces && plan->pieces[i].start < end; i++)
+	{
+		other = &plan->pieces[i];
+		if (!other->added && other->offset > other->start)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Writes the recorded edits to the buffer.  Pieces that are still in their original
+ * position are not copied.  Original pieces that moved left are written first, from the
+ * front of the buffer, and original pieces that moved right are written next, from the
+ * back of the buffer, so neither overwrites bytes that a later piece in the same direction
+ * still needs.  The few pieces moving right whose bytes would be overwritten by a piece
+ * moving left are saved beforehand.  The added pieces are written last.
+ * @param plan - the edit_plan_t to commit
+ * @return - 0 on success, nonzero if any of the recorded edits failed
+ */
+MUTATORS_API int edit_plan_commit(edit_plan_t * plan)
+{
+	size_t i, total = 0;
+	edit_piece_t * piece;
+
+	if (plan->direct)
+		return 0;
+	if (plan->error)
+		return 1;
+
+	//Save the original bytes that the pieces moving left would overwrite.  The saved
+	//pieces are marked as added, and their offset is changed to their offset in plan->original
+	for (i = 0; i < plan->num_pieces; i++)
+	{
+		piece = &plan->pieces[i];
+		if (!piece->added && piece->offset < piece->start && source_overwritten(plan, piece))
+			total += piece->length;
+	}
+	if (total) {
+		if (grow_array((void **)&plan->original, &plan->max_original, total, 1))
+			return 1;
+		total = 0;
+		for (i = 0; i < plan->num_pieces; i++)
+		{
+			piece = &plan->pieces[i];
+			if (!piece->added && piece->offset < piece->start && source_overwritten(plan, piece)) {
+				memcpy(plan->original + total, plan->buffer + piece->offset, piece->length);
+				piece->offset = total;
+				piece->added = 2;
+				total += piece->length;
+			}
+		}
+	}
+
+	for (i = 0; i < plan->num_pieces; i++)
+	{
+		piece = &plan->pieces[i];
+		if (!piece->added && piece->offset > piece->start)
+			memmove(plan->buffer + piece->start, plan->buffer + piece->offset, piece->length);
+	}
+	for (i = plan->num_pieces; i > 0; i--)
+	{
+		piece = &plan->pieces[i - 1];
+		if (!piece->added && piece->offset < piece->start)
+			memmove(plan->buffer + piece->start, plan->buffer + piece->offset, piece->length);
+	}
+	for (i = 0; i < plan->num_pieces; i++)
+	{
+		piece = &plan->pieces[i];
+		if (piece->added == 1)
+			memcpy(plan->buffer + piece->start, plan->added + piece->offset, piece->length);
+		else if (piece->added == 2)
+			memcpy(plan->buffer + piece->start, plan->original + piece->offset, piece->length);
+	}
+
+	edit_plan_begin(plan, plan->buffer, plan->size, plan->direct);
+	return 0;
+}
+
+/**
+ * Frees the storage used by an edit_plan_t
+ * @param plan - the edit_plan_t to free
+ */
+MUTATORS_API void edit_plan_free(edit_plan_t * plan)
+{
+	free(plan->pieces);
+	free(plan->temp_pieces);
+	free(plan->added);
+	free(plan->original);
+	memset(plan, 0, sizeof(edit_plan_t));
+}
+
+/**
+ * Counts the memory allocated by an edit_plan_t, not including the edit_plan_t itself
+ * @param plan - the edit_plan_t to count the memory of
+ * @return - the number of bytes allocated for the plan's pieces and bytes
+ */
+MUTATORS_API size_t edit_plan_memory_usage(const edit_plan_t * plan)
+{
+	return (plan->max_pieces + plan->max_temp_pieces) * sizeof(edit_piece_t) + plan->max_added + plan->max_original;
+}
+
+/**
+ * Reads bytes from the edited buffer
+ * @param plan - the edit_plan_t to read from
+ * @param pos - the offset to read from
+ * @param dst - the buffer to read into
+ * @param length - the number of bytes to read
+ */
+MUTATORS_API void edit_plan_read(edit_plan_t * plan, size_t pos, void * dst, size_t length)
+{
+	size_t i, skip, to_copy;
+	uint8_t * out = (uint8_t *)dst;
+	edit_piece_t * piece;
+
+	if (plan->direct) {
+		memcpy(dst, plan->buffer + pos, length);
+		return;
+	}
+
+	for (i = length ? find_piece(plan, pos) : 0; length; i++)
+	{
+		piece = &plan->pieces[i];
+		skip = pos - piece->start;
+		to_copy = piece->length - skip;
+		if (to_copy > length)
+			to_copy = length;
+		if (piece->added)
+			memcpy(out, plan->added + piece->offset + skip, to_copy);
+		else
+			memcpy(out, plan->buffer + piece->offset + skip, to_copy);
+		out += to_copy;
+		pos += to_copy;
+		length -= to_copy;
+	}
+}
+
+/**
+ * Reads a single byte from the edited buffer
+ * @param plan - the edit_plan_t to read from
+ * @param pos - the offset to read from
+ * @return - the byte at pos
+ */
+MUTATORS_API uint8_t edit_plan_get(edit_plan_t * plan, size_t pos)
+{
+	uint8_t value;
+	if (plan->direct)
+		return plan->buffer[pos];
+	edit_plan_read(plan, pos, &value, 1);
+	return value;
+}
+
+/**
+ * Reserves a range of the edited buffer to be overwritten by the caller
+ * @param plan - the edit_plan_t to modify
+ * @param pos - the offset of the range to overwrite
+ * @param length - the length of the range to overwrite
+ * @return - a pointer that the caller should write the new length bytes to, or NULL on failure.
+ * The pointer is only valid until the next edit is made to the plan.
+ */
+MUTATORS_API uint8_t * edit_plan_reserve(edit_plan_t * plan, size_t pos, size_t length)
+{
+	edit_piece_t piece;
+	uint8_t * ret;
+	size_t i;
+
+	if (plan->direct || !length)
+		return plan->buffer + pos;
+
+	//If the range is inside added bytes that nothing else references, they can be overwritten in place
+	i = find_piece(plan, pos);
+	if (plan->pieces[i].added && !plan->pieces[i].shared && pos + length <= plan->pieces[i].start + plan->pieces[i].length)
+		return plan->added + plan->pieces[i].offset + (pos - plan->pieces[i].start);
+
+	if (grow_array((void **)&plan->added, &plan->max_added, plan->added_length + length, 1)) {
+		plan->error = 1;
+		return NULL;
+	}
+
+	piece.length = length;
+	piece.offset = plan->added_length;
+	piece.added = 1;
+	piece.shared = 0;
+	if (replace_range(plan, pos, length, &piece, 1))
+		return NULL;
+	ret = plan->added + plan->added_length;
+	plan->added_length += length;
+	return ret;
+}
+
+/**
+ * Sets a single byte of the edited buffer
+ * @param plan - the edit_plan_t to modify
+ * @param pos - the offset of the byte to set
+ * @param value - the new value of the byte
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_plan_set(edit_plan_t * plan, size_t pos, uint8_t value)
+{
+	uint8_t * dst;
+	if (plan->direct) {
+		plan->buffer[pos] = value;
+		return 0;
+	}
+	dst = edit_plan_reserve(plan, pos, 1);
+	if (!dst)
+		return 1;
+	*dst = value;
+	return 0;
+}
+
+/**
+ * Overwrites a range of the edited buffer, as memmove would
+ * @param plan - the edit_plan_t to modify
+ * @param pos - the offset to write to
+ * @param src - the bytes to write.  This must not point into the plan's storage.
+ * @param length - the number of bytes to write
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_plan_write(edit_plan_t * plan, size_t pos, const void * src, size_t length)
+{
+	uint8_t * dst;
+	if (plan->direct) {
+		memmove(plan->buffer + pos, src, length);
+		return 0;
+	}
+	dst = edit_plan_reserve(plan, pos, length);
+	if (!dst)
+		return 1;
+	memcpy(dst, src, length);
+	return 0;
+}
+
+/**
+ * Sets a range of the edited buffer to a single value, as memset would
+ * @param plan - the edit_plan_t to modify
+ * @param pos - the offset to write to
+ * @param value - the value to write
+ * @param length - the number of bytes to write
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_plan_fill(edit_plan_t * plan, size_t pos, uint8_t value, size_t length)
+{
+	uint8_t * dst = edit_plan_reserve(plan, pos, length);
+	if (!dst)
+		return 1;
+	memset(dst, value, length);
+	return 0;
+}
+
+/**
+ * Copies a range of the edited buffer to another offset in the edited buffer, as memmove would.
+ * No bytes are copied, only references to the pieces that hold them, so any added bytes in
+ * the range are marked as shared.
+ * @param plan - the edit_plan_t to modify
+ * @param from - the offset to copy from
+ * @param to - the offset to copy to
+ * @param length - the number of bytes to copy
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_plan_move(edit_plan_t * plan, size_t from, size_t to, size_t length)
+{
+	size_t i, count = 0, end = from + length, skip;
+	edit_piece_t * piece;
+
+	if (!length || from == to)
+		return 0;
+	if (plan->direct) {
+		memmove(plan->buffer + to, plan->buffer + from, length);
+		return 0;
+	}
+
+	for (i = find_piece(plan, from); i < plan->num_pieces && plan->pieces[i].start < end; i++)
+	{
+		if (grow_array((void **)&plan->temp_pieces, &plan->max_temp_pieces, count + 1, sizeof(edit_piece_t))) {
+			plan->error = 1;
+			return 1;
+		}
+		plan->pieces[i].shared = plan->pieces[i].added;
+		piece = &plan->temp_pieces[count++];
+		*piece = plan->pieces[i];
+		if (piece->start < from) { //Trim the first piece to the start of the range
+			skip = from - piece->start;
+			piece->offset += skip;
+			piece->length -= skip;
+			piece->start = from;
+		}
+		if (piece->start + piece->length > end) //Trim the last piece to the end of the range
+			piece->length = end - piece->start;
+	}
+	return replace_range(plan, to, length, plan->temp_pieces, count);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Buffers shorter than this are edited in place, as moving their tails is cheaper
+//than maintaining the piece table
+#define EDIT_PLAN_MIN_LENGTH (256 * 1024)
+//The most times in a row that a mutation is tried again because its edit plan couldn't be
+//committed (i.e. an allocation failed while recording its edits) before the mutator gives up
+#define EDIT_PLAN_MAX_RETRIES 16
+
+//A contiguous run of the edited buffer, taken either from the original buffer or
+//from the bytes added by the edits
+typedef struct {
+	size_t start;  //offset of this piece in the edited buffer
+	size_t length;
+	size_t offset; //offset of this piece in its source
+	int added;     //0 if the source is the original buffer, 1 if it is the added bytes
+	               //(2 is used internally while committing)
+	int shared;    //Set if the added bytes may be referenced by more than one piece
+} edit_piece_t;
+
+//A piece table that records a series of edits to a buffer, so that stacked
+//moves/inserts/deletes don't each need to shift the tail of the buffer.  Every
+//edit is expressed as it would be done on the full buffer (i.e. with memmove/memset
+//semantics), and the result is written back to the buffer once in edit_plan_commit.
+typedef struct {
+	uint8_t * buffer; //the buffer being edited, holds the original bytes until committed
+	size_t size;      //the number of bytes of buffer being edited
+	int direct;       //If set, the edits are applied to buffer immediately
+	int error;        //Set if an allocation failed while recording an edit
+
+	edit_piece_t * pieces;
+	size_t num_pieces;
+	size_t max_pieces;
+
+	edit_piece_t * temp_pieces;
+	size_t max_temp_pieces;
+
+	uint8_t * added;
+	size_t added_length;
+	size_t max_added;
+
+	uint8_t * original;
+	size_t max_original;
+} edit_plan_t;
+
+MUTATORS_API void edit_plan_begin(edit_plan_t * plan, uint8_t * buffer, size_t size, int direct);
+MUTATORS_API int edit_plan_commit(edit_plan_t * plan);
+MUTATORS_API void edit_plan_free(edit_plan_t * plan);
+MUTATORS_API size_t edit_plan_memory_usage(const edit_plan_t * plan);
+
+MUTATORS_API uint8_t edit_plan_get(edit_plan_t * plan, size_t pos);
+MUTATORS_API void edit_plan_read(edit_plan_t * plan, size_t pos, void * dst, size_t length);
+MUTATORS_API uint8_t * edit_plan_reserve(edit_plan_t * plan, size_t pos, size_t length);
+MUTATORS_API int edit_plan_set(edit_plan_t * plan, size_t pos, uint8_t value);
+MUTATORS_API int edit_plan_write(edit_plan_t * plan, size_t pos, const void * src, size_t length);
+MUTATORS_API int edit_plan_fill(edit_plan_t * plan, size_t pos, uint8_t value, size_t length);
+MUTATORS_API int edit_plan_move(edit_plan_t * plan, size_t from, size_t to, size_t length);
@@ -0,0 +1,291 @@
+#include "edit_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Grows an array so that it can hold at least the requested number of elements
+ * @param array - a pointer to the array to grow
+ * @param max - a pointer to the current capacity of the array, updated on success
+ * @param needed - the number of elements the array needs to hold
+ * @param element_size - the size of each element in the array
+ * @return - 0 on success, nonzero on failure
+ */
+static int grow_array(void ** array, size_t * max, size_t needed, size_t element_size)
+{
+	size_t new_max;
+	void * new_array;
+
+	if (needed <= *max)
+		return 0;
+	new_max = *max ? *max : 64;
+	while (new_max < needed)
+		new_max *= 2;
+	new_array = realloc(*array, new_max * element_size);
+	if (!new_array)
+		return 1;
+	*array = new_array;
+	*max = new_max;
+	return 0;
+}
+
+/**
+ * Records the operation that changed one buffer into another, as the replacement of the range
+ * between their common prefix and common suffix
+ * @param trace - the edit_trace_t to add the operation to
+ * @param before - the buffer before the operation
+ * @param before_length - the length of before
+ * @param after - the buffer after the operation
+ * @param after_length - the length of after
+ * @return - 0 on success, nonzero on failure
+ */
+static int add_diff(edit_trace_t * trace, const uint8_t * before, size_t before_length, const uint8_t * after, size_t after_length)
+{
+	size_t prefix = 0, suffix = 0, shorter = before_length < after_length ? before_length : after_length;
+
+	while (prefix < shorter && before[prefix] == after[prefix])
+		prefix++;
+	while (suffix < shorter - prefix && before[before_length - suffix - 1] == after[after_length - suffix - 1])
+		suffix++;
+	if (prefix == shorter && before_length == after_length) //The operation didn't change anything
+		return 0;
+	return edit_trace_add(trace, prefix, before_length - prefix - suffix, after + prefix, after_length - prefix - suffix);
+}
+
+/**
+ * Clears an edit trace and starts recording the operations applied to a buffer
+ * @param trace - the edit_trace_t to start
+ * @param base - the buffer that the first operation will be applied to
+ * @param base_length - the length of base
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_trace_start(edit_trace_t * trace, const uint8_t * base, size_t base_length)
+{
+	trace->num_ops = 0;
+	trace->data_length = 0;
+	trace->error = 0;
+	if (grow_array((void **)&trace->base, &trace->max_base, base_length, 1))
+		return 1;
+	memcpy(trace->base, base, base_length);
+	trace->base_length = base_length;
+	trace->enabled = 1;
+	return 0;
+}
+
+/**
+ * Stops recording operations.  The operations recorded so far are kept until the trace is started again.
+ * @param trace - the edit_trace_t to stop
+ */
+MUTATORS_API void edit_trace_stop(edit_trace_t * trace)
+{
+	trace->enabled = 0;
+}
+
+/**
+ * Frees the memory used by an edit_trace_t.  The edit_trace_t itself is not freed.
+ * @param trace - the edit_trace_t to free
+ */
+MUTATORS_API void edit_trace_free(edit_trace_t * trace)
+{
+	free(trace->base);
+	free(trace->ops);
+	free(trace->data);
+	free(trace->before);
+	free(trace->after);
+	memset(trace, 0, sizeof(edit_trace_t));
+}
+
+/**
+ * Counts the memory allocated by an edit_trace_t, not including the edit_trace_t itself
+ * @param trace - the edit_trace_t to count the memory of
+ * @return - the number of bytes allocated for the trace's operations and buffers
+ */
+MUTATORS_API size_t edit_trace_memory_usage(const edit_trace_t * trace)
+{
+	return trace->max_base + trace->max_ops * sizeof(edit_trace_op_t) + trace->max_data + trace->max_before + trace->max_after;
+}
+
+/**
+ * Adds an operation to an edit trace
+ * @param trace - the edit_trace_t to add the operation to
+ * @param pos - the offset of the range that the operation replaced
+ * @param remove_length - the length of the range that the operation replaced
+ * @param data - the bytes that the range was replaced with
+ * @param insert_length - the number of bytes in data
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int edit_trace_add(edit_trace_t * trace, size_t pos, size_t remove_length, const uint8_t * data, size_t insert_length)
+{
+	edit_trace_op_t * op;
+
+	if (grow_array((void **)&trace->ops, &trace->max_ops, trace->num_ops + 1, sizeof(edit_trace_op_t))
+		|| grow_array((void **)&trace->data, &trace->max_data, trace->data_length + insert_length, 1))
+	{
+		trace->error = 1;
+		return 1;
+	}
+	op = &trace->ops[trace->num_ops++];
+	op->pos = pos;
+	op->remove_length = remove_length;
+	op->insert_length = insert_length;
+	op->data = trace->data_length;
+	if (insert_length)
+		memcpy(trace->data + trace->data_length, data, insert_length);
+	trace->data_length += insert_length;
+	return 0;
+}
+
+/**
+ * Remembers the contents of a buffer before an operation is recorded in its edit plan.  This
+ * does nothing if the trace isn't enabled.
+ * @param trace - the edit_trace_t to record the operation in
+ * @param plan - the edit_plan_t that the operation will be recorded in
+ * @param length - the length of the edited buffer before the operation
+ */
+MUTATORS_API void edit_trace_begin_op(edit_trace_t * trace, edit_plan_t * plan, size_t length)
+{
+	if (!trace->enabled || trace->error)
+		return;
+	if (grow_array((void **)&trace->before, &trace->max_before, length, 1)) {
+		trace->error = 1;
+		return;
+	}
+	edit_plan_read(plan, 0, trace->before, length);
+	trace->before_length = length;
+}
+
+/**
+ * Records the operation done since edit_trace_begin_op was called, by comparing the buffer to
+ * its contents then.  This does nothing if the trace isn't enabled.
+ * @param trace - the edit_trace_t to record the operation in
+ * @param plan - the edit_plan_t that the operation was recorded in
+ * @param length - the length of the edited buffer after the operation
+ */
+MUTATORS_API void edit_trace_end_op(edit_trace_t * trace, edit_plan_t * plan, size_t length)
+{
+	if (!trace->enabled || trace->error)
+		return;
+	if (grow_array((void **)&trace->after, &trace->max_after, length, 1)) {
+		trace->error = 1;
+		return;
+	}
+	edit_plan_read(plan, 0, trace->after, length);
+	add_diff(trace, trace->before, trace->before_length, trace->after, length);
+}
+
+/**
+ * Applies some of the recorded operations to the trace's base buffer.  Each operation's offsets
+ * are clamped to the buffer, since reverting earlier operations can change its length.
+ * @param trace - the edit_trace_t with the operations to apply
+ * @param keep - an array with an entry for each operation, which is nonzero if the operation
+ * should be applied, or NULL to apply all of them
+ * @param buffer - the buffer to write the result to
+ * @param buffer_length - the size of buffer.  Any bytes that don't fit are dropped.
+ * @return - the length of the result
+ */
+MUTATORS_API size_t edit_trace_apply(edit_trace_t * trace, const uint8_t * keep, uint8_t * buffer, size_t buffer_length)
+{
+	size_t i, pos, remove, insert, length = trace->base_length < buffer_length ? trace->base_length : buffer_length;
+	edit_trace_op_t * op;
+
+	memcpy(buffer, trace->base, length);
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		if (keep && !keep[i])
+			continue;
+		op = &trace->ops[i];
+		pos = op->pos < length ? op->pos : length;
+		remove = op->remove_length < length - pos ? op->remove_length : length - pos;
+		insert = op->insert_length;
+		if (length - remove + insert > buffer_length)
+			insert = buffer_length - (length - remove);
+		memmove(buffer + pos + insert, buffer + pos + remove, length - pos - remove);
+		memcpy(buffer + pos, trace->data + op->data, insert);
+		length = length - remove + insert;
+	}
+	return length;
+}
+
+/**
+ * Minimizes an output by reverting the recorded operations that aren't needed for it to stay
+ * interesting.  Chunks of the operations are reverted together, and the chunks are halved until
+ * no single operation can be reverted (as in delta debugging), so outputs made of a few operations
+ * only need a handful of verdicts.  If the recorded operations don't produce the output (e.g. the
+ * output came from a stage that doesn't record its operations), the remaining difference is treated
+ * as one more operation.
+ * @param trace - the edit_trace_t with the operations that produced the output
+ * @param output - the output to minimize
+ * @param output_length - the length of output
+ * @param buffer - a buffer that the minimized output will be written to, and which the
+ * candidates passed to verdict are in
+ * @param buffer_length - the size of buffer
+ * @param verdict - a function that's called with each candidate, which returns nonzero if the
+ * candidate is still interesting
+ * @param context - an argument to pass to verdict
+ * @return - the length of the minimized output, or -1 on failure
+ */
+MUTATORS_API int edit_trace_minimize(edit_trace_t * trace, const uint8_t * output, size_t output_length,
+	uint8_t * buffer, size_t buffer_length, edit_trace_verdict_t verdict, void * context)
+{
+	uint8_t * keep = NULL;
+	size_t * kept = NULL, num_kept, granularity = 2, chunk, start, count, i, length;
+	int removed, ret = -1;
+
+	if (trace->error || output_length > buffer_length)
+		return -1;
+
+	//If the operations don't reproduce the output exactly (e.g. because the output depended on
+	//stale bytes past the end of the buffer), whatever is different is one more operation
+	length = edit_trace_apply(trace, NULL, buffer, buffer_length);
+	if (add_diff(trace, buffer, length, output, output_length))
+		return -1;
+	if (!trace->num_ops) { //The output is the same as the base buffer
+		memcpy(buffer, output, output_length);
+		return (int)output_length;
+	}
+
+	keep = (uint8_t *)malloc(trace->num_ops);
+	kept = (size_t *)malloc(trace->num_ops * sizeof(size_t));
+	if (!keep || !kept)
+		goto cleanup;
+
+	memset(keep, 1, trace->num_ops);
+	for (i = 0; i < trace->num_ops; i++)
+		kept[i] = i;
+	num_kept = trace->num_ops;
+	while (num_kept)
+	{
+		chunk = (num_kept + granularity - 1) / granularity;
+		removed = 0;
+		for (start = 0; start < num_kept; )
+		{
+			count = chunk < num_kept - start ? chunk : num_kept - start;
+			for (i = start; i < start + count; i++)
+				keep[kept[i]] = 0;
+			length = edit_trace_apply(trace, keep, buffer, buffer_length);
+			if (verdict(context, (const char *)buffer, length)) {
+				memmove(&kept[start], &kept[start + count], (num_kept - start - count) * sizeof(size_t));
+				num_kept -= count;
+				removed = 1;
+			}
+			else {
+				for (i = start; i < start + count; i++)
+					keep[kept[i]] = 1;
+				start += count;
+			}
+		}
+
+		if (removed) //Try the same size chunks of what's left
+			granularity = granularity > 2 ? granularity - 1 : 2;
+		else if (chunk == 1) //None of the remaining operations can be reverted
+			break;
+		else
+			granularity = granularity * 2 < num_kept ? granularity * 2 : num_kept;
+	}
+	ret = (int)edit_trace_apply(trace, keep, buffer, buffer_length);
+
+cleanup:
+	free(keep);
+	free(kept);
+	return ret;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "mutators.h"
+#include "edit_plan.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Decides whether a candidate produced while minimizing an output is still interesting (e.g. it
+//still crashes the target).  Returns nonzero if it is.
+typedef int (*edit_trace_verdict_t)(void * context, const char * buffer, size_t length);
+
+//One of the stacked operations that produced an output, expressed as a replacement of a range of
+//the buffer as it was before the operation
+typedef struct {
+	size_t pos;
+	size_t remove_length; //The number of bytes replaced
+	size_t insert_length; //The number of bytes they're replaced with
+	size_t data;          //The offset of the inserted bytes in the trace's data
+} edit_trace_op_t;
+
+//Records the individual operations that a mutator stacks to produce an output, so the output can
+//be minimized by reverting the operations that aren't needed for it to stay interesting.  Only
+//outputs generated while the trace is enabled are recorded.
+typedef struct {
+	int enabled;
+	int error; //Set if an allocation failed while recording an operation
+
+	uint8_t * base; //The buffer that the first operation was applied to
+	size_t base_length;
+	size_t max_base;
+
+	edit_trace_op_t * ops;
+	size_t num_ops;
+	size_t max_ops;
+
+	uint8_t * data;
+	size_t data_length;
+	size_t max_data;
+
+	uint8_t * before; //The buffer before the operation being recorded
+	size_t before_length;
+	size_t max_before;
+	uint8_t * after;  //The buffer after the operation being recorded
+	size_t max_after;
+} edit_trace_t;
+
+MUTATORS_API int edit_trace_start(edit_trace_t * trace, const uint8_t * base, size_t base_length);
+MUTATORS_API void edit_trace_stop(edit_trace_t * trace);
+MUTATORS_API void edit_trace_free(edit_trace_t * trace);
+MUTATORS_API size_t edit_trace_memory_usage(const edit_trace_t * trace);
+MUTATORS_API int edit_trace_add(edit_trace_t * trace, size_t pos, size_t remove_length, const uint8_t * data, size_t insert_length);
+MUTATORS_API void edit_trace_begin_op(edit_trace_t * trace, edit_plan_t * plan, size_t length);
+MUTATORS_API void edit_trace_end_op(edit_trace_t * trace, edit_plan_t * plan, size_t length);
+MUTATORS_API size_t edit_trace_apply(edit_trace_t * trace, const uint8_t * keep, uint8_t * buffer, size_t buffer_length);
+MUTATORS_API int edit_trace_minimize(edit_trace_t * trace, const uint8_t * output, size_t output_length,
+	uint8_t * buffer, size_t buffer_length, edit_trace_verdict_t verdict, void * context);
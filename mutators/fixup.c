@@ -0,0 +1,714 @@
+#include "fixup.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+//The CRC-32 can be folded with carry-less multiplies, and SSE4.2 has an instruction for the CRC-32C.
+//On x86 both are compiled in whatever the compiler's target is (with the target attribute on gcc and
+//clang), and cpuid decides at runtime whether they're used, so the library still runs on CPUs without them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#include <nmmintrin.h>
+#define USE_PCLMUL
+#define USE_SSE42
+#define CRC_TARGET(features) __attribute__((target(features)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define USE_PCLMUL
+#define USE_SSE42
+#define CRC_TARGET(features)
+#endif
+
+#define ADLER_BASE 65521 //The largest prime smaller than 65536
+#define ADLER_NMAX 5552  //The most bytes that can be summed before the sums can overflow
+
+//A bit reflected CRC, with the tables used to compute it 8 bytes at a time and to append zeros to it
+typedef struct {
+	uint32_t poly;   //The polynomial, bit reflected
+	uint32_t one;    //The polynomial 1 (x^0) in the same representation
+	uint32_t xorout; //XORed with the register at the start and the end of the checksum
+	uint32_t table[8][256];
+	uint32_t x2n[64]; //x^(2^n) modulo the polynomial
+} crc_model_t;
+
+static crc_model_t crc32_model = { 0xedb88320, 0x80000000, 0xffffffff, { { 0 } }, { 0 } };
+static crc_model_t crc32c_model = { 0x82f63b78, 0x80000000, 0xffffffff, { { 0 } }, { 0 } };
+static crc_model_t crc16_model = { 0xa001, 0x8000, 0, { { 0 } }, { 0 } };
+//The tables are shared by every mutator in the process, which can be on different threads.  This is 0
+//until they're built, 1 while a thread is building them, and 2 once they're ready.
+static volatile long crc_models_state;
+static int cpu_has_pclmul; //Set if the CPU has PCLMULQDQ and SSE4.1
+static int cpu_has_sse42;
+
+static const char * fixup_type_names[] = { "crc32", "crc32c", "adler32", "crc16", "length" };
+
+/* Multiplies two polynomials modulo the CRC's polynomial (as in zlib's crc32_combine) */
+static uint32_t multiply_mod(const crc_model_t * model, uint32_t a, uint32_t b)
+{
+	uint32_t m, product = 0;
+
+	for (m = model->one; m; m >>= 1)
+	{
+		if (a & m)
+			product ^= b;
+		b = b & 1 ? (b >> 1) ^ model->poly : b >> 1;
+	}
+	return product;
+}
+
+static void init_crc_model(crc_model_t * model)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++)
+	{
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = crc & 1 ? (crc >> 1) ^ model->poly : crc >> 1;
+		model->table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++)
+	{
+		for (j = 1; j < 8; j++)
+			model->table[j][i] = (model->table[j - 1][i] >> 8) ^ model->table[0][model->table[j - 1][i] & 0xff];
+	}
+
+	model->x2n[0] = model->one >> 1;
+	for (i = 1; i < 64; i++)
+		model->x2n[i] = multiply_mod(model, model->x2n[i - 1], model->x2n[i - 1]);
+}
+
+/* Checks which of the CRC instructions the CPU has */
+static void detect_crc_instructions(void)
+{
+#if defined(USE_PCLMUL) || defined(USE_SSE42)
+	unsigned int regs[4] = { 0 };
+
+#ifdef _MSC_VER
+	__cpuid((int *)regs, 1);
+#else
+	__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+	cpu_has_pclmul = (regs[2] & (1 << 1)) && (regs[2] & (1 << 19));
+	cpu_has_sse42 = (regs[2] & (1 << 20)) != 0;
+#endif
+}
+
+/* Sets target to value if it's comparand, and returns its previous value (as a full barrier) */
+static long compare_exchange(volatile long * target, long value, long comparand)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(target, value, comparand);
+#else
+	return __sync_val_compare_and_swap(target, comparand, value);
+#endif
+}
+
+/* Builds the CRC tables the first time it's called.  Other threads that call it at the same time
+ * wait until the tables are built. */
+static void init_crc_models(void)
+{
+	long state = compare_exchange(&crc_models_state, 1, 0);
+
+	if (state == 0) {
+		init_crc_model(&crc32_model);
+		init_crc_model(&crc32c_model);
+		init_crc_model(&crc16_model);
+		detect_crc_instructions();
+		compare_exchange(&crc_models_state, 2, 1);
+		return;
+	}
+	while (state != 2)
+		state = compare_exchange(&crc_models_state, 2, 2);
+}
+
+static const crc_model_t * get_crc_model(int type)
+{
+	if (type == FIXUP_CRC32)
+		return &crc32_model;
+	if (type == FIXUP_CRC32C)
+		return &crc32c_model;
+	return &crc16_model;
+}
+
+/* Updates a CRC register with a buffer, 8 bytes at a time (slicing-by-8) */
+static uint32_t crc_update_table(const crc_model_t * model, uint32_t crc, const uint8_t * buffer, size_t length)
+{
+	uint32_t one, two;
+
+	for (; length >= 8; buffer += 8, length -= 8)
+	{
+		one = crc ^ (buffer[0] | (uint32_t)buffer[1] << 8 | (uint32_t)buffer[2] << 16 | (uint32_t)buffer[3] << 24);
+		two = buffer[4] | (uint32_t)buffer[5] << 8 | (uint32_t)buffer[6] << 16 | (uint32_t)buffer[7] << 24;
+		crc = model->table[7][one & 0xff] ^ model->table[6][(one >> 8) & 0xff] ^
+			model->table[5][(one >> 16) & 0xff] ^ model->table[4][one >> 24] ^
+			model->table[3][two & 0xff] ^ model->table[2][(two >> 8) & 0xff] ^
+			model->table[1][(two >> 16) & 0xff] ^ model->table[0][two >> 24];
+	}
+	for (; length; buffer++, length--)
+		crc = model->table[0][(crc ^ *buffer) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef USE_PCLMUL
+/* Updates a CRC-32 register by folding the buffer 64 bytes at a time with carry-less multiplies, as
+   described in Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+   The length must be a multiple of 16, and at least 64. */
+CRC_TARGET("pclmul,sse4.1") static uint32_t crc32_pclmul(uint32_t crc, const uint8_t * buffer, size_t length)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buffer), _mm_cvtsi32_si128(crc));
+	x2 = _mm_loadu_si128((const __m128i *)(buffer + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(buffer + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(buffer + 48));
+	for (buffer += 64, length -= 64; length >= 64; buffer += 64, length -= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)buffer));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buffer + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buffer + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buffer + 48)));
+	}
+
+	//Fold the four lanes into one, then fold in the rest 16 bytes at a time
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+	for (; length >= 16; buffer += 16, length -= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buffer)), x5);
+	}
+
+	//Fold the 128 bits to 64 bits, then do a Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5k0, 0x00), x2);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+#ifdef USE_SSE42
+/* Updates a CRC-32C register with SSE4.2's crc32 instruction */
+CRC_TARGET("sse4.2") static uint32_t crc32c_sse42(uint32_t crc, const uint8_t * buffer, size_t length)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64_t crc64 = crc, word;
+
+	for (; length >= 8; buffer += 8, length -= 8)
+	{
+		memcpy(&word, buffer, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (uint32_t)crc64;
+#else
+	uint32_t word;
+
+	for (; length >= 4; buffer += 4, length -= 4)
+	{
+		memcpy(&word, buffer, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+	}
+#endif
+	for (; length; buffer++, length--)
+		crc = _mm_crc32_u8(crc, *buffer);
+	return crc;
+}
+#endif
+
+/* Updates a CRC register with a buffer, using the fastest implementation that the CPU supports */
+static uint32_t crc_update(const crc_model_t * model, uint32_t crc, const uint8_t * buffer, size_t length)
+{
+#ifdef USE_PCLMUL
+	size_t folded;
+	if (cpu_has_pclmul && model == &crc32_model && length >= 64) {
+		folded = length & ~(size_t)15;
+		crc = crc32_pclmul(crc, buffer, folded);
+		buffer += folded;
+		length -= folded;
+	}
+#endif
+#ifdef USE_SSE42
+	if (cpu_has_sse42 && model == &crc32c_model)
+		return crc32c_sse42(crc, buffer, length);
+#endif
+	return crc_update_table(model, crc, buffer, length);
+}
+
+/* Multiplies a CRC register by x^(8 * length), i.e. appends length zero bytes to the data it was
+   computed over, in time logarithmic in length */
+static uint32_t crc_append_zeros(const crc_model_t * model, uint32_t crc, uint64_t length)
+{
+	int n;
+
+	for (n = 3; length; length >>= 1, n++)
+	{
+		if (length & 1)
+			crc = multiply_mod(model, model->x2n[n], crc);
+	}
+	return crc;
+}
+
+static uint32_t adler32_update(uint32_t adler, const uint8_t * buffer, size_t length)
+{
+	uint32_t a = adler & 0xffff, b = adler >> 16;
+	size_t chunk;
+
+	while (length)
+	{
+		chunk = length < ADLER_NMAX ? length : ADLER_NMAX;
+		length -= chunk;
+		for (; chunk; buffer++, chunk--)
+		{
+			a += *buffer;
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return (b << 16) | a;
+}
+
+/**
+ * Computes a checksum of a buffer, continuing from the checksum of the data before it, in the same
+ * way as zlib's crc32 and adler32 functions.
+ * @param type - the kind of checksum, one of the FIXUP_* values other than FIXUP_LENGTH
+ * @param checksum - the checksum of the data before buffer, or the checksum of no data (1 for
+ * FIXUP_ADLER32 and 0 for the CRCs)
+ * @param buffer - the data to checksum
+ * @param length - the length of buffer
+ * @return - the checksum of the data before buffer followed by buffer
+ */
+MUTATORS_API uint32_t fixup_checksum(int type, uint32_t checksum, const uint8_t * buffer, size_t length)
+{
+	const crc_model_t * model;
+
+	if (type == FIXUP_ADLER32)
+		return adler32_update(checksum, buffer, length);
+	init_crc_models();
+	model = get_crc_model(type);
+	return crc_update(model, checksum ^ model->xorout, buffer, length) ^ model->xorout;
+}
+
+static uint32_t initial_checksum(int type)
+{
+	return type == FIXUP_ADLER32 ? 1 : 0;
+}
+
+//The size of the blocks that buffers are compared in.  memcmp is vectorized, so the blocks are
+//compared with it and only the block with the difference is compared byte by byte.
+#define COMPARE_BLOCK_SIZE 256
+
+/* The length of the common prefix of two buffers */
+static size_t first_difference(const uint8_t * a, const uint8_t * b, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i + COMPARE_BLOCK_SIZE <= length && !memcmp(a + i, b + i, COMPARE_BLOCK_SIZE); i += COMPARE_BLOCK_SIZE);
+	for (; i < length && a[i] == b[i]; i++);
+	return i;
+}
+
+/* One past the last offset where two buffers differ, or 0 if they're the same */
+static size_t last_difference(const uint8_t * a, const uint8_t * b, size_t length)
+{
+	for (; length >= COMPARE_BLOCK_SIZE && !memcmp(a + length - COMPARE_BLOCK_SIZE, b + length - COMPARE_BLOCK_SIZE,
+		COMPARE_BLOCK_SIZE); length -= COMPARE_BLOCK_SIZE);
+	for (; length && a[length - 1] == b[length - 1]; length--);
+	return length;
+}
+
+/* Finds the bytes covered by a fixup in a buffer of the given length.  Returns nonzero if the buffer
+   is too short for them. */
+static int resolve_offset(int offset, size_t length, size_t * resolved)
+{
+	size_t distance = offset < 0 ? (size_t)(-(int64_t)offset) : (size_t)offset;
+
+	if (distance > length)
+		return 1;
+	*resolved = offset < 0 ? length - distance : distance;
+	return 0;
+}
+
+static int resolve_covered(fixup_t * fixup, size_t length, size_t * start, size_t * end)
+{
+	*end = length;
+	if (resolve_offset(fixup->start, length, start) || (fixup->has_end && resolve_offset(fixup->end, length, end)))
+		return 1;
+	return *start > *end;
+}
+
+/* Recomputes a checksum from the difference between the buffer and the reference, which differ in
+   the bytes from first up to last, but are the same length.  The CRCs are linear, so the CRC of the
+   XOR of the two buffers (followed by however many bytes are after last) is XORed with the
+   reference's CRC.  Adler-32's sums are adjusted by the change in each byte. */
+static uint32_t checksum_difference(fixup_t * fixup, const uint8_t * reference, const uint8_t * buffer, size_t first,
+	size_t last, size_t end)
+{
+	const crc_model_t * model;
+	uint8_t difference[1024];
+	uint32_t crc = 0, weight;
+	int64_t a = 0, b = 0, change;
+	size_t i, j, chunk;
+
+	if (fixup->type == FIXUP_ADLER32) {
+		//Each byte is added to b once for each byte from it to the end of the covered bytes
+		weight = (uint32_t)((end - first) % ADLER_BASE);
+		for (i = first; i < last; i++)
+		{
+			change = (int64_t)buffer[i] - reference[i];
+			a += change;
+			b += change * weight;
+			weight = weight ? weight - 1 : ADLER_BASE - 1;
+		}
+		a = ((fixup->reference_checksum & 0xffff) + a % ADLER_BASE + ADLER_BASE) % ADLER_BASE;
+		b = ((fixup->reference_checksum >> 16) + b % ADLER_BASE + ADLER_BASE) % ADLER_BASE;
+		return ((uint32_t)b << 16) | (uint32_t)a;
+	}
+
+	model = get_crc_model(fixup->type);
+	for (i = first; i < last; i += chunk)
+	{
+		chunk = last - i < sizeof(difference) ? last - i : sizeof(difference);
+		for (j = 0; j < chunk; j++)
+			difference[j] = reference[i + j] ^ buffer[i + j];
+		crc = crc_update(model, crc, difference, chunk);
+	}
+	return fixup->reference_checksum ^ crc_append_zeros(model, crc, end - last);
+}
+
+/* Computes the checksum of the bytes from start up to end of the buffer, only checksumming the bytes
+   that differ from the reference when possible */
+static uint32_t compute_checksum(fixup_list_t * list, fixup_t * fixup, const uint8_t * buffer, size_t start, size_t end)
+{
+	const uint8_t * reference = list->reference;
+	size_t common, first, last, checkpoint;
+
+	if (!list->valid || !fixup->reference_covered || start != fixup->reference_start)
+		return fixup_checksum(fixup->type, initial_checksum(fixup->type), buffer + start, end - start);
+
+	common = end < fixup->reference_end ? end : fixup->reference_end;
+	first = start + first_difference(reference + start, buffer + start, common - start);
+	if (end == fixup->reference_end) {
+		if (first == end)
+			return fixup->reference_checksum;
+		last = first + last_difference(reference + first, buffer + first, end - first);
+		return checksum_difference(fixup, reference, buffer, first, last, end);
+	}
+
+	//The number of bytes covered changed, so continue from the last checkpoint before the first change
+	checkpoint = (first - start) / FIXUP_CHECKPOINT_SIZE;
+	start += checkpoint * FIXUP_CHECKPOINT_SIZE;
+	return fixup_checksum(fixup->type, fixup->checkpoints[checkpoint], buffer + start, end - start);
+}
+
+static void write_field(uint8_t * field, uint64_t value, int size, int big_endian)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		field[big_endian ? size - 1 - i : i] = (uint8_t)(value >> (8 * i));
+}
+
+/* Reads an optional integer from a fixup's options.  Returns nonzero if it has the wrong type. */
+static int get_fixup_int(json_t * obj, const char * name, int * value, int * found)
+{
+	int result, temp;
+
+	temp = get_int_options_from_json(obj, name, &result);
+	if (result < 0) {
+		printf("The %s of a fixup must be an integer\n", name);
+		return 1;
+	}
+	if (result > 0)
+		*value = temp;
+	if (found)
+		*found = result > 0;
+	return 0;
+}
+
+static int parse_fixup(fixup_t * fixup, json_t * obj)
+{
+	char * type, * endian;
+	int result, found, i;
+
+	type = get_string_options_from_json(obj, "type", &result);
+	if (result <= 0) {
+		printf("Each fixup must have a type\n");
+		return 1;
+	}
+	for (i = 0; i <= FIXUP_LENGTH && strcmp(type, fixup_type_names[i]); i++);
+	if (i > FIXUP_LENGTH)
+		printf("Unknown fixup type '%s'\n", type);
+	free(type);
+	if (i > FIXUP_LENGTH)
+		return 1;
+	fixup->type = i;
+	fixup->size = i == FIXUP_CRC16 ? 2 : 4;
+
+	if (get_fixup_int(obj, "offset", &fixup->offset, &found) || get_fixup_int(obj, "start", &fixup->start, NULL)
+		|| get_fixup_int(obj, "end", &fixup->end, &fixup->has_end) || get_fixup_int(obj, "adjust", &fixup->adjust, NULL)
+		|| (fixup->type == FIXUP_LENGTH && get_fixup_int(obj, "size", &fixup->size, NULL)))
+		return 1;
+	if (!found) {
+		printf("Each fixup must have an offset\n");
+		return 1;
+	}
+	if (fixup->size != 1 && fixup->size != 2 && fixup->size != 4 && fixup->size != 8) {
+		printf("The size of a length fixup must be 1, 2, 4, or 8\n");
+		return 1;
+	}
+
+	endian = get_string_options_from_json(obj, "endian", &result);
+	if (result < 0)
+		return 1;
+	if (result > 0) {
+		fixup->big_endian = !strcmp(endian, "big");
+		if (!fixup->big_endian && strcmp(endian, "little"))
+			result = -1;
+		free(endian);
+		if (result < 0) {
+			printf("The endian of a fixup must be little or big\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Sets the fixups that a fixup list applies from a mutator's options.  The fixups option is a
+ * list of objects, each with a type (crc32, crc32c, adler32, crc16, or length), the offset of
+ * the field, and optionally the start and end of the bytes it covers (by default, the whole
+ * output), its endian (little, the default, or big), and for length fields, their size (1, 2, 4
+ * or 8, default 4) and an adjust to add to the length.
+ * @param list - the fixup_list_t to set the fixups of
+ * @param options - the mutator's options, or NULL
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int fixup_list_parse(fixup_list_t * list, char * options)
+{
+	json_t * fixup_obj;
+	fixup_t * fixups;
+	int result;
+
+	fixup_list_free(list);
+	if (!options)
+		return 0;
+	init_crc_models();
+
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(options, fixups_array, "fixups", fixup_obj, result)
+		fixups = (fixup_t *)realloc(list->fixups, (list->count + 1) * sizeof(fixup_t));
+		if (!fixups) {
+			result = -1;
+			break;
+		}
+		list->fixups = fixups;
+		memset(&list->fixups[list->count], 0, sizeof(fixup_t));
+		list->count++;
+		if (parse_fixup(&list->fixups[list->count - 1], fixup_obj)) {
+			result = -1;
+			break;
+		}
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_END(fixups_array);
+
+	if (result < 0) {
+		fixup_list_free(list);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Frees the fixups and reference buffer of a fixup_list_t.  The fixup_list_t itself is not freed.
+ * @param list - the fixup_list_t to free
+ */
+MUTATORS_API void fixup_list_free(fixup_list_t * list)
+{
+	size_t i;
+
+	for (i = 0; i < list->count; i++)
+		free(list->fixups[i].checkpoints);
+	free(list->fixups);
+	free(list->reference);
+	memset(list, 0, sizeof(fixup_list_t));
+}
+
+/**
+ * Counts the memory allocated by a fixup_list_t, not including the fixup_list_t itself
+ * @param list - the fixup_list_t to count the memory of
+ * @return - the number of bytes allocated for the fixups, their checkpoints, and the reference buffer
+ */
+MUTATORS_API size_t fixup_list_memory_usage(const fixup_list_t * list)
+{
+	size_t i, bytes = list->count * sizeof(fixup_t);
+
+	for (i = 0; i < list->count; i++)
+		bytes += list->fixups[i].checkpoints_count * sizeof(uint32_t);
+	if (list->reference)
+		bytes += list->reference_length ? list->reference_length : 1;
+	return bytes;
+}
+
+/**
+ * Sets the reference buffer that the outputs are compared with, and checksums the bytes that each
+ * fixup covers in it.  Nothing is done if the reference is still valid, so this can be called with the
+ * unmodified input before every mutation; the valid field should be cleared when the input changes.
+ * The outputs are fixed up correctly whatever the reference is, but only the outputs that are
+ * similar to it are fixed up incrementally.
+ * @param list - the fixup_list_t to update
+ * @param input - the new reference buffer, usually the input
+ * @param input_length - the length of input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int fixup_list_update(fixup_list_t * list, const uint8_t * input, size_t input_length)
+{
+	fixup_t * fixup;
+	uint8_t * reference;
+	uint32_t * checkpoints, checksum;
+	size_t i, j, start, end, count, chunk;
+
+	if (!list->count || list->valid)
+		return 0;
+	reference = (uint8_t *)realloc(list->reference, input_length ? input_length : 1);
+	if (!reference)
+		return 1;
+	list->reference = reference;
+	memcpy(list->reference, input, input_length);
+	list->reference_length = input_length;
+
+	for (i = 0; i < list->count; i++)
+	{
+		fixup = &list->fixups[i];
+		fixup->reference_covered = 0;
+		if (fixup->type == FIXUP_LENGTH || resolve_covered(fixup, input_length, &start, &end))
+			continue;
+
+		count = (end - start) / FIXUP_CHECKPOINT_SIZE + 1;
+		checkpoints = (uint32_t *)realloc(fixup->checkpoints, count * sizeof(uint32_t));
+		if (!checkpoints)
+			return 1;
+		fixup->checkpoints = checkpoints;
+		fixup->checkpoints_count = count;
+
+		checksum = initial_checksum(fixup->type);
+		for (j = 0; j < count; j++)
+		{
+			fixup->checkpoints[j] = checksum;
+			chunk = end - start - j * FIXUP_CHECKPOINT_SIZE;
+			if (chunk > FIXUP_CHECKPOINT_SIZE)
+				chunk = FIXUP_CHECKPOINT_SIZE;
+			checksum = fixup_checksum(fixup->type, checksum, input + start + j * FIXUP_CHECKPOINT_SIZE, chunk);
+		}
+		fixup->reference_checksum = checksum;
+		fixup->reference_start = start;
+		fixup->reference_end = end;
+		fixup->reference_covered = 1;
+	}
+	list->valid = 1;
+	return 0;
+}
+
+/**
+ * Applies the fixups to an output, in order.  The fixups that don't fit in the output (because it
+ * has gotten shorter than their offsets) are skipped.
+ * @param list - the fixup_list_t with the fixups to apply
+ * @param buffer - the output to fix up
+ * @param length - the length of the output
+ */
+MUTATORS_API void fixup_list_apply(fixup_list_t * list, uint8_t * buffer, size_t length)
+{
+	fixup_t * fixup;
+	size_t i, start, end, field;
+	uint64_t value;
+
+	for (i = 0; i < list->count; i++)
+	{
+		fixup = &list->fixups[i];
+		if (resolve_covered(fixup, length, &start, &end) || resolve_offset(fixup->offset, length, &field)
+			|| field + fixup->size > length)
+			continue;
+		if (fixup->type == FIXUP_LENGTH)
+			value = (uint64_t)((int64_t)(end - start) + fixup->adjust);
+		else
+			value = compute_checksum(list, fixup, buffer, start, end);
+		write_field(buffer + field, value, fixup->size, fixup->big_endian);
+	}
+}
+
+//The caller's verdict function, which the minimization candidates are passed on to once they're fixed up
+typedef struct {
+	fixup_list_t * list;
+	edit_trace_verdict_t verdict;
+	void * context;
+} fixup_verdict_t;
+
+static int fixup_verdict(void * context, const char * buffer, size_t length)
+{
+	fixup_verdict_t * fixup_context = (fixup_verdict_t *)context;
+
+	//The candidates are in the buffer given to edit_trace_minimize, so they can be modified
+	fixup_list_apply(fixup_context->list, (uint8_t *)buffer, length);
+	return fixup_context->verdict(fixup_context->context, buffer, length);
+}
+
+/**
+ * Minimizes an output with edit_trace_minimize, applying the fixups to each candidate before it's
+ * passed to the verdict function, since reverting operations leaves the checksums and lengths stale.
+ * @param list - the fixup_list_t with the fixups to apply
+ * @param trace - the edit_trace_t with the operations that produced the output
+ * @param output - the output to minimize
+ * @param output_length - the length of output
+ * @param buffer - a buffer that the minimized output will be written to
+ * @param buffer_length - the size of buffer
+ * @param verdict - a function that's called with each candidate, which returns nonzero if the
+ * candidate is still interesting
+ * @param context - an argument to pass to verdict
+ * @return - the length of the minimized output, or -1 on failure
+ */
+MUTATORS_API int fixup_list_minimize(fixup_list_t * list, edit_trace_t * trace, const uint8_t * output, size_t output_length,
+	uint8_t * buffer, size_t buffer_length, edit_trace_verdict_t verdict, void * context)
+{
+	fixup_verdict_t fixup_context;
+	int length;
+
+	if (!list->count)
+		return edit_trace_minimize(trace, output, output_length, buffer, buffer_length, verdict, context);
+	fixup_context.list = list;
+	fixup_context.verdict = verdict;
+	fixup_context.context = context;
+	length = edit_trace_minimize(trace, output, output_length, buffer, buffer_length, fixup_verdict, &fixup_context);
+	if (length > 0)
+		fixup_list_apply(list, buffer, length);
+	return length;
+}
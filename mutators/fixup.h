@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mutators.h"
+#include "edit_trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The kinds of fields that a fixup can recompute
+enum {
+	FIXUP_CRC32,   //The CRC-32 used by zlib, gzip, PNG, and zip, 4 bytes
+	FIXUP_CRC32C,  //The CRC-32C (Castagnoli) used by iSCSI, SCTP, and ext4, 4 bytes
+	FIXUP_ADLER32, //The Adler-32 used by zlib, 4 bytes
+	FIXUP_CRC16,   //The CRC-16/ARC used by LHA and many serial protocols, 2 bytes
+	FIXUP_LENGTH,  //The number of bytes covered, plus adjust
+};
+
+//The number of bytes between the saved checksums of the start of each fixup's covered bytes
+#define FIXUP_CHECKPOINT_SIZE 4096
+
+//A field of the output (such as a checksum or a length prefix) that is recomputed after each
+//mutation, so the target doesn't reject the output before it gets to the interesting code.  The
+//offsets can be negative, in which case they count back from the end of the output.
+typedef struct {
+	int type;       //One of the FIXUP_* values
+	int start;      //The first offset covered by the field
+	int end;        //One past the last offset covered by the field
+	int has_end;    //Whether end was given; if not, the covered bytes go to the end of the output
+	int offset;     //The offset that the field is written to
+	int size;       //The size of the field in bytes
+	int big_endian;
+	int adjust;     //Added to the number of bytes covered by a length field
+
+	//The checksum of the bytes that the field covers in the reference buffer, and the checksum of
+	//the first i * FIXUP_CHECKPOINT_SIZE of those bytes for each i, so that outputs that only
+	//differ from the reference in part of the covered bytes can be checksummed incrementally
+	int reference_covered;    //Whether the reference buffer has the covered bytes and the field
+	size_t reference_start;
+	size_t reference_end;
+	uint32_t reference_checksum;
+	uint32_t * checkpoints;
+	size_t checkpoints_count;
+} fixup_t;
+
+//The fixups that a mutator applies to each of its outputs, in order, so a length can be fixed up
+//before the checksum that covers it.  The outputs are compared with a reference buffer (usually
+//the input), so that only the part of each checksum that changed has to be recomputed.
+typedef struct {
+	fixup_t * fixups;
+	size_t count;
+	uint8_t * reference;
+	size_t reference_length;
+	int valid; //Whether the reference buffer and its checksums are up to date
+} fixup_list_t;
+
+MUTATORS_API int fixup_list_parse(fixup_list_t * list, char * options);
+MUTATORS_API void fixup_list_free(fixup_list_t * list);
+MUTATORS_API size_t fixup_list_memory_usage(const fixup_list_t * list);
+MUTATORS_API int fixup_list_update(fixup_list_t * list, const uint8_t * input, size_t input_length);
+MUTATORS_API void fixup_list_apply(fixup_list_t * list, uint8_t * buffer, size_t length);
+MUTATORS_API int fixup_list_minimize(fixup_list_t * list, edit_trace_t * trace, const uint8_t * output, size_t output_length,
+	uint8_t * buffer, size_t buffer_length, edit_trace_verdict_t verdict, void * context);
+MUTATORS_API uint32_t fixup_checksum(int type, uint32_t checksum, const uint8_t * buffer, size_t length);
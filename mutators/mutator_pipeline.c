@@ -0,0 +1,588 @@
+#include "mutator_pipeline.h"
+
+#include <jansson.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#define ATOMIC_LOAD(x) ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(x), 0, 0))
+#define ATOMIC_STORE(x, value) InterlockedExchange64((volatile LONG64 *)(x), (LONG64)(value))
+#else
+#include <pthread.h>
+#define ATOMIC_LOAD(x) __atomic_load_n(x, __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(x, value) __atomic_store_n(x, value, __ATOMIC_SEQ_CST)
+#endif
+
+//The requests that the consumer makes of the producer thread
+#define PIPELINE_RUN   0
+#define PIPELINE_PAUSE 1
+#define PIPELINE_STOP  2
+
+typedef struct {
+	char * buffer;
+	int length;    //What the mutator's mutate function returned
+	int iteration; //The mutator's iteration after it generated the testcase
+} pipeline_slot_t;
+
+//A saved mutator state, and the number of testcases that had been generated when it was saved
+typedef struct {
+	uint64_t position;
+	char * state;
+} pipeline_checkpoint_t;
+
+struct mutator_pipeline
+{
+	mutator_t * mutator;
+	void * mutator_state;
+	char * options;
+	char * input;
+	size_t input_length;
+
+	//The testcases are numbered in the order they're generated, and testcase n is in slot
+	//n % num_slots.  The producer fills the slots up to head, the consumer hands out the slots up to
+	//read, and the slots up to tail have been released so the producer can fill them again.
+	pipeline_slot_t * slots;
+	char * buffers;
+	size_t num_slots;
+	size_t slot_size;
+	uint64_t head;
+	uint64_t tail;
+	uint64_t read;
+	int iteration; //The iteration of the last testcase handed out
+
+	//The mutator's state is saved every num_slots testcases, so the state as of the last testcase
+	//handed out can be recreated by replaying the testcases after the last checkpoint before it.
+	//checkpoints[1] is the newest.
+	pipeline_checkpoint_t checkpoints[2];
+	int replay_unsafe; //Set when the options make the testcases depend on more than the mutator's state, so they can't be replayed
+
+	uint64_t control;          //One of the PIPELINE_* values
+	uint64_t producer_waiting; //Set while the producer is waiting for a slot to be released
+	uint64_t consumer_waiting; //Set while the consumer is waiting for a slot to be filled
+	int paused;                //Set while the producer is paused
+	int finished;              //Set once the mutator has run out of mutations (or failed)
+
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE cond;
+	HANDLE thread;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int thread_started;
+#endif
+};
+
+static void lock_pipeline(mutator_pipeline_t * pipeline)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&pipeline->lock);
+#else
+	pthread_mutex_lock(&pipeline->lock);
+#endif
+}
+
+static void unlock_pipeline(mutator_pipeline_t * pipeline)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&pipeline->lock);
+#else
+	pthread_mutex_unlock(&pipeline->lock);
+#endif
+}
+
+//Waits for the other thread to wake this one.  The lock must be held.
+static void wait_pipeline(mutator_pipeline_t * pipeline)
+{
+#ifdef _WIN32
+	SleepConditionVariableCS(&pipeline->cond, &pipeline->lock, INFINITE);
+#else
+	pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+#endif
+}
+
+//Wakes the other thread.  The lock must be held.
+static void wake_pipeline(mutator_pipeline_t * pipeline)
+{
+#ifdef _WIN32
+	WakeAllConditionVariable(&pipeline->cond);
+#else
+	pthread_cond_broadcast(&pipeline->cond);
+#endif
+}
+
+/* Replaces the older checkpoint with the mutator's current state */
+static void add_checkpoint(mutator_pipeline_t * pipeline, uint64_t position)
+{
+	if (pipeline->checkpoints[0].state)
+		pipeline->mutator->free_state(pipeline->checkpoints[0].state);
+	pipeline->checkpoints[0] = pipeline->checkpoints[1];
+	pipeline->checkpoints[1].position = position;
+	pipeline->checkpoints[1].state = pipeline->mutator->get_state(pipeline->mutator_state);
+}
+
+/* Replaces both checkpoints with the mutator's current state, after it's been changed other than by mutating */
+static void reset_checkpoints(mutator_pipeline_t * pipeline, uint64_t position)
+{
+	add_checkpoint(pipeline, position);
+	add_checkpoint(pipeline, position);
+}
+
+/* Generates testcases until the consumer asks the producer to stop */
+static void produce_testcases(mutator_pipeline_t * pipeline)
+{
+	pipeline_slot_t * slot;
+	uint64_t head;
+	int stop;
+
+	while (1)
+	{
+		if (ATOMIC_LOAD(&pipeline->control) != PIPELINE_RUN) {
+			lock_pipeline(pipeline);
+			while (pipeline->control == PIPELINE_PAUSE) {
+				pipeline->paused = 1;
+				wake_pipeline(pipeline);
+				wait_pipeline(pipeline);
+			}
+			pipeline->paused = 0;
+			stop = pipeline->control == PIPELINE_STOP;
+			unlock_pipeline(pipeline);
+			if (stop)
+				return;
+			continue;
+		}
+
+		//Wait for the consumer to release a slot if they're all full
+		head = pipeline->head;
+		if (pipeline->finished || head - ATOMIC_LOAD(&pipeline->tail) == pipeline->num_slots) {
+			lock_pipeline(pipeline);
+			ATOMIC_STORE(&pipeline->producer_waiting, 1);
+			while (ATOMIC_LOAD(&pipeline->control) == PIPELINE_RUN
+				&& (pipeline->finished || head - ATOMIC_LOAD(&pipeline->tail) == pipeline->num_slots))
+				wait_pipeline(pipeline);
+			ATOMIC_STORE(&pipeline->producer_waiting, 0);
+			unlock_pipeline(pipeline);
+			continue;
+		}
+
+		slot = &pipeline->slots[head % pipeline->num_slots];
+		slot->length = pipeline->mutator->mutate(pipeline->mutator_state, slot->buffer, pipeline->slot_size);
+		slot->iteration = pipeline->mutator->get_current_iteration(pipeline->mutator_state);
+		if (slot->length <= 0)
+			pipeline->finished = 1;
+		else if ((head + 1) % pipeline->num_slots == 0)
+			add_checkpoint(pipeline, head + 1);
+
+		//Publish the slot, then wake the consumer if it's waiting for it
+		ATOMIC_STORE(&pipeline->head, head + 1);
+		if (ATOMIC_LOAD(&pipeline->consumer_waiting)) {
+			lock_pipeline(pipeline);
+			wake_pipeline(pipeline);
+			unlock_pipeline(pipeline);
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI producer_thread(LPVOID arg)
+{
+	produce_testcases((mutator_pipeline_t *)arg);
+	return 0;
+}
+#else
+static void * producer_thread(void * arg)
+{
+	produce_testcases((mutator_pipeline_t *)arg);
+	return NULL;
+}
+#endif
+
+/* Waits for the producer to stop between testcases, so the mutator can be used from the consumer's thread */
+static void pause_producer(mutator_pipeline_t * pipeline)
+{
+	lock_pipeline(pipeline);
+	ATOMIC_STORE(&pipeline->control, PIPELINE_PAUSE);
+	wake_pipeline(pipeline);
+	while (!pipeline->paused)
+		wait_pipeline(pipeline);
+	unlock_pipeline(pipeline);
+}
+
+static void resume_producer(mutator_pipeline_t * pipeline)
+{
+	lock_pipeline(pipeline);
+	ATOMIC_STORE(&pipeline->control, PIPELINE_RUN);
+	wake_pipeline(pipeline);
+	unlock_pipeline(pipeline);
+}
+
+/* Throws away the testcases that haven't been handed out yet.  The producer must be paused, and
+   the mutator's state must be the state as of the last testcase that was handed out. */
+static void drop_testcases(mutator_pipeline_t * pipeline)
+{
+	pipeline->head = pipeline->read;
+	pipeline->finished = 0;
+}
+
+/**
+ * Checks whether a mutator's options make its testcases depend on more than its state.  The
+ * duplicate output filter (dedup_size and dedup_file) isn't saved in the state, and may be shared
+ * with other mutators, so a replayed duplicate may not be replaced the same way.  The schedule's
+ * milliseconds budgets end the stages at different testcases each time they're run.
+ * @param options - the mutator's options, or NULL
+ * @return - 1 if the testcases can't be replayed from a checkpoint, 0 otherwise
+ */
+static int options_prevent_replay(char * options)
+{
+	json_t * root, * schedule;
+	size_t i;
+	int ret;
+
+	if (!options)
+		return 0;
+	root = json_loads(options, 0, NULL);
+	if (!root)
+		return 0;
+	ret = json_object_get(root, "dedup_size") || json_object_get(root, "dedup_file");
+	schedule = json_object_get(root, "schedule");
+	for (i = 0; json_is_array(schedule) && i < json_array_size(schedule); i++)
+	{
+		if (json_object_get(json_array_get(schedule, i), "milliseconds"))
+			ret = 1;
+	}
+	json_decref(root);
+	return ret;
+}
+
+/**
+ * Gets the mutator's state as of the last testcase that was handed out, i.e. without the effects of
+ * the testcases that the producer has generated since.  The producer must be paused.  If there are
+ * testcases waiting in the ring, a second copy of the mutator is created from the last checkpoint
+ * before the last testcase handed out, and the testcases after the checkpoint are generated again.
+ * That fails if the mutator's options prevent the testcases from being replayed.
+ * @param pipeline - the mutator_pipeline_t to get the state of
+ * @return - the state, which should be freed with the mutator's free_state function, or NULL on failure
+ */
+static char * get_consumed_state(mutator_pipeline_t * pipeline)
+{
+	pipeline_checkpoint_t * checkpoint;
+	void * replay_state;
+	char * buffer, * state = NULL;
+	uint64_t i;
+
+	if (pipeline->head == pipeline->read)
+		return pipeline->mutator->get_state(pipeline->mutator_state);
+	if (pipeline->replay_unsafe) {
+		printf("The mutator's state can't be saved while it has testcases waiting in the pipeline, since its dedup or "
+			"milliseconds options prevent them from being replayed\n");
+		return NULL;
+	}
+
+	checkpoint = &pipeline->checkpoints[pipeline->checkpoints[1].position <= pipeline->read ? 1 : 0];
+	if (!checkpoint->state || checkpoint->position > pipeline->read)
+		return NULL;
+	replay_state = pipeline->mutator->create(pipeline->options, checkpoint->state, pipeline->input, pipeline->input_length);
+	if (!replay_state)
+		return NULL;
+	buffer = (char *)malloc(pipeline->slot_size);
+	if (buffer) {
+		for (i = checkpoint->position; i < pipeline->read; i++)
+		{
+			if (pipeline->mutator->mutate(replay_state, buffer, pipeline->slot_size) <= 0)
+				break;
+		}
+		if (i == pipeline->read)
+			state = pipeline->mutator->get_state(replay_state);
+		free(buffer);
+	}
+	pipeline->mutator->cleanup(replay_state);
+	return state;
+}
+
+/**
+ * Creates a mutator and starts generating its testcases on a background thread.  The testcases are
+ * retrieved with mutator_pipeline_next_testcase, and the pipeline should be freed with
+ * mutator_pipeline_cleanup.  While the pipeline is running, the mutator should only be used through
+ * the pipeline's functions.
+ * @param mutator - the mutator to run
+ * @param options - the options to create the mutator with
+ * @param state - optionally, a previously dumped state to create the mutator with
+ * @param input - the input that the mutator will be mutating
+ * @param input_length - the size of the input parameter
+ * @param num_slots - the number of testcases that can be generated ahead of the fuzzer
+ * @param slot_size - the size of the buffer that each testcase is generated in
+ * @return - the new pipeline, or NULL on failure
+ */
+MUTATORS_API mutator_pipeline_t * mutator_pipeline_create(mutator_t * mutator, char * options, char * state, char * input,
+	size_t input_length, size_t num_slots, size_t slot_size)
+{
+	mutator_pipeline_t * pipeline;
+	size_t i;
+
+	if (!num_slots || !slot_size)
+		return NULL;
+	pipeline = (mutator_pipeline_t *)calloc(1, sizeof(mutator_pipeline_t));
+	if (!pipeline)
+		return NULL;
+	pipeline->mutator = mutator;
+	pipeline->num_slots = num_slots;
+	pipeline->slot_size = slot_size;
+#ifdef _WIN32
+	InitializeCriticalSection(&pipeline->lock);
+	InitializeConditionVariable(&pipeline->cond);
+#else
+	pthread_mutex_init(&pipeline->lock, NULL);
+	pthread_cond_init(&pipeline->cond, NULL);
+#endif
+
+	pipeline->options = options ? strdup(options) : NULL;
+	pipeline->replay_unsafe = options_prevent_replay(options);
+	pipeline->input = (char *)malloc(input_length);
+	pipeline->slots = (pipeline_slot_t *)calloc(num_slots, sizeof(pipeline_slot_t));
+	pipeline->buffers = (char *)malloc(num_slots * slot_size);
+	if ((options && !pipeline->options) || !pipeline->input || !pipeline->slots || !pipeline->buffers) {
+		mutator_pipeline_cleanup(pipeline);
+		return NULL;
+	}
+	memcpy(pipeline->input, input, input_length);
+	pipeline->input_length = input_length;
+	for (i = 0; i < num_slots; i++)
+		pipeline->slots[i].buffer = pipeline->buffers + i * slot_size;
+
+	pipeline->mutator_state = mutator->create(options, state, input, input_length);
+	if (!pipeline->mutator_state) {
+		mutator_pipeline_cleanup(pipeline);
+		return NULL;
+	}
+	pipeline->iteration = mutator->get_current_iteration(pipeline->mutator_state);
+	reset_checkpoints(pipeline, 0);
+
+#ifdef _WIN32
+	pipeline->thread = CreateThread(NULL, 0, producer_thread, pipeline, 0, NULL);
+	if (!pipeline->thread) {
+#else
+	pipeline->thread_started = !pthread_create(&pipeline->thread, NULL, producer_thread, pipeline);
+	if (!pipeline->thread_started) {
+#endif
+		printf("Couldn't start the mutator pipeline's thread\n");
+		mutator_pipeline_cleanup(pipeline);
+		return NULL;
+	}
+	return pipeline;
+}
+
+/**
+ * Stops the producer thread, and frees the pipeline and its mutator.  Any testcases that haven't
+ * been released can't be used afterwards.
+ * @param pipeline - the mutator_pipeline_t to free
+ */
+MUTATORS_API void mutator_pipeline_cleanup(mutator_pipeline_t * pipeline)
+{
+	int i;
+
+#ifdef _WIN32
+	if (pipeline->thread) {
+#else
+	if (pipeline->thread_started) {
+#endif
+		lock_pipeline(pipeline);
+		ATOMIC_STORE(&pipeline->control, PIPELINE_STOP);
+		wake_pipeline(pipeline);
+		unlock_pipeline(pipeline);
+#ifdef _WIN32
+		WaitForSingleObject(pipeline->thread, INFINITE);
+		CloseHandle(pipeline->thread);
+#else
+		pthread_join(pipeline->thread, NULL);
+#endif
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if (pipeline->checkpoints[i].state)
+			pipeline->mutator->free_state(pipeline->checkpoints[i].state);
+	}
+	if (pipeline->mutator_state)
+		pipeline->mutator->cleanup(pipeline->mutator_state);
+#ifdef _WIN32
+	DeleteCriticalSection(&pipeline->lock);
+#else
+	pthread_mutex_destroy(&pipeline->lock);
+	pthread_cond_destroy(&pipeline->cond);
+#endif
+	free(pipeline->options);
+	free(pipeline->input);
+	free(pipeline->slots);
+	free(pipeline->buffers);
+	free(pipeline);
+}
+
+/**
+ * Gets the next testcase, waiting for the producer to generate it if necessary.  The testcases are
+ * handed out in the order they were generated, so their iterations are in order too.  The testcase
+ * stays valid until it's released with mutator_pipeline_release_testcase.  Several testcases can be
+ * held at once, but they must be released in the order they were handed out.
+ * @param pipeline - the mutator_pipeline_t to get the testcase from
+ * @param testcase - used to return the testcase, which is owned by the pipeline
+ * @param iteration - optionally, used to return the mutator's iteration after it generated the
+ * testcase (i.e. the value its get_current_iteration function returned)
+ * @return - the length of the testcase, 0 when the mutator is out of mutations, or -1 on error.  Once
+ * 0 or -1 is returned, it's returned again until the state or input is changed.
+ */
+MUTATORS_API int mutator_pipeline_next_testcase(mutator_pipeline_t * pipeline, char ** testcase, int * iteration)
+{
+	pipeline_slot_t * slot;
+	uint64_t read = pipeline->read;
+
+	if (read - pipeline->tail == pipeline->num_slots) //Every slot is waiting to be released
+		return -1;
+	if (ATOMIC_LOAD(&pipeline->head) == read) {
+		lock_pipeline(pipeline);
+		ATOMIC_STORE(&pipeline->consumer_waiting, 1);
+		while (ATOMIC_LOAD(&pipeline->head) == read)
+			wait_pipeline(pipeline);
+		ATOMIC_STORE(&pipeline->consumer_waiting, 0);
+		unlock_pipeline(pipeline);
+	}
+
+	slot = &pipeline->slots[read % pipeline->num_slots];
+	if (slot->length <= 0) //The last slot isn't handed out, so the mutator's state doesn't include it
+		return slot->length;
+	pipeline->read = read + 1;
+	pipeline->iteration = slot->iteration;
+	*testcase = slot->buffer;
+	if (iteration)
+		*iteration = slot->iteration;
+	return slot->length;
+}
+
+/**
+ * Releases the oldest testcase that was handed out by mutator_pipeline_next_testcase, so the
+ * producer can generate another testcase in its slot.
+ * @param pipeline - the mutator_pipeline_t that the testcase came from
+ */
+MUTATORS_API void mutator_pipeline_release_testcase(mutator_pipeline_t * pipeline)
+{
+	if (pipeline->tail == pipeline->read)
+		return;
+	ATOMIC_STORE(&pipeline->tail, pipeline->tail + 1);
+	if (ATOMIC_LOAD(&pipeline->producer_waiting)) {
+		lock_pipeline(pipeline);
+		wake_pipeline(pipeline);
+		unlock_pipeline(pipeline);
+	}
+}
+
+/**
+ * Gets the mutator's state as of the last testcase that was handed out, so that a fuzzer that
+ * saves the state and later restores it continues with the first testcase it didn't get.  The
+ * testcases that the producer generated ahead are replayed from a checkpoint on the consumer's
+ * thread, which takes at most two rings' worth of mutations.  If the mutator's options include
+ * the duplicate output filter or a schedule with milliseconds budgets, the testcases can't be
+ * replayed, so this fails unless every testcase generated has been handed out.
+ * @param pipeline - the mutator_pipeline_t to get the state of
+ * @return - the state, which should be freed with mutator_pipeline_free_state, or NULL on failure
+ */
+MUTATORS_API char * mutator_pipeline_get_state(mutator_pipeline_t * pipeline)
+{
+	char * state;
+
+	pause_producer(pipeline);
+	state = get_consumed_state(pipeline);
+	resume_producer(pipeline);
+	return state;
+}
+
+/**
+ * Frees a state returned by mutator_pipeline_get_state
+ * @param pipeline - the mutator_pipeline_t that returned the state
+ * @param state - the state to free
+ */
+MUTATORS_API void mutator_pipeline_free_state(mutator_pipeline_t * pipeline, char * state)
+{
+	pipeline->mutator->free_state(state);
+}
+
+/**
+ * Sets the mutator's state.  The testcases that haven't been handed out yet are thrown away, and
+ * the producer starts again from the new state.
+ * @param pipeline - the mutator_pipeline_t to set the state of
+ * @param state - the state to load, as returned by mutator_pipeline_get_state
+ * @return 0 on success and -1 on failure
+ */
+MUTATORS_API int mutator_pipeline_set_state(mutator_pipeline_t * pipeline, char * state)
+{
+	int ret;
+
+	pause_producer(pipeline);
+	drop_testcases(pipeline);
+	ret = pipeline->mutator->set_state(pipeline->mutator_state, state);
+	pipeline->iteration = pipeline->mutator->get_current_iteration(pipeline->mutator_state);
+	reset_checkpoints(pipeline, pipeline->read);
+	resume_producer(pipeline);
+	return ret ? -1 : 0;
+}
+
+/**
+ * Sets the mutator's input.  The mutator is first rewound to the last testcase that was handed
+ * out, so none of its mutations are skipped, and the testcases generated from the old input that
+ * haven't been handed out yet are thrown away.  If the mutator's options prevent its testcases
+ * from being replayed (see mutator_pipeline_get_state), it isn't rewound, and the mutations
+ * in the thrown away testcases are skipped.
+ * @param pipeline - the mutator_pipeline_t to set the input of
+ * @param input - the new input
+ * @param input_length - the size of the input parameter
+ * @return 0 on success and -1 on failure
+ */
+MUTATORS_API int mutator_pipeline_set_input(mutator_pipeline_t * pipeline, char * input, size_t input_length)
+{
+	char * new_input, * state;
+	int ret = -1;
+
+	new_input = (char *)malloc(input_length);
+	if (!new_input)
+		return -1;
+	memcpy(new_input, input, input_length);
+
+	pause_producer(pipeline);
+	if (pipeline->head != pipeline->read && !pipeline->replay_unsafe) {
+		state = get_consumed_state(pipeline);
+		if (!state || pipeline->mutator->set_state(pipeline->mutator_state, state)) {
+			if (state)
+				pipeline->mutator->free_state(state);
+			free(new_input);
+			resume_producer(pipeline);
+			return -1;
+		}
+		pipeline->mutator->free_state(state);
+	}
+	drop_testcases(pipeline);
+
+	if (!pipeline->mutator->set_input(pipeline->mutator_state, input, input_length)) {
+		free(pipeline->input);
+		pipeline->input = new_input;
+		pipeline->input_length = input_length;
+		ret = 0;
+	}
+	else
+		free(new_input);
+	pipeline->iteration = pipeline->mutator->get_current_iteration(pipeline->mutator_state);
+	reset_checkpoints(pipeline, pipeline->read);
+	resume_producer(pipeline);
+	return ret;
+}
+
+/**
+ * Gets the mutator's iteration as of the last testcase that was handed out
+ * @param pipeline - the mutator_pipeline_t to get the iteration of
+ * @return - the iteration
+ */
+MUTATORS_API int mutator_pipeline_get_current_iteration(mutator_pipeline_t * pipeline)
+{
+	return pipeline->iteration;
+}
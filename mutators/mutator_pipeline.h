@@ -0,0 +1,24 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <global_types.h>
+
+#include <stddef.h>
+
+//Runs a mutator on a background thread, which fills a ring of preallocated testcase slots ahead
+//of the fuzzer, so generating the next testcase overlaps with running the current one.  The ring
+//has a single producer (the background thread) and a single consumer (the fuzzer), so the slots
+//are handed over without locks; the threads only sleep when the ring is full or empty.
+typedef struct mutator_pipeline mutator_pipeline_t;
+
+MUTATORS_API mutator_pipeline_t * mutator_pipeline_create(mutator_t * mutator, char * options, char * state, char * input,
+	size_t input_length, size_t num_slots, size_t slot_size);
+MUTATORS_API void mutator_pipeline_cleanup(mutator_pipeline_t * pipeline);
+MUTATORS_API int mutator_pipeline_next_testcase(mutator_pipeline_t * pipeline, char ** testcase, int * iteration);
+MUTATORS_API void mutator_pipeline_release_testcase(mutator_pipeline_t * pipeline);
+MUTATORS_API char * mutator_pipeline_get_state(mutator_pipeline_t * pipeline);
+MUTATORS_API void mutator_pipeline_free_state(mutator_pipeline_t * pipeline, char * state);
+MUTATORS_API int mutator_pipeline_set_state(mutator_pipeline_t * pipeline, char * state);
+MUTATORS_API int mutator_pipeline_set_input(mutator_pipeline_t * pipeline, char * input, size_t input_length);
+MUTATORS_API int mutator_pipeline_get_current_iteration(mutator_pipeline_t * pipeline);
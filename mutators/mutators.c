@@ -12,3 +12,45 @@ MUTATORS_API int return_unknown_or_infinite_total_iterations(void * mutator_stat
 {
 	return -1; //infinite
 }
+
+static const char * memory_usage_category_names[MEMORY_USAGE_CATEGORIES] = {
+	"state", "input", "dictionary", "splice_files", "seeds", "samples", "children", "indexes", "history", "dedup"
+};
+
+/**
+ * Adds up the bytes in each category of a mutator's memory usage
+ * @param usage - the memory usage, as returned by the mutator's get_memory_usage function
+ * @return - the total number of bytes
+ */
+MUTATORS_API uint64_t memory_usage_total(const memory_usage_t * usage)
+{
+	uint64_t total = 0;
+	int i;
+	for (i = 0; i < MEMORY_USAGE_CATEGORIES; i++)
+		total += usage->bytes[i];
+	return total;
+}
+
+/**
+ * Gets the name of one of the memory usage categories
+ * @param category - one of the MEMORY_USAGE_* values
+ * @return - the category's name, or NULL if category isn't valid
+ */
+MUTATORS_API const char * memory_usage_category_name(int category)
+{
+	if (category < 0 || category >= MEMORY_USAGE_CATEGORIES)
+		return NULL;
+	return memory_usage_category_names[category];
+}
+
+/**
+ * Checks whether a mutator can allocate more memory without going over its memory_limit option
+ * @param limit - the mutator's memory limit in bytes, or 0 if it doesn't have one
+ * @param used - the number of bytes that the limit applies to which the mutator already holds
+ * @param bytes - the number of bytes that the mutator wants to allocate
+ * @return - 1 if the memory fits under the limit, 0 if it doesn't
+ */
+MUTATORS_API int memory_usage_fits(uint64_t limit, uint64_t used, uint64_t bytes)
+{
+	return !limit || (used <= limit && bytes <= limit - used);
+}
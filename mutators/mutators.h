@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #ifdef _WIN32
 #if defined(MUTATORS_EXPORTS)
 #define MUTATORS_API __declspec(dllexport)
@@ -15,16 +17,46 @@
 #endif
 
 //If you're combining all of the mutators into one project, uncomment this to give them all
-//unique names
+//unique names.  Each mutator's functions are then prefixed with the MUTATOR_PREFIX from its
+//header, e.g. afl_create.  The mutators_all target defines this.
 //#define ALL_MUTATORS_IN_ONE
 #ifndef ALL_MUTATORS_IN_ONE
 #define FUNCNAME(name) name
 #else
-#define FUNCNAME(name) MUTATOR_NAME ## _ ## name
+#define FUNCNAME_PASTE(prefix, name) prefix ## _ ## name
+#define FUNCNAME_EXPAND(prefix, name) FUNCNAME_PASTE(prefix, name)
+#define FUNCNAME(name) FUNCNAME_EXPAND(MUTATOR_PREFIX, name)
 #endif
 
+//Flags that describe the result of running one of a mutator's outputs, for the mutators with a report_result function
+#define MUTATE_RESULT_NEW_COVERAGE 1 //The output found new coverage
+#define MUTATE_RESULT_UNCHANGED    2 //The output's execution was the same as the unmodified input's
+
+//The categories that the mutators with a get_memory_usage function report their memory in
+enum {
+	MEMORY_USAGE_STATE,        //The mutator's state and its fixed size tables
+	MEMORY_USAGE_INPUT,        //The copy of the input, and the buffers that outputs are built in
+	MEMORY_USAGE_DICTIONARY,   //The dictionary tokens, and the indexes used to find and choose them
+	MEMORY_USAGE_SPLICE_FILES, //The splice files, and which of them can be spliced with the input
+	MEMORY_USAGE_SEEDS,        //The other seeds in the seed pool
+	MEMORY_USAGE_SAMPLES,      //The sample files that parts of the outputs are taken from
+	MEMORY_USAGE_CHILDREN,     //The inputs, options, and buffers kept for a multipart mutator's parts
+	MEMORY_USAGE_INDEXES,      //What's computed about the input (effector map, comparison operands, regions, checksums)
+	MEMORY_USAGE_HISTORY,      //The provenance records and the edits recorded to minimize outputs
+	MEMORY_USAGE_DEDUP,        //The duplicate output filter
+	MEMORY_USAGE_CATEGORIES
+};
+
+//The number of bytes that a mutator has allocated, in each of the MEMORY_USAGE_* categories
+typedef struct {
+	uint64_t bytes[MEMORY_USAGE_CATEGORIES];
+} memory_usage_t;
+
 MUTATORS_API void default_free_state(char * state);
 MUTATORS_API int return_unknown_or_infinite_total_iterations(void * mutator_state);
+MUTATORS_API uint64_t memory_usage_total(const memory_usage_t * usage);
+MUTATORS_API const char * memory_usage_category_name(int category);
+MUTATORS_API int memory_usage_fits(uint64_t limit, uint64_t used, uint64_t bytes);
 
 #define GENERIC_MUTATOR_CREATE(type_t, option_parser_func, cleanup_state_func) \
 	type_t * new_state = option_parser_func(options);                            \
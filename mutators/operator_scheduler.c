@@ -0,0 +1,204 @@
+#include "operator_scheduler.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Forgets everything a scheduler has learned, so the operators are chosen uniformly again
+ * @param scheduler - the operator_scheduler_t to reset
+ */
+MUTATORS_API void operator_scheduler_reset(operator_scheduler_t * scheduler)
+{
+	int enabled = scheduler->enabled;
+	memset(scheduler, 0, sizeof(operator_scheduler_t));
+	scheduler->enabled = enabled;
+}
+
+static void compute_cumulative(operator_scheduler_t * scheduler, uint32_t num_operators)
+{
+	uint64_t total_finds = 0, total_uses = 0;
+	double average_rate, rates[SCHEDULER_MAX_OPERATORS], total_rate = 0, sum = 0;
+	uint32_t i;
+
+	for (i = 0; i < num_operators; i++)
+	{
+		total_finds += scheduler->finds[i];
+		total_uses += scheduler->uses[i];
+	}
+
+	//Operators that haven't been used much are assumed to find new coverage at the average rate
+	average_rate = (total_finds + 1.0) / (total_uses + 1.0);
+	for (i = 0; i < num_operators; i++)
+	{
+		rates[i] = (scheduler->finds[i] + average_rate * SCHEDULER_PRIOR_USES) / (scheduler->uses[i] + SCHEDULER_PRIOR_USES);
+		total_rate += rates[i];
+	}
+
+	for (i = 0; i < num_operators; i++)
+	{
+		sum += (rates[i] / total_rate) * (100 - SCHEDULER_EXPLORE_PERCENT) / 100.0
+			+ (SCHEDULER_EXPLORE_PERCENT / 100.0) / num_operators;
+		scheduler->cumulative[i] = sum;
+	}
+	scheduler->cumulative_operators = num_operators;
+}
+
+/**
+ * Chooses one of the operators, and records it as used by the output that is being generated
+ * @param scheduler - the operator_scheduler_t to choose the operator with
+ * @param num_operators - the number of operators to choose from.  Only the first num_operators
+ * operators will be chosen from.
+ * @param random - a random number used to choose the operator
+ * @return - the index of the chosen operator
+ */
+MUTATORS_API uint32_t operator_scheduler_choose(operator_scheduler_t * scheduler, uint32_t num_operators, uint64_t random)
+{
+	uint32_t low = 0, high, middle;
+	double target;
+
+	if (!scheduler->enabled || num_operators > SCHEDULER_MAX_OPERATORS)
+		return (uint32_t)(random % num_operators);
+
+	if (scheduler->cumulative_operators != num_operators)
+		compute_cumulative(scheduler, num_operators);
+
+	//Binary search for the first operator whose cumulative probability is above the target
+	target = (random >> 11) * (1.0 / 9007199254740992.0) * scheduler->cumulative[num_operators - 1];
+	high = num_operators - 1;
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (scheduler->cumulative[middle] > target)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	scheduler->current |= 1U << low;
+	return low;
+}
+
+/**
+ * Records the operators that were used to generate an output, so that they can be credited once
+ * its result is reported.
+ * @param scheduler - the operator_scheduler_t that chose the operators
+ * @param iteration - the iteration of the output
+ */
+MUTATORS_API void operator_scheduler_finish(operator_scheduler_t * scheduler, int iteration)
+{
+	if (!scheduler->enabled || !scheduler->current)
+		return;
+	scheduler->history[scheduler->history_next].iteration = iteration;
+	scheduler->history[scheduler->history_next].operators = scheduler->current;
+	scheduler->history_next = (scheduler->history_next + 1) % SCHEDULER_HISTORY;
+	scheduler->current = 0;
+}
+
+/**
+ * Updates the statistics of the operators used to generate an output, based on whether it found
+ * new coverage.  Results for outputs that are no longer in the history are ignored.
+ * @param scheduler - the operator_scheduler_t that chose the operators
+ * @param iteration - the iteration of the output
+ * @param new_coverage - whether the output found new coverage
+ */
+MUTATORS_API void operator_scheduler_report(operator_scheduler_t * scheduler, int iteration, int new_coverage)
+{
+	scheduler_output_t * output = NULL;
+	size_t i;
+
+	if (!scheduler->enabled)
+		return;
+	for (i = 0; i < SCHEDULER_HISTORY && !output; i++)
+	{
+		if (scheduler->history[i].operators && scheduler->history[i].iteration == iteration)
+			output = &scheduler->history[i];
+	}
+	if (!output)
+		return;
+
+	for (i = 0; i < SCHEDULER_MAX_OPERATORS; i++)
+	{
+		if (output->operators & (1U << i)) {
+			scheduler->uses[i]++;
+			scheduler->finds[i] += new_coverage ? 1 : 0;
+			scheduler->total_uses++;
+		}
+	}
+	output->operators = 0; //Each output is only counted once
+
+	if (scheduler->total_uses >= SCHEDULER_DECAY_USES)
+	{
+		for (i = 0; i < SCHEDULER_MAX_OPERATORS; i++)
+		{
+			scheduler->uses[i] /= 2;
+			scheduler->finds[i] /= 2;
+		}
+		scheduler->total_uses /= 2;
+	}
+	scheduler->cumulative_operators = 0;
+}
+
+/**
+ * Adds the statistics a scheduler has learned to a mutator's state
+ * @param obj - the JSON object to add the statistics to
+ * @param name - the name to save the statistics with
+ * @param scheduler - the operator_scheduler_t to save
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int operator_scheduler_add_to_json(json_t * obj, const char * name, operator_scheduler_t * scheduler)
+{
+	json_t *temp, *operator_list, *operator_obj;
+	char enabled_name[256];
+	size_t i;
+
+	snprintf(enabled_name, sizeof(enabled_name), "%s_enabled", name);
+	ADD_INT(temp, scheduler->enabled, obj, enabled_name);
+
+	operator_list = json_array();
+	if (!operator_list)
+		return 0;
+	json_object_set_new(obj, name, operator_list);
+	for (i = 0; i < SCHEDULER_MAX_OPERATORS; i++)
+	{
+		operator_obj = json_object();
+		if (!operator_obj)
+			return 0;
+		json_array_append_new(operator_list, operator_obj);
+		ADD_UINT64T(temp, scheduler->uses[i], operator_obj, "uses");
+		ADD_UINT64T(temp, scheduler->finds[i], operator_obj, "finds");
+	}
+	return 1;
+}
+
+/**
+ * Loads the statistics saved by operator_scheduler_add_to_json
+ * @param state - the mutator's saved state
+ * @param name - the name the statistics were saved with
+ * @param scheduler - the operator_scheduler_t to load the statistics into
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int operator_scheduler_get_from_json(char * state, const char * name, operator_scheduler_t * scheduler)
+{
+	int result, inner_result, temp_int;
+	uint64_t temp_uint64t;
+	char enabled_name[256];
+	json_t * operator_obj;
+	size_t i = 0;
+
+	operator_scheduler_reset(scheduler);
+	snprintf(enabled_name, sizeof(enabled_name), "%s_enabled", name);
+	GET_INT(temp_int, state, scheduler->enabled, enabled_name, result);
+
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(state, operators, name, operator_obj, result)
+		if (i < SCHEDULER_MAX_OPERATORS) {
+			GET_ITEM(operator_obj, scheduler->uses[i], temp_uint64t, get_uint64t_options_from_json, "uses", inner_result);
+			GET_ITEM(operator_obj, scheduler->finds[i], temp_uint64t, get_uint64t_options_from_json, "finds", inner_result);
+			scheduler->total_uses += scheduler->uses[i];
+			i++;
+		}
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_END(operators);
+	if (result < 0)
+		return 1;
+	return 0;
+}
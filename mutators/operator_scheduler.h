@@ -0,0 +1,50 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The most operators that a scheduler can choose between
+#define SCHEDULER_MAX_OPERATORS 32
+//The number of recent outputs whose operators are remembered until their result is reported
+#define SCHEDULER_HISTORY 256
+//The percentage of the choices that are spread evenly across the operators, so none of them starve
+#define SCHEDULER_EXPLORE_PERCENT 10
+//The number of pseudo-uses with the average find rate that each operator starts with
+#define SCHEDULER_PRIOR_USES 100
+//Once this many uses have been reported, the statistics are halved so the scheduler keeps adapting
+#define SCHEDULER_DECAY_USES 1000000
+
+//The operators used to generate one of the recent outputs
+typedef struct {
+	int iteration;
+	uint32_t operators; //A bitmask of the operators used
+} scheduler_output_t;
+
+//Learns which of a mutator's operators produce outputs that find new coverage, and chooses those
+//operators more often.  Each operator is chosen with a probability proportional to its rate of
+//finding new coverage (as in MOpt), mixed with a uniform distribution so every operator is still tried.
+typedef struct {
+	int enabled; //If not set, operators are chosen uniformly (as random % num_operators)
+
+	uint64_t uses[SCHEDULER_MAX_OPERATORS];  //The number of reported outputs that used each operator
+	uint64_t finds[SCHEDULER_MAX_OPERATORS]; //The number of those outputs that found new coverage
+	uint64_t total_uses; //The sum of uses
+
+	uint32_t current; //The operators used by the output that is being generated
+	scheduler_output_t history[SCHEDULER_HISTORY];
+	size_t history_next;
+
+	double cumulative[SCHEDULER_MAX_OPERATORS]; //The cumulative probability of choosing each operator
+	uint32_t cumulative_operators; //The number of operators cumulative was computed for, 0 if it's stale
+} operator_scheduler_t;
+
+MUTATORS_API void operator_scheduler_reset(operator_scheduler_t * scheduler);
+MUTATORS_API uint32_t operator_scheduler_choose(operator_scheduler_t * scheduler, uint32_t num_operators, uint64_t random);
+MUTATORS_API void operator_scheduler_finish(operator_scheduler_t * scheduler, int iteration);
+MUTATORS_API void operator_scheduler_report(operator_scheduler_t * scheduler, int iteration, int new_coverage);
+MUTATORS_API int operator_scheduler_add_to_json(json_t * obj, const char * name, operator_scheduler_t * scheduler);
+MUTATORS_API int operator_scheduler_get_from_json(char * state, const char * name, operator_scheduler_t * scheduler);
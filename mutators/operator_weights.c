@@ -0,0 +1,230 @@
+#include "operator_weights.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Returns the first operator with the same name as operator i */
+static uint32_t first_operator(const char * const * names, uint32_t i)
+{
+	uint32_t j;
+	for (j = 0; j < i && strcmp(names[j], names[i]); j++);
+	return j;
+}
+
+/**
+ * Reads the weights from a JSON object that maps operator names to weights
+ * @param weights - the operator_weights_t to read the weights into
+ * @param obj - the JSON object with the weights
+ * @param name - the name of the option, for the error messages
+ * @param names - the name of each of the mutator's operators
+ * @param count - the number of operators
+ * @param min_count - the number of operators that are always available
+ * @return - 0 on success, nonzero on failure
+ */
+static int parse_weights(operator_weights_t * weights, json_t * obj, const char * name, const char * const * names,
+	uint32_t count, uint32_t min_count)
+{
+	json_t * value;
+	const char * key;
+	uint64_t total = 0;
+	uint32_t i;
+
+	operator_weights_free(weights);
+	if (!json_is_object(obj) || count > SCHEDULER_MAX_OPERATORS) {
+		printf("The %s option must be an object that maps operator names to weights\n", name);
+		return 1;
+	}
+
+	//Each name starts with its default weight, the number of operators with that name
+	weights->count = count;
+	for (i = 0; i < count; i++)
+		weights->weights[first_operator(names, i)]++;
+
+	json_object_foreach(obj, key, value)
+	{
+		for (i = 0; i < count && strcmp(names[i], key); i++);
+		if (i == count) {
+			printf("Unknown operator %s in the %s option\n", key, name);
+			operator_weights_free(weights);
+			return 1;
+		}
+		if (!json_is_integer(value) || json_integer_value(value) < 0 || json_integer_value(value) > OPERATOR_WEIGHT_MAX) {
+			printf("The weight of %s in the %s option must be an integer from 0 to %d\n", key, name, OPERATOR_WEIGHT_MAX);
+			operator_weights_free(weights);
+			return 1;
+		}
+		weights->weights[i] = (uint32_t)json_integer_value(value);
+	}
+
+	//The operators that aren't always available (such as the ones that need a dictionary) can't be
+	//the only ones with a weight, or there'd be nothing to choose when they're unavailable
+	for (i = 0; i < min_count; i++)
+		total += weights->weights[i];
+	if (!total) {
+		//The operators that aren't always available are only listed if there are any
+		for (i = min_count; i < count && first_operator(names, i) != i; i++);
+		if (i == count)
+			printf("At least one operator needs a weight above 0 in the %s option\n", name);
+		else {
+			printf("At least one operator besides");
+			for (; i < count; i++)
+			{
+				if (first_operator(names, i) == i)
+					printf("%s %s", total++ ? "," : "", names[i]);
+			}
+			printf(" needs a weight above 0 in the %s option\n", name);
+		}
+		operator_weights_free(weights);
+		return 1;
+	}
+
+	if (alias_table_build(&weights->table, weights->weights, count)) {
+		operator_weights_free(weights);
+		return 1;
+	}
+	weights->available_count = count;
+	weights->enabled = 1;
+	return 0;
+}
+
+/**
+ * Sets up the operator weights from a mutator's options.  If the option isn't given, the weights
+ * aren't enabled.
+ * @param weights - the operator_weights_t to set up
+ * @param options - the mutator's options, or NULL
+ * @param name - the name of the option
+ * @param names - the name of each of the mutator's operators, in the order that the mutator numbers them
+ * @param count - the number of operators
+ * @param min_count - the number of operators that are always available.  At least one of them
+ * needs a weight above 0.
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int operator_weights_parse(operator_weights_t * weights, char * options, const char * name,
+	const char * const * names, uint32_t count, uint32_t min_count)
+{
+	json_t * root, * obj;
+	int ret = 0;
+
+	operator_weights_free(weights);
+	if (!options)
+		return 0;
+	root = json_loads(options, 0, NULL);
+	obj = json_object_get(root, name);
+	if (obj)
+		ret = parse_weights(weights, obj, name, names, count, min_count);
+	json_decref(root);
+	return ret;
+}
+
+/**
+ * Frees the alias table of an operator_weights_t, and disables the weights.  The
+ * operator_weights_t itself is not freed.
+ * @param weights - the operator_weights_t to free
+ */
+MUTATORS_API void operator_weights_free(operator_weights_t * weights)
+{
+	alias_table_free(&weights->table);
+	alias_table_free(&weights->available);
+	memset(weights, 0, sizeof(operator_weights_t));
+}
+
+/**
+ * Counts the memory allocated by an operator_weights_t, not including the operator_weights_t itself
+ * @param weights - the operator_weights_t to count the memory of
+ * @return - the number of bytes allocated for the alias tables
+ */
+MUTATORS_API size_t operator_weights_memory_usage(const operator_weights_t * weights)
+{
+	return (weights->table.count + weights->available.count) * 2 * sizeof(uint32_t);
+}
+
+/**
+ * Chooses one of the operators with probability proportional to its weight.  If the mutator has
+ * fewer operators available than the weights were given for (such as when there's no dictionary),
+ * a table for the available operators is built the first time they're chosen from.
+ * @param weights - the operator_weights_t to choose the operator with
+ * @param num_operators - the number of operators to choose from.  Only the first num_operators
+ * operators will be chosen from, and it must be at least the min_count given to operator_weights_parse.
+ * @param random - a random number used to choose the operator
+ * @return - the index of the chosen operator
+ */
+MUTATORS_API uint32_t operator_weights_choose(operator_weights_t * weights, uint32_t num_operators, uint64_t random)
+{
+	uint32_t choice;
+
+	if (num_operators >= weights->count)
+		return (uint32_t)alias_table_sample(&weights->table, random);
+	if (weights->available_count != num_operators) {
+		alias_table_free(&weights->available);
+		if (!alias_table_build(&weights->available, weights->weights, num_operators))
+			weights->available_count = num_operators;
+	}
+	if (weights->available_count == num_operators)
+		return (uint32_t)alias_table_sample(&weights->available, random);
+
+	//If the table couldn't be allocated, the unavailable operators are drawn again from the full
+	//table, which still follows the weights.  One of the available operators has a weight above 0.
+	do {
+		choice = (uint32_t)alias_table_sample(&weights->table, random);
+		random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+	} while (choice >= num_operators);
+	return choice;
+}
+
+/**
+ * Adds the operator weights to a mutator's state, in the same format as the option
+ * @param obj - the JSON object to add the weights to
+ * @param name - the name to save the weights with
+ * @param weights - the operator_weights_t to save
+ * @param names - the name of each of the mutator's operators
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int operator_weights_add_to_json(json_t * obj, const char * name, operator_weights_t * weights,
+	const char * const * names)
+{
+	json_t *temp, *weights_obj;
+	uint32_t i;
+
+	if (!weights->enabled)
+		return 1;
+	weights_obj = json_object();
+	if (!weights_obj)
+		return 0;
+	json_object_set_new(obj, name, weights_obj);
+	for (i = 0; i < weights->count; i++)
+	{
+		if (first_operator(names, i) == i)
+			ADD_UINT64T(temp, weights->weights[i], weights_obj, names[i]);
+	}
+	return 1;
+}
+
+/**
+ * Loads the weights saved by operator_weights_add_to_json.  If the state doesn't have any weights,
+ * the current weights are kept.
+ * @param state - the mutator's saved state
+ * @param name - the name the weights were saved with
+ * @param weights - the operator_weights_t to load the weights into
+ * @param names - the name of each of the mutator's operators
+ * @param count - the number of operators
+ * @param min_count - the number of operators that are always available
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int operator_weights_get_from_json(char * state, const char * name, operator_weights_t * weights,
+	const char * const * names, uint32_t count, uint32_t min_count)
+{
+	json_t * root, * obj;
+	int ret = 0;
+
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+	obj = json_object_get(root, name);
+	if (obj)
+		ret = parse_weights(weights, obj, name, names, count, min_count);
+	json_decref(root);
+	return ret;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mutators.h"
+#include "alias_table.h"
+#include "operator_scheduler.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The largest weight that can be given to an operator
+#define OPERATOR_WEIGHT_MAX 1000000
+
+//User-given weights for a mutator's operators, given as an object that maps each operator's name
+//to its weight (such as {"delete": 4, "flip_bit": 0}).  The weights are compiled into an alias
+//table, so choosing an operator is still one random number and a lookup.  Several of a mutator's
+//operators can share a name (so that operator is chosen more often by default); a name's weight
+//replaces the total weight of its operators, which defaults to the number of operators with the name.
+typedef struct {
+	int enabled; //If not set, the operators are chosen by the mutator's operator_scheduler_t
+	uint32_t weights[SCHEDULER_MAX_OPERATORS]; //The weight of each operator
+	uint32_t count;           //The number of operators the weights were given for
+	alias_table_t table;      //Chooses from all count operators
+	alias_table_t available;  //Chooses from the first available_count operators, when fewer are available
+	uint32_t available_count;
+} operator_weights_t;
+
+MUTATORS_API int operator_weights_parse(operator_weights_t * weights, char * options, const char * name,
+	const char * const * names, uint32_t count, uint32_t min_count);
+MUTATORS_API void operator_weights_free(operator_weights_t * weights);
+MUTATORS_API size_t operator_weights_memory_usage(const operator_weights_t * weights);
+MUTATORS_API uint32_t operator_weights_choose(operator_weights_t * weights, uint32_t num_operators, uint64_t random);
+MUTATORS_API int operator_weights_add_to_json(json_t * obj, const char * name, operator_weights_t * weights,
+	const char * const * names);
+MUTATORS_API int operator_weights_get_from_json(char * state, const char * name, operator_weights_t * weights,
+	const char * const * names, uint32_t count, uint32_t min_count);
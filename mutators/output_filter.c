@@ -0,0 +1,361 @@
+#include "output_filter.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define OUTPUT_FILTER_MAGIC 0x315245544c494644ULL //"DFILTER1"
+#define OUTPUT_FILTER_PROBES 6 //The number of bits set in an output's block
+#define OUTPUT_FILTER_BITS_PER_OUTPUT 10
+
+#define PRIME64_1 0x9e3779b185ebca87ULL
+#define PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3 0x165667b19e3779f9ULL
+#define PRIME64_4 0x85ebca77c2b2ae63ULL
+#define PRIME64_5 0x27d4eb2f165667c5ULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t read64(const uint8_t * p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t read32(const uint8_t * p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME64_2;
+	acc = ROTL64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static uint64_t hash_merge_round(uint64_t acc, uint64_t value)
+{
+	acc ^= hash_round(0, value);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ * Hashes a buffer with XXH64 (with a seed of 0), which hashes 32 bytes per step in four independent
+ * lanes, so it runs at close to the memory bandwidth.  The buffer is read as little endian.
+ * @param buffer - the buffer to hash
+ * @param length - the length of buffer
+ * @return - the 64-bit hash of the buffer
+ */
+MUTATORS_API uint64_t output_filter_hash(const uint8_t * buffer, size_t length)
+{
+	const uint8_t * end = buffer + length;
+	uint64_t v1, v2, v3, v4, hash;
+
+	if (length >= 32) {
+		v1 = PRIME64_1 + PRIME64_2;
+		v2 = PRIME64_2;
+		v3 = 0;
+		v4 = 0 - PRIME64_1;
+		do {
+			v1 = hash_round(v1, read64(buffer));
+			v2 = hash_round(v2, read64(buffer + 8));
+			v3 = hash_round(v3, read64(buffer + 16));
+			v4 = hash_round(v4, read64(buffer + 24));
+			buffer += 32;
+		} while (buffer + 32 <= end);
+		hash = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+		hash = hash_merge_round(hash, v1);
+		hash = hash_merge_round(hash, v2);
+		hash = hash_merge_round(hash, v3);
+		hash = hash_merge_round(hash, v4);
+	}
+	else
+		hash = PRIME64_5;
+	hash += (uint64_t)length;
+
+	for (; buffer + 8 <= end; buffer += 8) {
+		hash ^= hash_round(0, read64(buffer));
+		hash = ROTL64(hash, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (buffer + 4 <= end) {
+		hash ^= (uint64_t)read32(buffer) * PRIME64_1;
+		hash = ROTL64(hash, 23) * PRIME64_2 + PRIME64_3;
+		buffer += 4;
+	}
+	for (; buffer < end; buffer++) {
+		hash ^= (*buffer) * PRIME64_5;
+		hash = ROTL64(hash, 11) * PRIME64_1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static uint64_t atomic_or(uint64_t * target, uint64_t value)
+{
+#ifdef _WIN32
+	return (uint64_t)InterlockedOr64((volatile LONG64 *)target, (LONG64)value);
+#else
+	return __sync_fetch_and_or(target, value);
+#endif
+}
+
+static uint64_t atomic_increment(volatile uint64_t * target)
+{
+#ifdef _WIN32
+	return (uint64_t)InterlockedIncrement64((volatile LONG64 *)target);
+#else
+	return __sync_add_and_fetch(target, 1);
+#endif
+}
+
+/**
+ * Maps the file that backs a filter, creating it if it doesn't exist.  A new (or empty) file is
+ * given the requested size; otherwise the file's size is used.
+ * @param filter - the output_filter_t to map the file for
+ * @param filename - the name of the file
+ * @param size - the requested size of the bits, or 0 to use the default size
+ * @return - 0 on success, nonzero on failure
+ */
+static int map_filter_file(output_filter_t * filter, const char * filename, uint64_t size)
+{
+	uint64_t file_size;
+	void * mapping;
+
+#ifdef _WIN32
+	HANDLE file, map;
+	LARGE_INTEGER existing_size;
+
+	file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("Couldn't open the dedup file %s\n", filename);
+		return 1;
+	}
+	if (!GetFileSizeEx(file, &existing_size)) {
+		CloseHandle(file);
+		return 1;
+	}
+	file_size = (uint64_t)existing_size.QuadPart;
+#else
+	int fd;
+	struct stat st;
+
+	fd = open(filename, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		printf("Couldn't open the dedup file %s\n", filename);
+		return 1;
+	}
+	if (fstat(fd, &st)) {
+		close(fd);
+		return 1;
+	}
+	file_size = (uint64_t)st.st_size;
+#endif
+
+	//Every process has to agree on the size, so an existing file's size wins
+	if (file_size == 0)
+		file_size = sizeof(output_filter_header_t) + (size ? size : OUTPUT_FILTER_DEFAULT_SIZE);
+	else if (size && file_size != sizeof(output_filter_header_t) + size) {
+		printf("The dedup file %s was created with a different dedup_size\n", filename);
+		file_size = 0;
+	}
+
+#ifdef _WIN32
+	//Mapping the file also extends it to the mapping's size
+	map = file_size ? CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(file_size >> 32), (DWORD)file_size, NULL) : NULL;
+	mapping = map ? MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)file_size) : NULL;
+	if (map)
+		CloseHandle(map);
+	CloseHandle(file);
+#else
+	mapping = NULL;
+	if (file_size && (st.st_size || !ftruncate(fd, (off_t)file_size))) {
+		mapping = mmap(NULL, (size_t)file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapping == MAP_FAILED)
+			mapping = NULL;
+	}
+	close(fd);
+#endif
+	if (!mapping)
+		return 1;
+
+	filter->mapping = mapping;
+	filter->mapping_size = (size_t)file_size;
+	filter->header = (output_filter_header_t *)mapping;
+	return 0;
+}
+
+static void unmap_filter_file(output_filter_t * filter)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(filter->mapping);
+#else
+	munmap(filter->mapping, filter->mapping_size);
+#endif
+	filter->mapping = NULL;
+}
+
+/**
+ * Sets up a filter from the mutator's options.  The dedup_size option sets the size of the filter
+ * in bytes (rounded down to a power of two), and the dedup_file option names a file that backs the
+ * filter, so that the processes that use the same file avoid each other's outputs.  The filter is
+ * enabled if either option is given.
+ * @param filter - the output_filter_t to set up
+ * @param options - the mutator's options, or NULL
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int output_filter_parse(output_filter_t * filter, char * options)
+{
+	uint64_t size, bytes;
+	char * filename;
+	int result;
+
+	output_filter_free(filter);
+	if (!options)
+		return 0;
+	size = get_uint64t_options(options, "dedup_size", &result);
+	if (result < 0)
+		return 1;
+	if (result == 0)
+		size = 0;
+	else if (size < 64) {
+		printf("The dedup_size option must be at least 64 bytes\n");
+		return 1;
+	}
+	filename = get_string_options(options, "dedup_file", &result);
+	if (result < 0)
+		return 1;
+	if (!size && !filename)
+		return 0;
+
+	//The size has to be a power of two number of blocks
+	if (size) {
+		for (bytes = 64; bytes <= size / 2; bytes *= 2);
+		size = bytes;
+	}
+
+	if (filename) {
+		result = map_filter_file(filter, filename, size);
+		free(filename);
+		if (result)
+			return 1;
+		size = filter->mapping_size - sizeof(output_filter_header_t);
+		if (size < 64 || (size & (size - 1))) {
+			printf("The dedup file's size isn't valid\n");
+			output_filter_free(filter);
+			return 1;
+		}
+	}
+	else {
+		filter->header = (output_filter_header_t *)calloc(1, sizeof(output_filter_header_t) + (size_t)size);
+		if (!filter->header)
+			return 1;
+	}
+
+#ifdef _WIN32
+	InterlockedCompareExchange64((volatile LONG64 *)&filter->header->magic, (LONG64)OUTPUT_FILTER_MAGIC, 0);
+#else
+	__sync_val_compare_and_swap(&filter->header->magic, 0, OUTPUT_FILTER_MAGIC);
+#endif
+	if (filter->header->magic != OUTPUT_FILTER_MAGIC) {
+		printf("The dedup file isn't an output filter\n");
+		output_filter_free(filter);
+		return 1;
+	}
+
+	filter->blocks = (uint64_t *)(filter->header + 1);
+	filter->block_mask = size / 64 - 1;
+	filter->capacity = size * 8 / OUTPUT_FILTER_BITS_PER_OUTPUT;
+	filter->enabled = 1;
+	return 0;
+}
+
+/**
+ * Frees (or unmaps) the memory of a filter.  The output_filter_t itself is not freed.
+ * @param filter - the output_filter_t to free
+ */
+MUTATORS_API void output_filter_free(output_filter_t * filter)
+{
+	if (filter->mapping)
+		unmap_filter_file(filter);
+	else
+		free(filter->header);
+	memset(filter, 0, sizeof(output_filter_t));
+}
+
+/**
+ * Counts the memory used by a filter's bits, not including the output_filter_t itself.  When the
+ * filter is backed by a file, this is the size of the mapping, which is shared with the other
+ * processes that use the file.
+ * @param filter - the output_filter_t to count the memory of
+ * @return - the number of bytes allocated (or mapped) for the filter
+ */
+MUTATORS_API size_t output_filter_memory_usage(const output_filter_t * filter)
+{
+	if (!filter->enabled)
+		return 0;
+	return sizeof(output_filter_header_t) + (size_t)(filter->block_mask + 1) * 64;
+}
+
+/**
+ * Checks whether an output is already in a filter, and adds it if it isn't.  The filter can be
+ * shared with other threads and processes, so the bits are set atomically.
+ * @param filter - the output_filter_t to check the output against
+ * @param buffer - the output
+ * @param length - the length of the output
+ * @return - 1 if the output is (probably) a duplicate, 0 if it was added to the filter
+ */
+MUTATORS_API int output_filter_check(output_filter_t * filter, const uint8_t * buffer, size_t length)
+{
+	uint64_t hash, bits, masks[8] = { 0 }, * block;
+	int i, missing = 0;
+
+	filter->checked++;
+	hash = output_filter_hash(buffer, length);
+	block = &filter->blocks[(hash & filter->block_mask) * 8];
+
+	//The block is chosen with the low bits of the hash, and the bits within it with a remix of the
+	//hash, since there aren't enough bits left over for the larger filters
+	bits = (hash ^ (hash >> 29)) * PRIME64_2;
+	for (i = 0; i < OUTPUT_FILTER_PROBES; i++, bits >>= 9)
+		masks[(bits >> 6) & 7] |= 1ULL << (bits & 63);
+	for (i = 0; i < 8; i++)
+		missing |= (block[i] & masks[i]) != masks[i];
+	if (!missing) {
+		filter->duplicates++;
+		return 1;
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (masks[i] && (block[i] & masks[i]) != masks[i])
+			atomic_or(&block[i], masks[i]);
+	}
+
+	//Once the filter is full, start over rather than letting the false positives pile up.  Any
+	//outputs that other processes add while it's being cleared are just forgotten.
+	if (atomic_increment(&filter->header->inserted) >= filter->capacity) {
+		memset(filter->blocks, 0, (size_t)(filter->block_mask + 1) * 64);
+		filter->header->inserted = 0;
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The size of the filter (in bytes) when the dedup_file option is given without dedup_size
+#define OUTPUT_FILTER_DEFAULT_SIZE (4 * 1024 * 1024)
+//The most times that a duplicate output is replaced with a new one before it's returned anyway
+#define OUTPUT_FILTER_MAX_RETRIES 16
+
+//The start of the filter's memory, before the bits.  When the filter is backed by a file, this is
+//shared with the other processes using the file.
+typedef struct {
+	uint64_t magic;
+	volatile uint64_t inserted; //The number of outputs added since the filter was last cleared
+	uint64_t reserved[6];
+} output_filter_header_t;
+
+//A Bloom filter of the hashes of a mutator's outputs, used to replace the outputs that repeat an
+//earlier one before the target wastes an execution on them.  Each output sets a few bits in one
+//64 byte block, so checking an output only touches one cache line.  Once the filter holds about
+//one output per 10 bits it's cleared, which keeps the false positive rate below about 1%.  The
+//filter can be backed by a file that's mapped into each of the cooperating processes, so they
+//also avoid each other's outputs.
+typedef struct {
+	int enabled;
+	output_filter_header_t * header;
+	uint64_t * blocks;
+	uint64_t block_mask; //The number of 64 byte blocks, minus one
+	uint64_t capacity;   //The number of outputs that are added before the filter is cleared
+	void * mapping;      //The mapped file, or NULL if the filter isn't backed by a file
+	size_t mapping_size;
+
+	uint64_t checked;    //The number of this process's outputs that were checked
+	uint64_t duplicates; //and the number of them that were already in the filter
+} output_filter_t;
+
+MUTATORS_API int output_filter_parse(output_filter_t * filter, char * options);
+MUTATORS_API void output_filter_free(output_filter_t * filter);
+MUTATORS_API size_t output_filter_memory_usage(const output_filter_t * filter);
+MUTATORS_API int output_filter_check(output_filter_t * filter, const uint8_t * buffer, size_t length);
+MUTATORS_API uint64_t output_filter_hash(const uint8_t * buffer, size_t length);
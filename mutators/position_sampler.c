@@ -0,0 +1,199 @@
+#include "position_sampler.h"
+
+#include <utils.h>
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Sets the weights that a position sampler chooses offsets with
+ * @param sampler - the position_sampler_t to set the weights of
+ * @param weights - the weight of each of the input's offsets, or NULL to choose the offsets uniformly
+ * @param count - the number of entries in weights
+ * @return - 0 on success, nonzero on failure (including when all of the weights are 0)
+ */
+MUTATORS_API int position_sampler_set(position_sampler_t * sampler, const uint32_t * weights, size_t count)
+{
+	position_sampler_free(sampler);
+	if (!weights || !count)
+		return 0;
+
+	sampler->weights = (uint32_t *)malloc(count * sizeof(uint32_t));
+	if (!sampler->weights)
+		return 1;
+	memcpy(sampler->weights, weights, count * sizeof(uint32_t));
+	sampler->count = count;
+	if (alias_table_build(&sampler->table, sampler->weights, sampler->count)) {
+		position_sampler_free(sampler);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Loads a position sampler's weights from a file.  The file should contain a list of
+ * nonnegative integers, one for each of the input's offsets, separated by whitespace or commas.
+ * @param sampler - the position_sampler_t to set the weights of
+ * @param filename - the file to load the weights from
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int position_sampler_load(position_sampler_t * sampler, char * filename)
+{
+	char * contents;
+	uint32_t * weights = NULL, * new_weights;
+	size_t count = 0, max = 0;
+	uint64_t value;
+	int length, i = 0, ret;
+
+	length = read_file(filename, &contents);
+	if (length < 0) {
+		printf("Unable to open position weights file '%s'\n", filename);
+		return 1;
+	}
+
+	while (i < length)
+	{
+		if (contents[i] < '0' || contents[i] > '9') {
+			if (contents[i] != ' ' && contents[i] != ',' && contents[i] != '\t' && contents[i] != '\r' && contents[i] != '\n') {
+				printf("Invalid character in position weights file '%s' at offset %d\n", filename, i);
+				free(contents);
+				free(weights);
+				return 1;
+			}
+			i++;
+			continue;
+		}
+
+		value = 0;
+		for (; i < length && contents[i] >= '0' && contents[i] <= '9'; i++)
+		{
+			value = value * 10 + (contents[i] - '0');
+			if (value > UINT32_MAX)
+				value = UINT32_MAX;
+		}
+
+		if (count == max) {
+			max = max ? max * 2 : 256;
+			new_weights = (uint32_t *)realloc(weights, max * sizeof(uint32_t));
+			if (!new_weights) {
+				free(contents);
+				free(weights);
+				return 1;
+			}
+			weights = new_weights;
+		}
+		weights[count++] = (uint32_t)value;
+	}
+	free(contents);
+
+	ret = position_sampler_set(sampler, weights, count);
+	free(weights);
+	if (ret || !count)
+		printf("The position weights file '%s' must have at least one nonzero weight\n", filename);
+	return ret || !count;
+}
+
+/**
+ * Frees the weights of a position_sampler_t.  The position_sampler_t itself is not freed.
+ * @param sampler - the position_sampler_t to free the weights of
+ */
+MUTATORS_API void position_sampler_free(position_sampler_t * sampler)
+{
+	free(sampler->weights);
+	alias_table_free(&sampler->table);
+	memset(sampler, 0, sizeof(position_sampler_t));
+}
+
+/**
+ * Counts the memory allocated by a position_sampler_t, not including the position_sampler_t itself
+ * @param sampler - the position_sampler_t to count the memory of
+ * @return - the number of bytes allocated for the weights and their alias table
+ */
+MUTATORS_API size_t position_sampler_memory_usage(const position_sampler_t * sampler)
+{
+	if (!sampler->weights)
+		return 0;
+	return sampler->count * sizeof(uint32_t) + sampler->table.count * 2 * sizeof(uint32_t);
+}
+
+/**
+ * Chooses an offset in a range.  If the sampler has weights, the offset is chosen according to
+ * them, unless the weighted choice falls outside the range (e.g. because the buffer has been
+ * shrunk), in which case it is chosen uniformly.  Without weights, this returns the same offset
+ * as start + random % (end - start).
+ * @param sampler - the position_sampler_t to choose the offset with
+ * @param start - the first offset that can be chosen
+ * @param end - one past the last offset that can be chosen.  This must be greater than start.
+ * @param random - a random number used to choose the offset
+ * @return - the chosen offset
+ */
+MUTATORS_API uint64_t position_sampler_choose(position_sampler_t * sampler, uint64_t start, uint64_t end, uint64_t random)
+{
+	uint64_t pos;
+
+	if (sampler->weights) {
+		pos = alias_table_sample(&sampler->table, random);
+		if (pos >= start && pos < end)
+			return pos;
+	}
+	return start + random % (end - start);
+}
+
+/**
+ * Adds a position sampler's weights to a mutator's state
+ * @param obj - the JSON object to add the weights to
+ * @param name - the name to save the weights with
+ * @param sampler - the position_sampler_t to save
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int position_sampler_add_to_json(json_t * obj, const char * name, position_sampler_t * sampler)
+{
+	json_t * temp;
+	char count_name[256];
+
+	if (!sampler->weights)
+		return 1;
+	snprintf(count_name, sizeof(count_name), "%s_count", name);
+	ADD_UINT64T(temp, sampler->count, obj, count_name);
+	ADD_MEM(temp, sampler->weights, sampler->count * sizeof(uint32_t), obj, name);
+	return 1;
+}
+
+/**
+ * Loads the weights saved by position_sampler_add_to_json.  If the state doesn't have any
+ * weights, the sampler chooses offsets uniformly.
+ * @param state - the mutator's saved state
+ * @param name - the name the weights were saved with
+ * @param sampler - the position_sampler_t to load the weights into
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int position_sampler_get_from_json(char * state, const char * name, position_sampler_t * sampler)
+{
+	char count_name[256];
+	json_t * root;
+	uint64_t count;
+	uint32_t * weights;
+	int result, ret = 1;
+
+	position_sampler_free(sampler);
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+	if (!json_object_get(root, name)) { //The weights aren't required
+		json_decref(root);
+		return 0;
+	}
+
+	snprintf(count_name, sizeof(count_name), "%s_count", name);
+	count = get_uint64t_options_from_json(root, count_name, &result);
+	if (result > 0) {
+		weights = (uint32_t *)get_mem_options_from_json(root, name, &result);
+		if (result > 0)
+			ret = position_sampler_set(sampler, weights, (size_t)count);
+		free(weights);
+	}
+	json_decref(root);
+	return ret;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mutators.h"
+#include "alias_table.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Chooses the offsets that mutations are made at, with probability proportional to a weight for
+//each of the input's offsets (e.g. from taint analysis, or from an effector map).  Without
+//weights, offsets are chosen uniformly.
+typedef struct {
+	uint32_t * weights; //The weight of each offset, or NULL if the offsets are chosen uniformly
+	size_t count;       //The number of entries in weights
+	alias_table_t table;
+} position_sampler_t;
+
+MUTATORS_API int position_sampler_set(position_sampler_t * sampler, const uint32_t * weights, size_t count);
+MUTATORS_API int position_sampler_load(position_sampler_t * sampler, char * filename);
+MUTATORS_API void position_sampler_free(position_sampler_t * sampler);
+MUTATORS_API size_t position_sampler_memory_usage(const position_sampler_t * sampler);
+MUTATORS_API uint64_t position_sampler_choose(position_sampler_t * sampler, uint64_t start, uint64_t end, uint64_t random);
+MUTATORS_API int position_sampler_add_to_json(json_t * obj, const char * name, position_sampler_t * sampler);
+MUTATORS_API int position_sampler_get_from_json(char * state, const char * name, position_sampler_t * sampler);
@@ -0,0 +1,136 @@
+#include "provenance_log.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Sets the number of records that a provenance log keeps.  Any records already in the log are
+ * discarded.
+ * @param log - the provenance_log_t to resize
+ * @param size - the number of records to keep, or 0 to disable the log
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int provenance_log_resize(provenance_log_t * log, size_t size)
+{
+	provenance_log_free(log);
+	if (!size)
+		return 0;
+	log->records = (mutate_provenance_t *)calloc(size, sizeof(mutate_provenance_t));
+	if (!log->records)
+		return 1;
+	log->size = size;
+	return 0;
+}
+
+/**
+ * Frees the records of a provenance_log_t.  The provenance_log_t itself is not freed.
+ * @param log - the provenance_log_t to free the records of
+ */
+MUTATORS_API void provenance_log_free(provenance_log_t * log)
+{
+	free(log->records);
+	memset(log, 0, sizeof(provenance_log_t));
+}
+
+/**
+ * Counts the memory allocated by a provenance log, not including the provenance_log_t itself
+ * @param log - the provenance_log_t to count the memory of
+ * @return - the number of bytes allocated for the records
+ */
+MUTATORS_API size_t provenance_log_memory_usage(const provenance_log_t * log)
+{
+	return log->size * sizeof(mutate_provenance_t);
+}
+
+/**
+ * Adds an output's record to a provenance log, replacing the record in the same slot
+ * @param log - the provenance_log_t to add the record to
+ * @param record - the record to add.  Its iteration must be nonzero.
+ */
+MUTATORS_API void provenance_log_add(provenance_log_t * log, const mutate_provenance_t * record)
+{
+	if (log->size)
+		log->records[record->iteration % log->size] = *record;
+}
+
+/**
+ * Looks up the record of an output in a provenance log
+ * @param log - the provenance_log_t to look the record up in
+ * @param iteration - the iteration of the output
+ * @param record - used to return the output's record
+ * @return - 0 on success, nonzero if the output's record isn't in the log (because the log is
+ * disabled, or the record has been replaced by a later output's)
+ */
+MUTATORS_API int provenance_log_find(provenance_log_t * log, uint64_t iteration, mutate_provenance_t * record)
+{
+	mutate_provenance_t * slot;
+
+	if (!log->size || !iteration)
+		return 1;
+	slot = &log->records[iteration % log->size];
+	if (slot->iteration != iteration)
+		return 1;
+	*record = *slot;
+	return 0;
+}
+
+/**
+ * Adds a provenance log's records to a mutator's state
+ * @param obj - the JSON object to add the records to
+ * @param name - the name to save the records with
+ * @param log - the provenance_log_t to save
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int provenance_log_add_to_json(json_t * obj, const char * name, provenance_log_t * log)
+{
+	json_t * temp;
+	char size_name[256];
+
+	if (!log->size)
+		return 1;
+	snprintf(size_name, sizeof(size_name), "%s_size", name);
+	ADD_UINT64T(temp, log->size, obj, size_name);
+	ADD_MEM(temp, log->records, log->size * sizeof(mutate_provenance_t), obj, name);
+	return 1;
+}
+
+/**
+ * Loads the records saved by provenance_log_add_to_json.  If the state doesn't have a provenance
+ * log, the log is left as it is, so the size given in the options is kept.
+ * @param state - the mutator's saved state
+ * @param name - the name the records were saved with
+ * @param log - the provenance_log_t to load the records into
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int provenance_log_get_from_json(char * state, const char * name, provenance_log_t * log)
+{
+	char size_name[256];
+	json_t * root;
+	uint64_t size;
+	mutate_provenance_t * records;
+	int result, ret = 1;
+
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+	if (!json_object_get(root, name)) { //The log isn't required
+		json_decref(root);
+		return 0;
+	}
+
+	snprintf(size_name, sizeof(size_name), "%s_size", name);
+	size = get_uint64t_options_from_json(root, size_name, &result);
+	if (result > 0) {
+		records = (mutate_provenance_t *)get_mem_options_from_json(root, name, &result);
+		if (result > 0 && size && !provenance_log_resize(log, (size_t)size)) {
+			memcpy(log->records, records, log->size * sizeof(mutate_provenance_t));
+			ret = 0;
+		}
+		free(records);
+	}
+	json_decref(root);
+	return ret;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Everything that's needed to regenerate one of a mutator's outputs from the mutator's state,
+//rather than saving the output itself
+typedef struct {
+	uint64_t iteration;       //The iteration of the output, or 0 for an empty slot in the log
+	uint64_t random_state[2]; //The random number generator's state before the output's stage was called
+	uint64_t stage_cur;
+	uint32_t input_length;    //The length of the seed when the output was generated
+	int32_t seed_id;          //The seed pool id of the seed that was mutated
+	int32_t stage;
+	int32_t queue_cycle;
+	uint32_t trim_remove_len;
+	uint32_t trim_remove_pos;
+} mutate_provenance_t;
+
+//A fixed size ring of the provenance of a mutator's most recent outputs.  Each output's record is
+//kept in the slot for its iteration, so looking one up doesn't require a search.
+typedef struct {
+	mutate_provenance_t * records;
+	size_t size; //The number of records kept, or 0 if the log is disabled
+} provenance_log_t;
+
+MUTATORS_API int provenance_log_resize(provenance_log_t * log, size_t size);
+MUTATORS_API void provenance_log_free(provenance_log_t * log);
+MUTATORS_API size_t provenance_log_memory_usage(const provenance_log_t * log);
+MUTATORS_API void provenance_log_add(provenance_log_t * log, const mutate_provenance_t * record);
+MUTATORS_API int provenance_log_find(provenance_log_t * log, uint64_t iteration, mutate_provenance_t * record);
+MUTATORS_API int provenance_log_add_to_json(json_t * obj, const char * name, provenance_log_t * log);
+MUTATORS_API int provenance_log_get_from_json(char * state, const char * name, provenance_log_t * log);
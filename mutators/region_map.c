@@ -0,0 +1,516 @@
+#include "region_map.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_ranges(const void * a, const void * b)
+{
+	const region_range_t * range_a = (const region_range_t *)a;
+	const region_range_t * range_b = (const region_range_t *)b;
+	if (range_a->start != range_b->start)
+		return range_a->start < range_b->start ? -1 : 1;
+	return range_a->end < range_b->end ? -1 : (range_a->end > range_b->end);
+}
+
+static int parse_number(const char ** list, size_t * value)
+{
+	const char * p = *list;
+	size_t digit;
+
+	if (*p < '0' || *p > '9')
+		return 1;
+	for (*value = 0; *p >= '0' && *p <= '9'; p++)
+	{
+		digit = *p - '0';
+		if (*value > (SIZE_MAX - 1 - digit) / 10)
+			return 1;
+		*value = *value * 10 + digit;
+	}
+	*list = p;
+	return 0;
+}
+
+/* Parses a list of ranges in the format understood by cut(1), such as "1-5,8,10-", into a sorted
+   list of merged ranges.  Ranges without an end (such as "10-") end at SIZE_MAX. */
+static int parse_ranges(const char * list, region_range_t ** ranges, size_t * count)
+{
+	const char * p;
+	region_range_t * parsed;
+	size_t i, chunks, num = 0;
+
+	for (p = list, chunks = 1; *p; p++)
+	{
+		if (*p == ',')
+			chunks++;
+	}
+	parsed = (region_range_t *)malloc(chunks * sizeof(region_range_t));
+	if (!parsed)
+		return 1;
+
+	for (p = list; *p; )
+	{
+		if (*p == ',') {
+			p++;
+			continue;
+		}
+		parsed[num].start = 0;
+		if (*p != '-' && parse_number(&p, &parsed[num].start))
+			goto error;
+		if (*p == '-') {
+			p++;
+			parsed[num].end = SIZE_MAX;
+			if (*p && *p != ',') {
+				if (parse_number(&p, &parsed[num].end) || parsed[num].end < parsed[num].start)
+					goto error;
+				parsed[num].end++;
+			}
+		}
+		else
+			parsed[num].end = parsed[num].start + 1;
+		if (*p && *p != ',')
+			goto error;
+		num++;
+	}
+	if (!num)
+		goto error;
+
+	qsort(parsed, num, sizeof(region_range_t), compare_ranges);
+	*count = 1;
+	for (i = 1; i < num; i++)
+	{
+		if (parsed[i].start <= parsed[*count - 1].end) {
+			if (parsed[i].end > parsed[*count - 1].end)
+				parsed[*count - 1].end = parsed[i].end;
+		}
+		else
+			parsed[(*count)++] = parsed[i];
+	}
+	*ranges = parsed;
+	return 0;
+
+error:
+	free(parsed);
+	return 1;
+}
+
+static void reset_cursor(region_map_t * map)
+{
+	map->cursor_width = 0;
+	map->cursor_bits = 0;
+	map->cursor_range = 0;
+	map->cursor_before = 0;
+}
+
+/**
+ * Sets the regions of the input that a region map allows to be mutated
+ * @param map - the region_map_t to set the regions of
+ * @param regions - the offsets that can be mutated, as a list of ranges in the format understood by
+ * cut(1) (e.g. "4-99,120-"), or NULL to allow every offset
+ * @param protect - the byte values that can't be mutated, in the same format (e.g. "0-31,127"),
+ * or NULL to allow every value
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int region_map_set(region_map_t * map, const char * regions, const char * protect)
+{
+	region_range_t * protected_ranges;
+	size_t i, j, count;
+
+	region_map_free(map);
+	if (!regions && !protect)
+		return 0;
+
+	if (regions) {
+		if (parse_ranges(regions, &map->spec, &map->spec_count)) {
+			printf("Invalid regions '%s', expected a list of offsets such as 1-5,8,10-\n", regions);
+			region_map_free(map);
+			return 1;
+		}
+		map->regions = strdup(regions);
+	}
+	else {
+		map->spec = (region_range_t *)malloc(sizeof(region_range_t));
+		if (map->spec) {
+			map->spec[0].start = 0;
+			map->spec[0].end = SIZE_MAX;
+			map->spec_count = 1;
+		}
+	}
+
+	if (protect) {
+		if (parse_ranges(protect, &protected_ranges, &count)) {
+			printf("Invalid protect_bytes '%s', expected a list of byte values such as 0-31,127\n", protect);
+			region_map_free(map);
+			return 1;
+		}
+		for (i = 0; i < count && protected_ranges[i].start < 256; i++)
+		{
+			for (j = protected_ranges[i].start; j < protected_ranges[i].end && j < 256; j++)
+				map->protected_bytes[j] = 1;
+		}
+		free(protected_ranges);
+		map->has_protected_bytes = 1;
+		map->protect = strdup(protect);
+	}
+
+	if (!map->spec || (regions && !map->regions) || (protect && !map->protect)) {
+		region_map_free(map);
+		return 1;
+	}
+	map->enabled = 1;
+	return 0;
+}
+
+/**
+ * Frees a region map's regions.  The region_map_t itself is not freed.
+ * @param map - the region_map_t to free the regions of
+ */
+MUTATORS_API void region_map_free(region_map_t * map)
+{
+	free(map->regions);
+	free(map->protect);
+	free(map->spec);
+	free(map->ranges);
+	free(map->edit_ranges);
+	memset(map, 0, sizeof(region_map_t));
+}
+
+/**
+ * Counts the memory allocated by a region_map_t, not including the region_map_t itself
+ * @param map - the region_map_t to count the memory of
+ * @return - the number of bytes allocated for the regions and the input's ranges
+ */
+MUTATORS_API size_t region_map_memory_usage(const region_map_t * map)
+{
+	size_t bytes = (map->spec_count + map->max + map->edit_max) * sizeof(region_range_t);
+	if (map->regions)
+		bytes += strlen(map->regions) + 1;
+	if (map->protect)
+		bytes += strlen(map->protect) + 1;
+	return bytes;
+}
+
+static int add_range(region_map_t * map, size_t start, size_t end)
+{
+	region_range_t * ranges;
+
+	if (map->count == map->max) {
+		ranges = (region_range_t *)realloc(map->ranges, (map->max ? map->max * 2 : 16) * sizeof(region_range_t));
+		if (!ranges)
+			return 1;
+		map->ranges = ranges;
+		map->max = map->max ? map->max * 2 : 16;
+	}
+	map->ranges[map->count].start = start;
+	map->ranges[map->count].end = end;
+	map->count++;
+	return 0;
+}
+
+/**
+ * Computes the offsets of an input that can be mutated.  The offsets are only recomputed if the
+ * input's length has changed, or if map->valid has been cleared because the input has changed.
+ * @param map - the region_map_t to compute the offsets of
+ * @param input - the input that will be mutated
+ * @param input_length - the length of input
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int region_map_update(region_map_t * map, const uint8_t * input, size_t input_length)
+{
+	size_t i, offset, start, end;
+
+	if (!map->enabled || (map->valid && map->input_length == input_length))
+		return 0;
+
+	map->count = 0;
+	map->valid = 0;
+	reset_cursor(map);
+	for (i = 0; i < map->spec_count && map->spec[i].start < input_length; i++)
+	{
+		end = map->spec[i].end < input_length ? map->spec[i].end : input_length;
+		if (!map->has_protected_bytes) {
+			if (add_range(map, map->spec[i].start, end))
+				return 1;
+			continue;
+		}
+
+		//Split the region around the protected bytes in it
+		start = map->spec[i].start;
+		for (offset = start; offset < end; offset++)
+		{
+			if (!map->protected_bytes[input[offset]])
+				continue;
+			if (offset != start && add_range(map, start, offset))
+				return 1;
+			start = offset + 1;
+		}
+		if (start != end && add_range(map, start, end))
+			return 1;
+	}
+	map->input_length = input_length;
+	map->valid = 1;
+	return 0;
+}
+
+/* The number of positions in a range where a value of width units (bits, or bytes) fits */
+static uint64_t range_positions(const region_range_t * range, size_t width, int bits)
+{
+	uint64_t units = (uint64_t)(range->end - range->start) << (bits ? 3 : 0);
+	return units >= width ? units - width + 1 : 0;
+}
+
+/**
+ * Counts the positions of the input where a value fits in the offsets that can be mutated, i.e.
+ * the number of mutations made by a deterministic stage that steps through the input.
+ * region_map_update must have been called with the input first.
+ * @param map - the region_map_t to count the positions of
+ * @param width - the size of the value, in bits or bytes
+ * @param bits - 1 if width is in bits, 0 if it is in bytes
+ * @return - the number of positions
+ */
+MUTATORS_API uint64_t region_map_count(region_map_t * map, size_t width, int bits)
+{
+	uint64_t count = 0;
+	size_t i;
+
+	for (i = 0; i < map->count; i++)
+		count += range_positions(&map->ranges[i], width, bits);
+	return count;
+}
+
+/**
+ * Finds the position of the index'th place that a value fits in the offsets that can be mutated.
+ * Stepping through the indices in order only looks at each range once.
+ * @param map - the region_map_t to find the position in
+ * @param index - which of the positions to find, from 0 to region_map_count() - 1
+ * @param width - the size of the value, in bits or bytes
+ * @param bits - 1 if width and the returned position are in bits, 0 if they are in bytes
+ * @param pos - used to return the position
+ * @return - 0 on success, nonzero if there isn't an index'th position
+ */
+MUTATORS_API int region_map_locate(region_map_t * map, uint64_t index, size_t width, int bits, uint64_t * pos)
+{
+	uint64_t positions;
+
+	if (map->cursor_width != width || map->cursor_bits != bits || index < map->cursor_before) {
+		reset_cursor(map);
+		map->cursor_width = width;
+		map->cursor_bits = bits;
+	}
+	for (; map->cursor_range < map->count; map->cursor_range++)
+	{
+		positions = range_positions(&map->ranges[map->cursor_range], width, bits);
+		if (index - map->cursor_before < positions) {
+			*pos = ((uint64_t)map->ranges[map->cursor_range].start << (bits ? 3 : 0)) + index - map->cursor_before;
+			return 0;
+		}
+		map->cursor_before += positions;
+	}
+	return 1;
+}
+
+/**
+ * Finds the range of mutable offsets that an offset is in.  While an output is being edited, this
+ * is one of the ranges of the output rather than the input.
+ * @param map - the region_map_t to search
+ * @param offset - the offset to find the range of.  The end of a range (where bytes can be
+ * inserted into it) counts as being in it.
+ * @return - the range, or NULL if the offset isn't in one
+ */
+MUTATORS_API const region_range_t * region_map_find(region_map_t * map, size_t offset)
+{
+	region_range_t * ranges = map->editing ? map->edit_ranges : map->ranges;
+	size_t low = 0, high = map->editing ? map->edit_count : map->count, mid;
+
+	//Find the last range that starts at or before the offset
+	while (low < high)
+	{
+		mid = low + (high - low) / 2;
+		if (ranges[mid].start <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (!low || offset > ranges[low - 1].end)
+		return NULL;
+	return &ranges[low - 1];
+}
+
+/**
+ * Checks whether a span of bytes can be mutated
+ * @param map - the region_map_t to check
+ * @param offset - the first offset of the span
+ * @param length - the length of the span.  A length of 0 checks whether bytes can be inserted at offset.
+ * @return - 1 if every byte of the span can be mutated, 0 otherwise
+ */
+MUTATORS_API int region_map_contains(region_map_t * map, size_t offset, size_t length)
+{
+	const region_range_t * range = region_map_find(map, offset);
+	return range && length <= range->end - offset;
+}
+
+/* Finds the positions from low to high (not including high) in a range that are between start and
+   end, and where width bytes fit.  Returns 0 if there aren't any. */
+static int choice_bounds(const region_range_t * range, size_t start, size_t end, size_t width, size_t * low, size_t * high)
+{
+	if (range->end - range->start < width)
+		return 0;
+	*low = range->start > start ? range->start : start;
+	*high = range->end - width + 1 < end ? range->end - width + 1 : end;
+	return *low < *high;
+}
+
+/**
+ * Chooses a position in the offsets that can be mutated, uniformly from the positions between start
+ * and end where width bytes fit (or where bytes can be inserted, if width is 0).
+ * @param map - the region_map_t to choose the position from
+ * @param start - the first position that can be chosen
+ * @param end - one past the last position that can be chosen
+ * @param width - the number of bytes that will be mutated at the position
+ * @param random - a random number used to choose the position
+ * @param pos - used to return the chosen position
+ * @return - 0 on success, nonzero if there aren't any positions to choose from
+ */
+MUTATORS_API int region_map_choose(region_map_t * map, size_t start, size_t end, size_t width, uint64_t random, size_t * pos)
+{
+	region_range_t * ranges = map->editing ? map->edit_ranges : map->ranges;
+	size_t i, count = map->editing ? map->edit_count : map->count, low, high;
+	uint64_t total = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (choice_bounds(&ranges[i], start, end, width, &low, &high))
+			total += high - low;
+	}
+	if (!total)
+		return 1;
+
+	random %= total;
+	for (i = 0; i < count; i++)
+	{
+		if (!choice_bounds(&ranges[i], start, end, width, &low, &high))
+			continue;
+		if (random < high - low) {
+			*pos = low + (size_t)random;
+			return 0;
+		}
+		random -= high - low;
+	}
+	return 1;
+}
+
+/**
+ * Starts editing an output made from the input that the map was last updated with.  Until
+ * region_map_end_edit is called, region_map_find, region_map_contains, and region_map_choose use
+ * the ranges of the output, as updated by region_map_edit.
+ * @param map - the region_map_t to start editing
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int region_map_begin_edit(region_map_t * map)
+{
+	region_range_t * ranges;
+
+	if (map->edit_max < map->count) {
+		ranges = (region_range_t *)realloc(map->edit_ranges, map->count * sizeof(region_range_t));
+		if (!ranges)
+			return 1;
+		map->edit_ranges = ranges;
+		map->edit_max = map->count;
+	}
+	if (map->count)
+		memcpy(map->edit_ranges, map->ranges, map->count * sizeof(region_range_t));
+	map->edit_count = map->count;
+	map->editing = 1;
+	return 0;
+}
+
+/**
+ * Records that bytes were removed from and/or inserted into the output being edited, so that the
+ * offsets after them still line up with the output.  The removed bytes must all be mutable.
+ * @param map - the region_map_t being edited
+ * @param offset - the offset of the edit
+ * @param remove_length - the number of bytes removed at offset
+ * @param insert_length - the number of bytes inserted at offset, which can be mutated by later edits
+ */
+MUTATORS_API void region_map_edit(region_map_t * map, size_t offset, size_t remove_length, size_t insert_length)
+{
+	region_range_t * range, * ranges_end = map->edit_ranges + map->edit_count;
+
+	if (!map->editing || remove_length == insert_length)
+		return;
+	range = (region_range_t *)region_map_find(map, offset);
+	if (!range)
+		return;
+	range->end = range->end - remove_length + insert_length;
+	for (range++; range < ranges_end; range++)
+	{
+		range->start = range->start - remove_length + insert_length;
+		range->end = range->end - remove_length + insert_length;
+	}
+}
+
+/**
+ * Stops editing an output, so that the map's ranges are the input's again
+ * @param map - the region_map_t to stop editing
+ */
+MUTATORS_API void region_map_end_edit(region_map_t * map)
+{
+	map->editing = 0;
+}
+
+/**
+ * Adds a region map's options to a mutator's state
+ * @param obj - the JSON object to add the options to
+ * @param name - the name to save the regions with.  The protected bytes are saved as name_protect.
+ * @param map - the region_map_t to save
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int region_map_add_to_json(json_t * obj, const char * name, region_map_t * map)
+{
+	json_t * temp;
+	char protect_name[256];
+
+	snprintf(protect_name, sizeof(protect_name), "%s_protect", name);
+	ADD_STRING(temp, map->regions, obj, name);
+	ADD_STRING(temp, map->protect, obj, protect_name);
+	return 1;
+}
+
+/**
+ * Loads the options saved by region_map_add_to_json.  If the state doesn't have any, every offset
+ * of the input can be mutated.
+ * @param state - the mutator's saved state
+ * @param name - the name the regions were saved with
+ * @param map - the region_map_t to load the options into
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int region_map_get_from_json(char * state, const char * name, region_map_t * map)
+{
+	char protect_name[256];
+	char * regions = NULL, * protect = NULL;
+	json_t * root;
+	int result, ret = 1;
+
+	region_map_free(map);
+	root = json_loads(state, 0, NULL);
+	if (!root)
+		return 1;
+
+	snprintf(protect_name, sizeof(protect_name), "%s_protect", name);
+	regions = get_string_options_from_json(root, name, &result);
+	if (result >= 0) {
+		if (!result)
+			regions = NULL;
+		protect = get_string_options_from_json(root, protect_name, &result);
+		if (result >= 0)
+			ret = region_map_set(map, regions, result ? protect : NULL);
+		if (result <= 0)
+			protect = NULL;
+	}
+	free(regions);
+	free(protect);
+	json_decref(root);
+	return ret;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//A range of offsets, from start up to (but not including) end
+typedef struct {
+	size_t start;
+	size_t end;
+} region_range_t;
+
+//Limits the offsets of the input that are mutated to the given regions (e.g. to leave a file's
+//magic number or length fields alone), optionally also leaving alone the bytes with certain
+//values.  The offsets that can be mutated are computed for each input as a sorted list of ranges.
+typedef struct {
+	int enabled;
+	char * regions;         //The regions option, a list of offsets in the format understood by cut(1)
+	char * protect;         //The protect_bytes option, a list of byte values in the same format
+	region_range_t * spec;  //The regions, sorted and merged.  Open ended regions end at SIZE_MAX.
+	size_t spec_count;
+	uint8_t protected_bytes[256]; //Set for each byte value that isn't mutated
+	int has_protected_bytes;
+
+	region_range_t * ranges; //The offsets of the current input that can be mutated
+	size_t count;
+	size_t max;
+	size_t input_length;
+	int valid; //Whether ranges has been computed for the current input
+
+	//A copy of ranges that follows the insertions and deletions made while an output is edited,
+	//so that the later edits to the output still avoid the bytes that can't be mutated
+	region_range_t * edit_ranges;
+	size_t edit_count;
+	size_t edit_max;
+	int editing;
+
+	//Where the last position found by region_map_locate was, so stepping through them is fast
+	size_t cursor_width;
+	int cursor_bits;
+	size_t cursor_range;
+	uint64_t cursor_before;
+} region_map_t;
+
+MUTATORS_API int region_map_set(region_map_t * map, const char * regions, const char * protect);
+MUTATORS_API void region_map_free(region_map_t * map);
+MUTATORS_API size_t region_map_memory_usage(const region_map_t * map);
+MUTATORS_API int region_map_update(region_map_t * map, const uint8_t * input, size_t input_length);
+MUTATORS_API uint64_t region_map_count(region_map_t * map, size_t width, int bits);
+MUTATORS_API int region_map_locate(region_map_t * map, uint64_t index, size_t width, int bits, uint64_t * pos);
+MUTATORS_API const region_range_t * region_map_find(region_map_t * map, size_t offset);
+MUTATORS_API int region_map_contains(region_map_t * map, size_t offset, size_t length);
+MUTATORS_API int region_map_choose(region_map_t * map, size_t start, size_t end, size_t width, uint64_t random, size_t * pos);
+MUTATORS_API int region_map_begin_edit(region_map_t * map);
+MUTATORS_API void region_map_edit(region_map_t * map, size_t offset, size_t remove_length, size_t insert_length);
+MUTATORS_API void region_map_end_edit(region_map_t * map);
+MUTATORS_API int region_map_add_to_json(json_t * obj, const char * name, region_map_t * map);
+MUTATORS_API int region_map_get_from_json(char * state, const char * name, region_map_t * map);
@@ -0,0 +1,390 @@
+#include "seed_pool.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t find_seed(seed_pool_t * pool, int id)
+{
+	size_t i;
+	for (i = 0; i < pool->count; i++)
+	{
+		if (pool->seeds[i].id == id)
+			break;
+	}
+	return i;
+}
+
+/* Returns the length of a blob of length bytes once it's encoded by ADD_MEM, or 0 on failure */
+static size_t encoded_mem_length(size_t length)
+{
+	json_t * encoded;
+	char * zeros;
+	size_t encoded_length = 0;
+
+	zeros = (char *)calloc(1, length);
+	if (!zeros)
+		return 0;
+	encoded = json_mem(zeros, length);
+	if (encoded && json_is_string(encoded))
+		encoded_length = json_string_length(encoded);
+	if (encoded)
+		json_decref(encoded);
+	free(zeros);
+	return encoded_length;
+}
+
+static seed_pool_seed_t * new_seed(seed_pool_t * pool)
+{
+	seed_pool_seed_t * seeds, * seed;
+
+	if (pool->count == pool->max) {
+		seeds = (seed_pool_seed_t *)realloc(pool->seeds, (pool->max ? pool->max * 2 : 8) * sizeof(seed_pool_seed_t));
+		if (!seeds)
+			return NULL;
+		pool->seeds = seeds;
+		pool->max = pool->max ? pool->max * 2 : 8;
+	}
+	seed = &pool->seeds[pool->count];
+	memset(seed, 0, sizeof(seed_pool_seed_t));
+	if (pool->progress_size) {
+		seed->progress = calloc(1, pool->progress_size);
+		if (!seed->progress)
+			return NULL;
+	}
+	return seed;
+}
+
+/**
+ * Adds a seed to a seed pool.  The first time a seed is added, the mutator's current input is
+ * added to the pool as seed 0.
+ * @param pool - the seed_pool_t to add the seed to
+ * @param input - the seed's contents
+ * @param input_length - the length of input
+ * @param progress - the mutator's progress through the new seed, i.e. the progress of a seed that
+ * hasn't been mutated yet
+ * @param progress_size - the size of progress.  This must be the same each time a seed is added.
+ * @return - the id of the new seed, or -1 on failure
+ */
+MUTATORS_API int seed_pool_add(seed_pool_t * pool, const char * input, size_t input_length, const void * progress, size_t progress_size)
+{
+	seed_pool_seed_t * seed;
+
+	if (!input_length || (pool->count && progress_size != pool->progress_size))
+		return -1;
+
+	if (!pool->count) {
+		pool->progress_size = progress_size;
+		seed = new_seed(pool);
+		if (!seed)
+			return -1;
+		seed->id = 0;
+		pool->count = 1;
+		pool->selected = 0;
+		pool->next_id = 1;
+	}
+
+	seed = new_seed(pool);
+	if (!seed)
+		return -1;
+	seed->input = (char *)malloc(input_length);
+	if (!seed->input) {
+		free(seed->progress);
+		return -1;
+	}
+	memcpy(seed->input, input, input_length);
+	seed->input_length = input_length;
+	if (progress_size)
+		memcpy(seed->progress, progress, progress_size);
+	seed->id = pool->next_id++;
+	pool->count++;
+	return seed->id;
+}
+
+/**
+ * Removes a seed from a seed pool.  The selected seed can't be removed.
+ * @param pool - the seed_pool_t to remove the seed from
+ * @param id - the id of the seed to remove
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int seed_pool_remove(seed_pool_t * pool, int id)
+{
+	size_t index = find_seed(pool, id);
+
+	if (index == pool->count || index == pool->selected)
+		return 1;
+	free(pool->seeds[index].input);
+	free(pool->seeds[index].progress);
+
+	//Move the last seed into the removed seed's place, so the seeds stay contiguous
+	pool->count--;
+	if (index != pool->count) {
+		pool->seeds[index] = pool->seeds[pool->count];
+		if (pool->selected == pool->count)
+			pool->selected = index;
+	}
+	return 0;
+}
+
+/**
+ * Selects the seed that the mutator mutates.  The selected seed's input and progress are swapped
+ * with the mutator's, so the mutator's previous input and progress are kept in the pool until
+ * their seed is selected again.
+ * @param pool - the seed_pool_t with the seed
+ * @param id - the id of the seed to select
+ * @param input - a pointer to the mutator's input.  The previous input is stored in the pool.
+ * @param input_length - a pointer to the length of the mutator's input
+ * @param progress - the mutator's progress through its input, pool->progress_size bytes long
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int seed_pool_select(seed_pool_t * pool, int id, char ** input, size_t * input_length, void * progress)
+{
+	seed_pool_seed_t * current, * next;
+	size_t index;
+
+	if (!pool->count) //The mutator's input is the only seed
+		return id != 0;
+	index = find_seed(pool, id);
+	if (index == pool->count)
+		return 1;
+	if (index == pool->selected)
+		return 0;
+
+	current = &pool->seeds[pool->selected];
+	next = &pool->seeds[index];
+	current->input = *input;
+	current->input_length = *input_length;
+	*input = next->input;
+	*input_length = next->input_length;
+	next->input = NULL;
+	next->input_length = 0;
+	if (pool->progress_size) {
+		memcpy(current->progress, progress, pool->progress_size);
+		memcpy(progress, next->progress, pool->progress_size);
+	}
+	pool->selected = index;
+	return 0;
+}
+
+/**
+ * Gets the id of the selected seed
+ * @param pool - the seed_pool_t to get the selected seed of
+ * @return - the id of the selected seed
+ */
+MUTATORS_API int seed_pool_selected_id(seed_pool_t * pool)
+{
+	if (!pool->count)
+		return 0;
+	return pool->seeds[pool->selected].id;
+}
+
+/**
+ * Gets the number of seeds in the pool other than the selected one
+ * @param pool - the seed_pool_t to count the seeds of
+ * @return - the number of seeds that aren't selected
+ */
+MUTATORS_API size_t seed_pool_other_count(seed_pool_t * pool)
+{
+	return pool->count ? pool->count - 1 : 0;
+}
+
+/**
+ * Gets one of the seeds other than the selected one, e.g. to splice with the selected seed
+ * @param pool - the seed_pool_t with the seed
+ * @param n - which of the seeds to get, from 0 to seed_pool_other_count() - 1
+ * @param input_length - used to return the length of the seed
+ * @return - the seed's contents, which are owned by the pool
+ */
+MUTATORS_API char * seed_pool_other_seed(seed_pool_t * pool, size_t n, size_t * input_length)
+{
+	seed_pool_seed_t * seed = &pool->seeds[n < pool->selected ? n : n + 1];
+	*input_length = seed->input_length;
+	return seed->input;
+}
+
+/**
+ * Frees the seeds in a seed_pool_t, other than the selected one (whose input is held by the
+ * mutator).  The seed_pool_t itself is not freed.
+ * @param pool - the seed_pool_t to free the seeds of
+ */
+MUTATORS_API void seed_pool_free(seed_pool_t * pool)
+{
+	size_t i;
+	for (i = 0; i < pool->count; i++)
+	{
+		free(pool->seeds[i].input);
+		free(pool->seeds[i].progress);
+	}
+	free(pool->seeds);
+	memset(pool, 0, sizeof(seed_pool_t));
+}
+
+/**
+ * Counts the memory allocated by a seed pool, not including the seed_pool_t itself or the selected
+ * seed's input (which is held by the mutator)
+ * @param pool - the seed_pool_t to count the memory of
+ * @return - the number of bytes allocated for the seeds
+ */
+MUTATORS_API size_t seed_pool_memory_usage(const seed_pool_t * pool)
+{
+	size_t i, bytes = pool->max * sizeof(seed_pool_seed_t);
+	for (i = 0; i < pool->count; i++)
+	{
+		if (pool->seeds[i].input)
+			bytes += pool->seeds[i].input_length;
+		if (pool->seeds[i].progress)
+			bytes += pool->progress_size;
+	}
+	return bytes;
+}
+
+/**
+ * Adds the seeds in a seed pool to a mutator's state.  The selected seed is saved with the mutator's
+ * input, so the state can be loaded into a mutator that was created with a different one.
+ * @param obj - the JSON object to add the seeds to
+ * @param name - the name to save the seeds with
+ * @param pool - the seed_pool_t to save
+ * @param input - the mutator's input, i.e. the selected seed's input
+ * @param input_length - the length of the mutator's input
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int seed_pool_add_to_json(json_t * obj, const char * name, seed_pool_t * pool, const char * input, size_t input_length)
+{
+	json_t *temp, *seed_list, *seed_obj;
+	char field_name[256];
+	size_t i;
+
+	if (!pool->count)
+		return 1;
+	snprintf(field_name, sizeof(field_name), "%s_selected", name);
+	ADD_INT(temp, pool->seeds[pool->selected].id, obj, field_name);
+	snprintf(field_name, sizeof(field_name), "%s_next_id", name);
+	ADD_INT(temp, pool->next_id, obj, field_name);
+	snprintf(field_name, sizeof(field_name), "%s_progress_size", name);
+	ADD_UINT64T(temp, pool->progress_size, obj, field_name);
+
+	seed_list = json_array();
+	if (!seed_list)
+		return 0;
+	json_object_set_new(obj, name, seed_list);
+	for (i = 0; i < pool->count; i++)
+	{
+		seed_obj = json_object();
+		if (!seed_obj)
+			return 0;
+		json_array_append_new(seed_list, seed_obj);
+		ADD_INT(temp, pool->seeds[i].id, seed_obj, "id");
+		if (i == pool->selected) {
+			ADD_MEM(temp, input, input_length, seed_obj, "input");
+			ADD_UINT64T(temp, input_length, seed_obj, "input_length");
+		}
+		else {
+			ADD_MEM(temp, pool->seeds[i].input, pool->seeds[i].input_length, seed_obj, "input");
+			ADD_UINT64T(temp, pool->seeds[i].input_length, seed_obj, "input_length");
+		}
+		if (pool->progress_size)
+			ADD_MEM(temp, pool->seeds[i].progress, pool->progress_size, seed_obj, "progress");
+	}
+	return 1;
+}
+
+/**
+ * Loads the seeds saved by seed_pool_add_to_json.  The selected seed's input replaces the mutator's
+ * input.  States that were saved without it keep the mutator's input.  States whose seeds' progress
+ * isn't progress_size bytes long (such as ones saved by a different build) are rejected.
+ * @param state - the mutator's saved state
+ * @param name - the name the seeds were saved with
+ * @param pool - the seed_pool_t to load the seeds into
+ * @param input - a pointer to the mutator's input.  If it's replaced, the previous input is freed.
+ * @param input_length - a pointer to the length of the mutator's input
+ * @param progress_size - the size of the progress that the mutator passes to seed_pool_add and
+ * seed_pool_select, or 0 if it doesn't keep any
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int seed_pool_get_from_json(char * state, const char * name, seed_pool_t * pool, char ** input, size_t * input_length,
+	size_t progress_size)
+{
+	char field_name[256];
+	int result, inner_result, selected;
+	json_t * seed_obj, * progress_obj;
+	seed_pool_seed_t * seed;
+	char * selected_input = NULL;
+	size_t selected_input_length = 0, progress_encoded_length = 0;
+
+	seed_pool_free(pool);
+	snprintf(field_name, sizeof(field_name), "%s_selected", name);
+	selected = get_int_options(state, field_name, &result);
+	if (result <= 0) //The seed pool isn't required
+		return result < 0;
+	snprintf(field_name, sizeof(field_name), "%s_next_id", name);
+	pool->next_id = get_int_options(state, field_name, &result);
+	if (result <= 0)
+		return 1;
+	snprintf(field_name, sizeof(field_name), "%s_progress_size", name);
+	pool->progress_size = (size_t)get_uint64t_options(state, field_name, &result);
+	if (result <= 0 || pool->progress_size != progress_size) {
+		pool->progress_size = 0;
+		return 1;
+	}
+	if (progress_size) {
+		progress_encoded_length = encoded_mem_length(progress_size);
+		if (!progress_encoded_length)
+			return 1;
+	}
+
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(state, seeds, name, seed_obj, result)
+		seed = new_seed(pool);
+		if (!seed) {
+			FOREACH_OBJECT_JSON_ARRAY_ITEM_FREE(seeds);
+			seed_pool_free(pool);
+			return 1;
+		}
+		pool->count++;
+		seed->id = get_int_options_from_json(seed_obj, "id", &inner_result);
+		if (inner_result <= 0)
+			result = -1;
+		if (seed->id != selected) {
+			seed->input_length = (size_t)get_uint64t_options_from_json(seed_obj, "input_length", &inner_result);
+			if (inner_result <= 0)
+				result = -1;
+			seed->input = get_mem_options_from_json(seed_obj, "input", &inner_result);
+			if (inner_result <= 0)
+				result = -1;
+		}
+		else if (!selected_input) {
+			selected_input_length = (size_t)get_uint64t_options_from_json(seed_obj, "input_length", &inner_result);
+			if (inner_result > 0) {
+				selected_input = get_mem_options_from_json(seed_obj, "input", &inner_result);
+				if (inner_result <= 0)
+					result = -1;
+			}
+		}
+		if (pool->progress_size) {
+			//The progress is copied into the mutator's, so it has to be exactly the size the mutator expects
+			progress_obj = json_object_get(seed_obj, "progress");
+			if (!progress_obj || !json_is_string(progress_obj) || json_string_length(progress_obj) != progress_encoded_length)
+				result = -1;
+			else {
+				free(seed->progress);
+				seed->progress = get_mem_options_from_json(seed_obj, "progress", &inner_result);
+				if (inner_result <= 0)
+					result = -1;
+			}
+		}
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_END(seeds);
+
+	pool->selected = find_seed(pool, selected);
+	if (result < 0 || pool->selected == pool->count) {
+		free(selected_input);
+		seed_pool_free(pool);
+		return 1;
+	}
+	if (selected_input) {
+		free(*input);
+		*input = selected_input;
+		*input_length = selected_input_length;
+	}
+	return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//One of the seeds in a seed_pool_t, and the mutator's progress through it
+typedef struct {
+	int id;
+	char * input;        //NULL for the selected seed, whose input is held by the mutator
+	size_t input_length;
+	void * progress;     //The mutator's progress through the seed, saved while it isn't selected
+} seed_pool_seed_t;
+
+//Holds the seeds that a mutator can switch between without being recreated.  The selected seed's
+//input stays in the mutator's state, so selecting a seed only swaps pointers and copies the
+//mutator's (fixed size) progress.  Until the first seed is added, the pool is empty and the
+//mutator's input is seed 0.
+typedef struct {
+	seed_pool_seed_t * seeds;
+	size_t count;
+	size_t max;
+	size_t selected;      //The index of the selected seed
+	int next_id;
+	size_t progress_size; //The size of each seed's progress
+} seed_pool_t;
+
+MUTATORS_API int seed_pool_add(seed_pool_t * pool, const char * input, size_t input_length, const void * progress, size_t progress_size);
+MUTATORS_API int seed_pool_remove(seed_pool_t * pool, int id);
+MUTATORS_API int seed_pool_select(seed_pool_t * pool, int id, char ** input, size_t * input_length, void * progress);
+MUTATORS_API int seed_pool_selected_id(seed_pool_t * pool);
+MUTATORS_API size_t seed_pool_other_count(seed_pool_t * pool);
+MUTATORS_API char * seed_pool_other_seed(seed_pool_t * pool, size_t n, size_t * input_length);
+MUTATORS_API void seed_pool_free(seed_pool_t * pool);
+MUTATORS_API size_t seed_pool_memory_usage(const seed_pool_t * pool);
+MUTATORS_API int seed_pool_add_to_json(json_t * obj, const char * name, seed_pool_t * pool, const char * input, size_t input_length);
+MUTATORS_API int seed_pool_get_from_json(char * state, const char * name, seed_pool_t * pool, char ** input, size_t * input_length,
+	size_t progress_size);
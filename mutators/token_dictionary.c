@@ -0,0 +1,731 @@
+#include "token_dictionary.h"
+#include "output_filter.h"
+
+#include <utils.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAX_PATH PATH_MAX //linux/apple have PATH_MAX, windows has MAX_PATH
+#endif
+
+//The total length of a dictionary's tokens
+#define DATA_LENGTH(dict) ((dict)->offsets ? (size_t)(dict)->offsets[(dict)->count] : 0)
+
+/**
+ * Counts the bytes that a dictionary's tokens and offsets take up once it's compacted
+ * @param dict - the token_dictionary_t to count the bytes of
+ * @return - the number of bytes
+ */
+static uint64_t compact_size(const token_dictionary_t * dict)
+{
+	return DATA_LENGTH(dict) + (dict->count + 1) * sizeof(uint32_t);
+}
+
+/**
+ * Maps a file into memory, read only
+ * @param filename - the name of the file
+ * @param mapping - set to the mapped file, or NULL if the file is empty
+ * @param size - set to the size of the file
+ * @return - 0 on success, nonzero if the file couldn't be opened or mapped
+ */
+static int map_file(const char * filename, void ** mapping, size_t * size)
+{
+	*mapping = NULL;
+	*size = 0;
+
+#ifdef _WIN32
+	HANDLE file, map;
+	LARGE_INTEGER file_size;
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 1;
+	if (!GetFileSizeEx(file, &file_size) || (uint64_t)file_size.QuadPart > SIZE_MAX) {
+		CloseHandle(file);
+		return 1;
+	}
+	*size = (size_t)file_size.QuadPart;
+	if (*size) {
+		map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		*mapping = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (map)
+			CloseHandle(map);
+	}
+	CloseHandle(file);
+#else
+	int fd;
+	struct stat st;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return 1;
+	}
+	*size = (size_t)st.st_size;
+	if (*size) {
+		*mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (*mapping == MAP_FAILED)
+			*mapping = NULL;
+	}
+	close(fd);
+#endif
+	return *size && !*mapping;
+}
+
+static void unmap_file(void * mapping, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+#else
+	munmap(mapping, size);
+#endif
+}
+
+static int is_directory(const char * path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+	return !stat(path, &st) && S_ISDIR(st.st_mode);
+#endif
+}
+
+/**
+ * Copies the tokens of a dictionary that points into a mapped file to memory that the dictionary
+ * owns, so that more tokens can be added to it
+ * @param dict - the token_dictionary_t to copy the tokens of
+ * @return - 0 on success, nonzero on failure
+ */
+static int copy_mapped_tokens(token_dictionary_t * dict)
+{
+	size_t data_length = DATA_LENGTH(dict);
+	uint8_t * data;
+	uint32_t * offsets;
+
+	data = (uint8_t *)malloc(data_length ? data_length : 1);
+	offsets = (uint32_t *)malloc((dict->count + 1) * sizeof(uint32_t));
+	if (!data || !offsets) {
+		free(data);
+		free(offsets);
+		return 1;
+	}
+	memcpy(data, dict->data, data_length);
+	memcpy(offsets, dict->offsets, (dict->count + 1) * sizeof(uint32_t));
+
+	unmap_file(dict->mapping, dict->mapping_size);
+	dict->mapping = NULL;
+	dict->mapping_size = 0;
+	dict->data = data;
+	dict->data_capacity = data_length ? data_length : 1;
+	dict->offsets = offsets;
+	dict->offsets_capacity = dict->count + 1;
+	return 0;
+}
+
+/**
+ * Makes room for another token after the last token in a dictionary's buffer
+ * @param dict - the token_dictionary_t to make room in
+ * @param length - the length of the token
+ * @return - 0 on success, nonzero on failure
+ */
+static int reserve_token(token_dictionary_t * dict, size_t length)
+{
+	size_t data_length, capacity;
+	void * temp;
+
+	if (dict->mapping && copy_mapped_tokens(dict))
+		return 1;
+
+	//The offsets are 32-bit, and the hash table holds each token's index + 1
+	data_length = DATA_LENGTH(dict);
+	if (length > UINT32_MAX - data_length || dict->count >= UINT32_MAX - 1)
+		return 1;
+
+	if (data_length + length > dict->data_capacity) {
+		for (capacity = dict->data_capacity ? dict->data_capacity : 4096; capacity < data_length + length; capacity *= 2);
+		temp = realloc(dict->data, capacity);
+		if (!temp)
+			return 1;
+		dict->data = (uint8_t *)temp;
+		dict->data_capacity = capacity;
+	}
+	if (dict->count + 2 > dict->offsets_capacity) {
+		capacity = dict->offsets_capacity ? dict->offsets_capacity * 2 : 256;
+		temp = realloc(dict->offsets, capacity * sizeof(uint32_t));
+		if (!temp)
+			return 1;
+		if (!dict->offsets)
+			((uint32_t *)temp)[0] = 0;
+		dict->offsets = (uint32_t *)temp;
+		dict->offsets_capacity = capacity;
+	}
+	return 0;
+}
+
+/**
+ * Finds a token in a dictionary's hash table
+ * @param dict - the token_dictionary_t to search
+ * @param token - the token to find
+ * @param length - the length of token
+ * @param hash - the hash of token
+ * @return - the slot that holds the token, or the empty slot where it would go if it isn't in the dictionary
+ */
+static size_t find_token(const token_dictionary_t * dict, const uint8_t * token, size_t length, uint64_t hash)
+{
+	size_t slot = (size_t)hash & (dict->slots_count - 1);
+	uint32_t index;
+
+	while ((index = dict->slots[slot]) != 0)
+	{
+		index--;
+		if (TOKEN_DICTIONARY_LENGTH(dict, index) == length && !memcmp(TOKEN_DICTIONARY_TOKEN(dict, index), token, length))
+			break;
+		slot = (slot + 1) & (dict->slots_count - 1);
+	}
+	return slot;
+}
+
+static int build_slots(token_dictionary_t * dict, size_t slots_count)
+{
+	size_t i;
+	uint32_t * slots;
+
+	slots = (uint32_t *)calloc(slots_count, sizeof(uint32_t));
+	if (!slots)
+		return 1;
+	free(dict->slots);
+	dict->slots = slots;
+	dict->slots_count = slots_count;
+	for (i = 0; i < dict->count; i++)
+	{
+		slots[find_token(dict, TOKEN_DICTIONARY_TOKEN(dict, i), TOKEN_DICTIONARY_LENGTH(dict, i),
+			output_filter_hash(TOKEN_DICTIONARY_TOKEN(dict, i), TOKEN_DICTIONARY_LENGTH(dict, i)))] = (uint32_t)(i + 1);
+	}
+	return 0;
+}
+
+/**
+ * Adds the token that was written after the last token in a dictionary's buffer (in the room made by
+ * reserve_token), unless it's already in the dictionary or it doesn't fit under the byte limit
+ * @param dict - the token_dictionary_t to add the token to
+ * @param length - the length of the token
+ * @param max_bytes - the most bytes that the compacted dictionary can take up, or 0 for no limit
+ * @return - 0 if the token was added or was already in the dictionary, 1 if it doesn't fit, or -1 on failure
+ */
+static int add_written_token(token_dictionary_t * dict, size_t length, uint64_t max_bytes)
+{
+	const uint8_t * token = dict->data + DATA_LENGTH(dict);
+	size_t slot, slots_count;
+
+	//The hash table is kept at most half full
+	if ((dict->count + 1) * 2 > dict->slots_count) {
+		for (slots_count = 64; slots_count < (dict->count + 1) * 4; slots_count *= 2);
+		if (build_slots(dict, slots_count))
+			return -1;
+	}
+
+	slot = find_token(dict, token, length, output_filter_hash(token, length));
+	if (dict->slots[slot]) {
+		dict->duplicates++;
+		return 0;
+	}
+	if (max_bytes && compact_size(dict) + length + sizeof(uint32_t) > max_bytes) {
+		dict->skipped++;
+		return 1;
+	}
+
+	dict->slots[slot] = (uint32_t)(dict->count + 1);
+	dict->offsets[dict->count + 1] = dict->offsets[dict->count] + (uint32_t)length;
+	dict->count++;
+	return 0;
+}
+
+/**
+ * Shrinks a dictionary's buffers to fit its tokens, and frees its hash table.  The hash table is
+ * rebuilt if more tokens are added.
+ * @param dict - the token_dictionary_t to compact
+ */
+static void compact_tokens(token_dictionary_t * dict)
+{
+	size_t data_length = DATA_LENGTH(dict);
+	void * temp;
+
+	free(dict->slots);
+	dict->slots = NULL;
+	dict->slots_count = 0;
+	if (dict->mapping || !dict->offsets)
+		return;
+
+	temp = realloc(dict->data, data_length ? data_length : 1);
+	if (temp) {
+		dict->data = (uint8_t *)temp;
+		dict->data_capacity = data_length ? data_length : 1;
+	}
+	temp = realloc(dict->offsets, (dict->count + 1) * sizeof(uint32_t));
+	if (temp) {
+		dict->offsets = (uint32_t *)temp;
+		dict->offsets_capacity = dict->count + 1;
+	}
+}
+
+static int hex_value(uint8_t c)
+{
+	return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+/**
+ * Parses a dictionary in the text format used by afl and honggfuzz.  Each line holds a token in
+ * double quotes, optionally after a name and an = sign, such as kw1="value".  The name can end with
+ * @level, in which case the token is only loaded when the dictionary's level is at least that high.
+ * The tokens can use the \\, \", \xNN, \a, \n, \r, \t, and \0 escapes.  The control characters
+ * have to be escaped, but bytes above 127 can be given as they are (as honggfuzz allows, though afl
+ * doesn't), so UTF-8 tokens don't need escaping.  Empty lines and lines that start with # are
+ * skipped.  The tokens are decoded straight into the dictionary's buffer.
+ * @param dict - the token_dictionary_t to add the tokens to
+ * @param filename - the name of the dictionary file, for the error messages
+ * @param contents - the contents of the dictionary file
+ * @param length - the length of contents
+ * @param level - the highest level of the tokens to load
+ * @param max_token_length - the longest token that's allowed, or 0 for no limit
+ * @param max_bytes - the most bytes that the compacted dictionary can take up, or 0 for no limit
+ * @return - 0 on success, nonzero on failure
+ */
+static int parse_dictionary_text(token_dictionary_t * dict, const char * filename, const uint8_t * contents, size_t length,
+	uint32_t level, size_t max_token_length, uint64_t max_bytes)
+{
+	const uint8_t * line, * line_end, * p, * end, * contents_end = contents + length;
+	uint8_t * token;
+	size_t token_length;
+	uint32_t token_level, line_number = 0;
+
+	for (line = contents; line < contents_end; line = line_end + 1)
+	{
+		line_number++;
+		line_end = (const uint8_t *)memchr(line, '\n', contents_end - line);
+		if (!line_end)
+			line_end = contents_end;
+
+		// Trim on left and right, and skip empty lines and comments.
+		for (p = line; p < line_end && isspace(*p); p++);
+		for (end = line_end; end > p && isspace(end[-1]); end--);
+		if (p == end || *p == '#')
+			continue;
+
+		// All other lines must end with '"', which we can consume.
+		if (end[-1] != '"') {
+			printf("Malformed name=\"value\" pair in dictionary file %s on line %u.\n", filename, line_number);
+			return 1;
+		}
+		end--;
+
+		// Skip the name, and parse the @level after it, if there is one.
+		while (p < end && *p != '"' && *p != '@' && *p != '=' && !isspace(*p))
+			p++;
+		if (p < end && *p == '@') {
+			for (p++, token_level = 0; p < end && isdigit(*p); p++)
+				token_level = token_level > (UINT32_MAX - 9) / 10 ? UINT32_MAX : token_level * 10 + (*p - '0');
+			if (token_level > level)
+				continue;
+		}
+
+		// Skip whitespace and = signs, and consume the opening '"'.
+		while (p < end && (isspace(*p) || *p == '='))
+			p++;
+		if (p == end || *p != '"') {
+			printf("Malformed name=\"keyword\" pair in dictionary file %s on line %u.\n", filename, line_number);
+			return 1;
+		}
+		p++;
+		if (p == end) {
+			printf("Empty keyword in dictionary file %s on line %u.\n", filename, line_number);
+			return 1;
+		}
+
+		// The decoded token is never longer than the text between the quotes
+		if (reserve_token(dict, end - p)) {
+			printf("Failed allocating memory while parsing dictionary file %s, line %u.\n", filename, line_number);
+			return 1;
+		}
+		token = dict->data + DATA_LENGTH(dict);
+		token_length = 0;
+		while (p < end)
+		{
+			if (*p < 32 || *p == 127) {
+				printf("Non-printable characters in dictionary file %s on line %u.\n", filename, line_number);
+				return 1;
+			}
+			if (*p != '\\') {
+				token[token_length++] = *(p++);
+				continue;
+			}
+
+			p++;
+			switch (p < end ? *p : 0)
+			{
+			case '\\':
+			case '"':
+				token[token_length++] = *p;
+				break;
+			case 'a': token[token_length++] = '\a'; break;
+			case 'n': token[token_length++] = '\n'; break;
+			case 'r': token[token_length++] = '\r'; break;
+			case 't': token[token_length++] = '\t'; break;
+			case '0': token[token_length++] = '\0'; break;
+			case 'x':
+				if (end - p >= 3 && isxdigit(p[1]) && isxdigit(p[2])) {
+					token[token_length++] = (uint8_t)((hex_value(p[1]) << 4) | hex_value(p[2]));
+					p += 2;
+					break;
+				}
+				//Fall through to the error
+			default:
+				printf("Invalid escaping in dictionary file %s on line %u.\n", filename, line_number);
+				return 1;
+			}
+			p++;
+		}
+
+		if (max_token_length && token_length > max_token_length) {
+			printf("Keyword too big in dictionary file %s on line %u (%llu bytes, limit is %llu).\n", filename, line_number,
+				(unsigned long long)token_length, (unsigned long long)max_token_length);
+			return 1;
+		}
+		if (add_written_token(dict, token_length, max_bytes) < 0) {
+			printf("Failed allocating memory while parsing dictionary file %s, line %u.\n", filename, line_number);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Loads a mapped compiled dictionary file.  If the dictionary is empty (and the file fits under the
+ * byte limit), the dictionary uses the mapped file as is; otherwise the file's tokens are added to
+ * the dictionary and the file is unmapped.
+ * @param dict - the token_dictionary_t to load the tokens into
+ * @param filename - the name of the file, for the error messages
+ * @param mapping - the mapped file, which this function takes ownership of
+ * @param size - the size of the mapped file
+ * @param max_token_length - the longest token that's allowed, or 0 for no limit
+ * @param max_bytes - the most bytes that the dictionary can take up, or 0 for no limit
+ * @return - 0 on success, nonzero on failure
+ */
+static int load_compiled_dictionary(token_dictionary_t * dict, const char * filename, void * mapping, size_t size,
+	size_t max_token_length, uint64_t max_bytes)
+{
+	const token_dictionary_header_t * header = (const token_dictionary_header_t *)mapping;
+	const uint32_t * offsets = (const uint32_t *)(header + 1);
+	const uint8_t * data;
+	uint64_t i;
+
+	if (size < sizeof(token_dictionary_header_t) + sizeof(uint32_t) || header->count >= UINT32_MAX - 1
+		|| header->data_length > UINT32_MAX
+		|| size != sizeof(token_dictionary_header_t) + (header->count + 1) * sizeof(uint32_t) + header->data_length
+		|| offsets[0] != 0 || offsets[header->count] != header->data_length)
+	{
+		printf("The compiled dictionary file %s isn't valid.\n", filename);
+		unmap_file(mapping, size);
+		return 1;
+	}
+	for (i = 0; i < header->count; i++)
+	{
+		if (offsets[i + 1] < offsets[i] || (max_token_length && offsets[i + 1] - offsets[i] > max_token_length)) {
+			printf("The compiled dictionary file %s has an invalid token (token %llu).\n", filename, (unsigned long long)i);
+			unmap_file(mapping, size);
+			return 1;
+		}
+	}
+	data = (const uint8_t *)(offsets + header->count + 1);
+
+	if (!dict->offsets && !dict->mapping && (!max_bytes || size <= max_bytes)) {
+		dict->mapping = mapping;
+		dict->mapping_size = size;
+		dict->offsets = (uint32_t *)offsets;
+		dict->data = (uint8_t *)data;
+		dict->count = (size_t)header->count;
+		return 0;
+	}
+
+	for (i = 0; i < header->count; i++)
+	{
+		if (token_dictionary_add(dict, data + offsets[i], offsets[i + 1] - offsets[i], max_bytes) < 0) {
+			printf("Failed allocating memory while loading dictionary file %s.\n", filename);
+			unmap_file(mapping, size);
+			return 1;
+		}
+	}
+	unmap_file(mapping, size);
+	return 0;
+}
+
+static int add_token_file(token_dictionary_t * dict, const char * filename, uint64_t max_bytes)
+{
+	char * contents;
+	int length, ret;
+
+	length = read_file((char *)filename, &contents);
+	if (length < 0) {
+		printf("Unable to open dictionary file '%s'\n", filename);
+		return 1;
+	}
+	ret = token_dictionary_add(dict, (const uint8_t *)contents, length, max_bytes);
+	free(contents);
+	if (ret < 0) {
+		printf("Failed allocating memory while parsing dictionary file %s.\n", filename);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Loads each file in a directory as a token
+ * @param dict - the token_dictionary_t to add the tokens to
+ * @param path - the directory
+ * @param max_token_length - the longest token that's allowed, or 0 for no limit
+ * @param max_bytes - the most bytes that the compacted dictionary can take up, or 0 for no limit
+ * @return - 0 on success, nonzero on failure
+ */
+static int load_dictionary_directory(token_dictionary_t * dict, const char * path, size_t max_token_length, uint64_t max_bytes)
+{
+	char filename[MAX_PATH];
+
+#ifdef _WIN32
+	WIN32_FIND_DATA fdata;
+	HANDLE h;
+	wchar_t * wide_pattern;
+
+	if (path[strlen(path) - 1] == '\\')
+		snprintf(filename, sizeof(filename), "%s*", path);
+	else
+		snprintf(filename, sizeof(filename), "%s\\*", path);
+	wide_pattern = convert_char_array_to_wchar(filename, NULL);
+	h = FindFirstFile(wide_pattern, &fdata);
+	free(wide_pattern);
+	if (h == INVALID_HANDLE_VALUE) {
+		printf("Unable to open dictionary directory '%s'\n", path);
+		return 1;
+	}
+
+	do {
+		if ((fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || (!fdata.nFileSizeHigh && !fdata.nFileSizeLow))
+			continue;
+
+		snprintf(filename, sizeof(filename), "%s\\%s", path, fdata.cFileName);
+		if (_access(filename, 0)) {
+			printf("Unable to access dictionary file '%s'\n", filename);
+			FindClose(h);
+			return 1;
+		}
+		if (fdata.nFileSizeHigh > 0 || (max_token_length && fdata.nFileSizeLow > max_token_length)) {
+			printf("Dictionary item '%s' is too big (limit is %llu bytes)\n", filename, (unsigned long long)max_token_length);
+			FindClose(h);
+			return 1;
+		}
+		if (add_token_file(dict, filename, max_bytes)) {
+			FindClose(h);
+			return 1;
+		}
+	} while (FindNextFile(h, &fdata));
+
+	FindClose(h);
+#else
+	DIR * d;
+	struct dirent * de;
+	struct stat st;
+
+	d = opendir(path);
+	if (!d) {
+		printf("Unable to open dictionary directory '%s'\n", path);
+		return 1;
+	}
+
+	while ((de = readdir(d)))
+	{
+		snprintf(filename, sizeof(filename), "%s/%s", path, de->d_name);
+		if (lstat(filename, &st) || access(filename, R_OK)) {
+			printf("Unable to access dictionary file '%s'\n", filename);
+			closedir(d);
+			return 1;
+		}
+
+		/* This also takes care of . and .. */
+		if (!S_ISREG(st.st_mode) || !st.st_size)
+			continue;
+
+		if (max_token_length && (uint64_t)st.st_size > max_token_length) {
+			printf("Dictionary item '%s' is too big (%llu bytes, limit is %llu)\n", filename,
+				(unsigned long long)st.st_size, (unsigned long long)max_token_length);
+			closedir(d);
+			return 1;
+		}
+		if (add_token_file(dict, filename, max_bytes)) {
+			closedir(d);
+			return 1;
+		}
+	}
+	closedir(d);
+#endif
+	return 0;
+}
+
+/**
+ * Loads the tokens of a dictionary, and adds them to a dictionary.  The path can be:
+ * - a directory, in which case each file in it is a token
+ * - a compiled dictionary file (written by token_dictionary_save), which is mapped rather than parsed
+ * - a dictionary file in the afl/honggfuzz text format, which can be followed by @level to load
+ *   only the tokens with a level up to that one
+ * Tokens that are already in the dictionary are skipped, as are the tokens that don't fit under
+ * max_bytes (which are counted in the dictionary's skipped field).
+ * @param dict - the token_dictionary_t to add the tokens to
+ * @param path - the path of the dictionary
+ * @param max_token_length - the longest token that's allowed, or 0 for no limit
+ * @param max_bytes - the most bytes that the dictionary can take up, or 0 for no limit
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_dictionary_load(token_dictionary_t * dict, const char * path, size_t max_token_length, uint64_t max_bytes)
+{
+	char * filename, * level_string;
+	uint32_t level = 0;
+	uint64_t magic = 0;
+	void * mapping;
+	size_t size;
+	int ret;
+
+	filename = strdup(path);
+	if (!filename)
+		return 1;
+	level_string = strrchr(filename, '@');
+	if (level_string) {
+		*level_string = 0;
+		level = (uint32_t)strtoul(level_string + 1, NULL, 10);
+	}
+
+	if (is_directory(filename)) {
+		if (level_string) {
+			printf("Dictionary levels not supported for directories.\n");
+			ret = 1;
+		}
+		else
+			ret = load_dictionary_directory(dict, filename, max_token_length, max_bytes);
+	}
+	else if (map_file(filename, &mapping, &size)) {
+		printf("Unable to open dictionary file '%s'\n", filename);
+		ret = 1;
+	}
+	else {
+		if (size >= sizeof(magic))
+			memcpy(&magic, mapping, sizeof(magic));
+		if (magic == TOKEN_DICTIONARY_MAGIC)
+			ret = load_compiled_dictionary(dict, filename, mapping, size, max_token_length, max_bytes);
+		else {
+			ret = parse_dictionary_text(dict, filename, (const uint8_t *)mapping, size, level, max_token_length, max_bytes);
+			if (mapping)
+				unmap_file(mapping, size);
+		}
+	}
+
+	free(filename);
+	compact_tokens(dict);
+	return ret;
+}
+
+/**
+ * Writes a dictionary to a compiled dictionary file, which token_dictionary_load can map instead of
+ * parsing.  The file uses the machine's byte order.
+ * @param dict - the token_dictionary_t to write
+ * @param filename - the name of the file to write
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_dictionary_save(const token_dictionary_t * dict, const char * filename)
+{
+	token_dictionary_header_t header;
+	uint32_t empty_offset = 0;
+	FILE * fp;
+	int failed;
+
+	memset(&header, 0, sizeof(token_dictionary_header_t));
+	header.magic = TOKEN_DICTIONARY_MAGIC;
+	header.count = dict->count;
+	header.data_length = DATA_LENGTH(dict);
+
+	fp = fopen(filename, "wb");
+	if (!fp) {
+		printf("Unable to create the compiled dictionary file '%s'\n", filename);
+		return 1;
+	}
+	failed = fwrite(&header, sizeof(token_dictionary_header_t), 1, fp) != 1;
+	if (dict->offsets)
+		failed |= fwrite(dict->offsets, sizeof(uint32_t), dict->count + 1, fp) != dict->count + 1;
+	else
+		failed |= fwrite(&empty_offset, sizeof(uint32_t), 1, fp) != 1;
+	if (header.data_length)
+		failed |= fwrite(dict->data, 1, (size_t)header.data_length, fp) != header.data_length;
+	failed |= fclose(fp) != 0;
+	if (failed) {
+		printf("Failed writing the compiled dictionary file '%s'\n", filename);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Adds a token to a dictionary, unless it's already in the dictionary or it doesn't fit under the
+ * byte limit
+ * @param dict - the token_dictionary_t to add the token to
+ * @param token - the token, which is copied into the dictionary
+ * @param length - the length of token
+ * @param max_bytes - the most bytes that the dictionary can take up, or 0 for no limit
+ * @return - 0 if the token was added or was already in the dictionary, 1 if it doesn't fit, or -1 on failure
+ */
+MUTATORS_API int token_dictionary_add(token_dictionary_t * dict, const uint8_t * token, size_t length, uint64_t max_bytes)
+{
+	if (reserve_token(dict, length))
+		return -1;
+	memcpy(dict->data + DATA_LENGTH(dict), token, length);
+	return add_written_token(dict, length, max_bytes);
+}
+
+/**
+ * Frees (or unmaps) the tokens of a dictionary, and empties it.  The token_dictionary_t itself is
+ * not freed.
+ * @param dict - the token_dictionary_t to free
+ */
+MUTATORS_API void token_dictionary_free(token_dictionary_t * dict)
+{
+	if (dict->mapping)
+		unmap_file(dict->mapping, dict->mapping_size);
+	else {
+		free(dict->data);
+		free(dict->offsets);
+	}
+	free(dict->slots);
+	memset(dict, 0, sizeof(token_dictionary_t));
+}
+
+/**
+ * Counts the memory used by a dictionary, not including the token_dictionary_t itself.  When the
+ * dictionary uses a mapped compiled dictionary file, this includes the size of the mapping.
+ * @param dict - the token_dictionary_t to count the memory of
+ * @return - the number of bytes allocated (or mapped) for the dictionary
+ */
+MUTATORS_API size_t token_dictionary_memory_usage(const token_dictionary_t * dict)
+{
+	return dict->mapping_size + dict->data_capacity + (dict->offsets_capacity + dict->slots_count) * sizeof(uint32_t);
+}
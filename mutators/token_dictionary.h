@@ -0,0 +1,46 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TOKEN_DICTIONARY_MAGIC 0x31544349444b4f54ULL //"TOKDICT1"
+
+//The start of a compiled dictionary file.  It's followed by count + 1 offsets (as uint32_t), and
+//then by the tokens' bytes, one after another, so the file can be mapped and used without parsing.
+typedef struct {
+	uint64_t magic;
+	uint64_t count;       //The number of tokens
+	uint64_t data_length; //The total length of the tokens
+	uint64_t reserved;
+} token_dictionary_header_t;
+
+//The tokens of a dictionary, stored one after another in a single buffer, with a table of where
+//each token starts.  Tokens that are already in the dictionary aren't added again.  A dictionary
+//that's loaded from a compiled dictionary file points into the mapped file instead, until a
+//token is added to it.
+typedef struct {
+	uint8_t * data;     //The tokens' bytes
+	uint32_t * offsets; //Token i is the bytes from data + offsets[i] to data + offsets[i + 1]
+	size_t count;
+	size_t data_capacity;
+	size_t offsets_capacity;
+	uint32_t * slots;   //A hash table of each token's index + 1 (or 0 for an empty slot), to find duplicates
+	size_t slots_count; //A power of two, or 0 if the hash table hasn't been built
+	void * mapping;     //The mapped compiled dictionary file, or NULL
+	size_t mapping_size;
+
+	uint64_t duplicates; //The number of tokens that weren't added because they were already in the dictionary
+	uint64_t skipped;    //The number of tokens that weren't added because they didn't fit under the byte limit
+} token_dictionary_t;
+
+//The start and the length of token i of a dictionary
+#define TOKEN_DICTIONARY_TOKEN(dict, i) ((dict)->data + (dict)->offsets[i])
+#define TOKEN_DICTIONARY_LENGTH(dict, i) ((size_t)((dict)->offsets[(i) + 1] - (dict)->offsets[i]))
+
+MUTATORS_API int token_dictionary_load(token_dictionary_t * dict, const char * path, size_t max_token_length, uint64_t max_bytes);
+MUTATORS_API int token_dictionary_save(const token_dictionary_t * dict, const char * filename);
+MUTATORS_API int token_dictionary_add(token_dictionary_t * dict, const uint8_t * token, size_t length, uint64_t max_bytes);
+MUTATORS_API void token_dictionary_free(token_dictionary_t * dict);
+MUTATORS_API size_t token_dictionary_memory_usage(const token_dictionary_t * dict);
@@ -0,0 +1,309 @@
+#include "token_matcher.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_NODE ((uint32_t)-1)
+
+typedef struct {
+	uint32_t first_child;  //The children of a node are kept in a linked list
+	uint32_t next_sibling;
+	uint32_t fail;         //The node for the longest proper suffix of this node that is in the trie
+	uint32_t output_link;  //The next node in the fail chain that ends a token
+	uint32_t first_output; //An index into outputs of the tokens that end at this node
+	uint32_t depth;
+	uint8_t byte;
+} trie_node_t;
+
+typedef struct {
+	uint32_t id;
+	uint32_t next;
+} trie_output_t;
+
+struct token_matcher
+{
+	trie_node_t * nodes;
+	uint32_t num_nodes;
+	uint32_t max_nodes;
+
+	trie_output_t * outputs;
+	uint32_t num_outputs;
+	uint32_t max_outputs;
+
+	uint32_t root_children[256]; //The root's children are looked up directly, as most bytes start at the root
+	int compiled;
+};
+
+static int grow_array(void ** array, uint32_t * max, uint32_t needed, size_t element_size)
+{
+	uint32_t new_max;
+	void * new_array;
+
+	if (needed <= *max)
+		return 0;
+	new_max = *max ? *max * 2 : 64;
+	while (new_max < needed)
+		new_max *= 2;
+	new_array = realloc(*array, new_max * element_size);
+	if (!new_array)
+		return 1;
+	*array = new_array;
+	*max = new_max;
+	return 0;
+}
+
+static uint32_t find_child(token_matcher_t * matcher, uint32_t node, uint8_t byte)
+{
+	uint32_t child;
+	if (node == 0)
+		return matcher->root_children[byte];
+	for (child = matcher->nodes[node].first_child; child != NO_NODE; child = matcher->nodes[child].next_sibling)
+	{
+		if (matcher->nodes[child].byte == byte)
+			return child;
+	}
+	return NO_NODE;
+}
+
+static uint32_t add_node(token_matcher_t * matcher, uint32_t parent, uint8_t byte)
+{
+	uint32_t node;
+	trie_node_t * new_node;
+
+	if (grow_array((void **)&matcher->nodes, &matcher->max_nodes, matcher->num_nodes + 1, sizeof(trie_node_t)))
+		return NO_NODE;
+	node = matcher->num_nodes++;
+	new_node = &matcher->nodes[node];
+	new_node->first_child = NO_NODE;
+	new_node->next_sibling = NO_NODE;
+	new_node->fail = 0;
+	new_node->output_link = NO_NODE;
+	new_node->first_output = NO_NODE;
+	new_node->byte = byte;
+	if (node == 0) { //The root
+		new_node->depth = 0;
+		return node;
+	}
+
+	new_node->depth = matcher->nodes[parent].depth + 1;
+	if (parent == 0)
+		matcher->root_children[byte] = node;
+	else {
+		new_node->next_sibling = matcher->nodes[parent].first_child;
+		matcher->nodes[parent].first_child = node;
+	}
+	return node;
+}
+
+/**
+ * Creates an empty token_matcher_t.  Tokens should be added with token_matcher_add, and then
+ * token_matcher_compile should be called before the matcher is used to scan a buffer.
+ * @return - the new token_matcher_t, or NULL on failure
+ */
+MUTATORS_API token_matcher_t * token_matcher_create(void)
+{
+	token_matcher_t * matcher = (token_matcher_t *)malloc(sizeof(token_matcher_t));
+	if (!matcher)
+		return NULL;
+	memset(matcher, 0, sizeof(token_matcher_t));
+	memset(matcher->root_children, 0xff, sizeof(matcher->root_children));
+	if (add_node(matcher, 0, 0) == NO_NODE) {
+		free(matcher);
+		return NULL;
+	}
+	return matcher;
+}
+
+/**
+ * Frees a token_matcher_t
+ * @param matcher - the token_matcher_t to free
+ */
+MUTATORS_API void token_matcher_free(token_matcher_t * matcher)
+{
+	if (!matcher)
+		return;
+	free(matcher->nodes);
+	free(matcher->outputs);
+	free(matcher);
+}
+
+/**
+ * Counts the memory held by a token_matcher_t, including the token_matcher_t itself
+ * @param matcher - the token_matcher_t to count the memory of, or NULL
+ * @return - the number of bytes allocated for the matcher
+ */
+MUTATORS_API size_t token_matcher_memory_usage(const token_matcher_t * matcher)
+{
+	if (!matcher)
+		return 0;
+	return sizeof(token_matcher_t) + (size_t)matcher->max_nodes * sizeof(trie_node_t) +
+		(size_t)matcher->max_outputs * sizeof(trie_output_t);
+}
+
+/**
+ * Adds a token to a token_matcher_t
+ * @param matcher - the token_matcher_t to add the token to
+ * @param token - the token to add
+ * @param length - the length of the token.  Empty tokens are ignored.
+ * @param id - an id for the token, which is returned in the matches found by token_matcher_scan
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_matcher_add(token_matcher_t * matcher, const uint8_t * token, size_t length, uint32_t id)
+{
+	uint32_t node = 0, child;
+	size_t i;
+
+	if (!length)
+		return 0;
+	for (i = 0; i < length; i++)
+	{
+		child = find_child(matcher, node, token[i]);
+		if (child == NO_NODE) {
+			child = add_node(matcher, node, token[i]);
+			if (child == NO_NODE)
+				return 1;
+		}
+		node = child;
+	}
+
+	if (grow_array((void **)&matcher->outputs, &matcher->max_outputs, matcher->num_outputs + 1, sizeof(trie_output_t)))
+		return 1;
+	matcher->outputs[matcher->num_outputs].id = id;
+	matcher->outputs[matcher->num_outputs].next = matcher->nodes[node].first_output;
+	matcher->nodes[node].first_output = matcher->num_outputs++;
+	matcher->compiled = 0;
+	return 0;
+}
+
+/**
+ * Computes the failure links for the tokens that have been added to a token_matcher_t
+ * @param matcher - the token_matcher_t to compile
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_matcher_compile(token_matcher_t * matcher)
+{
+	uint32_t * queue, head = 0, tail = 0, node, child, fail, next;
+	int i;
+
+	queue = (uint32_t *)malloc(matcher->num_nodes * sizeof(uint32_t));
+	if (!queue)
+		return 1;
+
+	//Walk the trie breadth first, so each node's fail node is done before the node itself
+	for (i = 0; i < 256; i++)
+	{
+		child = matcher->root_children[i];
+		if (child != NO_NODE) {
+			matcher->nodes[child].fail = 0;
+			matcher->nodes[child].output_link = NO_NODE;
+			queue[tail++] = child;
+		}
+	}
+
+	while (head < tail)
+	{
+		node = queue[head++];
+		for (child = matcher->nodes[node].first_child; child != NO_NODE; child = matcher->nodes[child].next_sibling)
+		{
+			fail = matcher->nodes[node].fail;
+			next = find_child(matcher, fail, matcher->nodes[child].byte);
+			while (next == NO_NODE && fail != 0) {
+				fail = matcher->nodes[fail].fail;
+				next = find_child(matcher, fail, matcher->nodes[child].byte);
+			}
+			fail = next == NO_NODE ? 0 : next;
+
+			matcher->nodes[child].fail = fail;
+			if (matcher->nodes[fail].first_output != NO_NODE)
+				matcher->nodes[child].output_link = fail;
+			else
+				matcher->nodes[child].output_link = matcher->nodes[fail].output_link;
+			queue[tail++] = child;
+		}
+	}
+
+	free(queue);
+	matcher->compiled = 1;
+	return 0;
+}
+
+static int compare_matches(const void * a, const void * b)
+{
+	const token_match_t * match_a = (const token_match_t *)a;
+	const token_match_t * match_b = (const token_match_t *)b;
+	if (match_a->offset != match_b->offset)
+		return match_a->offset < match_b->offset ? -1 : 1;
+	if (match_a->id != match_b->id)
+		return match_a->id < match_b->id ? -1 : 1;
+	return 0;
+}
+
+static int add_matches(token_matcher_t * matcher, uint32_t node, size_t end, token_match_t ** matches,
+	size_t * num_matches, size_t * max_matches)
+{
+	uint32_t output;
+	token_match_t * new_matches;
+
+	for (output = matcher->nodes[node].first_output; output != NO_NODE; output = matcher->outputs[output].next)
+	{
+		if (*num_matches == *max_matches) {
+			*max_matches = *max_matches ? *max_matches * 2 : 64;
+			new_matches = (token_match_t *)realloc(*matches, *max_matches * sizeof(token_match_t));
+			if (!new_matches)
+				return 1;
+			*matches = new_matches;
+		}
+		(*matches)[*num_matches].offset = end - matcher->nodes[node].depth;
+		(*matches)[*num_matches].id = matcher->outputs[output].id;
+		(*num_matches)++;
+	}
+	return 0;
+}
+
+/**
+ * Finds every occurrence of the tokens in a buffer
+ * @param matcher - a compiled token_matcher_t
+ * @param buffer - the buffer to search
+ * @param length - the length of the buffer
+ * @param matches - used to return an array of the matches found, sorted by offset and then id.
+ * The caller should free this array.
+ * @param num_matches - used to return the number of matches found
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_matcher_scan(token_matcher_t * matcher, const uint8_t * buffer, size_t length,
+	token_match_t ** matches, size_t * num_matches)
+{
+	uint32_t node = 0, next, output_node;
+	size_t i, max_matches = 0;
+
+	*matches = NULL;
+	*num_matches = 0;
+	if (!matcher->compiled && token_matcher_compile(matcher))
+		return 1;
+
+	for (i = 0; i < length; i++)
+	{
+		next = find_child(matcher, node, buffer[i]);
+		while (next == NO_NODE && node != 0) {
+			node = matcher->nodes[node].fail;
+			next = find_child(matcher, node, buffer[i]);
+		}
+		node = next == NO_NODE ? 0 : next;
+
+		for (output_node = matcher->nodes[node].first_output != NO_NODE ? node : matcher->nodes[node].output_link;
+			output_node != NO_NODE; output_node = matcher->nodes[output_node].output_link)
+		{
+			if (add_matches(matcher, output_node, i + 1, matches, num_matches, &max_matches)) {
+				free(*matches);
+				*matches = NULL;
+				*num_matches = 0;
+				return 1;
+			}
+		}
+	}
+
+	//The matches were found in the order that they end, sort them by where they start
+	if (*num_matches)
+		qsort(*matches, *num_matches, sizeof(token_match_t), compare_matches);
+	return 0;
+}
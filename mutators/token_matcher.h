@@ -0,0 +1,23 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//A place where one of the tokens was found in a buffer
+typedef struct {
+	size_t offset; //The offset of the start of the token
+	uint32_t id;   //The id the token was added with
+} token_match_t;
+
+//An Aho-Corasick automaton that finds every occurrence of a set of tokens in one pass over a buffer
+typedef struct token_matcher token_matcher_t;
+
+MUTATORS_API token_matcher_t * token_matcher_create(void);
+MUTATORS_API void token_matcher_free(token_matcher_t * matcher);
+MUTATORS_API size_t token_matcher_memory_usage(const token_matcher_t * matcher);
+MUTATORS_API int token_matcher_add(token_matcher_t * matcher, const uint8_t * token, size_t length, uint32_t id);
+MUTATORS_API int token_matcher_compile(token_matcher_t * matcher);
+MUTATORS_API int token_matcher_scan(token_matcher_t * matcher, const uint8_t * buffer, size_t length,
+	token_match_t ** matches, size_t * num_matches);
@@ -0,0 +1,277 @@
+#include "token_scorer.h"
+
+#include <jansson_helper.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Sets the number of tokens that a scorer keeps statistics for, and forgets any statistics it
+ * had.  This should be called whenever the dictionary is loaded.
+ * @param scorer - the token_scorer_t to resize
+ * @param num_tokens - the number of tokens in the dictionary
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_scorer_resize(token_scorer_t * scorer, size_t num_tokens)
+{
+	int enabled = scorer->enabled;
+
+	token_scorer_free(scorer);
+	scorer->enabled = enabled;
+	if (!num_tokens)
+		return 0;
+
+	scorer->uses = (uint64_t *)calloc(num_tokens, sizeof(uint64_t));
+	scorer->hits = (uint64_t *)calloc(num_tokens, sizeof(uint64_t));
+	scorer->cumulative = (double *)calloc(num_tokens, sizeof(double));
+	if (!scorer->uses || !scorer->hits || !scorer->cumulative) {
+		token_scorer_free(scorer);
+		scorer->enabled = enabled;
+		return 1;
+	}
+	scorer->num_tokens = num_tokens;
+	return 0;
+}
+
+/**
+ * Frees the statistics of a token_scorer_t.  The token_scorer_t itself is not freed.
+ * @param scorer - the token_scorer_t to free the statistics of
+ */
+MUTATORS_API void token_scorer_free(token_scorer_t * scorer)
+{
+	free(scorer->uses);
+	free(scorer->hits);
+	free(scorer->cumulative);
+	memset(scorer, 0, sizeof(token_scorer_t));
+}
+
+/**
+ * Counts the memory allocated by a token_scorer_t, not including the token_scorer_t itself
+ * @param scorer - the token_scorer_t to count the memory of
+ * @return - the number of bytes allocated for the scores
+ */
+MUTATORS_API size_t token_scorer_memory_usage(const token_scorer_t * scorer)
+{
+	if (!scorer->uses)
+		return 0;
+	return scorer->num_tokens * (2 * sizeof(uint64_t) + sizeof(double));
+}
+
+/**
+ * Whether a scorer has learned enough to prefer some tokens over others, i.e. it is enabled and at
+ * least one token has been used in an output that found new coverage.
+ * @param scorer - the token_scorer_t to check
+ * @return - 1 if the scores should be used, 0 otherwise
+ */
+MUTATORS_API int token_scorer_ready(token_scorer_t * scorer)
+{
+	return scorer->enabled && scorer->num_tokens && scorer->total_hits;
+}
+
+/**
+ * Estimates the rate at which outputs that use a token find new coverage.  Tokens that haven't been
+ * used much are assumed to find new coverage at the average rate.
+ * @param scorer - the token_scorer_t with the token's statistics
+ * @param token - the index of the token
+ * @return - the token's score
+ */
+MUTATORS_API double token_scorer_score(token_scorer_t * scorer, size_t token)
+{
+	double average_rate = (scorer->total_hits + 1.0) / (scorer->total_uses + 1.0);
+	if (token >= scorer->num_tokens)
+		return average_rate;
+	return (scorer->hits[token] + average_rate * TOKEN_SCORER_PRIOR_USES) / (scorer->uses[token] + TOKEN_SCORER_PRIOR_USES);
+}
+
+static void compute_cumulative(token_scorer_t * scorer)
+{
+	double total_score = 0, sum = 0;
+	size_t i;
+
+	for (i = 0; i < scorer->num_tokens; i++)
+	{
+		scorer->cumulative[i] = token_scorer_score(scorer, i);
+		total_score += scorer->cumulative[i];
+	}
+	for (i = 0; i < scorer->num_tokens; i++)
+	{
+		sum += (scorer->cumulative[i] / total_score) * (100 - TOKEN_SCORER_EXPLORE_PERCENT) / 100.0
+			+ (TOKEN_SCORER_EXPLORE_PERCENT / 100.0) / scorer->num_tokens;
+		scorer->cumulative[i] = sum;
+	}
+	scorer->cumulative_valid = 1;
+	scorer->reports_since_refresh = 0;
+}
+
+/**
+ * Chooses one of the tokens.  The caller should call token_scorer_use with the token if it is
+ * used in the output.
+ * @param scorer - the token_scorer_t to choose the token with
+ * @param num_tokens - the number of tokens in the dictionary.  If the scorer wasn't sized for this
+ * many tokens, the token is chosen uniformly.
+ * @param random - a random number used to choose the token
+ * @return - the index of the chosen token
+ */
+MUTATORS_API size_t token_scorer_choose(token_scorer_t * scorer, size_t num_tokens, uint64_t random)
+{
+	size_t low = 0, high, middle;
+	double target;
+
+	if (!token_scorer_ready(scorer) || scorer->num_tokens != num_tokens)
+		return (uint32_t)(random % (uint32_t)num_tokens);
+
+	if (!scorer->cumulative_valid || scorer->reports_since_refresh >= TOKEN_SCORER_REFRESH_REPORTS)
+		compute_cumulative(scorer);
+
+	//Binary search for the first token whose cumulative probability is above the target
+	target = (random >> 11) * (1.0 / 9007199254740992.0) * scorer->cumulative[scorer->num_tokens - 1];
+	high = scorer->num_tokens - 1;
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (scorer->cumulative[middle] > target)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	return low;
+}
+
+/**
+ * Records a token as used by the output that is being generated
+ * @param scorer - the token_scorer_t to record the token with
+ * @param token - the index of the token
+ */
+MUTATORS_API void token_scorer_use(token_scorer_t * scorer, size_t token)
+{
+	if (!scorer->enabled || token >= scorer->num_tokens || scorer->num_current == TOKEN_SCORER_MAX_OUTPUT_TOKENS)
+		return;
+	scorer->current[scorer->num_current++] = (uint32_t)token;
+}
+
+/**
+ * Records the tokens that were used to generate an output, so that they can be credited once
+ * its result is reported.
+ * @param scorer - the token_scorer_t that the tokens were recorded with
+ * @param iteration - the iteration of the output
+ */
+MUTATORS_API void token_scorer_finish(token_scorer_t * scorer, int iteration)
+{
+	token_scorer_output_t * output;
+
+	if (!scorer->enabled || !scorer->num_current)
+		return;
+	output = &scorer->history[scorer->history_next];
+	output->iteration = iteration;
+	output->num_tokens = scorer->num_current;
+	memcpy(output->tokens, scorer->current, scorer->num_current * sizeof(uint32_t));
+	scorer->history_next = (scorer->history_next + 1) % TOKEN_SCORER_HISTORY;
+	scorer->num_current = 0;
+}
+
+/**
+ * Updates the statistics of the tokens used to generate an output, based on whether it found
+ * new coverage.  Results for outputs that are no longer in the history are ignored.
+ * @param scorer - the token_scorer_t that the tokens were recorded with
+ * @param iteration - the iteration of the output
+ * @param new_coverage - whether the output found new coverage
+ */
+MUTATORS_API void token_scorer_report(token_scorer_t * scorer, int iteration, int new_coverage)
+{
+	token_scorer_output_t * output = NULL;
+	uint32_t token;
+	size_t i;
+
+	if (!scorer->enabled)
+		return;
+	for (i = 0; i < TOKEN_SCORER_HISTORY && !output; i++)
+	{
+		if (scorer->history[i].num_tokens && scorer->history[i].iteration == iteration)
+			output = &scorer->history[i];
+	}
+	if (!output)
+		return;
+
+	for (i = 0; i < output->num_tokens; i++)
+	{
+		token = output->tokens[i];
+		if (token >= scorer->num_tokens)
+			continue;
+		scorer->uses[token]++;
+		scorer->total_uses++;
+		if (new_coverage) {
+			scorer->hits[token]++;
+			scorer->total_hits++;
+		}
+	}
+	output->num_tokens = 0; //Each output is only counted once
+	scorer->reports_since_refresh++;
+}
+
+/**
+ * Adds the statistics a scorer has learned to a mutator's state
+ * @param obj - the JSON object to add the statistics to
+ * @param name - the name to save the statistics with
+ * @param scorer - the token_scorer_t to save
+ * @return - 1 on success, 0 on failure
+ */
+MUTATORS_API int token_scorer_add_to_json(json_t * obj, const char * name, token_scorer_t * scorer)
+{
+	json_t *temp, *token_list, *token_obj;
+	char enabled_name[256];
+	size_t i;
+
+	snprintf(enabled_name, sizeof(enabled_name), "%s_enabled", name);
+	ADD_INT(temp, scorer->enabled, obj, enabled_name);
+
+	token_list = json_array();
+	if (!token_list)
+		return 0;
+	json_object_set_new(obj, name, token_list);
+	for (i = 0; i < scorer->num_tokens; i++)
+	{
+		token_obj = json_object();
+		if (!token_obj)
+			return 0;
+		json_array_append_new(token_list, token_obj);
+		ADD_UINT64T(temp, scorer->uses[i], token_obj, "uses");
+		ADD_UINT64T(temp, scorer->hits[i], token_obj, "hits");
+	}
+	return 1;
+}
+
+/**
+ * Loads the statistics saved by token_scorer_add_to_json.  The scorer should already be sized for
+ * the dictionary with token_scorer_resize; statistics for tokens past the end of it are ignored.
+ * @param state - the mutator's saved state
+ * @param name - the name the statistics were saved with
+ * @param scorer - the token_scorer_t to load the statistics into
+ * @return - 0 on success, nonzero on failure
+ */
+MUTATORS_API int token_scorer_get_from_json(char * state, const char * name, token_scorer_t * scorer)
+{
+	int result, inner_result, temp_int;
+	uint64_t temp_uint64t;
+	char enabled_name[256];
+	json_t * token_obj;
+	size_t i = 0;
+
+	snprintf(enabled_name, sizeof(enabled_name), "%s_enabled", name);
+	GET_INT(temp_int, state, scorer->enabled, enabled_name, result);
+	if (token_scorer_resize(scorer, scorer->num_tokens))
+		return 1;
+
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_BEGIN(state, tokens, name, token_obj, result)
+		if (i < scorer->num_tokens) {
+			GET_ITEM(token_obj, scorer->uses[i], temp_uint64t, get_uint64t_options_from_json, "uses", inner_result);
+			GET_ITEM(token_obj, scorer->hits[i], temp_uint64t, get_uint64t_options_from_json, "hits", inner_result);
+			scorer->total_uses += scorer->uses[i];
+			scorer->total_hits += scorer->hits[i];
+			i++;
+		}
+	FOREACH_OBJECT_JSON_ARRAY_ITEM_END(tokens);
+	if (result < 0)
+		return 1;
+	return 0;
+}
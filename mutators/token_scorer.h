@@ -0,0 +1,60 @@
+#pragma once
+
+#include "mutators.h"
+
+#include <jansson.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The number of recent outputs whose tokens are remembered until their result is reported
+#define TOKEN_SCORER_HISTORY 256
+//The most tokens that are credited for a single output
+#define TOKEN_SCORER_MAX_OUTPUT_TOKENS 8
+//The percentage of the choices that are spread evenly across the tokens, so none of them starve
+#define TOKEN_SCORER_EXPLORE_PERCENT 10
+//The number of pseudo-uses with the average hit rate that each token starts with
+#define TOKEN_SCORER_PRIOR_USES 20
+//The number of reports between recomputing the token weights, so large dictionaries stay cheap
+#define TOKEN_SCORER_REFRESH_REPORTS 64
+
+//The tokens used to generate one of the recent outputs
+typedef struct {
+	int iteration;
+	uint32_t num_tokens;
+	uint32_t tokens[TOKEN_SCORER_MAX_OUTPUT_TOKENS];
+} token_scorer_output_t;
+
+//Counts how often each of a dictionary's tokens is used in an output that finds new coverage,
+//and chooses the productive tokens more often.  Each token is chosen with a probability
+//proportional to its hit rate, mixed with a uniform distribution so every token is still tried.
+typedef struct {
+	int enabled; //If not set, tokens are chosen uniformly (as random % num_tokens)
+
+	size_t num_tokens;
+	uint64_t * uses; //The number of reported outputs that used each token
+	uint64_t * hits; //The number of those outputs that found new coverage
+	uint64_t total_uses;
+	uint64_t total_hits;
+
+	uint32_t current[TOKEN_SCORER_MAX_OUTPUT_TOKENS]; //The tokens used by the output that is being generated
+	uint32_t num_current;
+	token_scorer_output_t history[TOKEN_SCORER_HISTORY];
+	size_t history_next;
+
+	double * cumulative; //The cumulative probability of choosing each token
+	int cumulative_valid;
+	uint64_t reports_since_refresh;
+} token_scorer_t;
+
+MUTATORS_API int token_scorer_resize(token_scorer_t * scorer, size_t num_tokens);
+MUTATORS_API void token_scorer_free(token_scorer_t * scorer);
+MUTATORS_API size_t token_scorer_memory_usage(const token_scorer_t * scorer);
+MUTATORS_API int token_scorer_ready(token_scorer_t * scorer);
+MUTATORS_API double token_scorer_score(token_scorer_t * scorer, size_t token);
+MUTATORS_API size_t token_scorer_choose(token_scorer_t * scorer, size_t num_tokens, uint64_t random);
+MUTATORS_API void token_scorer_use(token_scorer_t * scorer, size_t token);
+MUTATORS_API void token_scorer_finish(token_scorer_t * scorer, int iteration);
+MUTATORS_API void token_scorer_report(token_scorer_t * scorer, int iteration, int new_coverage);
+MUTATORS_API int token_scorer_add_to_json(json_t * obj, const char * name, token_scorer_t * scorer);
+MUTATORS_API int token_scorer_get_from_json(char * state, const char * name, token_scorer_t * scorer);
@@ -0,0 +1,69 @@
+#include "mutators_all.h"
+
+#include <string.h>
+
+//The mutators' function tables, which call each mutator's functions directly rather than through
+//a library loaded by mutator_factory
+extern mutator_t afl_mutator;
+extern mutator_t arithmetic_mutator;
+extern mutator_t bit_flip_mutator;
+extern mutator_t dictionary_mutator;
+extern mutator_t havoc_mutator;
+extern mutator_t honggfuzz_mutator;
+extern mutator_t input_to_state_mutator;
+extern mutator_t interesting_value_mutator;
+extern mutator_t multipart_mutator;
+extern mutator_t ni_mutator;
+extern mutator_t nop_mutator;
+extern mutator_t splice_mutator;
+extern mutator_t zzuf_mutator;
+#ifndef __APPLE__
+extern mutator_t radamsa_mutator;
+#endif
+
+static const mutator_registry_entry_t mutator_registry[] = {
+	{ "afl", &afl_mutator },
+	{ "arithmetic", &arithmetic_mutator },
+	{ "bit_flip", &bit_flip_mutator },
+	{ "dictionary", &dictionary_mutator },
+	{ "havoc", &havoc_mutator },
+	{ "honggfuzz", &honggfuzz_mutator },
+	{ "input_to_state", &input_to_state_mutator },
+	{ "interesting_value", &interesting_value_mutator },
+	{ "multipart", &multipart_mutator },
+	{ "ni", &ni_mutator },
+	{ "nop", &nop_mutator },
+#ifndef __APPLE__
+	{ "radamsa", &radamsa_mutator },
+#endif
+	{ "splice", &splice_mutator },
+	{ "zzuf", &zzuf_mutator },
+};
+
+/**
+ * Finds one of the mutators built into the mutators_all library
+ * @param name - the name of the mutator to find, e.g. afl
+ * @return - the mutator's function table, which must not be freed, or NULL if there isn't a
+ * mutator with that name
+ */
+MUTATORS_ALL_API mutator_t * mutators_all_find(const char * name)
+{
+	size_t i;
+	for (i = 0; i < sizeof(mutator_registry) / sizeof(mutator_registry[0]); i++)
+	{
+		if (!strcmp(mutator_registry[i].name, name))
+			return mutator_registry[i].mutator;
+	}
+	return NULL;
+}
+
+/**
+ * Lists the mutators built into the mutators_all library
+ * @param count - used to return the number of mutators
+ * @return - an array of the mutators' names and function tables
+ */
+MUTATORS_ALL_API const mutator_registry_entry_t * mutators_all_list(size_t * count)
+{
+	*count = sizeof(mutator_registry) / sizeof(mutator_registry[0]);
+	return mutator_registry;
+}
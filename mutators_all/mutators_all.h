@@ -0,0 +1,27 @@
+#pragma once
+
+#include <global_types.h>
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#if defined(MUTATORS_ALL_EXPORTS)
+#define MUTATORS_ALL_API __declspec(dllexport)
+#elif defined(MUTATORS_ALL_NO_IMPORT)
+#define MUTATORS_ALL_API
+#else
+#define MUTATORS_ALL_API __declspec(dllimport)
+#endif
+#else //_WIN32
+#define MUTATORS_ALL_API
+#endif
+
+//One of the mutators built into the mutators_all library
+typedef struct
+{
+	const char * name;
+	mutator_t * mutator;
+} mutator_registry_entry_t;
+
+MUTATORS_ALL_API mutator_t * mutators_all_find(const char * name);
+MUTATORS_ALL_API const mutator_registry_entry_t * mutators_all_list(size_t * count);
@@ -1,5 +1,7 @@
 #include "ni_mutator.h"
 #include <mutators.h>
+#include <seed_pool.h>
+#include <fixup.h>
 
 #include <utils.h>
 #include <jansson_helper.h>
@@ -36,8 +38,15 @@ struct ni_state
 
 	uint64_t random_state[2];
 	char ** sample_filenames;
-	size_t num_samples;
+	size_t num_sample_filenames;
+	size_t num_samples; //The number of samples that were loaded, which can be less than num_sample_filenames
 	sample_t ** samples;
+	uint64_t samples_bytes; //The bytes held by the samples
+	uint64_t memory_limit;  //The most bytes that the samples and seed pool can hold, or 0 for no limit
+	//The seeds that can be selected instead of the input, which are also used as samples
+	seed_pool_t seed_pool;
+	//The checksums and length fields that are recomputed in each output
+	fixup_list_t fixups;
 };
 typedef struct ni_state ni_state_t;
 
@@ -101,7 +110,8 @@ static inline long long rnd(ni_state_t * state) {
  * mutator options.
  * @param state - a mutator specific structure previously created by the create function.
  * @param index - The index of the sample file to retrieve. To retrieve the input buffer,
- * specify -1 for the index.
+ * specify -1 for the index.  Indices past the sample files retrieve the other seeds in the
+ * seed pool.
  * @param len - A pointer to a size_t used to return the length of the retrieved buffer
  * @return A pointer to the copy of the input buffer or sample
  */
@@ -113,6 +123,8 @@ static char * get_sample(ni_state_t * state, int index, size_t *len)
 	if(index < 0) {
 		length = state->input_length;
 		content = state->input;
+	} else if((size_t)index >= state->num_samples) {
+		content = seed_pool_other_seed(&state->seed_pool, (size_t)index - state->num_samples, &length);
 	} else {
 		length = state->samples[index]->length;
 		content = state->samples[index]->content;
@@ -132,10 +144,12 @@ static char * get_sample(ni_state_t * state, int index, size_t *len)
  */
 static char * get_random_sample(ni_state_t * state, size_t *len)
 {
-	int index = RAND(state, state->num_samples + 1);
+	size_t index = RAND(state, state->num_samples + 1 + seed_pool_other_count(&state->seed_pool));
 	if(index == state->num_samples)
 		return get_sample(state, -1, len);
-	return get_sample(state, index, len);
+	if(index > state->num_samples)
+		index--;
+	return get_sample(state, (int)index, len);
 }
 
 /*
@@ -555,7 +569,7 @@ retry:
 			if (end < 2)
 				goto retry;
 			a = RAND(state,end-2);
-			b = a + 2 + ((rnd(state) & 1) ? RAND(state,MIN(BUFSIZE-2, end-a-2)) : RAND(state,32));
+			b = a + 2 + ((rnd(state) & 1) ? RAND(state,MIN(BUFSIZE-2, end-a-2)) : RAND(state,(size_t)32));
 			write_all(state, data, a);
 			while(a + p < b)
 				buff[p++] = data[RAND(state,end)];
@@ -682,6 +696,10 @@ NI_MUTATOR_API void init(mutator_t * m)
 static ni_state_t * setup_options(char * options)
 {
 	ni_state_t * state;
+	sample_t * sample;
+	char * content;
+	int length;
+	uint64_t bytes;
 	size_t i;
 	state = (ni_state_t *)malloc(sizeof(ni_state_t));
 	if (!state)
@@ -702,27 +720,46 @@ static ni_state_t * setup_options(char * options)
 
 	PARSE_OPTION_UINT64T_TEMP(state, options, random_state[0], "random_state0", FUNCNAME(cleanup), temp1);
 	PARSE_OPTION_UINT64T_TEMP(state, options, random_state[1], "random_state1", FUNCNAME(cleanup), temp2);
-	PARSE_OPTION_ARRAY(state, options, sample_filenames, num_samples, "samples", FUNCNAME(cleanup));
+	PARSE_OPTION_UINT64T_TEMP(state, options, memory_limit, "memory_limit", FUNCNAME(cleanup), temp3);
+	PARSE_OPTION_ARRAY(state, options, sample_filenames, num_sample_filenames, "samples", FUNCNAME(cleanup));
+	if (fixup_list_parse(&state->fixups, options)) {
+		FUNCNAME(cleanup)(state);
+		return NULL;
+	}
 
-	if(state->num_samples) {
-		state->samples = calloc(state->num_samples, sizeof(void *));
+	if(state->num_sample_filenames) {
+		state->samples = calloc(state->num_sample_filenames, sizeof(void *));
 		if(!state->samples) {
 			FUNCNAME(cleanup)(state);
 			return NULL;
 		}
-		for(i = 0; i < state->num_samples; i++) {
+		for(i = 0; i < state->num_sample_filenames; i++) {
 
-			state->samples[i] = malloc(sizeof(sample_t));
-			if(!state->samples[i]) {
+			length = read_file(state->sample_filenames[i], &content);
+			if(length < 0) {
+				printf("Could not read file %s\n", state->sample_filenames[i]);
 				FUNCNAME(cleanup)(state);
 				return NULL;
 			}
-			state->samples[i]->length = read_file(state->sample_filenames[i], &state->samples[i]->content);
-			if(state->samples[i]->length < 0) {
-				printf("Could not read file %s\n", state->sample_filenames[i]);
+
+			//The samples that don't fit under the memory_limit are left out
+			bytes = length + sizeof(sample_t);
+			if(!memory_usage_fits(state->memory_limit, state->samples_bytes, bytes)) {
+				printf("Skipping sample %s, which doesn't fit under the memory_limit\n", state->sample_filenames[i]);
+				free(content);
+				continue;
+			}
+
+			sample = malloc(sizeof(sample_t));
+			if(!sample) {
+				free(content);
 				FUNCNAME(cleanup)(state);
 				return NULL;
 			}
+			sample->content = content;
+			sample->length = length;
+			state->samples[state->num_samples++] = sample;
+			state->samples_bytes += bytes;
 		}
 	}
 
@@ -773,15 +810,15 @@ NI_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 
 	destroy_mutex(ni_state->mutate_mutex);
 	for(i = 0; i < ni_state->num_samples; i++) {
-		if(ni_state->samples) {
-			if(ni_state->samples[i])
-				free(ni_state->samples[i]->content);
-			free(ni_state->samples[i]);
-		}
-		free(ni_state->sample_filenames[i]);
+		free(ni_state->samples[i]->content);
+		free(ni_state->samples[i]);
 	}
+	for(i = 0; i < ni_state->num_sample_filenames; i++)
+		free(ni_state->sample_filenames[i]);
 	free(ni_state->sample_filenames);
 	free(ni_state->samples);
+	seed_pool_free(&ni_state->seed_pool);
+	fixup_list_free(&ni_state->fixups);
 	free(ni_state->input);
 	free(ni_state);
 }
@@ -814,6 +851,9 @@ NI_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t
 	//Now mutate the buffer
 	ni_state->iteration++;
 	ni(ni_state);
+	if (fixup_list_update(&ni_state->fixups, (uint8_t *)ni_state->input, ni_state->input_length))
+		return -1;
+	fixup_list_apply(&ni_state->fixups, ni_state->mutated_buffer, (size_t)ni_state->mutated_buffer_length);
 	return (int)ni_state->mutated_buffer_length;
 }
 
@@ -849,6 +889,8 @@ NI_MUTATOR_API char * FUNCNAME(get_state)(void * mutator_state)
 	ADD_INT(temp, ni_state->iteration, obj, "iteration");
 	ADD_UINT64T(temp, ni_state->random_state[0], obj, "random_state0");
 	ADD_UINT64T(temp, ni_state->random_state[1], obj, "random_state1");
+	if (!seed_pool_add_to_json(obj, "seed_pool", &ni_state->seed_pool, ni_state->input, ni_state->input_length))
+		return NULL;
 	ret = json_dumps(obj, 0);
 	json_decref(obj);
 	return ret;
@@ -873,6 +915,9 @@ NI_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state)
 	GET_INT(temp_int, state, ni_state->iteration, "iteration", result);
 	GET_UINT64T(temp_uint64t, state, ni_state->random_state[0], "random_state0", result);
 	GET_UINT64T(temp_uint64t, state, ni_state->random_state[1], "random_state1", result);
+	if (seed_pool_get_from_json(state, "seed_pool", &ni_state->seed_pool, &ni_state->input, &ni_state->input_length, 0))
+		return 1;
+	ni_state->fixups.valid = 0; //The state's selected seed can replace the input
 	return 0;
 }
 
@@ -900,6 +945,100 @@ NI_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inp
 	SINGLE_INPUT_GET_INFO(ni_state_t);
 }
 
+/**
+ * This function adds a seed to the mutator's seed pool.  The seed can be selected with select_seed
+ * without recreating the mutator, and is used as one of the samples in the meantime.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param input - the seed to add
+ * @param input_length - the size in bytes of the input buffer.
+ * @return the id of the new seed on success, or -1 on failure (including when the seed doesn't fit
+ * under the memory_limit option)
+ */
+NI_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length)
+{
+	ni_state_t * ni_state = (ni_state_t *)mutator_state;
+	int id = -1;
+
+	if (take_mutex(ni_state->mutate_mutex))
+		return -1;
+	if (memory_usage_fits(ni_state->memory_limit, ni_state->samples_bytes + seed_pool_memory_usage(&ni_state->seed_pool),
+		input_length + sizeof(seed_pool_seed_t)))
+		id = seed_pool_add(&ni_state->seed_pool, input, input_length, NULL, 0);
+	else
+		printf("The seed doesn't fit under the memory_limit\n");
+	if (release_mutex(ni_state->mutate_mutex))
+		return -1;
+	return id;
+}
+
+/**
+ * This function removes a seed from the mutator's seed pool.  The selected seed can't be removed.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to remove, as returned by add_seed
+ * @return 0 on success and -1 on failure
+ */
+NI_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id)
+{
+	ni_state_t * ni_state = (ni_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(ni_state->mutate_mutex))
+		return -1;
+	ret = seed_pool_remove(&ni_state->seed_pool, id);
+	if (release_mutex(ni_state->mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function selects which of the seeds in the mutator's seed pool is mutated.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param id - the id of the seed to select, as returned by add_seed, or 0 for the input the
+ * mutator was created with
+ * @return 0 on success and -1 on failure
+ */
+NI_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id)
+{
+	ni_state_t * ni_state = (ni_state_t *)mutator_state;
+	int ret;
+
+	if (take_mutex(ni_state->mutate_mutex))
+		return -1;
+	ret = seed_pool_select(&ni_state->seed_pool, id, &ni_state->input, &ni_state->input_length, NULL);
+	if (!ret)
+		ni_state->fixups.valid = 0;
+	if (release_mutex(ni_state->mutate_mutex))
+		return -1;
+	return ret ? -1 : 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+NI_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	ni_state_t * ni_state = (ni_state_t *)mutator_state;
+	size_t i;
+
+	if (take_mutex(ni_state->mutate_mutex))
+		return -1;
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(ni_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = ni_state->input_length;
+	usage->bytes[MEMORY_USAGE_SAMPLES] = ni_state->samples_bytes + ni_state->num_sample_filenames * (sizeof(sample_t *) + sizeof(char *));
+	for (i = 0; i < ni_state->num_sample_filenames; i++)
+		usage->bytes[MEMORY_USAGE_SAMPLES] += strlen(ni_state->sample_filenames[i]) + 1;
+	usage->bytes[MEMORY_USAGE_SEEDS] = seed_pool_memory_usage(&ni_state->seed_pool);
+	usage->bytes[MEMORY_USAGE_INDEXES] = fixup_list_memory_usage(&ni_state->fixups);
+	if (release_mutex(ni_state->mutate_mutex))
+		return -1;
+	return 0;
+}
+
 /**
  * This function will set the input(saved in the mutators state) to something new.
  * This can be used to reinitialize a mutator with new data, without reallocating the entire state struct.
@@ -910,6 +1049,7 @@ NI_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inp
  */
 NI_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
 {
+	((ni_state_t *)mutator_state)->fixups.valid = 0; //The outputs are compared with the new input from now on
 	GENERIC_MUTATOR_SET_INPUT(ni_state_t);
 }
 
@@ -923,6 +1063,19 @@ NI_MUTATOR_API int FUNCNAME(help)(char ** help_str)
 	GENERIC_MUTATOR_HELP(
 "ni - ni-based mutator\n"
 "Options:\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
+"  memory_limit          The most bytes that the samples and the seeds added\n"
+"                          with add_seed can hold.  The samples that don't fit\n"
+"                          are skipped, and the seeds that don't fit are\n"
+"                          refused.  Default is 0 (no limit).\n"
 "  random_state0         The first half of the seed to honggfuzz's random\n"
 "                          number generator\n"
 "  random_state1         The second half of the seed to honggfuzz's random\n"
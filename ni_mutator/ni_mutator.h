@@ -14,6 +14,7 @@
 #endif
 
 #define MUTATOR_NAME "ni"
+#define MUTATOR_PREFIX ni
 
 NI_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 NI_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -25,6 +26,10 @@ NI_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
 NI_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 #define ni_get_total_iteration_count return_unknown_or_infinite_total_iterations
 NI_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+NI_MUTATOR_API int FUNCNAME(add_seed)(void * mutator_state, char * input, size_t input_length);
+NI_MUTATOR_API int FUNCNAME(remove_seed)(void * mutator_state, int id);
+NI_MUTATOR_API int FUNCNAME(select_seed)(void * mutator_state, int id);
+NI_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 NI_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 NI_MUTATOR_API int FUNCNAME(help)(char ** help_str);
 
@@ -127,6 +127,23 @@ NOP_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_in
 	SINGLE_INPUT_GET_INFO(nop_state_t);
 }
 
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+NOP_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	nop_state_t * nop_state = (nop_state_t *)mutator_state;
+
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(nop_state_t);
+	usage->bytes[MEMORY_USAGE_INPUT] = nop_state->input_length;
+	return 0;
+}
+
 /**
 * This function will set the input(saved in the mutators state) to something new.
 * This can be used to reinitialize a mutator with new data, without reallocating the entire state struct.
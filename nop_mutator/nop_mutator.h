@@ -14,6 +14,7 @@
 #endif
 
 #define MUTATOR_NAME "nop"
+#define MUTATOR_PREFIX nop
 
 NOP_MUTATOR_API void * FUNCNAME(create)(char * options, char * state, char * input, size_t input_length);
 NOP_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state);
@@ -25,6 +26,7 @@ NOP_MUTATOR_API int FUNCNAME(set_state)(void * mutator_state, char * state);
 NOP_MUTATOR_API int FUNCNAME(get_current_iteration)(void * mutator_state);
 #define nop_get_total_iteration_count return_unknown_or_infinite_total_iterations
 NOP_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_inputs, size_t **input_sizes);
+NOP_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage);
 NOP_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length);
 NOP_MUTATOR_API int FUNCNAME(help)(char ** help_str);
 
@@ -1,4 +1,5 @@
 #include "radamsa_mutator.h"
+#include <fixup.h>
 
 #include <jansson.h>
 #include <jansson_helper.h>
@@ -60,6 +61,9 @@ typedef struct radamsa_state
 
 	//A mutex used when doing thread safe mutations
 	mutex_t mutate_mutex;
+
+	//The checksums and length fields that are recomputed in each output
+	fixup_list_t fixups;
 } radamsa_state_t;
 
 static void cleanup_process(radamsa_state_t * state);
@@ -97,7 +101,7 @@ RADAMSA_MUTATOR_API void init(mutator_t * m)
 #define DEVELOP_PREFIX "../../" //CMake puts things at root/build/killerbeez/
 #endif
 
-RADAMSA_MUTATOR_API radamsa_state_t * setup_options(char * options)
+static radamsa_state_t * setup_options(char * options)
 {
 	radamsa_state_t * state;
 	state = (radamsa_state_t *)malloc(sizeof(radamsa_state_t));
@@ -120,6 +124,10 @@ RADAMSA_MUTATOR_API radamsa_state_t * setup_options(char * options)
 		PARSE_OPTION_INT(state, options, seed, "seed", FUNCNAME(cleanup));
 		PARSE_OPTION_INT(state, options, port, "port", FUNCNAME(cleanup));
 		PARSE_OPTION_INT(state, options, radamsa_iteration, "radamsa_iteration", FUNCNAME(cleanup));
+		if (fixup_list_parse(&state->fixups, options)) {
+			FUNCNAME(cleanup)(state);
+			return NULL;
+		}
 	}
 
 	if (!state->path) {
@@ -176,6 +184,7 @@ RADAMSA_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 	radamsa_state_t * state = (radamsa_state_t *)mutator_state;
 	cleanup_process(state);
 	destroy_mutex(state->mutate_mutex);
+	fixup_list_free(&state->fixups);
 	free(state->input);
 	free(state->path);
 	free(state);
@@ -259,8 +268,16 @@ static int mutate_inner(radamsa_state_t * state, char * buffer, size_t buffer_le
 RADAMSA_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_t buffer_length)
 {
 	radamsa_state_t * state = (radamsa_state_t *)mutator_state;
+	int length;
+
 	state->iteration++;
-	return mutate_inner(state, buffer, buffer_length);
+	length = mutate_inner(state, buffer, buffer_length);
+	if (length > 0) {
+		if (fixup_list_update(&state->fixups, (uint8_t *)state->input, state->input_length))
+			return -1;
+		fixup_list_apply(&state->fixups, (uint8_t *)buffer, length);
+	}
+	return length;
 }
 
 /**
@@ -328,6 +345,24 @@ RADAMSA_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * nu
 	SINGLE_INPUT_GET_INFO(radamsa_state_t);
 }
 
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+RADAMSA_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+	radamsa_state_t * state = (radamsa_state_t *)mutator_state;
+
+	memset(usage, 0, sizeof(memory_usage_t));
+	usage->bytes[MEMORY_USAGE_STATE] = sizeof(radamsa_state_t) + (state->path ? strlen(state->path) + 1 : 0);
+	usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+	usage->bytes[MEMORY_USAGE_INDEXES] = fixup_list_memory_usage(&state->fixups);
+	return 0;
+}
+
 /**
 * This function will set the input(saved in the mutators state) to something new.
 * This can be used to reinitialize a mutator with new data, without reallocating the entire state struct.
@@ -349,6 +384,7 @@ RADAMSA_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_inp
 	}
 	state->input_length = input_length;
 	memcpy(state->input, new_input, input_length);
+	state->fixups.valid = 0;
 	FUNCNAME(set_state)(mutator_state, NULL); //give the new input to radamsa.exe
 	return 0;
 }
@@ -364,6 +400,15 @@ RADAMSA_MUTATOR_API int FUNCNAME(help)(char** help_str)
 	GENERIC_MUTATOR_HELP(
 "radamsa - Radamsa mutator (Starts and calls radamsa to mutate input)\n"
 "Options:\n"
+"  fixups                A list of fields that are recomputed in each output, so\n"
+"                          checksums and length prefixes stay valid.  Each is an\n"
+"                          object with a type (crc32, crc32c, adler32, crc16, or\n"
+"                          length), the offset of the field, and optionally the\n"
+"                          start and end of the bytes it covers (by default, the\n"
+"                          whole output), its endian (little or big), and for\n"
+"                          length fields, their size (default 4) and an adjust\n"
+"                          to add to the length.  Negative offsets count back\n"
+"                          from the end of the output.\n"
 "  path                  The path to radamsa.exe\n"
 "  port                  The port to tell radamsa to bind to when starting up\n"
 "  radamsa_iteration     The number of iterations to seek forward in the\n"
@@ -1,5 +1,7 @@
 #include "zzuf_mutator.h"
 #include <mutators.h>
+#include <fixup.h>
+#include <output_filter.h>
 
 #include <utils.h>
 #include <jansson_helper.h>
@@ -45,6 +47,8 @@ struct zzuf_state
   unsigned char protect[256]; // Per-value byte protection
   unsigned char refuse[256];  // Per-value byte exclusion
   int64_t *ranges;            // Per-offset byte protection
+  fixup_list_t fixups;        // Checksums and length fields recomputed in each output
+  output_filter_t dedup;      // Outputs already returned, so they aren't returned again
 
   //Protects the fields below, i.e. the iteration count, data array, and random state
   mutex_t mutate_mutex;
@@ -405,7 +409,8 @@ static zzuf_state_t * setup_options(char * options)
 
   state->ratio = state->ratio < MIN_RATIO ? MIN_RATIO : state->ratio > MAX_RATIO ? MAX_RATIO : state->ratio;
   setup_state_from_strings(state);
-  if(state->mode == FUZZING_UNKNOWN) {
+  if(state->mode == FUZZING_UNKNOWN || fixup_list_parse(&state->fixups, options)
+    || output_filter_parse(&state->dedup, options)) {
     FUNCNAME(cleanup)(state);
     return NULL;
   }
@@ -456,6 +461,8 @@ ZZUF_MUTATOR_API void FUNCNAME(cleanup)(void * mutator_state)
 
   destroy_mutex(state->mutate_mutex);
   free_ranges(state);
+  fixup_list_free(&state->fixups);
+  output_filter_free(&state->dedup);
   free(state->input);
   free(state);
 }
@@ -471,14 +478,26 @@ ZZUF_MUTATOR_API int FUNCNAME(mutate)(void * mutator_state, char * buffer, size_
 {
   zzuf_state_t * state = (zzuf_state_t *)mutator_state;
   size_t mutated_buffer_length;
+  int retries;
   //Can't mutate an empty buffer
   if (buffer_length == 0)
     return -1;
 
   mutated_buffer_length = buffer_length > state->input_length ? state->input_length : buffer_length;
-  memcpy(buffer, state->input, mutated_buffer_length);
-  _zz_fuzz(state, buffer, mutated_buffer_length);
-  state->iteration++;
+  if (fixup_list_update(&state->fixups, (uint8_t *)state->input, state->input_length))
+    return -1;
+  for (retries = 0; ; retries++) {
+    memcpy(buffer, state->input, mutated_buffer_length);
+    state->current_chunk = -1; // The chunks' bitmasks depend on the iteration, so they can't be reused
+    _zz_fuzz(state, buffer, mutated_buffer_length);
+    state->iteration++;
+    fixup_list_apply(&state->fixups, (uint8_t *)buffer, mutated_buffer_length);
+
+    // A duplicate of an earlier output is skipped, moving on to the next iteration's seed
+    if (!state->dedup.enabled || retries == OUTPUT_FILTER_MAX_RETRIES
+      || !output_filter_check(&state->dedup, (uint8_t *)buffer, mutated_buffer_length))
+      break;
+  }
   return (int)mutated_buffer_length;
 }
 
@@ -579,6 +598,64 @@ ZZUF_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_i
   SINGLE_INPUT_GET_INFO(zzuf_state_t);
 }
 
+/**
+ * This function gets the statistics of the duplicate output filter that the dedup_size and
+ * dedup_file options enable. The duplicate rate is duplicates / checked.
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param checked - used to return the number of outputs that were checked against the filter
+ * @param duplicates - used to return the number of those outputs that were already in the filter,
+ * which were skipped
+ * @return 0 on success and -1 on failure
+ */
+ZZUF_MUTATOR_API int FUNCNAME(get_dedup_stats)(void * mutator_state, uint64_t * checked, uint64_t * duplicates)
+{
+  zzuf_state_t * state = (zzuf_state_t *)mutator_state;
+
+  if (take_mutex(state->mutate_mutex))
+    return -1;
+  *checked = state->dedup.checked;
+  *duplicates = state->dedup.duplicates;
+  if (release_mutex(state->mutate_mutex))
+    return -1;
+  return 0;
+}
+
+/**
+ * This function gets the number of bytes of memory that the mutator holds, in each of the
+ * MEMORY_USAGE_* categories (see mutators.h).
+ * @param mutator_state - a mutator specific structure previously created by the create function.
+ * @param usage - used to return the mutator's memory usage
+ * @return 0 on success and -1 on failure
+ */
+ZZUF_MUTATOR_API int FUNCNAME(get_memory_usage)(void * mutator_state, memory_usage_t * usage)
+{
+  zzuf_state_t * state = (zzuf_state_t *)mutator_state;
+  char * options[] = { state->protect_string, state->refuse_string, state->range_string, state->mode_string };
+  const char * parser;
+  size_t i;
+
+  if (take_mutex(state->mutate_mutex))
+    return -1;
+  memset(usage, 0, sizeof(memory_usage_t));
+  usage->bytes[MEMORY_USAGE_STATE] = sizeof(zzuf_state_t);
+  for (i = 0; i < sizeof(options) / sizeof(options[0]); i++)
+    if (options[i])
+      usage->bytes[MEMORY_USAGE_STATE] += strlen(options[i]) + 1;
+  usage->bytes[MEMORY_USAGE_INPUT] = state->input_length;
+  if (state->ranges) {
+    //_zz_allocrange allocates a pair for each comma separated range, plus a terminating pair
+    for (parser = state->range_string, i = 2; *parser; ++parser)
+      if (*parser == ',')
+        i++;
+    usage->bytes[MEMORY_USAGE_INDEXES] += i * 2 * sizeof(int64_t);
+  }
+  usage->bytes[MEMORY_USAGE_INDEXES] += fixup_list_memory_usage(&state->fixups);
+  usage->bytes[MEMORY_USAGE_DEDUP] = output_filter_memory_usage(&state->dedup);
+  if (release_mutex(state->mutate_mutex))
+    return -1;
+  return 0;
+}
+
 /**
  * This function will set the input(saved in the mutators state) to something new.
  * This can be used to reinitialize a mutator with new data, without reallocating the entire state struct.
@@ -589,6 +666,7 @@ ZZUF_MUTATOR_API void FUNCNAME(get_input_info)(void * mutator_state, int * num_i
  */
 ZZUF_MUTATOR_API int FUNCNAME(set_input)(void * mutator_state, char * new_input, size_t input_length)
 {
+  ((zzuf_state_t *)mutator_state)->fixups.valid = 0; //The outputs are compared with the new input from now on
   GENERIC_MUTATOR_SET_INPUT(zzuf_state_t);
 }
 
@@ -602,6 +680,13 @@ ZZUF_MUTATOR_API int FUNCNAME(help)(char ** help_str)
   GENERIC_MUTATOR_HELP(
       "zzuf - zzuf-based mutator\n"
       "Options:\n"
+      "\tdedup_file            file that backs the duplicate output filter, so the\n"
+      "\t                      processes that share it skip each other's outputs\n"
+      "\tdedup_size            size of the duplicate output filter in bytes\n"
+      "\tfixups                checksum and length fields to recompute in each output,\n"
+      "\t                      as a list of objects with a type (crc32, crc32c,\n"
+      "\t                      adler32, crc16, or length), offset, start, end,\n"
+      "\t                      endian, size, and adjust\n"
       "\tmode                  fuzzing mode to use: xor, set, or unset\n"
       "\tprotect               protect bytes and characters in <list>\n"
       "\trange                 only fuzz bytes at offsets within <ranges>\n"